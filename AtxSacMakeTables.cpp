@@ -8,16 +8,52 @@
 
 #include <Rcpp.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <system_error>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ATXSAC_HAVE_MMAP 1
+#define ATXSAC_HAVE_GETRUSAGE 1
+#endif
+
+#if defined(_WIN32)
+#include <process.h>
+#endif
+
+#if defined(R_VERSION)
+#if R_VERSION >= R_Version(3, 6, 0)
+#include <R_ext/Altrep.h>
+#define ATXSAC_HAVE_ALTREP 1
+#endif
+#endif
 using namespace Rcpp;
 using std::vector;
 using std::sort;
 using std::string;
-using std::map;
 using std::pair;
 using std::make_pair;
-using std::shared_ptr;
 using std::unique_ptr;
-using std::make_shared;
 using std::iterator;
 using std::ostream;
 using std::ostringstream;
@@ -26,8 +62,9 @@ using std::endl;
 
 
 
-// RCpp as<string> converts any missing R character vectors to the string "NA".
-// Therefore "NA" is a special string value.
+// RCpp as<string> converts any missing R character vectors to the string "NA",
+// and the characters of NA_STRING are also "NA". Therefore "NA" is a special
+// string value.
 
 static const string NaString = "NA";
 
@@ -60,6 +97,10 @@ namespace Col
     static const string OutcomeSubType = "outcome_subtype";
     static const string OutcomeCondition = "outcome_condition";
     static const string OutcomeSpayNeuter = "outcome_spay_neuter";
+    static const string Discrepancy = "discrepancy";
+    static const string Action = "action";
+    static const string Source = "source";
+    static const string City = "city";
 }
 
 
@@ -96,544 +137,405 @@ static string DateTimeToString (const Datetime& dateTime)
 
 
 /*
- *  Class: WrapAsFactor
+ *  Function: HashString
  *
- *      Converts a C++ vector of strings to a wrapped R vector of factors.
+ *      Computes the 64-bit FNV-1a hash of a string of characters.
  *      
  */
-static IntegerVector WrapAsFactor (const vector<string>& stringVector)
+static size_t HashString (const char* text, size_t length)
 {
-    // Convert the raw string vector to a wrapped R vector of character
-    // vectors.
+    uint64_t hash = 14695981039346656037ULL;
 
-    CharacterVector charVector = wrap(stringVector);
-    
-    // Build an R character vector that contains unique strings; that
-    // is, does not contain redundant duplicates of any strings.
-
-    CharacterVector levelsVector = sort_unique(charVector);
-    
-    // Number of unique strings is the number of factor levels.
-    // Now have to find the special literal string "NA" and remove
-    // it, because we don't want that special string to become
-    // a factor level.
-
-    int numLevels = levelsVector.size();
-    
-    for (int i = 0; i < numLevels; ++i)
+    for (size_t i = 0; i < length; ++i)
     {
-        if (string((char*) levelsVector[i]) == "NA")
-        {
-            levelsVector.erase(i);
-            break;
-        }
+        hash ^= (unsigned char) text[i];
+        hash *= 1099511628211ULL;
     }
-    
-    // Create the integer vector of factor indexes by assigning sequential
-    // numbers 1..numLevels to the unique strings, with "NA" removed.
-
-    IntegerVector factorVector = match(charVector, levelsVector);
-    
-    // Make the vector an R vector of factors by assigning the right
-    // class name and attaching the vector of level names.
 
-    factorVector.attr("levels") = levelsVector;
-    factorVector.attr("class") = "factor";
-    
-    return factorVector;
+    return (size_t) hash;
 }
 
 
 
 
-enum DayRelation
+/*
+ *  Function: GetVectorBytes
+ *
+ *      Returns the number of bytes allocated for the elements of a vector.
+ *      
+ */
+template <typename T>
+static inline size_t GetVectorBytes (const vector<T>& elements)
 {
-    EarlierDay,
-    SameDay,
-    LaterDay
-};
+    return elements.capacity() * sizeof(T);
+}
 
 
 
 
 /*
- *  Class: CompareByDay
+ *  Function: GetProcessId
  *
- *      Determines whether the first date-time is on the same day,
- *      an earlier day, or a later day than the second date-time.
+ *      Returns the ID of the current process, to tag the names of files
+ *      that other processes may write to the same directory.
  *      
  */
-static DayRelation CompareByDay (const Datetime& dateTime1, const Datetime& dateTime2)
+static long GetProcessId ()
 {
-    int year1 = dateTime1.getYear();
-    int year2 = dateTime2.getYear();
-    
-    if (year1 < year2)
-        return EarlierDay;
-    if (year1 > year2)
-        return LaterDay;
-    
-    // Same year, check the month.
-
-    int month1 = dateTime1.getMonth();
-    int month2 = dateTime2.getMonth();
-    
-    if (month1 < month2)
-        return EarlierDay;
-    if (month1 > month2)
-        return LaterDay;
-
-    // Same month, check the day.
-
-    int day1 = dateTime1.getDay();
-    int day2 = dateTime2.getDay();
-    
-    if (day1 < day2)
-        return EarlierDay;
-    if (day1 > day2)
-        return LaterDay;
-    
-    return SameDay;
+#if defined(_WIN32)
+    return _getpid();
+#else
+    return getpid();
+#endif
 }
 
 
 
 
+/*
+ *  Function: MakeTempFilePath
+ *
+ *      Returns the name under which to write a file before it is renamed
+ *      into place: the name of the file, tagged with the process ID, so
+ *      that sessions refreshing the same cache in the background never
+ *      write the same temporary file.
+ *      
+ */
+static string MakeTempFilePath (const string& filePath)
+{
+    return filePath + "." + std::to_string(GetProcessId()) + ".tmp";
+}
 
 
 
-/*** Intake ******************************************************************/
-
-class Intake;
-typedef shared_ptr<Intake> IntakeRef;
-
-
 
+/*** Stopwatch ***************************************************************/
 
 /*
- *  Class: Intake
+ *  Class: Stopwatch
  *
- *      Animal intake event.
+ *      Measures elapsed wall-clock time, for timing the phases of a build.
+ *      The stopwatch starts when it is constructed.
  *      
  */
-class Intake
+class Stopwatch
 {
 public:
-    Intake ();
-    ~Intake () {}
-    
-    // Properties
-    
-    Datetime GetIntakeDate () const
-    { return mIntakeDate; }
-
-    void SetIntakeDate (const Datetime& intakeDate)
-    { mIntakeDate = intakeDate; }
-
-    string GetIntakeType () const
-    { return mIntakeType; }
-    
-    void SetIntakeType (const string& intakeType)
-    { mIntakeType = intakeType; }
-    
-    string GetIntakeSubType () const
-    { return mIntakeSubType; }
-
-    void SetIntakeSubType (const string& intakeSubType)
-    { mIntakeSubType = intakeSubType; }
-    
-    string GetIntakeCondition () const
-    { return mIntakeCondition; }
-
-    void SetIntakeCondition (const string& intakeCondition)
-    { mIntakeCondition = intakeCondition; }
-
-    string GetIntakeLocation () const
-    { return mIntakeLocation; }
+    Stopwatch () : mStart(Clock::now()) {}
 
-    void SetIntakeLocation (const string& intakeLocation)
-    { mIntakeLocation = intakeLocation; }
+    // Seconds since the stopwatch was started or last lapped.
 
-    int GetIntakeAgeCount () const
-    { return mIntakeAgeCount; }
+    double GetSeconds () const
+    { return std::chrono::duration<double>(Clock::now() - mStart).count(); }
 
-    void SetIntakeAgeCount (int intakeAgeCount)
-    { mIntakeAgeCount = intakeAgeCount; }
+    // Returns the seconds since the stopwatch was started or last lapped,
+    // and starts timing the next lap.
 
-    string GetIntakeAgeUnits () const
-    { return mIntakeAgeUnits; }
-    
-    void SetIntakeAgeUnits (const string& intakeAgeUnits)
-    { mIntakeAgeUnits = intakeAgeUnits; }
+    double Lap ()
+    { double seconds = GetSeconds(); mStart = Clock::now(); return seconds; }
 
-    int GetIntakeAge () const
-    { return mIntakeAge; }
-    
-    void SetIntakeAge (int intakeAge)
-    { mIntakeAge = intakeAge; }
+private:
+    typedef std::chrono::steady_clock Clock;
 
-    string GetIntakeSpayNeuter () const
-    { return mIntakeSpayNeuter; }
-    
-    void SetIntakeSpayNeuter (const string& intakeSpayNeuter)
-    { mIntakeSpayNeuter = intakeSpayNeuter; }
+    Clock::time_point mStart;       // Start of the current lap
+};
 
-    string GetKennel () const
-    { return mKennel; }
 
-    void SetKennel (const string& kennel)
-    { mKennel = kennel; }
-    
-    // Convert to printable string.
 
-    string ToString () const;
-    
-private:
-    
-    Datetime mIntakeDate;       // Intake event timestamp
-    string mIntakeType;         // Type of intake (e.g., Stray, Owner Surrender)
-    string mIntakeSubType;      // Sub-type of intake type (e.g., Stray/Field, Owner Surrender/OTC)
-    string mIntakeCondition;    // Condition at time of intake (e.g., Normal, Injured)
-    string mIntakeLocation;     // Place where animal was captured or surrendered
-    int mIntakeAgeCount;        // Integer age
-    string mIntakeAgeUnits;     // Units of the integer age (e.g., dy, mo, yr)
-    int mIntakeAge;             // Age represented as a count of seconds (denormalized age count)
-    string mIntakeSpayNeuter;   // Sterilization status (e.g., Intact, Altered)
-    string mKennel;             // Kennel assignment
-};
 
+/*** Profiling ***************************************************************/
 
+// Builds compiled with ATXSAC_PROFILE defined time the hot paths of the
+// engine: ATXSAC_PROFILE_SCOPE(name) counts the calls to its enclosing
+// scope and the time spent in it, under the name of the probe, and the
+// counts are returned by hmProfileCounters. Other builds compile the
+// timers out. The counts of scopes run on worker threads are sums over
+// the threads.
 
+#if defined(ATXSAC_PROFILE)
 
 /*
- *  Function: IntakeTimeLessThan
+ *  Struct: ProfileProbe
  *
- *      Compares the intake timestamps of two intake objects and returns
- *      whether the first is less than the second.
- *      
- *      Used when sorting a container of intake objects by intake date-time.
+ *      Counts of a timed scope. A probe is a static object of its scope,
+ *      and adds itself to the list of probes when first constructed.
  *      
  */
-static bool IntakeTimeLessThan (const IntakeRef& intakeA, const IntakeRef& intakeB)
+struct ProfileProbe
 {
-    return (intakeA->GetIntakeDate() < intakeB->GetIntakeDate());
-}
-
+    ProfileProbe (const char* probeName);
 
+    // First probe of the list of all probes constructed.
 
+    static std::atomic<ProfileProbe*>& GetFirst ()
+    { static std::atomic<ProfileProbe*> first(nullptr); return first; }
 
-/*
- *  Method: Null constructor
- *
- *      Initializes this object to NA.
- *      
- */
-Intake::Intake ()
-       :
-        mIntakeDate(NA_REAL),
-        mIntakeType(NaString),
-        mIntakeSubType(NaString),
-        mIntakeCondition(NaString),
-        mIntakeLocation(NaString),
-        mIntakeAgeCount(NA_INTEGER),
-        mIntakeAgeUnits(NaString),
-        mIntakeAge(NA_INTEGER),
-        mIntakeSpayNeuter(NaString),
-        mKennel(NaString)
-{
-}
+    const char* name;                   // Name of the probe
+    std::atomic<int64_t> calls;         // Number of times the scope ran
+    std::atomic<int64_t> nanoseconds;   // Time spent in the scope
+    ProfileProbe* next;                 // Next probe in the list
+};
 
 
 
 
 /*
- *  Method: ToString
+ *  Method: Constructor
  *
- *      Returns the printable string representation of this object.
+ *      Initializes a probe with zero counts, and adds it to the list of
+ *      probes. Probes of different scopes may be constructed at once on
+ *      different threads.
  *      
  */
-string Intake::ToString () const
+ProfileProbe::ProfileProbe (const char* probeName)
+            :
+             name(probeName),
+             calls(0),
+             nanoseconds(0),
+             next(nullptr)
 {
-    ostringstream buffer;
-    
-    buffer << "Intake " << DateTimeToString(mIntakeDate)
-           << " type(" << mIntakeType
-           << ") subtype(" << mIntakeSubType
-           << ") condition(" << mIntakeCondition
-           << ") spayNeuter(" << mIntakeSpayNeuter
-           << ") ageCount(" << mIntakeAgeCount
-           << ") ageUnits(" << mIntakeAgeUnits
-           << ") age(" << mIntakeAge
-           << ") location(" << mIntakeLocation
-           << ") kennel(" << mKennel
-           << ")";
-    
-    return buffer.str();
-}
+    std::atomic<ProfileProbe*>& first = GetFirst();
 
+    next = first.load();
 
-
-
-/*** Outcome *****************************************************************/
-
-class Outcome;
-typedef shared_ptr<Outcome> OutcomeRef;
+    while (!first.compare_exchange_weak(next, this))
+        ;
+}
 
 
 
 
 /*
- *  Class: Outcome
+ *  Class: ProfileScope
  *
- *      Animal outcome event.
+ *      Adds the time from its construction to its destruction to the
+ *      counts of a probe.
  *      
  */
-class Outcome
+class ProfileScope
 {
 public:
-    Outcome ();
-    ~Outcome () {}
+    ProfileScope (ProfileProbe& probe) : mProbe(probe), mStart(Clock::now()) {}
 
-    // Properties
+    ~ProfileScope ()
+    {
+        int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - mStart).count();
 
-    Datetime GetOutcomeDate () const
-    { return mOutcomeDate; }
-    
-    void SetOutcomeDate (const Datetime& outcomeDate)
-    { mOutcomeDate = outcomeDate; }
+        mProbe.calls.fetch_add(1, std::memory_order_relaxed);
+        mProbe.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
 
-    string GetOutcomeType () const
-    { return mOutcomeType; }
-    
-    void SetOutcomeType (const string& outcomeType)
-    { mOutcomeType = outcomeType; }
+private:
+    ProfileScope (const ProfileScope&);
+    ProfileScope& operator= (const ProfileScope&);
 
-    string GetOutcomeSubType () const
-    { return mOutcomeSubType; }
-    
-    void SetOutcomeSubType (const string& outcomeSubType)
-    { mOutcomeSubType = outcomeSubType; }
+    typedef std::chrono::steady_clock Clock;
 
-    string GetOutcomeCondition () const
-    { return mOutcomeCondition; }
-    
-    void SetOutcomeCondition (const string& outcomeCondition)
-    { mOutcomeCondition = outcomeCondition; }
+    ProfileProbe& mProbe;           // Probe of the scope
+    Clock::time_point mStart;       // Start of the scope
+};
 
-    string GetOutcomeSpayNeuter () const
-    { return mOutcomeSpayNeuter; }
+#define ATXSAC_PROFILE_JOIN2(a, b) a##b
+#define ATXSAC_PROFILE_JOIN(a, b) ATXSAC_PROFILE_JOIN2(a, b)
+#define ATXSAC_PROFILE_SCOPE(name) \
+    static ProfileProbe ATXSAC_PROFILE_JOIN(profileProbe, __LINE__)(name); \
+    ProfileScope ATXSAC_PROFILE_JOIN(profileScope, __LINE__)(ATXSAC_PROFILE_JOIN(profileProbe, __LINE__))
 
-    void SetOutcomeSpayNeuter (const string& outcomeSpayNeuter)
-    { mOutcomeSpayNeuter = outcomeSpayNeuter; }
+#else
 
-    // Convert to printable string.
+#define ATXSAC_PROFILE_SCOPE(name)
 
-    string ToString () const;
-    
-private:
-    
-    Datetime mOutcomeDate;      // Intake event timestamp
-    string mOutcomeType;        // Type of outcome (e.g., Adoption, Transfer, Return to Owner)
-    string mOutcomeSubType;     // Sub-type of outcome type (e.g., Adoption/Foster, Transfer/Partner)
-    string mOutcomeCondition;   // Condition at time of discharge (e.g., Normal, Sick)
-    string mOutcomeSpayNeuter;  // Sterilization status when discharged (e.g., Intact, Altered)
-};
+#endif
 
 
 
 
+/*** ParallelFor *************************************************************/
+
 /*
- *  Function: OutcomeTimeLessThan
+ *  Function: GetNumWorkerThreads
  *
- *      Compares the outcome timestamps of two outcome objects and returns
- *      whether the first is less than the second.
- *      
- *      Used when sorting a container of outcome objects by outcome date-time.
+ *      Returns the number of threads to use for work that is split across
+ *      cores, which is the number of hardware threads.
  *      
  */
-static bool OutcomeTimeCompare (const OutcomeRef& outcomeA, const OutcomeRef& outcomeB)
+static int GetNumWorkerThreads ()
 {
-    return (outcomeA->GetOutcomeDate() < outcomeB->GetOutcomeDate());
+    int numThreads = std::thread::hardware_concurrency();
+
+    return (numThreads > 0) ? numThreads : 1;
 }
 
 
 
 
 /*
- *  Method: Null constructor
+ *  Function: ParallelFor
  *
- *      Initializes this object to NA.
+ *      Runs body(task) for each task in [0, numTasks), spread across up to
+ *      numThreads threads (including the calling thread). Each thread takes
+ *      the next unclaimed task until none remain, so tasks may run in any
+ *      order and the body must only write to per-task state.
+ *
+ *      The body must not call the R API. The first exception thrown by any
+ *      task is rethrown on the calling thread once all threads finish.
  *      
  */
-Outcome::Outcome ()
-        :
-         mOutcomeDate(NA_REAL),
-         mOutcomeType(NaString),
-         mOutcomeSubType(NaString),
-         mOutcomeCondition(NaString),
-         mOutcomeSpayNeuter(NaString)
+template <class Body>
+static void ParallelFor (int numTasks, int numThreads, const Body& body)
 {
-}
+    if (numThreads > numTasks)
+        numThreads = numTasks;
 
+    if (numThreads <= 1)
+    {
+        for (int task = 0; task < numTasks; ++task)
+            body(task);
 
+        return;
+    }
 
+    std::atomic<int> nextTask(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr firstError;
 
-/*
- *  Method: ToString
- *
- *      Returns the printable string representation of this object.
- *      
- */
-string Outcome::ToString () const
-{
-    ostringstream buffer;
+    auto worker = [&] ()
+    {
+        try
+        {
+            for (int task = nextTask++; task < numTasks && !failed; task = nextTask++)
+                body(task);
+        }
+        catch (...)
+        {
+            // Keep only the first error; the other threads stop taking tasks.
 
-    buffer << "Outcome " << DateTimeToString(mOutcomeDate)
-           << " type(" << mOutcomeType
-           << ") subtype(" << mOutcomeSubType
-           << ") spayNeuter(" << mOutcomeSpayNeuter
-           << ")";
+            if (!failed.exchange(true))
+                firstError = std::current_exception();
+        }
+    };
 
-    return buffer.str();
+    // Start the other threads. When a thread cannot be started, carry on
+    // with those that were.
+
+    vector<std::thread> threads;
+
+    for (int i = 1; i < numThreads; ++i)
+    {
+        try
+        {
+            threads.push_back(std::thread(worker));
+        }
+        catch (const std::system_error&)
+        {
+            break;
+        }
+    }
+
+    worker();
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    if (firstError)
+        std::rethrow_exception(firstError);
 }
 
 
 
 
+/*** SymbolTable *************************************************************/
 
-/*** Animal ******************************************************************/
+// A symbol is the 32-bit identifier of an interned string. Symbol zero is
+// reserved for NA.
+
+typedef uint32_t Symbol;
 
-class Animal;
-typedef shared_ptr<Animal> AnimalRef;
+static const Symbol NaSymbol = 0;
 
 
 
 
 /*
- *  Class: Animal
+ *  Class: SymbolTable
  *
- *      Animal description.
+ *      Table of interned strings. Each distinct string is stored once and
+ *      is referred to by its symbol.
+ *
+ *      Categorical fields of the animal and event objects are stored as
+ *      symbols, so that ingesting a record does not copy strings, and so
+ *      that factor levels can be made directly from this table.
+ *
+ *      R character vector elements (CHARSXPs) can be interned directly.
+ *      Because R caches CHARSXPs, equal strings are usually the same
+ *      CHARSXP, so the symbol of each CHARSXP is remembered by address.
+ *      The remembered addresses are valid only while the input data frames
+ *      are protected, and must be forgotten at the end of a build.
  *      
  */
-class Animal
+class SymbolTable
 {
 public:
-    
-    Animal (const string& animalId, const Datetime& dateTime);
-    ~Animal () {}
-
-    // Add intake or outcome events for this animal.
-
-    void AddIntake (const IntakeRef& intake);
-    void AddOutcome (const OutcomeRef& outcome);
-    
-    // Update fields from another animal.
-    
-    void UpdateIfNewer (const AnimalRef& animal);
-
-    // Properties
+    SymbolTable ();
+    ~SymbolTable () {}
 
-    int GetNumIntakes () const
-    { return mIntakeList.size(); }
-    
-    IntakeRef GetIntakeAt (int i) const
-    { return mIntakeList.at(i); }
+    // Find or add the symbol for a string.
 
-    int GetNumOutcomes () const
-    { return mOutcomeList.size(); }
-    
-    OutcomeRef GetOutcomeAt (int i) const
-    { return mOutcomeList.at(i); }
-    
-    // Sort the intake or outcome events for this animal.
+    Symbol Intern (const char* text, size_t length);
 
-    void SortIntakes ();
-    void SortOutcomes ();
-    
-    // Properties
-    
-    string GetAnimalId () const
-    { return mAnimalId; }
+    Symbol Intern (const string& text)
+    { return Intern(text.data(), text.size()); }
 
-    void SetAnimalId (const string& animalId)
-    { mAnimalId = animalId; }
+    // Find or add the symbol for an R CHARSXP.
 
-    string GetKind () const
-    { return mKind; }
+    Symbol Intern (SEXP charSxp);
 
-    void SetKind (const string& kind)
-    { mKind = kind; }
-    
-    string GetName () const
-    { return mName; }
-    
-    void SetName (const string& name)
-    { mName = name; }
+    // Forget the addresses of interned CHARSXPs.
 
-    string GetGender () const
-    { return mGender; }
-    
-    void SetGender (const string& gender)
-    { mGender = gender; }
+    void ForgetCharSxps ();
 
-    string GetColor1 () const
-    { return mColor1; }
-    
-    void SetColor1 (const string& color1)
-    { mColor1 = color1; }
+    // Remove all symbols other than NA.
 
-    string GetColor2 () const
-    { return mColor2; }
-    
-    void SetColor2 (const string& color2)
-    { mColor2 = color2; }
+    void Clear ();
 
-    string GetBreed1 () const
-    { return mBreed1; }
-    
-    void SetBreed1 (const string& breed1)
-    { mBreed1 = breed1; }
+    // Number of bytes allocated by this table.
 
-    string GetBreed2 () const
-    { return mBreed2; }
-    
-    void SetBreed2 (const string& breed2)
-    { mBreed2 = breed2; }
+    size_t GetNumBytes () const;
 
-    Datetime GetDateTime () const
-    { return mDateTime; }
+    // Properties
 
-    // Convert to printable string.
+    int GetNumSymbols () const
+    { return mStrings.size(); }
 
-    string ToString () const;
+    const string& GetString (Symbol symbol) const
+    { return mStrings.at(symbol); }
 
-    // Print this animal and all intake and outcome events.
+    // Symbols ordered by ascending string value (NA excluded).
 
-    void DeepPrint (ostream& output) const;
+    const vector<Symbol>& GetSortedOrder () const;
 
 private:
-
-    void RemoveIntakeAt (int index)
-    { mIntakeList.erase(mIntakeList.begin() + index); }
+    void Grow ();
+    void GrowCharSxps ();
 
 private:
+    static const Symbol EmptySlot = 0;
+
+    vector<string> mStrings;                // Strings, indexed by symbol
+    vector<size_t> mHashes;                 // Hashes of strings, indexed by symbol
+    vector<Symbol> mSlots;                  // Hash table of symbols (NA marks empty)
+    size_t mSlotMask;                       // Number of slots minus one (power of two)
+    vector<SEXP> mCharSxpSlots;             // Hash table of CHARSXP addresses (nullptr marks empty)
+    vector<Symbol> mCharSxpSymbols;         // Symbols of the CHARSXPs, by slot
+    size_t mCharSxpSlotMask;                // Number of CHARSXP slots minus one (power of two)
+    size_t mNumCharSxps;                    // Number of CHARSXP addresses remembered
+    mutable vector<Symbol> mSortedOrder;    // Cached symbols sorted by string
+    mutable bool mSortedOrderValid;         // Whether the cached sort order is current
+};
 
-    string mAnimalId;   // Impound identifier for this animal
-    string mKind;       // Kind (e.g., Dog, Cat)
-    string mGender;     // Gender (e.g., Male, Female)
-    string mName;       // Name
-    string mColor1;     // Primary color
-    string mColor2;     // Secondary color
-    string mBreed1;     // Primary breed designation
-    string mBreed2;     // Secondary breed designation
-    Datetime mDateTime; // Timestamp of this animal's information
-    
-    typedef vector<IntakeRef> IntakeList;
-    typedef vector<OutcomeRef> OutcomeList;
+// Out-of-class definition, since mSlots.assign binds a reference to it.
 
-    IntakeList mIntakeList;      // List of intake events
-    OutcomeList mOutcomeList;    // List of outcome events
-};
+const Symbol SymbolTable::EmptySlot;
 
 
 
@@ -641,22 +543,21 @@ private:
 /*
  *  Method: Null constructor
  *
- *      Initializes this object to NA.
+ *      Initializes this object to a table containing only the NA symbol.
  *      
  */
-Animal::Animal (const string& animalId, const Datetime& dateTime)
-       :
-        mAnimalId(animalId),
-        mKind(NaString),
-        mGender(NaString),
-        mName(NaString),
-        mColor1(NaString),
-        mColor2(NaString),
-        mBreed1(NaString),
-        mBreed2(NaString),
-        mDateTime(dateTime),
-        mIntakeList(),
-        mOutcomeList()
+SymbolTable::SymbolTable ()
+           :
+            mStrings(1, NaString),
+            mHashes(1, 0),
+            mSlots(64, EmptySlot),
+            mSlotMask(63),
+            mCharSxpSlots(64, nullptr),
+            mCharSxpSymbols(64, NaSymbol),
+            mCharSxpSlotMask(63),
+            mNumCharSxps(0),
+            mSortedOrder(),
+            mSortedOrderValid(false)
 {
 }
 
@@ -664,870 +565,1029 @@ Animal::Animal (const string& animalId, const Datetime& dateTime)
 
 
 /*
- *  Method: UpdateIfNewer
+ *  Method: Intern
  *
- *      Updates this animal's information from the specified animal when
- *      the information is newer.
+ *      Returns the symbol for the specified string, adding the string to
+ *      this table when it is new.
  *
- *      Update will never delete accumulated information (i.e., convert a field
- *      to empty because the update-from animal's field is empty). 
+ *      The special string "NA" always maps to the NA symbol.
  *      
  */
-void Animal::UpdateIfNewer (const AnimalRef& animal)
+Symbol SymbolTable::Intern (const char* text, size_t length)
 {
-    // Do not update if the source animal has older information.
+    if (length == NaString.size() && memcmp(text, NaString.data(), length) == 0)
+        return NaSymbol;
 
-    if (animal->GetDateTime() <= GetDateTime())
-        return;
-    
-    // Never overwrite an existing field with a newer field that has possibly
-    // been deleted (i.e., a newer field that has value NA).
-    
-    string name = animal->GetName();
-    if (name != NaString)
-        SetName(name);
-    
-    string gender = animal->GetGender();
-    if (gender != NaString)
-        SetGender(gender);
-    
-    string color1 = animal->GetColor1();
-    if (color1 != NaString)
-        SetColor1(color1);
-    
-    string color2 = animal->GetColor2();
-    if (color2 != NaString)
-        SetColor2(color2);
-    
-    string breed1 = animal->GetBreed1();
-    if (breed1 != NaString)
-        SetBreed1(breed1);
-    
-    string breed2 = animal->GetBreed2();
-    if (breed2 != NaString)
-        SetBreed2(breed2);
-    
-    // Advance the timestamp to that of the source animal.
+    size_t hash = HashString(text, length);
+    size_t slot = hash & mSlotMask;
+
+    while (mSlots[slot] != EmptySlot)
+    {
+        Symbol symbol = mSlots[slot];
+        const string& existing = mStrings[symbol];
+
+        if (mHashes[symbol] == hash && existing.size() == length &&
+            memcmp(existing.data(), text, length) == 0)
+            return symbol;
+
+        slot = (slot + 1) & mSlotMask;
+    }
+
+    // Not found, so add the string as a new symbol. Keep the load factor
+    // at or under one half.
+
+    Symbol symbol = mStrings.size();
 
-    mDateTime = animal->GetDateTime();
+    mStrings.push_back(string(text, length));
+    mHashes.push_back(hash);
+    mSortedOrderValid = false;
+
+    if (2 * mStrings.size() > mSlots.size())
+        Grow();
+    else
+        mSlots[slot] = symbol;
+
+    return symbol;
 }
 
 
 
 
 /*
- *  Method: AddIntake
+ *  Method: Intern
+ *
+ *      Returns the symbol for the specified R CHARSXP, adding its string
+ *      to this table when it is new.
  *
- *      Adds the specified intake event for this animal.
+ *      NA_STRING is recognized by address. Other CHARSXPs are looked up by
+ *      address first, and by string value only the first time an address
+ *      is seen.
  *      
  */
-void Animal::AddIntake (const IntakeRef& intake)
+Symbol SymbolTable::Intern (SEXP charSxp)
 {
-    mIntakeList.push_back(intake);
+    if (charSxp == NA_STRING)
+        return NaSymbol;
+
+    // Multiplicative hash of the address; the low bits of an address are
+    // mostly alignment.
+
+    size_t hash = (size_t) (((uintptr_t) charSxp >> 3) * 11400714819323198485ULL);
+    size_t slot = hash & mCharSxpSlotMask;
+
+    while (mCharSxpSlots[slot] != nullptr)
+    {
+        if (mCharSxpSlots[slot] == charSxp)
+            return mCharSxpSymbols[slot];
+
+        slot = (slot + 1) & mCharSxpSlotMask;
+    }
+
+    Symbol symbol = Intern(CHAR(charSxp), LENGTH(charSxp));
+
+    mCharSxpSlots[slot] = charSxp;
+    mCharSxpSymbols[slot] = symbol;
+
+    if (2 * ++mNumCharSxps > mCharSxpSlots.size())
+        GrowCharSxps();
+
+    return symbol;
 }
 
 
 
 
 /*
- *  Method: AddOutcome
+ *  Method: GrowCharSxps
  *
- *      Adds the specified outcome event for this animal.
+ *      Doubles the number of CHARSXP hash table slots and re-inserts all
+ *      remembered CHARSXP addresses.
  *      
  */
-void Animal::AddOutcome (const OutcomeRef& outcome)
+void SymbolTable::GrowCharSxps ()
 {
-    mOutcomeList.push_back(outcome);
+    vector<SEXP> oldSlots(2 * mCharSxpSlots.size(), nullptr);
+    vector<Symbol> oldSymbols(2 * mCharSxpSymbols.size(), NaSymbol);
+
+    oldSlots.swap(mCharSxpSlots);
+    oldSymbols.swap(mCharSxpSymbols);
+    mCharSxpSlotMask = mCharSxpSlots.size() - 1;
+
+    for (size_t i = 0; i < oldSlots.size(); ++i)
+    {
+        SEXP charSxp = oldSlots[i];
+
+        if (charSxp == nullptr)
+            continue;
+
+        size_t hash = (size_t) (((uintptr_t) charSxp >> 3) * 11400714819323198485ULL);
+        size_t slot = hash & mCharSxpSlotMask;
+
+        while (mCharSxpSlots[slot] != nullptr)
+            slot = (slot + 1) & mCharSxpSlotMask;
+
+        mCharSxpSlots[slot] = charSxp;
+        mCharSxpSymbols[slot] = oldSymbols[i];
+    }
 }
 
 
 
 
 /*
- *  Method: SortIntakes
+ *  Method: ForgetCharSxps
  *
- *      Sorts the intake events for this animal.
+ *      Forgets the addresses of all interned CHARSXPs. Must be called before
+ *      the input data frames of a build become unprotected, because R may
+ *      then reuse the addresses for other strings.
  *      
  */
-void Animal::SortIntakes ()
+void SymbolTable::ForgetCharSxps ()
 {
-    sort(mIntakeList.begin(), mIntakeList.end(), IntakeTimeLessThan);
+    mCharSxpSlots.assign(64, nullptr);
+    mCharSxpSymbols.assign(64, NaSymbol);
+    mCharSxpSlotMask = 63;
+    mNumCharSxps = 0;
 }
 
 
 
 
 /*
- *  Method: SortOutcomes
+ *  Method: GetNumBytes
  *
- *      Sorts the outcome events for this animal.
+ *      Returns the number of bytes allocated by this table, including the
+ *      characters of strings too long to be held inside the string objects.
  *      
  */
-void Animal::SortOutcomes ()
+size_t SymbolTable::GetNumBytes () const
 {
-    sort(mOutcomeList.begin(), mOutcomeList.end(), OutcomeTimeCompare);
+    size_t numBytes = GetVectorBytes(mStrings) + GetVectorBytes(mHashes) + GetVectorBytes(mSlots) +
+                      GetVectorBytes(mCharSxpSlots) + GetVectorBytes(mCharSxpSymbols) +
+                      GetVectorBytes(mSortedOrder);
+
+    for (size_t i = 0; i < mStrings.size(); ++i)
+    {
+        const string& text = mStrings[i];
+        const char* object = reinterpret_cast<const char*>(&text);
+
+        if (text.data() < object || text.data() >= object + sizeof(string))
+            numBytes += text.capacity() + 1;
+    }
+
+    return numBytes;
 }
 
 
 
 
 /*
- *  Method: ToString
+ *  Method: Grow
  *
- *      Returns the printable string representation of this object.
+ *      Doubles the number of hash table slots and re-inserts all symbols.
  *      
  */
-string Animal::ToString () const
+void SymbolTable::Grow ()
 {
-    ostringstream buffer;
+    size_t numSlots = 2 * mSlots.size();
 
-    buffer << "Animal " << mAnimalId
-           << " kind(" << mKind
-           << ") gender(" << mGender
-           << ") name(" << mName
-           << ") color(" << mColor1 << "," << mColor2
-           << ") breed(" << mBreed1 << "," << mBreed2
-           << ")";
+    mSlots.assign(numSlots, EmptySlot);
+    mSlotMask = numSlots - 1;
 
-    return buffer.str();
+    for (Symbol symbol = 1; symbol < mStrings.size(); ++symbol)
+    {
+        size_t slot = mHashes[symbol] & mSlotMask;
+
+        while (mSlots[slot] != EmptySlot)
+            slot = (slot + 1) & mSlotMask;
+
+        mSlots[slot] = symbol;
+    }
 }
 
 
 
 
 /*
- *  Method: DeepPrint
+ *  Method: Clear
  *
- *      Prints a complete representation of this animal to the specified
- *      output stream.
+ *      Removes all symbols from this table, other than NA.
  *      
  */
-void Animal::DeepPrint (ostream& output) const
+void SymbolTable::Clear ()
 {
-    // Output this animal's  description.
+    mStrings.assign(1, NaString);
+    mHashes.assign(1, 0);
+    mSlots.assign(64, EmptySlot);
+    mSlotMask = 63;
+    mSortedOrder.clear();
+    ForgetCharSxps();
+    mSortedOrderValid = false;
+}
 
-    output << ToString() << endl;
 
-    // Output intake and outcome events interleaved as they appear
-    // on their respective lists.
 
-    int numIntakesRemaining = GetNumIntakes();
-    int numOutcomesRemaining = GetNumOutcomes();
-    int nextIntake = 0;
-    int nextOutcome = 0;
 
-    while (numIntakesRemaining > 0 || numOutcomesRemaining > 0)
+/*
+ *  Method: GetSortedOrder
+ *
+ *      Returns all symbols other than NA, ordered by ascending string value.
+ *      This is the order in which R sorts the levels of a factor.
+ *      
+ */
+const vector<Symbol>& SymbolTable::GetSortedOrder () const
+{
+    if (!mSortedOrderValid)
     {
-        if (numIntakesRemaining > 0)
-        {
-            IntakeRef intake = GetIntakeAt(nextIntake);
-            ++nextIntake;
-            --numIntakesRemaining;
-            
-            output << intake->ToString() << endl;
-        }
+        mSortedOrder.clear();
 
-        if (numOutcomesRemaining > 0)
-        {
-            OutcomeRef outcome = GetOutcomeAt(nextOutcome);
-            ++nextOutcome;
-            --numOutcomesRemaining;
-            
-            output << outcome->ToString() << endl;
-        }
+        for (Symbol symbol = 1; symbol < mStrings.size(); ++symbol)
+            mSortedOrder.push_back(symbol);
+
+        const vector<string>& strings = mStrings;
+
+        sort(mSortedOrder.begin(), mSortedOrder.end(),
+             [&strings] (Symbol a, Symbol b) { return strings[a] < strings[b]; });
+
+        mSortedOrderValid = true;
     }
-}
 
+    return mSortedOrder;
+}
 
 
 
-/*** AnimalMap ***************************************************************/
 
 /*
- *  Class: AnimalMap
+ *  Function: EncodeFactorColumns
  *
- *      Dictionary of animal objects keyed on animal ID.
+ *      Converts R integer vectors holding symbols, in place, to R vectors
+ *      of factors.
+ *
+ *      The factor levels of each vector are the strings of the symbols that
+ *      occur in the vector, taken in sorted order from the symbol table.
+ *      Vectors are recoded in parallel, through their data pointers; the
+ *      levels and class attributes are then set on the calling thread.
  *      
  */
-class AnimalMap : public map<string, AnimalRef>
+static void EncodeFactorColumns (const vector<IntegerVector*>& columns, const SymbolTable& symbols)
 {
-public:
-
-    // Find an animal.
+    ATXSAC_PROFILE_SCOPE("EncodeFactorColumns");
 
-    AnimalRef Lookup (const string& animalId) const;
-    
-    // Add or replace an animal.
+    // Sort the symbols and find the column data here, so that the worker
+    // threads only read the symbol table and never call the R API.
 
-    void Add (const AnimalRef& animal);
-};
+    const vector<Symbol>& sortedOrder = symbols.GetSortedOrder();
+    int numSymbols = symbols.GetNumSymbols();
+    int numColumns = columns.size();
 
+    vector<int*> values(numColumns);
+    vector<int> numValues(numColumns);
 
+    for (int c = 0; c < numColumns; ++c)
+    {
+        values[c] = columns[c]->begin();
+        numValues[c] = columns[c]->size();
+    }
 
+    vector< vector<Symbol> > levelSymbols(numColumns);
 
-/*
- *  Method: Lookup
- *
- *      Look up an animal object by its animal ID.
- *      
- *      Returns a pointer to the animal object, or nullptr when the
- *      animal is not found.
- *      
- */
-AnimalRef AnimalMap::Lookup (const string& animalId) const
-{
-    AnimalRef animal = nullptr;
-    const_iterator iter = find(animalId);
-    
-    if (iter != end())
+    ParallelFor(numColumns, GetNumWorkerThreads(), [&] (int c)
     {
-        animal = iter->second;
-    }
+        int* column = values[c];
 
-    return animal;
-}
+        // Mark the symbols that occur in the column. NA never becomes a
+        // factor level.
 
+        vector<int> codes(numSymbols, 0);
 
+        for (int i = 0; i < numValues[c]; ++i)
+            codes[column[i]] = 1;
 
+        codes[NaSymbol] = 0;
 
-/*
- *  Method: Add
- *
- *      Add an animal object to this dictionary or replace an existing
- *      animal object.
- *      
- */
-void AnimalMap::Add (const AnimalRef& animal)
-{
-    if (animal == nullptr)
-        return;
+        // Assign sequential factor codes 1..numLevels to the marked symbols,
+        // in sorted string order.
+
+        for (size_t i = 0; i < sortedOrder.size(); ++i)
+        {
+            Symbol symbol = sortedOrder[i];
+
+            if (codes[symbol] != 0)
+            {
+                levelSymbols[c].push_back(symbol);
+                codes[symbol] = levelSymbols[c].size();
+            }
+        }
+
+        // Replace each symbol by its factor index; NA maps to the
+        // R integer NA.
+
+        for (int i = 0; i < numValues[c]; ++i)
+            column[i] = (column[i] == (int) NaSymbol) ? NA_INTEGER : codes[column[i]];
+    });
 
-    (*this)[animal->GetAnimalId()] = animal;
+    // Make each vector an R vector of factors by assigning the right
+    // class name and attaching the vector of level names.
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        const vector<Symbol>& levels = levelSymbols[c];
+        CharacterVector levelsVector(levels.size());
+
+        for (size_t i = 0; i < levels.size(); ++i)
+            levelsVector[i] = symbols.GetString(levels[i]);
+
+        columns[c]->attr("levels") = levelsVector;
+        columns[c]->attr("class") = "factor";
+    }
 }
 
 
 
 
-/*** AnimalTable *************************************************************/
+/*** FactorDictionaries ******************************************************/
 
 /*
- *  Class: AnimalTable
+ *  Class: FactorDictionaries
  *
- *      Accumulator to build animal data frame.
+ *      Persistent factor levels of named columns, kept across builds.
+ *
+ *      The levels of each column are append-only: a level keeps its factor
+ *      code for as long as the dictionaries are kept, and strings not seen
+ *      before become new levels after the last one, in sorted order. Tables
+ *      built at different times, or from different data sets, then have
+ *      factors whose codes agree. Levels are held as strings, so that they
+ *      outlive the symbol table of any one build.
  *      
  */
-class AnimalTable
+class FactorDictionaries
 {
 public:
-    AnimalTable () {}
-    ~AnimalTable () {}
+    FactorDictionaries () : mEnabled(false) {}
+    ~FactorDictionaries () {}
 
-    void Append (const AnimalRef& animal);
-    void Clear ();
+    // Set the levels from an R list of character vectors named by column,
+    // and encode columns against them from now on.
+
+    void Assign (const List& dictionaries);
+
+    // Index of the dictionary of a column, or -1 when it has none.
+
+    int Find (const string& name) const;
+
+    // Index of the dictionary of a column, adding an empty one when it has
+    // none.
+
+    int FindOrAdd (const string& name);
+
+    // The dictionaries as an R list of character vectors named by column.
+
+    List GetList () const;
+
+    // Number of bytes allocated by these dictionaries.
+
+    size_t GetNumBytes () const;
+
+    // Properties
+
+    bool IsEnabled () const
+    { return mEnabled; }
+
+    vector<string>& GetLevelsAt (int index)
+    { return mLevels.at(index); }
 
-    DataFrame GetDataFrame () const;
-        
 private:
-    // Vectors acculumate the columns of this animal table.
-
-    vector<string> mAnimalIdCol;
-    vector<string> mNameCol;
-    vector<string> mKindCol;
-    vector<string> mGenderCol;
-    vector<string> mColor1Col;
-    vector<string> mColor2Col;
-    vector<string> mBreed1Col;
-    vector<string> mBreed2Col;
+    bool mEnabled;                      // Whether columns are encoded against the dictionaries
+    vector<string> mNames;              // Column names, by dictionary
+    vector< vector<string> > mLevels;   // Levels in factor code order, by dictionary
 };
 
 
 
 
 /*
- *  Method: Append
+ *  Method: Assign
  *
- *      Add an animal as a new row appended to this table.
+ *      Sets the dictionaries to the levels of an R list of character
+ *      vectors named by column, replacing any levels held. Levels must be
+ *      unique and not NA.
  *      
  */
-void AnimalTable::Append (const AnimalRef& animal)
+void FactorDictionaries::Assign (const List& dictionaries)
 {
-    // Table is stored as columns; so appending a row appends to each column.
+    mEnabled = true;
+    mNames.clear();
+    mLevels.clear();
+
+    int numDictionaries = dictionaries.size();
+    if (numDictionaries == 0)
+        return;
+
+    SEXP names = Rf_getAttrib(dictionaries, R_NamesSymbol);
+
+    if (names == R_NilValue)
+        throw string("Factor dictionaries must be named by column");
 
-    mAnimalIdCol.push_back(animal->GetAnimalId());
-    mNameCol.push_back(animal->GetName());
-    mKindCol.push_back(animal->GetKind());
-    mGenderCol.push_back(animal->GetGender());
-    mColor1Col.push_back(animal->GetColor1());
-    mColor2Col.push_back(animal->GetColor2());
-    mBreed1Col.push_back(animal->GetBreed1());
-    mBreed2Col.push_back(animal->GetBreed2());
+    for (int i = 0; i < numDictionaries; ++i)
+    {
+        string name = CHAR(STRING_ELT(names, i));
+        SEXP levels = VECTOR_ELT(dictionaries, i);
+
+        if (TYPEOF(levels) != STRSXP)
+            throw "Factor dictionary of column " + name + " is not a character vector";
+
+        vector<string> strings;
+
+        for (int k = 0; k < LENGTH(levels); ++k)
+        {
+            SEXP level = STRING_ELT(levels, k);
+
+            if (level == NA_STRING)
+                throw "Factor dictionary of column " + name + " has an NA level";
+
+            strings.push_back(string(CHAR(level), LENGTH(level)));
+        }
+
+        vector<string> sorted(strings);
+        sort(sorted.begin(), sorted.end());
+
+        if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+            throw "Factor dictionary of column " + name + " has duplicate levels";
+
+        mNames.push_back(name);
+        mLevels.push_back(strings);
+    }
 }
 
 
 
 
 /*
- *  Method: Clear
+ *  Method: Find
  *
- *      Remove all rows from this animal table.
+ *      Returns the index of the dictionary of the named column, or -1 when
+ *      the column has no dictionary.
  *      
  */
-void AnimalTable::Clear ()
+int FactorDictionaries::Find (const string& name) const
 {
-    mAnimalIdCol.clear();
-    mNameCol.clear();
-    mKindCol.clear();
-    mGenderCol.clear();
-    mColor1Col.clear();
-    mColor2Col.clear();
-    mBreed1Col.clear();
-    mBreed2Col.clear();
+    vector<string>::const_iterator found = std::find(mNames.begin(), mNames.end(), name);
+
+    return (found == mNames.end()) ? -1 : found - mNames.begin();
 }
 
 
 
 
 /*
- *  Method: GetDataFrame
+ *  Method: FindOrAdd
  *
- *      Creates an R data frame object corresponding to the rows of
- *      animals in this table.
+ *      Returns the index of the dictionary of the named column, adding an
+ *      empty dictionary for the column when it has none.
  *      
  */
-DataFrame AnimalTable::GetDataFrame () const
+int FactorDictionaries::FindOrAdd (const string& name)
 {
-    using namespace Col;
+    int index = Find(name);
 
-    // Each named column vector is converted to an R vector object,
-    // in this case factor (integer) vectors.
+    if (index < 0)
+    {
+        index = mNames.size();
+        mNames.push_back(name);
+        mLevels.push_back(vector<string>());
+    }
 
-    return DataFrame::create(Named(AnimalId) = WrapAsFactor(mAnimalIdCol),
-                             Named(Kind) = WrapAsFactor(mKindCol),
-                             Named(Name) = WrapAsFactor(mNameCol),
-                             Named(Gender) = WrapAsFactor(mGenderCol),
-                             Named(Color1) = WrapAsFactor(mColor1Col),
-                             Named(Color2) = WrapAsFactor(mColor2Col),
-                             Named(Breed1) = WrapAsFactor(mBreed1Col),
-                             Named(Breed2) = WrapAsFactor(mBreed2Col));
+    return index;
 }
 
 
 
 
-/*** ImpoundTable ************************************************************/
-
 /*
- *  Class: ImpoundTable
+ *  Method: GetList
  *
- *      Accumulator to build impound data frame.
+ *      Returns the dictionaries as an R list of character vectors named by
+ *      column, which can be assigned to the dictionaries of a later build.
  *      
  */
-class ImpoundTable
+List FactorDictionaries::GetList () const
 {
-public:
-    ImpoundTable () {}
-    ~ImpoundTable () {}
-    
-    void Append (const AnimalRef& animal, const IntakeRef& intake, const OutcomeRef& outcome);
-    void Clear ();
-        
-    DataFrame GetDataFrame () const;
-    
-private:
-    vector<string> mAnimalIdCol;
-    vector<Datetime> mIntakeDateCol;
-    vector<string> mIntakeTypeCol;
-    vector<string> mIntakeSubTypeCol;
-    vector<string> mIntakeConditionCol;
-    vector<string> mIntakeLocationCol;
-    vector<int> mIntakeAgeCountCol;
-    vector<string> mIntakeAgeUnitsCol;
-    vector<int> mIntakeAgeCol;
-    vector<string> mIntakeSpayNeuterCol;
-    vector<Datetime> mOutcomeDateCol;
-    vector<string> mOutcomeTypeCol;
-    vector<string> mOutcomeSubTypeCol;
-    vector<string> mOutcomeConditionCol;
-    vector<string> mOutcomeSpayNeuterCol;
-    vector<string> mKennelCol;
-};
+    int numDictionaries = mNames.size();
+    List dictionaries(numDictionaries);
+    CharacterVector names(numDictionaries);
 
+    for (int i = 0; i < numDictionaries; ++i)
+    {
+        const vector<string>& levels = mLevels[i];
+        CharacterVector levelsVector(levels.size());
 
+        for (size_t k = 0; k < levels.size(); ++k)
+            levelsVector[k] = levels[k];
 
+        SET_VECTOR_ELT(dictionaries, i, levelsVector);
+        names[i] = mNames[i];
+    }
 
-/*
- *  Class: Append
- *
- *      Add an impound as a new row appended to this table.
- *      
- */
-void ImpoundTable::Append (const AnimalRef& animal, const IntakeRef& intake, const OutcomeRef& outcome)
-{
-    mAnimalIdCol.push_back(animal->GetAnimalId());
-    
-    mIntakeDateCol.push_back(intake->GetIntakeDate());
-    mIntakeTypeCol.push_back(intake->GetIntakeType());
-    mIntakeSubTypeCol.push_back(intake->GetIntakeSubType());
-    mIntakeConditionCol.push_back(intake->GetIntakeCondition());
-    mIntakeLocationCol.push_back(intake->GetIntakeLocation());
-    mIntakeAgeCountCol.push_back(intake->GetIntakeAgeCount());
-    mIntakeAgeUnitsCol.push_back(intake->GetIntakeAgeUnits());
-    mIntakeAgeCol.push_back(intake->GetIntakeAge());
-    mIntakeSpayNeuterCol.push_back(intake->GetIntakeSpayNeuter());
-    mKennelCol.push_back(intake->GetKennel());
-    
-    mOutcomeDateCol.push_back(outcome->GetOutcomeDate());
-    mOutcomeTypeCol.push_back(outcome->GetOutcomeType());
-    mOutcomeSubTypeCol.push_back(outcome->GetOutcomeSubType());
-    mOutcomeConditionCol.push_back(outcome->GetOutcomeCondition());
-    mOutcomeSpayNeuterCol.push_back(outcome->GetOutcomeSpayNeuter());
-    
+    dictionaries.attr("names") = names;
+
+    return dictionaries;
 }
 
 
 
 
 /*
- *  Method: Clear
+ *  Method: GetNumBytes
  *
- *      Remove all rows from this impound table.
+ *      Returns the number of bytes allocated by these dictionaries.
  *      
  */
-void ImpoundTable::Clear ()
+size_t FactorDictionaries::GetNumBytes () const
 {
-    mAnimalIdCol.clear();
-    mIntakeDateCol.clear();
-    mIntakeTypeCol.clear();
-    mIntakeSubTypeCol.clear();
-    mIntakeConditionCol.clear();
-    mIntakeLocationCol.clear();
-    mIntakeAgeCountCol.clear();
-    mIntakeAgeUnitsCol.clear();
-    mIntakeAgeCol.clear();
-    mIntakeSpayNeuterCol.clear();
-    mOutcomeDateCol.clear();
-    mOutcomeTypeCol.clear();
-    mOutcomeSubTypeCol.clear();
-    mOutcomeConditionCol.clear();
-    mOutcomeSpayNeuterCol.clear();
-    mKennelCol.clear();
+    size_t numBytes = GetVectorBytes(mNames) + GetVectorBytes(mLevels);
+
+    for (size_t i = 0; i < mLevels.size(); ++i)
+        numBytes += GetVectorBytes(mLevels[i]);
+
+    return numBytes;
 }
 
 
 
 
 /*
- *  Class: GetDataFrame
+ *  Function: EncodeFactorColumns
  *
- *      Creates an R data frame object corresponding to the rows of
- *      impounds in this table.
+ *      Converts R integer vectors holding symbols, in place, to R vectors
+ *      of factors whose levels are those of the dictionaries of the named
+ *      columns, or, when the dictionaries are not enabled, the symbols that
+ *      occur in each vector (see above).
+ *
+ *      The symbols of the levels are found by interning the strings of the
+ *      dictionaries, so that each element is then recoded by an array
+ *      lookup. Symbols of a vector not among the levels of its dictionary
+ *      are appended to the dictionary, in sorted order. Vectors with no
+ *      rows leave their dictionary unchanged.
  *      
  */
-DataFrame ImpoundTable::GetDataFrame () const
+static void EncodeFactorColumns (const vector<IntegerVector*>& columns, const vector<string>& names,
+                                 SymbolTable& symbols, FactorDictionaries& dictionaries)
 {
-    using namespace Col;
+    if (!dictionaries.IsEnabled())
+    {
+        EncodeFactorColumns(columns, symbols);
+        return;
+    }
 
-    // Each named column vector is converted to an R vector object,
-    // either afactor (integer) vector, a numeric (real) vector, or
-    // a date-time (POSIXct) vector.
-    
-    return DataFrame::create(Named(AnimalId) = WrapAsFactor(mAnimalIdCol),
-                             Named(IntakeDate) = wrap(mIntakeDateCol),
-                             Named(IntakeType) = WrapAsFactor(mIntakeTypeCol),
-                             Named(IntakeSubType) = WrapAsFactor(mIntakeSubTypeCol),
-                             Named(IntakeCondition) = WrapAsFactor(mIntakeConditionCol),
-                             Named(IntakeLocation) = WrapAsFactor(mIntakeLocationCol),
-                             Named(IntakeAgeCount) = wrap(mIntakeAgeCountCol),
-                             Named(IntakeAgeUnits) = WrapAsFactor(mIntakeAgeUnitsCol),
-                             Named(IntakeAge) = wrap(mIntakeAgeCol),
-                             Named(IntakeSpayNeuter) = WrapAsFactor(mIntakeSpayNeuterCol),
-                             Named(Kennel) = WrapAsFactor(mKennelCol),
-                             Named(OutcomeDate) = wrap(mOutcomeDateCol),
-                             Named(OutcomeType) = WrapAsFactor(mOutcomeTypeCol),
-                             Named(OutcomeSubType) = WrapAsFactor(mOutcomeSubTypeCol),
-                             Named(OutcomeCondition) = WrapAsFactor(mOutcomeConditionCol),
-                             Named(OutcomeSpayNeuter) = WrapAsFactor(mOutcomeSpayNeuterCol));
+    ATXSAC_PROFILE_SCOPE("EncodeFactorColumns");
+
+    int numColumns = columns.size();
+
+    // Find the dictionary of each column, adding one for a column with rows.
+    // Dictionaries are only added before any is referred to, since adding
+    // one may move the others.
+
+    vector<int> dictionaryIndexes(numColumns);
+
+    for (int c = 0; c < numColumns; ++c)
+        dictionaryIndexes[c] = (columns[c]->size() != 0) ? dictionaries.FindOrAdd(names[c])
+                                                         : dictionaries.Find(names[c]);
+
+    // Intern the levels before the symbols are sorted, since interning may
+    // add symbols. An "NA" level has the NA symbol, which is never recoded
+    // to it.
+
+    vector<vector<string>*> levels(numColumns, nullptr);
+    vector< vector<Symbol> > levelSymbols(numColumns);
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        if (dictionaryIndexes[c] < 0)
+            continue;
+
+        levels[c] = &dictionaries.GetLevelsAt(dictionaryIndexes[c]);
+
+        for (size_t k = 0; k < levels[c]->size(); ++k)
+            levelSymbols[c].push_back(symbols.Intern((*levels[c])[k]));
+    }
+
+    // Sort the symbols and find the column data here, so that the worker
+    // threads only read the symbol table and never call the R API.
+
+    const vector<Symbol>& sortedOrder = symbols.GetSortedOrder();
+    int numSymbols = symbols.GetNumSymbols();
+
+    vector<int*> values(numColumns);
+    vector<int> numValues(numColumns);
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        values[c] = columns[c]->begin();
+        numValues[c] = columns[c]->size();
+    }
+
+    vector< vector<Symbol> > newSymbols(numColumns);
+
+    ParallelFor(numColumns, GetNumWorkerThreads(), [&] (int c)
+    {
+        int* column = values[c];
+        const vector<Symbol>& known = levelSymbols[c];
+
+        // Give the levels of the dictionary their codes, then mark the
+        // symbols of the column that are not among them. NA never becomes
+        // a factor level.
+
+        vector<int> codes(numSymbols, 0);
+
+        for (size_t k = 0; k < known.size(); ++k)
+            if (known[k] != NaSymbol)
+                codes[known[k]] = k + 1;
+
+        for (int i = 0; i < numValues[c]; ++i)
+            if (codes[column[i]] == 0)
+                codes[column[i]] = -1;
+
+        codes[NaSymbol] = 0;
+
+        // Give the marked symbols the codes after the last level, in sorted
+        // string order.
+
+        int numLevels = known.size();
+
+        for (size_t i = 0; i < sortedOrder.size(); ++i)
+        {
+            Symbol symbol = sortedOrder[i];
+
+            if (codes[symbol] == -1)
+            {
+                newSymbols[c].push_back(symbol);
+                codes[symbol] = ++numLevels;
+            }
+        }
+
+        for (int i = 0; i < numValues[c]; ++i)
+            column[i] = (column[i] == (int) NaSymbol) ? NA_INTEGER : codes[column[i]];
+    });
+
+    // Append the new levels to the dictionaries, then attach the levels of
+    // each dictionary to its vectors.
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        CharacterVector levelsVector;
+
+        if (levels[c] != nullptr)
+        {
+            for (size_t i = 0; i < newSymbols[c].size(); ++i)
+                levels[c]->push_back(symbols.GetString(newSymbols[c][i]));
+
+            levelsVector = CharacterVector(levels[c]->size());
+
+            for (size_t k = 0; k < levels[c]->size(); ++k)
+                levelsVector[k] = (*levels[c])[k];
+        }
+
+        columns[c]->attr("levels") = levelsVector;
+        columns[c]->attr("class") = "factor";
+    }
 }
 
 
 
 
-/*** DataFrameBuilder ********************************************************/
+/*** StringColumn ************************************************************/
 
 /*
- *  Class: DataFrameBuilder
+ *  Class: StringColumn
  *
- *      Builds separate animal and impound data frames from either combined or
- *      disjoint intake and outcome input data frames in various expected
- *      formats.
+ *      Read-only view of a character or factor column of an input data frame.
+ *
+ *      Cells are read as R CHARSXP handles, without making C++ strings.
+ *      The factor levels of a factor column are interned once, so reading
+ *      a symbol from a factor column is an array lookup. A column of any
+ *      other type is converted to a character vector once, up front.
+ *
+ *      The view does not protect the column; the data frame must stay
+ *      protected for the lifetime of the view, which is the case for the
+ *      arguments of an exported function.
  *      
  */
-class DataFrameBuilder
+class StringColumn
 {
 public:
-    DataFrameBuilder () {}
-    ~DataFrameBuilder () {}
+    StringColumn (const DataFrame& table, const string& name, SymbolTable& symbols);
+    ~StringColumn () {}
 
-    // Build animal table and impound table from different sorts
-    // of input records.
+    // Symbol of the string in a row.
 
-    void BuildFromAtxIntakesAndOutcomes (const DataFrame& intake, const DataFrame& outcome);
-    void BuildFromSacOpenImpounds (const DataFrame& impound);
-    void BuildFromSacCpraImpounds (const DataFrame& impound);
-        
-    // Properties
-    
-    DataFrame GetAnimalDataFrame () const
-    { return mAnimalTable.GetDataFrame(); }
-    
-    DataFrame GetImpoundDataFrame () const
-    { return mImpoundTable.GetDataFrame(); }
+    Symbol GetSymbolAt (int row) const;
 
-private:
-    void Clear ();
-    void IngestAtxIntakes (const DataFrame& intakeTable);
-    void IngestAtxOutcomes (const DataFrame& outcomeTable);
-    void IngestSacOpenImpounds (const DataFrame& impoundTable);
-    void IngestSacCpraImpounds (const DataFrame& impoundTable);
-    
-    AnimalRef AddAnimal (const AnimalRef& animal);
+    // CHARSXP of the string in a row (NA_STRING when missing).
 
-    void MergeAnimal (const AnimalRef& animal);
-    void EmitSolitaryIntake (const AnimalRef& animal, const IntakeRef& intake);
-    void EmitIntakeOutcome (const AnimalRef& animal, const IntakeRef& intake, const OutcomeRef& outcome);
-    void EmitSolitaryOutcome (const AnimalRef& animal, const OutcomeRef& outcome);
-    void BuildAnimalTable ();
-    void BuildImpoundTable ();
+    SEXP GetCharSxpAt (int row) const;
 
-    void Warning (const AnimalRef& animal, const string& message) const;
-    
 private:
-    AnimalMap mAnimalMap;           // Dictionary of individual animals
-    AnimalTable mAnimalTable;       // Output data table of animals
-    ImpoundTable mImpoundTable;     // Output data table of animal impounds
+    SymbolTable& mSymbols;          // Table in which strings are interned
+    CharacterVector mStrings;       // Character column, or factor levels
+    const int* mCodes;              // Factor codes, or nullptr for a character column
+    vector<Symbol> mLevelSymbols;   // Symbols of the factor levels
 };
 
 
 
 
 /*
- *  Class: Clear
+ *  Method: Constructor
  *
- *      Erases all internal data structures.
- *      Leaves this builder ready to build new tables.
+ *      Initializes this object to view the named column of a data frame.
  *      
  */
-void DataFrameBuilder::Clear ()
+StringColumn::StringColumn (const DataFrame& table, const string& name, SymbolTable& symbols)
+            :
+             mSymbols(symbols),
+             mStrings(),
+             mCodes(nullptr),
+             mLevelSymbols()
 {
-    mAnimalTable.Clear();
-    mImpoundTable.Clear();
-    mAnimalMap.clear();
+    SEXP column = table[name];
+
+    if (Rf_isFactor(column))
+    {
+        // Intern each factor level once.
+
+        mStrings = Rf_getAttrib(column, R_LevelsSymbol);
+        mCodes = INTEGER(column);
+
+        int numLevels = mStrings.size();
+        mLevelSymbols.resize(numLevels);
+
+        for (int i = 0; i < numLevels; ++i)
+            mLevelSymbols[i] = mSymbols.Intern(STRING_ELT(mStrings, i));
+    }
+    else
+    {
+        // Character vectors are viewed as is; anything else is converted.
+
+        mStrings = column;
+    }
 }
 
 
 
 
 /*
- *  Class: BuildFromAtxIntakesAndOutcomes
+ *  Method: GetSymbolAt
  *
- *      Builds tables from input intake and outcome events.
+ *      Returns the symbol of the string in the specified row.
  *      
  */
-void DataFrameBuilder::BuildFromAtxIntakesAndOutcomes (const DataFrame& intake, const DataFrame& outcome)
+Symbol StringColumn::GetSymbolAt (int row) const
 {
-    // Erase previous tables built.
+    if (mCodes != nullptr)
+    {
+        int code = mCodes[row];
 
-    Clear();
-
-    // Build the table of impounds.
-
-    IngestAtxIntakes(intake);
-    IngestAtxOutcomes(outcome);
-    BuildImpoundTable();
-    
-    // Build the table of animals.
+        return (code == NA_INTEGER) ? NaSymbol : mLevelSymbols[code - 1];
+    }
 
-    BuildAnimalTable();
+    return mSymbols.Intern(STRING_ELT(mStrings, row));
 }
 
 
 
 
 /*
- *  Class: BuildFromSacOpenImpounds
+ *  Method: GetCharSxpAt
  *
- *      Builds tables from input open-data impound events, which combine intake
- *      and outcome events.
+ *      Returns the CHARSXP of the string in the specified row.
  *      
  */
-void DataFrameBuilder::BuildFromSacOpenImpounds (const DataFrame& impound)
+SEXP StringColumn::GetCharSxpAt (int row) const
 {
-    // Erase previous tables built.
-
-    Clear();
+    if (mCodes != nullptr)
+    {
+        int code = mCodes[row];
 
-    // Build the table of impounds.
-    
-    IngestSacOpenImpounds(impound);
-    BuildImpoundTable();
+        return (code == NA_INTEGER) ? NA_STRING : STRING_ELT(mStrings, code - 1);
+    }
 
-    // Build the table of animals.
-    
-    BuildAnimalTable();
+    return STRING_ELT(mStrings, row);
 }
 
 
 
 
+/*** DateTimeParser **********************************************************/
+
 /*
- *  Class: BuildFromSacCpraImpounds
+ *  Function: DaysFromCivil
  *
- *      Builds tables from input CPRA impound events, which combine intake
- *      and outcome events.
+ *      Returns the number of days from 1970-01-01 to the specified date of
+ *      the proleptic Gregorian calendar.
  *      
  */
-void DataFrameBuilder::BuildFromSacCpraImpounds (const DataFrame& impound)
+static int64_t DaysFromCivil (int year, int month, int day)
 {
-    // Erase previous tables built.
-    
-    Clear();
-    
-    // Build the table of impounds.
-    
-    IngestSacCpraImpounds(impound);
-    BuildImpoundTable();
-    
-    // Build the table of animals.
-    
-    BuildAnimalTable();
+    year -= (month <= 2);
+
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + dayOfEra - 719468;
 }
 
 
 
 
 /*
- *  Class: BuildAnimalTable
+ *  Function: DaysInMonth
  *
- *      Builds the animal table from the animal map created from
- *      the input data.
+ *      Returns the number of days in the specified month of a year.
  *      
  */
-void DataFrameBuilder::BuildAnimalTable ()
+static int DaysInMonth (int year, int month)
 {
-    // Build the animal table from the animals in the animal map.
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
 
-    AnimalMap::const_iterator iter;
+    bool leapYear = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
 
-    for (iter = mAnimalMap.begin(); iter != mAnimalMap.end(); ++iter)
-    {
-        AnimalRef animal = iter->second;
-        
-        mAnimalTable.Append(animal);
-    }
+    return (month == 2 && leapYear) ? 29 : days[month - 1];
 }
 
 
 
 
 /*
- *  Class: AddAnimal
+ *  Function: NthSunday
  *
- *      Add a new animal or update an existing animal.
- *      
- *      Returns a pointer to the animal object that was updated, which
- *      may not be the animal object that was passed as an input argument.
+ *      Returns the day number (days from 1970-01-01) of the nth Sunday of the
+ *      specified month, or of the last Sunday when n is zero.
  *      
  */
-AnimalRef DataFrameBuilder::AddAnimal (const AnimalRef& animal)
+static int64_t NthSunday (int year, int month, int n)
 {
-    // Look up the animal to see if it is already in the dictionary.
-
-    AnimalRef existingAnimal = mAnimalMap.Lookup(animal->GetAnimalId());
-    
-    // Update an animal that has been seen before. Otherwise create
-    // a new animal.
+    // 1970-01-01 was a Thursday, the fourth day of a week starting on Sunday.
 
-    if (existingAnimal != nullptr)
+    if (n == 0)
     {
-        // Only update when the incoming information is (from a record) more recent than
-        // the existing animal's informaton.
+        int64_t lastDay = DaysFromCivil(year, month, DaysInMonth(year, month));
+        int64_t weekday = ((lastDay + 4) % 7 + 7) % 7;
 
-        existingAnimal->UpdateIfNewer(animal);
+        return lastDay - weekday;
+    }
 
-        return existingAnimal;
-    } 
-    else
-    {
-        // Add the new animal to the dictionary.
+    int64_t firstDay = DaysFromCivil(year, month, 1);
+    int64_t weekday = ((firstDay + 4) % 7 + 7) % 7;
 
-        mAnimalMap.Add(animal);
-        
-        return animal;
-    }
+    return firstDay + (7 - weekday) % 7 + 7 * (n - 1);
 }
 
 
 
 
 /*
- *  Method: Warning
+ *  Function: YearOfDay
  *
- *      Prints a warning message to the console.
+ *      Returns the year of the specified day number (days from 1970-01-01).
  *      
  */
-void DataFrameBuilder::Warning (const AnimalRef& animal, const string& message) const
+static int YearOfDay (int64_t day)
 {
-    Rcout << "WARNING " << animal->GetAnimalId() << " - " << message << endl;
+    day += 719468;
+
+    int64_t era = (day >= 0 ? day : day - 146096) / 146097;
+    int64_t dayOfEra = day - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+
+    return (int) (yearOfEra + era * 400 + (monthIndex >= 10));
 }
 
 
 
 
+// Local-day key of a missing date-time; earlier than the key of any day.
+
+static const int NaDay = INT_MIN;
+
+
+
+
 /*
- *  Method: IngestAtxIntakes
+ *  Class: TimeZoneRules
+ *
+ *      Converts local date-times of a shelter's time zone to UTC.
  *
- *      Adds the given Austin intake records to the internal representation of
- *      animals and events.  
+ *      The daylight-saving periods of each year are computed once, from the
+ *      US rules in force since 1967 (with the 1974-1975 exception), and
+ *      stored as wall-clock times. A local time in the skipped hour of spring
+ *      is read as daylight time, and a local time in the repeated hour of
+ *      autumn is read as the first (also daylight) occurrence.
  *      
  */
-void DataFrameBuilder::IngestAtxIntakes (const DataFrame& intakeTable)
+class TimeZoneRules
 {
-    int numIntakes = intakeTable.nrows();
-    if (numIntakes == 0)
-        return;
+public:
+    // Rules for an Olson time-zone name, or nullptr when not supported.
 
-    using namespace Col;
+    static const TimeZoneRules* Find (const string& name);
 
-    // Get the R data frame columns wrapped as C++ objects.
+    // UTC seconds of a local wall-clock time (seconds from 1970-01-01 00:00).
 
-    CharacterVector animalIdCol =  intakeTable[AnimalId];
-    CharacterVector kindCol = intakeTable[Kind];
-    CharacterVector genderCol = intakeTable[Gender];
-    CharacterVector nameCol = intakeTable[Name];
-    CharacterVector color1Col = intakeTable[Color1];
-    CharacterVector color2Col = intakeTable[Color2];
-    CharacterVector breed1Col = intakeTable[Breed1];
-    CharacterVector breed2Col = intakeTable[Breed2];
-    
-    DatetimeVector intakeDateCol = intakeTable[IntakeDate];
-    CharacterVector intakeTypeCol = intakeTable[IntakeType];
-    CharacterVector intakeConditionCol = intakeTable[IntakeCondition];
-    CharacterVector intakeLocationCol = intakeTable[IntakeLocation];
-    IntegerVector intakeAgeCountCol = intakeTable[IntakeAgeCount];
-    CharacterVector intakeAgeUnitsCol = intakeTable[IntakeAgeUnits];
-    IntegerVector intakeAgeCol = intakeTable[IntakeAge];
-    CharacterVector intakeSpayNeuterCol = intakeTable[IntakeSpayNeuter];
-
-    // Add rows of animals and intakes to the internal accumulator tables.
-
-    for (int i = 0; i < numIntakes; ++i)
-    {
-        string animalId = as<string>(animalIdCol[i]);
-        Datetime intakeDate = intakeDateCol[i];
-
-        // Create an animal object from the animal information in the
-        // intake record.
-
-        AnimalRef animal = make_shared<Animal>(animalId, intakeDate);
-        animal->SetKind(as<string>(kindCol[i]));
-        animal->SetGender(as<string>(genderCol[i]));
-        animal->SetName(as<string>(nameCol[i]));
-        animal->SetColor1(as<string>(color1Col[i]));
-        animal->SetColor2(as<string>(color2Col[i]));
-        animal->SetBreed1(as<string>(breed1Col[i]));
-        animal->SetBreed2(as<string>(breed2Col[i]));
-
-        // Add or update the animal in the internal map.
-        // The returned pointer is to the animal object stored in
-        // the internal map.
-        
-        animal = AddAnimal(animal);
-
-        // Create an intake object from the intake information in the
-        // intake record. Add the intake object to the internal map.
-
-        IntakeRef intake = make_shared<Intake>();
-        intake->SetIntakeDate(intakeDateCol[i]);
-        intake->SetIntakeType(as<string>(intakeTypeCol[i]));
-        intake->SetIntakeCondition(as<string>(intakeConditionCol[i]));
-        intake->SetIntakeLocation(as<string>(intakeLocationCol[i]));
-        intake->SetIntakeAgeCount(intakeAgeCountCol[i]);
-        intake->SetIntakeAgeUnits(as<string>(intakeAgeUnitsCol[i]));
-        intake->SetIntakeAge(intakeAgeCol[i]);
-        intake->SetIntakeSpayNeuter(as<string>(intakeSpayNeuterCol[i]));
-        
-        animal->AddIntake(intake);
-    }
-}
+    double LocalToUtc (double localSeconds) const;
+
+    // Local wall-clock time of UTC seconds.
+
+    double UtcToLocal (double utcSeconds) const;
+
+    // Local day number (days from 1970-01-01) of UTC seconds, or NaDay.
+
+    int GetLocalDay (double utcSeconds) const;
+
+    // Properties
+
+    const string& GetName () const
+    { return mName; }
+
+private:
+    TimeZoneRules (const string& name, int standardOffset, bool observesDst);
+
+    bool IsDst (double wallSeconds, double dstEndShift) const;
+
+private:
+    static const int FirstYear = 1900;
+    static const int NumYears = 300;
+
+    string mName;                   // Olson name of the time zone
+    double mStandardOffset;         // Local standard time minus UTC (seconds)
+    vector<double> mDstStarts;      // Wall-clock start of daylight time, by year
+    vector<double> mDstEnds;        // Wall-clock end of daylight time, by year
+};
 
 
 
 
 /*
- *  Method: IngestAtxOutcomes
+ *  Method: Constructor
  *
- *      Adds the given Austin outcome records to the internal representation of
- *      animals and events.  
+ *      Initializes this object with the daylight-saving periods of the
+ *      supported years.
  *      
  */
-void DataFrameBuilder::IngestAtxOutcomes (const DataFrame& outcomeTable)
+TimeZoneRules::TimeZoneRules (const string& name, int standardOffset, bool observesDst)
+             :
+              mName(name),
+              mStandardOffset(standardOffset),
+              mDstStarts(),
+              mDstEnds()
 {
-    int numOutcomes = outcomeTable.nrows();
-    if (numOutcomes == 0)
+    if (!observesDst)
         return;
-    
-    using namespace Col;
 
-    // Get the R data frame columns wrapped as C++ objects.
-
-    CharacterVector animalIdCol = outcomeTable[AnimalId];
-    CharacterVector kindCol = outcomeTable[Kind];
-    CharacterVector genderCol = outcomeTable[Gender];
-    CharacterVector nameCol = outcomeTable[Name];
-    CharacterVector color1Col = outcomeTable[Color1];
-    CharacterVector color2Col = outcomeTable[Color2];
-    CharacterVector breed1Col = outcomeTable[Breed1];
-    CharacterVector breed2Col = outcomeTable[Breed2];
-    DatetimeVector outcomeDateCol = outcomeTable[OutcomeDate];
-    CharacterVector outcomeTypeCol = outcomeTable[OutcomeType];
-    CharacterVector outcomeSubTypeCol = outcomeTable[OutcomeSubType];
-    CharacterVector outcomeSpayNeuterCol = outcomeTable[OutcomeSpayNeuter];
-    
-    // Add rows of animals and outcomes to the internal accumulator tables.
+    mDstStarts.resize(NumYears);
+    mDstEnds.resize(NumYears);
 
-    for (int i = 0; i < numOutcomes; ++i)
+    for (int i = 0; i < NumYears; ++i)
     {
-        string animalId = as<string>(animalIdCol[i]);
-        Datetime outcomeDate = outcomeDateCol[i];
-        
-        // Create an animal object from the animal information in the
-        // outcome record.
-
-        AnimalRef animal = make_shared<Animal>(animalId, outcomeDate);
-        animal->SetKind(as<string>(kindCol[i]));
-        animal->SetGender(as<string>(genderCol[i]));
-        animal->SetName(as<string>(nameCol[i]));
-        animal->SetColor1(as<string>(color1Col[i]));
-        animal->SetColor2(as<string>(color2Col[i]));
-        animal->SetBreed1(as<string>(breed1Col[i]));
-        animal->SetBreed2(as<string>(breed2Col[i]));
-        
-        // Add or update the animal in the internal map.
-        // The returned pointer is to the animal object stored in
-        // the internal map.
+        int year = FirstYear + i;
+        int64_t startDay;
+        int64_t endDay;
+
+        if (year >= 2007)
+        {
+            startDay = NthSunday(year, 3, 2);
+            endDay = NthSunday(year, 11, 1);
+        }
+        else if (year >= 1987)
+        {
+            startDay = NthSunday(year, 4, 1);
+            endDay = NthSunday(year, 10, 0);
+        }
+        else if (year == 1974 || year == 1975)
+        {
+            // Year-round daylight time of the energy crisis.
 
-        animal = AddAnimal(animal);
+            startDay = (year == 1974) ? DaysFromCivil(1974, 1, 6) : DaysFromCivil(1975, 2, 23);
+            endDay = NthSunday(year, 10, 0);
+        }
+        else if (year >= 1967)
+        {
+            startDay = NthSunday(year, 4, 0);
+            endDay = NthSunday(year, 10, 0);
+        }
+        else
+        {
+            startDay = endDay = 0;
+        }
 
-        // Create an outcome object from the outcome information in the
-        // outcome record. Add the outcome object to the internal map.
+        // Both changes happen at 2:00 AM local (wall-clock) time.
 
-        OutcomeRef outcome = make_shared<Outcome>();
-        outcome->SetOutcomeDate(outcomeDateCol[i]);
-        outcome->SetOutcomeType(as<string>(outcomeTypeCol[i]));
-        outcome->SetOutcomeSubType(as<string>(outcomeSubTypeCol[i]));
-        outcome->SetOutcomeSpayNeuter(as<string>(outcomeSpayNeuterCol[i]));
-        
-        animal->AddOutcome(outcome);
+        mDstStarts[i] = startDay * 86400.0 + 7200.0;
+        mDstEnds[i] = endDay * 86400.0 + 7200.0;
     }
 }
 
@@ -1535,409 +1595,10534 @@ void DataFrameBuilder::IngestAtxOutcomes (const DataFrame& outcomeTable)
 
 
 /*
- *  Method: IngestSacOpenImpounds
+ *  Method: Find
  *
- *      Adds the given open-data Sacramento impound (i.e., intake and outcome)
- *      records to the internal representation of animals and events.
+ *      Returns the rules of the named time zone, or nullptr if the toolkit
+ *      does not support the time zone.
  *      
  */
-void DataFrameBuilder::IngestSacOpenImpounds (const DataFrame& impoundTable)
+const TimeZoneRules* TimeZoneRules::Find (const string& name)
 {
-    int numImpounds = impoundTable.nrows();
-    if (numImpounds == 0)
-        return;
-    
-    using namespace Col;
+    static const TimeZoneRules utc("UTC", 0, false);
+    static const TimeZoneRules chicago("America/Chicago", -6 * 3600, true);
+    static const TimeZoneRules losAngeles("America/Los_Angeles", -8 * 3600, true);
 
-    // Get the R data frame columns wrapped as C++ objects.
-    
-    CharacterVector animalIdCol = impoundTable[AnimalId];
-    CharacterVector kindCol = impoundTable[Kind];
-    CharacterVector nameCol = impoundTable[Name];
-    
-    DatetimeVector intakeDateCol = impoundTable[IntakeDate];
-    CharacterVector intakeTypeCol = impoundTable[IntakeType];
-    CharacterVector intakeLocationCol = impoundTable[IntakeLocation];
-    DatetimeVector outcomeDateCol = impoundTable[OutcomeDate];
-    CharacterVector outcomeTypeCol = impoundTable[OutcomeType];
+    if (name == chicago.mName)
+        return &chicago;
 
-    // Add rows of animals and intakes and outcomes to the internal accumulator tables.
-    
-    for (int i = 0; i < numImpounds; ++i)
-    {
-        string animalId = as<string>(animalIdCol[i]);
-        Datetime intakeDate = intakeDateCol[i];
-        
-        // Create an animal object from the animal information in the
-        // impound record.
+    if (name == losAngeles.mName)
+        return &losAngeles;
 
-        AnimalRef animal = make_shared<Animal>(animalId, intakeDate);
-        animal->SetKind(as<string>(kindCol[i]));
-        animal->SetName(as<string>(nameCol[i]));
-        
-        // Add or update the animal in the internal map.
-        // The returned pointer is to the animal object stored in
-        // the internal map.
+    if (name == utc.mName || name == "GMT")
+        return &utc;
+
+    return nullptr;
+}
 
-        animal = AddAnimal(animal);
 
-        // Create intake and outcome objects from the information in the
-        // impound record. Add the intake-outcome pair to the internal map.
 
-        IntakeRef intake = make_shared<Intake>();
-        intake->SetIntakeDate(intakeDateCol[i]);
-        intake->SetIntakeType(as<string>(intakeTypeCol[i]));
-        intake->SetIntakeLocation(as<string>(intakeLocationCol[i]));
 
-        animal->AddIntake(intake);
+/*
+ *  Method: IsDst
+ *
+ *      Determines whether a wall-clock time is within the daylight-saving
+ *      period of its year, the end of the period being moved by the
+ *      specified number of seconds.
+ *      
+ */
+bool TimeZoneRules::IsDst (double wallSeconds, double dstEndShift) const
+{
+    if (mDstStarts.empty())
+        return false;
 
-        OutcomeRef outcome = make_shared<Outcome>();
-        outcome->SetOutcomeDate(outcomeDateCol[i]);
-        outcome->SetOutcomeType(as<string>(outcomeTypeCol[i]));
+    int i = YearOfDay((int64_t) std::floor(wallSeconds / 86400.0)) - FirstYear;
 
-        animal->AddOutcome(outcome);
-    }
+    return i >= 0 && i < NumYears &&
+           wallSeconds >= mDstStarts[i] && wallSeconds < mDstEnds[i] + dstEndShift;
 }
 
 
 
 
 /*
- *  Method: IngestSacCpraImpounds
+ *  Method: LocalToUtc
  *
- *      Adds the given CPRA (California Public Records Act) Sacramento
- *      impound (i.e., intake and outcome) records to the internal
- *      representation of animals and events.
+ *      Returns the UTC seconds of the specified local wall-clock time.
  *      
  */
-void DataFrameBuilder::IngestSacCpraImpounds (const DataFrame& impoundTable)
+double TimeZoneRules::LocalToUtc (double localSeconds) const
 {
-    int numImpounds = impoundTable.nrows();
-    if (numImpounds == 0)
-        return;
-    
-    using namespace Col;
+    double offset = mStandardOffset + (IsDst(localSeconds, 0.0) ? 3600.0 : 0.0);
 
-    // Get the R data frame columns wrapped as C++ objects.
-    
-    CharacterVector animalIdCol = impoundTable[AnimalId];
-    CharacterVector kindCol = impoundTable[Kind];
-    CharacterVector nameCol = impoundTable[Name];
-    CharacterVector genderCol = impoundTable[Gender];
-    CharacterVector color1Col = impoundTable[Color1];
-    CharacterVector color2Col = impoundTable[Color2];
-    CharacterVector breed1Col = impoundTable[Breed1];
-    CharacterVector breed2Col = impoundTable[Breed2];
-    CharacterVector kennelCol = impoundTable[Kennel];
-    
-    CharacterVector spayNeuterCol = impoundTable[SpayNeuter];
-    DatetimeVector intakeDateCol = impoundTable[IntakeDate];
-    CharacterVector intakeTypeCol = impoundTable[IntakeType];
-    CharacterVector intakeSubTypeCol = impoundTable[IntakeSubType];
-    CharacterVector intakeConditionCol = impoundTable[IntakeCondition];
-    CharacterVector intakeLocationCol = impoundTable[IntakeLocation];
-    DatetimeVector outcomeDateCol = impoundTable[OutcomeDate];
-    CharacterVector outcomeTypeCol = impoundTable[OutcomeType];
-    CharacterVector outcomeSubTypeCol = impoundTable[OutcomeSubType];
-    CharacterVector outcomeConditionCol = impoundTable[OutcomeCondition];
-    
-    // Add rows of animals and intakes and outcomes to the internal accumulator tables.
-    
-    for (int i = 0; i < numImpounds; ++i)
-    {
-        string animalId = as<string>(animalIdCol[i]);
-        Datetime intakeDate = intakeDateCol[i];
-        
-        // Create an animal object from the animal information in the
-        // impound record.
-
-        AnimalRef animal = make_shared<Animal>(animalId, intakeDate);
-        animal->SetKind(as<string>(kindCol[i]));
-        animal->SetName(as<string>(nameCol[i]));
-        animal->SetGender(as<string>(genderCol[i]));
-        animal->SetColor1(as<string>(color1Col[i]));
-        animal->SetColor2(as<string>(color2Col[i]));
-        animal->SetBreed1(as<string>(breed1Col[i]));
-        animal->SetBreed2(as<string>(breed2Col[i]));
-        
-        // Add or update the animal in the internal map.
-        // The returned pointer is to the animal object stored in
-        // the internal map.
+    return localSeconds - offset;
+}
 
-        animal = AddAnimal(animal);
-        
-        // Create intake and outcome objects from the information in the
-        // impound record. Add the intake-outcome pair to the internal map.
-
-        IntakeRef intake = make_shared<Intake>();
-        intake->SetKennel(as<string>(kennelCol[i]));
-        intake->SetIntakeDate(intakeDateCol[i]);
-        intake->SetIntakeType(as<string>(intakeTypeCol[i]));
-        intake->SetIntakeSubType(as<string>(intakeSubTypeCol[i]));
-        intake->SetIntakeCondition(as<string>(intakeConditionCol[i]));
-        intake->SetIntakeLocation(as<string>(intakeLocationCol[i]));
-        intake->SetIntakeSpayNeuter(as<string>(spayNeuterCol[i]));
-        
-        animal->AddIntake(intake);
-        
-        OutcomeRef outcome = make_shared<Outcome>();
-        outcome->SetOutcomeDate(outcomeDateCol[i]);
-        outcome->SetOutcomeType(as<string>(outcomeTypeCol[i]));
-        outcome->SetOutcomeSubType(as<string>(outcomeSubTypeCol[i]));
-        outcome->SetOutcomeCondition(as<string>(outcomeConditionCol[i]));
-        
-        animal->AddOutcome(outcome);
-    }
+
+
+
+/*
+ *  Method: UtcToLocal
+ *
+ *      Returns the local wall-clock time of the specified UTC seconds.
+ *      
+ */
+double TimeZoneRules::UtcToLocal (double utcSeconds) const
+{
+    // Daylight time ends at 2:00 AM daylight time, which is 1:00 AM
+    // standard time.
+
+    double standardSeconds = utcSeconds + mStandardOffset;
+
+    return standardSeconds + (IsDst(standardSeconds, -3600.0) ? 3600.0 : 0.0);
 }
 
 
 
 
 /*
- *  Method: BuildImpoundTable
+ *  Method: GetLocalDay
  *
- *      Builds the internal impound table by traversing the internal
- *      animal map and pairing-up intake and outcome objects.
+ *      Returns the local day number of the specified UTC seconds, or NaDay
+ *      for a missing date-time.
  *      
  */
-void DataFrameBuilder::BuildImpoundTable ()
+int TimeZoneRules::GetLocalDay (double utcSeconds) const
 {
-    AnimalMap::const_iterator iter;
-    
-    // For each animal in the animal map.
+    if (!R_FINITE(utcSeconds))
+        return NaDay;
+
+    return (int) std::floor(UtcToLocal(utcSeconds) / 86400.0);
+}
+
 
-    for (iter = mAnimalMap.begin(); iter != mAnimalMap.end(); ++iter)
-    {
-        AnimalRef animal = iter->second;
-        
-        // Order the intakes and outcomes by date and remove duplicates.
 
-        animal->SortIntakes();
-        animal->SortOutcomes();
 
-        // Process both lists to pair-up intake events with subsequent outcome
-        // events in order to create impound events (which are the rows
-        // of the impound table).
+/*
+ *  Function: ReadDigits
+ *
+ *      Reads a run of minCount to maxCount decimal digits and advances the
+ *      text pointer past them. Returns false if there are too few digits.
+ *      
+ */
+static bool ReadDigits (const char*& text, const char* end, int minCount, int maxCount, int& value)
+{
+    int count = 0;
+
+    value = 0;
 
-        MergeAnimal(animal);
+    while (text < end && count < maxCount && *text >= '0' && *text <= '9')
+    {
+        value = value * 10 + (*text++ - '0');
+        ++count;
     }
+
+    return count >= minCount;
 }
 
 
 
 
 /*
- *  Method: EmitSolitaryIntake
+ *  Function: IsDigits
  *
- *      Add an intake event that is not paired with an outcome event to the
- *      internal impound table.
- *      
- *      Presumably this intake event corresponds to an animal that is still
- *      in the custody of the animal shelter.
+ *      Returns whether the specified number of characters are all decimal
+ *      digits.
  *      
  */
-void DataFrameBuilder::EmitSolitaryIntake (const AnimalRef& animal, const IntakeRef& intake)
+static inline bool IsDigits (const char* text, int count)
 {
-    //Rcout << animal->GetAnimalId() << " intake only" << endl;
-    OutcomeRef outcome = make_shared<Outcome>();
-    mImpoundTable.Append(animal, intake, outcome);
+    for (int i = 0; i < count; ++i)
+        if ((unsigned) (text[i] - '0') > 9)
+            return false;
+
+    return true;
 }
 
 
 
 
 /*
- *  Method: EmitIntakeOutcome
+ *  Function: TwoDigits
  *
- *      Add a pair of intake and outcome events to the internal impound table.
+ *      Returns the value of two decimal digits.
  *      
  */
-void DataFrameBuilder::EmitIntakeOutcome (const AnimalRef& animal, const IntakeRef& intake, const OutcomeRef& outcome)
+static inline int TwoDigits (const char* text)
 {
-    //Rcout << animal->GetAnimalId() << " outcome only" << endl;
-    mImpoundTable.Append(animal, intake, outcome);
+    return (text[0] - '0') * 10 + (text[1] - '0');
 }
 
 
 
 
 /*
- *  Method: EmitSolitaryOutcome
+ *  Function: MakeLocalSeconds
  *
- *      Add an outcome event that is not paired with an intake event to the
- *      internal impound table.
- *      
- *      This outcome event ought to correspond to an animal for which the
- *      intake event is missing from the data set being processed.
+ *      Returns the seconds from 1970-01-01 00:00 of the specified wall-clock
+ *      date and time, or NaN if a field is out of range.
  *      
  */
-void DataFrameBuilder::EmitSolitaryOutcome (const AnimalRef& animal, const OutcomeRef& outcome)
+static double MakeLocalSeconds (int year, int month, int day, int hours, int minutes, double seconds)
 {
-    //Rcout << animal->GetAnimalId() << " merged" << endl;
-    IntakeRef intake = make_shared<Intake>();
-    mImpoundTable.Append(animal, intake, outcome);
+    if (month < 1 || month > 12 || day < 1 || day > DaysInMonth(year, month) ||
+        hours > 23 || minutes > 59 || seconds >= 61.0)
+        return NAN;
+
+    return DaysFromCivil(year, month, day) * 86400.0 + hours * 3600.0 + minutes * 60.0 + seconds;
 }
 
 
 
 
 /*
- *  Method: MergeAnimal
+ *  Function: ParseDateTime
  *
- *    Add impound records for the paired-up intake and outcome events of
- *    the specified animal.  
+ *      Converts a date-time string of the formats emitted by the data portals
+ *      to POSIXct seconds. Returns NA_REAL if the string is not a date-time.
+ *
+ *      Dates are either ISO 8601 (yyyy-mm-dd or yyyy/mm/dd) or US
+ *      (mm/dd/yyyy). A time may follow the date after a space or a "T", as
+ *      hh:mm, hh:mm:ss, or hh:mm:ss.fff, optionally with AM or PM. The time is
+ *      local to the specified time zone, unless a "Z" or a UTC offset
+ *      follows it. A date without a time is at midnight.
+ *
+ *      The fixed-width forms "yyyy-mm-dd hh:mm:ss" and "yyyy-mm-dd" are read
+ *      without a scan.
  *      
  */
-void DataFrameBuilder::MergeAnimal (const AnimalRef& animal)
+static double ParseDateTime (const char* text, size_t length, const TimeZoneRules& zone)
 {
-    int numIntakesRemaining = animal->GetNumIntakes();
-    int numOutcomesRemaining = animal->GetNumOutcomes();
-    int nextIntake = 0;
-    int nextOutcome = 0;
+    // Fast path for the fixed-width ISO 8601 forms.
 
-    while (numIntakesRemaining > 0)
+    if ((length == 19 || length == 10) &&
+        IsDigits(text, 4) && text[4] == '-' && IsDigits(text + 5, 2) &&
+        text[7] == '-' && IsDigits(text + 8, 2))
     {
-        // Pair each intake with an outcome.
-        // At the end there may be a solitary intake, meaning that the data
-        // set ends with the animal in the custody of the shelter.
-        
-        IntakeRef intake = animal->GetIntakeAt(nextIntake);
-        
-        if (numOutcomesRemaining == 0)
+        int year = TwoDigits(text) * 100 + TwoDigits(text + 2);
+        int month = TwoDigits(text + 5);
+        int day = TwoDigits(text + 8);
+        double local = NAN;
+
+        if (length == 10)
         {
-            // Intake(s) remaining but no more outcomes.
+            local = MakeLocalSeconds(year, month, day, 0, 0, 0.0);
+        }
+        else if ((text[10] == ' ' || text[10] == 'T') &&
+                 IsDigits(text + 11, 2) && text[13] == ':' &&
+                 IsDigits(text + 14, 2) && text[16] == ':' &&
+                 IsDigits(text + 17, 2))
+        {
+            local = MakeLocalSeconds(year, month, day,
+                                     TwoDigits(text + 11), TwoDigits(text + 14), TwoDigits(text + 17));
+        }
 
-            if (numIntakesRemaining > 1)
-            {
-                // Discrepancy: multiple intakes are left over, not just one.
-                // One or more late-date intakes is missing a matching outcome in the data set.
-                
-                Warning(animal, "Intake not matched with outcome.");
+        if (!std::isnan(local))
+            return zone.LocalToUtc(local);
+    }
 
-                // Take the most recent intake and discard the other(s).
-                
-                intake = animal->GetIntakeAt(animal->GetNumIntakes() - 1);
+    // General scan.
 
-                // The solitary intake is the final event for the animal.
+    const char* p = text;
+    const char* end = text + length;
+    int first;
+    int year;
+    int month;
+    int day;
 
-                EmitSolitaryIntake(animal, intake);
-                numIntakesRemaining = 0;
-                nextIntake = animal->GetNumIntakes();
-            }
-            else
+    while (p < end && *p == ' ')
+        ++p;
+
+    const char* firstStart = p;
+
+    if (!ReadDigits(p, end, 1, 4, first) || p == end || (*p != '-' && *p != '/'))
+        return NA_REAL;
+
+    int firstDigits = p - firstStart;
+    char separator = *p++;
+
+    if (firstDigits == 4)
+    {
+        // ISO 8601: yyyy-mm-dd or yyyy/mm/dd.
+
+        year = first;
+
+        if (!ReadDigits(p, end, 1, 2, month) || p == end || *p++ != separator ||
+            !ReadDigits(p, end, 1, 2, day))
+            return NA_REAL;
+    }
+    else if (separator == '/' && firstDigits <= 2)
+    {
+        // US: mm/dd/yyyy.
+
+        month = first;
+
+        if (!ReadDigits(p, end, 1, 2, day) || p == end || *p++ != '/' ||
+            !ReadDigits(p, end, 4, 4, year))
+            return NA_REAL;
+    }
+    else
+    {
+        return NA_REAL;
+    }
+
+    int hours = 0;
+    int minutes = 0;
+    double seconds = 0.0;
+    bool explicitOffset = false;
+    double offset = 0.0;
+
+    const char* timeStart = p;
+
+    if (p < end && *p == 'T')
+        ++p;
+    else
+        while (p < end && *p == ' ')
+            ++p;
+
+    if (p < end && *p >= '0' && *p <= '9')
+    {
+        int wholeSeconds = 0;
+
+        if (!ReadDigits(p, end, 1, 2, hours) || p == end || *p++ != ':' ||
+            !ReadDigits(p, end, 2, 2, minutes))
+            return NA_REAL;
+
+        if (p < end && *p == ':')
+        {
+            ++p;
+
+            if (!ReadDigits(p, end, 2, 2, wholeSeconds))
+                return NA_REAL;
+
+            seconds = wholeSeconds;
+
+            if (p < end && *p == '.')
             {
-                // A single intake is left over and not paired with an outcome.
-                // Add an impound record for the intake event.
-                // The solitary intake is the final event for the animal.
-                
-                EmitSolitaryIntake(animal, intake);
-                --numIntakesRemaining;
-                ++nextIntake;
+                double scale = 0.1;
+
+                for (++p; p < end && *p >= '0' && *p <= '9'; ++p, scale /= 10)
+                    seconds += (*p - '0') * scale;
             }
         }
-        else
+
+        while (p < end && *p == ' ')
+            ++p;
+
+        // 12-hour clock.
+
+        if (end - p >= 2 && (p[1] == 'M' || p[1] == 'm'))
         {
-            // Try to pair the next intake event with the next outcome event.
+            bool pm = (p[0] == 'P' || p[0] == 'p');
 
-            OutcomeRef outcome = animal->GetOutcomeAt(nextOutcome);
-            --numOutcomesRemaining;
-            ++nextOutcome;
-            
-            if (CompareByDay(outcome->GetOutcomeDate(), intake->GetIntakeDate()) == EarlierDay)
-            {
-                if (numIntakesRemaining == animal->GetNumIntakes())
-                {
+            if (!pm && p[0] != 'A' && p[0] != 'a')
+                return NA_REAL;
+
+            if (hours < 1 || hours > 12)
+                return NA_REAL;
+
+            hours = (hours % 12) + (pm ? 12 : 0);
+            p += 2;
+        }
+
+        // UTC designator or offset.
+
+        if (p < end && (*p == 'Z' || *p == 'z'))
+        {
+            explicitOffset = true;
+            ++p;
+        }
+        else if (p < end && (*p == '+' || *p == '-'))
+        {
+            double sign = (*p++ == '-') ? -1.0 : 1.0;
+            int offsetHours;
+            int offsetMinutes = 0;
+
+            if (!ReadDigits(p, end, 2, 2, offsetHours))
+                return NA_REAL;
+
+            if (p < end && *p == ':')
+                ++p;
+
+            if (p < end && !ReadDigits(p, end, 2, 2, offsetMinutes))
+                return NA_REAL;
+
+            explicitOffset = true;
+            offset = sign * (offsetHours * 3600.0 + offsetMinutes * 60.0);
+        }
+    }
+    else
+    {
+        p = timeStart;
+    }
+
+    while (p < end && *p == ' ')
+        ++p;
+
+    if (p != end)
+        return NA_REAL;
+
+    double local = MakeLocalSeconds(year, month, day, hours, minutes, seconds);
+
+    if (std::isnan(local))
+        return NA_REAL;
+
+    return explicitOffset ? local - offset : zone.LocalToUtc(local);
+}
+
+
+
+
+/*
+ *  Function: FindTimeZoneRules
+ *
+ *      Returns the rules of the named time zone, throwing an exception if
+ *      the time zone is not supported.
+ *      
+ */
+static const TimeZoneRules& FindTimeZoneRules (const string& name)
+{
+    const TimeZoneRules* zone = TimeZoneRules::Find(name);
+
+    if (zone == nullptr)
+        throw "Unsupported time zone " + name;
+
+    return *zone;
+}
+
+
+
+
+/*
+ *  Function: MakeDateTimeVector
+ *
+ *      Makes a POSIXct vector of the specified length in a time zone.
+ *      
+ */
+static NumericVector MakeDateTimeVector (int length, const TimeZoneRules& zone)
+{
+    NumericVector dateTimes(length);
+
+    dateTimes.attr("class") = CharacterVector::create("POSIXct", "POSIXt");
+    dateTimes.attr("tzone") = zone.GetName();
+
+    return dateTimes;
+}
+
+
+
+
+/*** CsvReader ***************************************************************/
+
+/*
+ *  Class: MappedFile
+ *
+ *      Read-only view of the bytes of a file.
+ *
+ *      The file is memory-mapped where the platform supports it, so the
+ *      pages of a cached download are read straight from the page cache;
+ *      otherwise the file is read into a buffer.
+ *      
+ */
+class MappedFile
+{
+public:
+    MappedFile (const string& filePath);
+    ~MappedFile ();
+
+    // Properties
+
+    const char* GetData () const
+    { return mData; }
+
+    size_t GetSize () const
+    { return mSize; }
+
+private:
+    MappedFile (const MappedFile&);
+    MappedFile& operator= (const MappedFile&);
+
+private:
+    const char* mData;      // First byte of the file
+    size_t mSize;           // Number of bytes in the file
+    bool mMapped;           // Whether mData is a mapping (otherwise, mBuffer)
+    string mBuffer;         // Contents of the file, when not mapped
+};
+
+
+
+
+/*
+ *  Method: Constructor
+ *
+ *      Initializes this object to view the specified file.
+ *      
+ */
+MappedFile::MappedFile (const string& filePath)
+          :
+           mData(nullptr),
+           mSize(0),
+           mMapped(false),
+           mBuffer()
+{
+#if defined(ATXSAC_HAVE_MMAP)
+    int fd = open(filePath.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        throw "Cannot open file " + filePath;
+
+    struct stat status;
+
+    if (fstat(fd, &status) != 0)
+    {
+        close(fd);
+        throw "Cannot get the size of file " + filePath;
+    }
+
+    mSize = status.st_size;
+
+    // An empty file cannot be mapped, and needs no mapping.
+
+    if (mSize > 0)
+    {
+        void* address = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (address == MAP_FAILED)
+        {
+            close(fd);
+            throw "Cannot map file " + filePath;
+        }
+
+        madvise(address, mSize, MADV_SEQUENTIAL);
+        mData = static_cast<const char*>(address);
+        mMapped = true;
+    }
+
+    close(fd);
+#else
+    std::ifstream file(filePath.c_str(), std::ios::in | std::ios::binary);
+
+    if (!file)
+        throw "Cannot open file " + filePath;
+
+    ostringstream contents;
+    contents << file.rdbuf();
+    mBuffer = contents.str();
+    mData = mBuffer.data();
+    mSize = mBuffer.size();
+#endif
+}
+
+
+
+
+/*
+ *  Method: Destructor
+ *
+ *      Unmaps the file.
+ *      
+ */
+MappedFile::~MappedFile ()
+{
+#if defined(ATXSAC_HAVE_MMAP)
+    if (mMapped)
+        munmap(const_cast<char*>(mData), mSize);
+#endif
+}
+
+
+
+
+/*
+ *  Function: FindCsvSpecial
+ *
+ *      Returns the address of the first quote, comma, carriage return, or
+ *      line feed in [text, end), or end if there is none.
+ *
+ *      Where SSE2 is available, sixteen bytes are compared at a time.
+ *      
+ */
+static const char* FindCsvSpecial (const char* text, const char* end)
+{
+#if defined(__SSE2__)
+    const __m128i quotes = _mm_set1_epi8('"');
+    const __m128i commas = _mm_set1_epi8(',');
+    const __m128i returns = _mm_set1_epi8('\r');
+    const __m128i newlines = _mm_set1_epi8('\n');
+
+    while (end - text >= 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+        __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, quotes),
+                                                    _mm_cmpeq_epi8(bytes, commas)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(bytes, returns),
+                                                    _mm_cmpeq_epi8(bytes, newlines)));
+        int mask = _mm_movemask_epi8(matches);
+
+        if (mask != 0)
+            return text + __builtin_ctz(mask);
+
+        text += 16;
+    }
+#endif
+
+    for ( ; text < end; ++text)
+    {
+        char c = *text;
+
+        if (c == '"' || c == ',' || c == '\r' || c == '\n')
+            break;
+    }
+
+    return text;
+}
+
+
+
+
+// A field of a CSV record, as it appears in the file. The characters of a
+// quoted field exclude the enclosing quotes, but still contain any doubled
+// quotes.
+
+struct CsvField
+{
+    const char* text;       // First character
+    size_t length;          // Number of characters
+    bool quoted;            // Whether the field was enclosed in quotes
+    bool escaped;           // Whether the characters contain doubled quotes
+};
+
+
+
+
+/*
+ *  Class: CsvReader
+ *
+ *      Splits the text of a CSV file into records and fields.
+ *
+ *      The dialect is that of read.csv: fields are separated by commas,
+ *      records end with LF or CRLF, and fields may be enclosed in double
+ *      quotes, in which case they may contain commas, line breaks, and
+ *      doubled quotes. Fields are not copied; they point into the text.
+ *      
+ */
+class CsvReader
+{
+public:
+    CsvReader (const char* text, size_t size);
+    ~CsvReader () {}
+
+    // Read the next record; returns false at the end of the text.
+
+    bool ReadRecord (vector<CsvField>& fields);
+
+    // Continue reading at an offset from the start of the text, which must
+    // be the start of a record.
+
+    void Seek (size_t offset);
+
+    // Properties
+
+    int GetLineNumber () const
+    { return mLineNumber; }
+
+    // Offset of the next character to read from the start of the text.
+
+    size_t GetOffset () const
+    { return mNext - mText; }
+
+private:
+    void ReadQuotedField (CsvField& field);
+
+private:
+    const char* mText;      // Start of the text
+    const char* mNext;      // Next character to read
+    const char* mEnd;       // End of the text
+    int mLineNumber;        // Line on which the last record started
+    int mNextLineNumber;    // Line of the next character
+};
+
+
+
+
+/*
+ *  Method: Constructor
+ *
+ *      Initializes this object to read the specified text, skipping any
+ *      UTF-8 byte-order mark.
+ *      
+ */
+CsvReader::CsvReader (const char* text, size_t size)
+         :
+          mText(text),
+          mNext(text),
+          mEnd(text + size),
+          mLineNumber(0),
+          mNextLineNumber(1)
+{
+    if (size >= 3 && memcmp(text, "\xEF\xBB\xBF", 3) == 0)
+        mNext += 3;
+}
+
+
+
+
+/*
+ *  Method: Seek
+ *
+ *      Continues reading at the specified offset, which must be the start
+ *      of a record, such as the offset after a record read before. Line
+ *      numbers are then counted from the offset.
+ *      
+ */
+void CsvReader::Seek (size_t offset)
+{
+    if (offset > (size_t) (mEnd - mText))
+        throw string("CSV offset past the end of the text");
+
+    mNext = mText + offset;
+    mNextLineNumber = 1;
+}
+
+
+
+
+/*
+ *  Method: ReadRecord
+ *
+ *      Reads the fields of the next record. Returns false, with no fields,
+ *      if there are no more records.
+ *      
+ */
+bool CsvReader::ReadRecord (vector<CsvField>& fields)
+{
+    fields.clear();
+
+    if (mNext == mEnd)
+        return false;
+
+    mLineNumber = mNextLineNumber;
+
+    while (true)
+    {
+        CsvField field = { mNext, 0, false, false };
+
+        if (mNext < mEnd && *mNext == '"')
+        {
+            ReadQuotedField(field);
+
+            // Skip anything between the closing quote and the separator.
+
+            mNext = FindCsvSpecial(mNext, mEnd);
+        }
+        else
+        {
+            // A quote within an unquoted field is an ordinary character.
+
+            const char* stop = FindCsvSpecial(mNext, mEnd);
+
+            while (stop < mEnd && *stop == '"')
+                stop = FindCsvSpecial(stop + 1, mEnd);
+
+            field.length = stop - mNext;
+            mNext = stop;
+        }
+
+        fields.push_back(field);
+
+        if (mNext == mEnd)
+            return true;
+
+        char separator = *mNext++;
+
+        if (separator == ',')
+            continue;
+
+        if (separator == '\r' && mNext < mEnd && *mNext == '\n')
+            ++mNext;
+
+        ++mNextLineNumber;
+
+        return true;
+    }
+}
+
+
+
+
+/*
+ *  Method: ReadQuotedField
+ *
+ *      Reads a quoted field, starting at its opening quote, and leaves the
+ *      reader after its closing quote.
+ *      
+ */
+void CsvReader::ReadQuotedField (CsvField& field)
+{
+    const char* text = ++mNext;
+
+    field.text = text;
+    field.quoted = true;
+
+    while (true)
+    {
+        const char* quote = static_cast<const char*>(memchr(mNext, '"', mEnd - mNext));
+
+        if (quote == nullptr)
+        {
+            ostringstream buffer;
+            buffer << "Unterminated quoted field on line " << mLineNumber;
+            throw buffer.str();
+        }
+
+        mNextLineNumber += std::count(mNext, quote, '\n');
+
+        if (quote + 1 < mEnd && quote[1] == '"')
+        {
+            field.escaped = true;
+            mNext = quote + 2;
+            continue;
+        }
+
+        field.length = quote - text;
+        mNext = quote + 1;
+
+        return;
+    }
+}
+
+
+
+
+/*
+ *  Function: InternCsvField
+ *
+ *      Returns the symbol of the characters of a CSV field, with doubled
+ *      quotes undone. The field "NA" is missing, as with read.csv.
+ *      
+ */
+static Symbol InternCsvField (const CsvField& field, SymbolTable& symbols, string& scratch)
+{
+    if (!field.escaped)
+        return symbols.Intern(field.text, field.length);
+
+    scratch.clear();
+
+    for (size_t i = 0; i < field.length; ++i)
+    {
+        scratch.push_back(field.text[i]);
+
+        if (field.text[i] == '"')
+            ++i;
+    }
+
+    return symbols.Intern(scratch);
+}
+
+
+
+
+/*
+ *  Function: ReadCsvFile
+ *
+ *      Reads a CSV file with a header line into a data frame of character
+ *      columns, as read.csv does with colClasses = "character". Blank lines
+ *      are skipped, and short records are filled with empty strings.
+ *
+ *      Each distinct string is interned once, and its CHARSXP is made once,
+ *      however many cells contain it. The column names are as in the header,
+ *      without being made syntactic.
+ *
+ *      The named date columns are instead parsed into POSIXct columns of the
+ *      specified time zone, each distinct string being parsed once.
+ *
+ *      Records may be read in chunks: reading starts at a nonzero start
+ *      offset (zero means after the header), stops after the maximum number
+ *      of records (unless negative), and the offset at which to read the
+ *      next chunk is returned. The header is read for every chunk.
+ *      
+ */
+static List ReadCsvFile (const string& filePath, const vector<string>& dateColumns,
+                         const TimeZoneRules& zone, size_t startOffset = 0,
+                         int maxRows = -1, size_t* endOffset = nullptr)
+{
+    MappedFile file(filePath);
+    CsvReader reader(file.GetData(), file.GetSize());
+    SymbolTable symbols;
+    vector<CsvField> fields;
+    string scratch;
+
+    // Read the header.
+
+    if (!reader.ReadRecord(fields))
+        throw "No header line in file " + filePath;
+
+    int numColumns = fields.size();
+    vector<string> headerNames(numColumns);
+    CharacterVector names(numColumns);
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        Symbol symbol = InternCsvField(fields[c], symbols, scratch);
+        headerNames[c] = symbols.GetString(symbol);
+        names[c] = headerNames[c];
+    }
+
+    vector<bool> isDateColumn(numColumns, false);
+
+    for (size_t i = 0; i < dateColumns.size(); ++i)
+    {
+        int c = 0;
+
+        while (c < numColumns && headerNames[c] != dateColumns[i])
+            ++c;
+
+        if (c == numColumns)
+            throw "No column named " + dateColumns[i] + " in file " + filePath;
+
+        isDateColumn[c] = true;
+    }
+
+    // Read the records into columns of symbols. A rough row count, from the
+    // length of the header line, avoids most of the regrowth.
+
+    if (startOffset != 0)
+        reader.Seek(startOffset);
+
+    vector< vector<Symbol> > symbolColumns(numColumns);
+    size_t headerLength = std::max<size_t>(fields.back().text + fields.back().length - file.GetData(), 1);
+    size_t estimatedRows = (file.GetSize() - reader.GetOffset()) / headerLength;
+
+    if (maxRows >= 0)
+        estimatedRows = std::min<size_t>(estimatedRows, maxRows);
+
+    for (int c = 0; c < numColumns; ++c)
+        symbolColumns[c].reserve(estimatedRows);
+
+    Symbol emptySymbol = symbols.Intern("", 0);
+    int numRecords = 0;
+
+    while (numRecords != maxRows && reader.ReadRecord(fields))
+    {
+        int numFields = fields.size();
+
+        if (numFields == 1 && fields[0].length == 0 && !fields[0].quoted)
+            continue;
+
+        if (numFields > numColumns)
+        {
+            ostringstream buffer;
+            buffer << "More fields than column names on line " << reader.GetLineNumber()
+                   << " of file " << filePath;
+            throw buffer.str();
+        }
+
+        for (int c = 0; c < numFields; ++c)
+            symbolColumns[c].push_back(InternCsvField(fields[c], symbols, scratch));
+
+        for (int c = numFields; c < numColumns; ++c)
+            symbolColumns[c].push_back(emptySymbol);
+
+        ++numRecords;
+    }
+
+    if (endOffset != nullptr)
+        *endOffset = reader.GetOffset();
+
+    // Make the columns, making the CHARSXP, or parsing the date-time, of
+    // each symbol once.
+
+    int numRows = numColumns > 0 ? symbolColumns[0].size() : 0;
+    int numSymbols = symbols.GetNumSymbols();
+    vector<SEXP> charSxps(numSymbols, nullptr);
+    vector<double> dateTimes;
+    vector<bool> dateTimeParsed;
+    List columns(numColumns);
+
+    charSxps[NaSymbol] = NA_STRING;
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        const vector<Symbol>& symbolColumn = symbolColumns[c];
+
+        if (isDateColumn[c])
+        {
+            if (dateTimes.empty())
+            {
+                dateTimes.resize(numSymbols, NA_REAL);
+                dateTimeParsed.resize(numSymbols, false);
+                dateTimeParsed[NaSymbol] = true;
+            }
+
+            NumericVector column = MakeDateTimeVector(numRows, zone);
+            double* values = column.begin();
+
+            for (int row = 0; row < numRows; ++row)
+            {
+                Symbol symbol = symbolColumn[row];
+
+                if (!dateTimeParsed[symbol])
+                {
+                    const string& text = symbols.GetString(symbol);
+                    dateTimes[symbol] = ParseDateTime(text.data(), text.size(), zone);
+                    dateTimeParsed[symbol] = true;
+                }
+
+                values[row] = dateTimes[symbol];
+            }
+
+            vector<Symbol>().swap(symbolColumns[c]);
+            SET_VECTOR_ELT(columns, c, column);
+            continue;
+        }
+
+        CharacterVector column(numRows);
+
+        for (int row = 0; row < numRows; ++row)
+        {
+            Symbol symbol = symbolColumn[row];
+
+            if (charSxps[symbol] == nullptr)
+            {
+                const string& text = symbols.GetString(symbol);
+                charSxps[symbol] = Rf_mkCharLen(text.data(), text.size());
+            }
+
+            SET_STRING_ELT(column, row, charSxps[symbol]);
+        }
+
+        // The columns hold the CHARSXPs now; drop the symbols.
+
+        vector<Symbol>().swap(symbolColumns[c]);
+        SET_VECTOR_ELT(columns, c, column);
+    }
+
+    columns.attr("names") = names;
+    columns.attr("row.names") = IntegerVector::create(NA_INTEGER, -numRows);
+    columns.attr("class") = "data.frame";
+
+    return columns;
+}
+
+
+
+
+/*
+ *  Function: JoinCsvFiles
+ *
+ *      Joins CSV files, such as the pages of a data set downloaded
+ *      separately, into one CSV file: the header line of the first file,
+ *      then the records of every file. The files must have the same header
+ *      line. Empty files are skipped.
+ *
+ *      The joined file is written to a temporary file, which then replaces
+ *      the destination file, so that a failed join leaves the destination
+ *      as it was.
+ *      
+ */
+static void JoinCsvFiles (const vector<string>& filePaths, const string& toFilePath)
+{
+    string tempFilePath = MakeTempFilePath(toFilePath);
+    FILE* output = fopen(tempFilePath.c_str(), "wb");
+
+    if (output == nullptr)
+        throw "Cannot create file " + tempFilePath;
+
+    try
+    {
+        string header;
+        bool endsWithNewline = true;
+
+        for (size_t i = 0; i < filePaths.size(); ++i)
+        {
+            MappedFile file(filePaths[i]);
+            CsvReader reader(file.GetData(), file.GetSize());
+            vector<CsvField> fields;
+
+            if (!reader.ReadRecord(fields))
+                continue;
+
+            // Compare the header lines, and copy everything after the first.
+
+            size_t headerEnd = reader.GetOffset();
+            string fileHeader(file.GetData(), headerEnd);
+
+            while (!fileHeader.empty() && (fileHeader.back() == '\n' || fileHeader.back() == '\r'))
+                fileHeader.pop_back();
+
+            size_t start = 0;
+
+            if (header.empty())
+                header = fileHeader;
+            else if (fileHeader != header)
+                throw "Different header line in file " + filePaths[i];
+            else
+                start = headerEnd;
+
+            if (start == file.GetSize())
+                continue;
+
+            if (!endsWithNewline)
+                fputc('\n', output);
+
+            size_t length = file.GetSize() - start;
+
+            if (fwrite(file.GetData() + start, 1, length, output) != length)
+                throw "Cannot write file " + tempFilePath;
+
+            endsWithNewline = (file.GetData()[file.GetSize() - 1] == '\n');
+        }
+
+        if (fclose(output) != 0)
+        {
+            output = nullptr;
+            throw "Cannot write file " + tempFilePath;
+        }
+
+        output = nullptr;
+
+        if (rename(tempFilePath.c_str(), toFilePath.c_str()) != 0)
+            throw "Cannot replace file " + toFilePath;
+    }
+    catch (...)
+    {
+        if (output != nullptr)
+            fclose(output);
+
+        remove(tempFilePath.c_str());
+        throw;
+    }
+}
+
+
+
+
+/*** Field wranglers **********************************************************/
+
+/*
+ *  Class: FieldWrangler
+ *
+ *      Base of the wranglers that split a raw character column of the
+ *      open data into two columns of factors.
+ *
+ *      The raw columns are highly repetitive, so each distinct input
+ *      string is wrangled once: input CHARSXPs are interned, and the
+ *      result for each input symbol is remembered.
+ *      
+ */
+class FieldWrangler
+{
+public:
+    FieldWrangler ();
+    virtual ~FieldWrangler () {}
+
+    // Wrangle a character vector into a data frame of two factor columns.
+
+    List Wrangle (const CharacterVector& strings, const string& firstName, const string& secondName);
+
+protected:
+    // Split one input string into its two parts. A part that is missing
+    // is NA.
+
+    virtual void Split (const string& text, string& first, string& second) const = 0;
+
+    // Split a string on '/' into its first two parts, as strsplit would.
+
+    static void SplitOnSlash (const string& text, string& first, string& second);
+
+private:
+    SymbolTable mInputs;            // Distinct input strings
+    SymbolTable mOutputs;           // Distinct output strings (factor levels)
+    vector<Symbol> mFirstMemo;      // First output symbol, by input symbol
+    vector<Symbol> mSecondMemo;     // Second output symbol, by input symbol
+};
+
+
+
+
+/*
+ *  Method: Null constructor
+ *
+ *      Initializes this object to have wrangled no strings; the NA input
+ *      wrangles to NA parts.
+ *      
+ */
+FieldWrangler::FieldWrangler ()
+             :
+              mInputs(),
+              mOutputs(),
+              mFirstMemo(1, NaSymbol),
+              mSecondMemo(1, NaSymbol)
+{
+}
+
+
+
+
+/*
+ *  Method: Wrangle
+ *
+ *      Splits each string of a character vector into two parts, returning
+ *      a data frame of two factor columns with the specified names.
+ *      
+ */
+List FieldWrangler::Wrangle (const CharacterVector& strings, const string& firstName, const string& secondName)
+{
+    int numRows = strings.size();
+    IntegerVector firstCol(numRows);
+    IntegerVector secondCol(numRows);
+    int* firstValues = firstCol.begin();
+    int* secondValues = secondCol.begin();
+    string first;
+    string second;
+
+    for (int row = 0; row < numRows; ++row)
+    {
+        Symbol input = mInputs.Intern(STRING_ELT(strings, row));
+
+        // Symbols are assigned sequentially, so a symbol past the end of
+        // the memo is a string not seen before.
+
+        if (input == mFirstMemo.size())
+        {
+            Split(mInputs.GetString(input), first, second);
+            mFirstMemo.push_back(mOutputs.Intern(first));
+            mSecondMemo.push_back(mOutputs.Intern(second));
+        }
+
+        firstValues[row] = mFirstMemo[input];
+        secondValues[row] = mSecondMemo[input];
+    }
+
+    vector<IntegerVector*> columns = { &firstCol, &secondCol };
+
+    EncodeFactorColumns(columns, mOutputs);
+
+    List dataFrame = List::create(Named(firstName) = firstCol,
+                                  Named(secondName) = secondCol);
+
+    dataFrame.attr("row.names") = IntegerVector::create(NA_INTEGER, -numRows);
+    dataFrame.attr("class") = "data.frame";
+
+    return dataFrame;
+}
+
+
+
+
+/*
+ *  Method: SplitOnSlash
+ *
+ *      Splits a string on the '/' delimiter into its first two parts,
+ *      matching strsplit: a trailing empty part is not a part, so
+ *      "Black/" has no second part, and the empty string has none at all.
+ *      Missing parts are NA; parts past the second are dropped.
+ *      
+ */
+void FieldWrangler::SplitOnSlash (const string& text, string& first, string& second)
+{
+    first = NaString;
+    second = NaString;
+
+    if (text.empty())
+        return;
+
+    size_t slash = text.find('/');
+
+    first = text.substr(0, slash);
+
+    if (slash == string::npos || slash + 1 == text.size())
+        return;
+
+    size_t nextSlash = text.find('/', slash + 1);
+
+    second = text.substr(slash + 1, (nextSlash == string::npos) ? string::npos : nextSlash - slash - 1);
+}
+
+
+
+
+/*
+ *  Function: FindNoCase
+ *
+ *      Returns the position of the first case-insensitive occurrence of
+ *      an ASCII pattern in a string, or string::npos.
+ *      
+ */
+static size_t FindNoCase (const string& text, const char* pattern)
+{
+    size_t length = strlen(pattern);
+
+    for (size_t i = 0; i + length <= text.size(); ++i)
+    {
+        size_t j = 0;
+
+        while (j < length && tolower((unsigned char) text[i + j]) == tolower((unsigned char) pattern[j]))
+            ++j;
+
+        if (j == length)
+            return i;
+    }
+
+    return string::npos;
+}
+
+
+
+
+/*
+ *  Class: ColorWrangler
+ *
+ *      Splits a color/coat, such as "Orange Tabby/White", into primary
+ *      and secondary colors.
+ *      
+ */
+class ColorWrangler : public FieldWrangler
+{
+protected:
+    virtual void Split (const string& text, string& first, string& second) const
+    { SplitOnSlash(text, first, second); }
+};
+
+
+
+
+/*
+ *  Class: BreedWrangler
+ *
+ *      Splits a breed, such as "Bull Terrier/Boxer" or "Beagle Mix", into
+ *      primary and secondary breeds.
+ *
+ *      The "Black/Tan" breed contains the delimiter, so it is first
+ *      rewritten as "Black-Tan", and a " Mix" suffix becomes the second
+ *      part "Mix". Both are matched regardless of case, once per string.
+ *      
+ */
+class BreedWrangler : public FieldWrangler
+{
+protected:
+    virtual void Split (const string& text, string& first, string& second) const;
+};
+
+
+
+
+void BreedWrangler::Split (const string& text, string& first, string& second) const
+{
+    string breed = text;
+    size_t position = FindNoCase(breed, "Black/Tan");
+
+    if (position != string::npos)
+        breed.replace(position, 9, "Black-Tan");
+
+    position = FindNoCase(breed, " Mix");
+
+    if (position != string::npos)
+        breed.replace(position, 4, "/Mix");
+
+    SplitOnSlash(breed, first, second);
+}
+
+
+
+
+/*
+ *  Class: AgeWrangler
+ *
+ *      Parses ages such as "2 weeks" into a count, consolidated units (dy,
+ *      wk, mo, yr) and a duration in seconds.
+ *
+ *      "NULL" ages are NA. A "0 years" age keeps its count and units but
+ *      has no duration, since it means the age is unknown. Each distinct
+ *      age string is parsed once.
+ *      
+ */
+class AgeWrangler
+{
+public:
+    AgeWrangler (const NumericVector& secondsPerUnit);
+    ~AgeWrangler () {}
+
+    // Wrangle a character vector into a data frame of age columns.
+
+    List Wrangle (const CharacterVector& strings);
+
+private:
+    struct Age
+    {
+        int count;          // Count of units
+        Symbol units;       // Consolidated units
+        double seconds;     // Duration in seconds
+    };
+
+    Age Parse (const string& text);
+
+private:
+    double mSecondsPerUnit[4];      // Seconds in a dy, wk, mo and yr
+    SymbolTable mInputs;            // Distinct input strings
+    SymbolTable mUnits;             // Distinct units (factor levels)
+    vector<Age> mMemo;              // Parsed age, by input symbol
+};
+
+
+
+
+/*
+ *  Method: Constructor
+ *
+ *      Initializes this object to convert ages in days, weeks, months and
+ *      years using the specified numbers of seconds per unit, in that order.
+ *      
+ */
+AgeWrangler::AgeWrangler (const NumericVector& secondsPerUnit)
+           :
+            mInputs(),
+            mUnits(),
+            mMemo()
+{
+    if (secondsPerUnit.size() != 4)
+        throw string("Expected the seconds in a day, week, month and year");
+
+    for (int i = 0; i < 4; ++i)
+        mSecondsPerUnit[i] = secondsPerUnit[i];
+
+    Age na = { NA_INTEGER, NaSymbol, NA_REAL };
+
+    mMemo.push_back(na);
+}
+
+
+
+
+/*
+ *  Method: Parse
+ *
+ *      Parses a "<count> <units>" age string.
+ *      
+ */
+AgeWrangler::Age AgeWrangler::Parse (const string& text)
+{
+    static const char* const UnitNames[] = { "dy", "wk", "mo", "yr" };
+    static const char* const UnitSpellings[][2] = { { "day", "days" },
+                                                    { "week", "weeks" },
+                                                    { "month", "months" },
+                                                    { "year", "years" } };
+
+    Age age = { NA_INTEGER, NaSymbol, NA_REAL };
+
+    if (text.empty() || text == "NULL")
+        return age;
+
+    size_t space = text.find(' ');
+    string countText = text.substr(0, space);
+    string unitsText;
+
+    if (space != string::npos)
+        unitsText = text.substr(space + 1, text.find(' ', space + 1) - space - 1);
+
+    // The count converts as by as.integer: a number, truncated.
+
+    char* end = nullptr;
+    double count = strtod(countText.c_str(), &end);
+
+    if (!countText.empty() && *end == '\0' && fabs(count) < INT_MAX)
+        age.count = (int) count;
+
+    // Consolidate alike units; other units are kept as they are.
+
+    int unit = -1;
+
+    for (int i = 0; i < 4 && unit < 0; ++i)
+        if (unitsText == UnitSpellings[i][0] || unitsText == UnitSpellings[i][1])
+            unit = i;
+
+    if (unit >= 0)
+        age.units = mUnits.Intern(UnitNames[unit]);
+    else if (!unitsText.empty())
+        age.units = mUnits.Intern(unitsText);
+
+    if (unit >= 0 && age.count != NA_INTEGER && !(unit == 3 && countText == "0"))
+        age.seconds = age.count * mSecondsPerUnit[unit];
+
+    return age;
+}
+
+
+
+
+/*
+ *  Method: Wrangle
+ *
+ *      Parses each age string of a character vector, returning a data frame
+ *      of age_count (integer), age_units (factor) and age (seconds) columns.
+ *      
+ */
+List AgeWrangler::Wrangle (const CharacterVector& strings)
+{
+    int numRows = strings.size();
+    IntegerVector countCol(numRows);
+    IntegerVector unitsCol(numRows);
+    NumericVector ageCol(numRows);
+
+    for (int row = 0; row < numRows; ++row)
+    {
+        Symbol input = mInputs.Intern(STRING_ELT(strings, row));
+
+        if (input == mMemo.size())
+            mMemo.push_back(Parse(mInputs.GetString(input)));
+
+        const Age& age = mMemo[input];
+
+        countCol[row] = age.count;
+        unitsCol[row] = age.units;
+        ageCol[row] = age.seconds;
+    }
+
+    vector<IntegerVector*> columns = { &unitsCol };
+
+    EncodeFactorColumns(columns, mUnits);
+
+    List dataFrame = List::create(Named("age_count") = countCol,
+                                  Named("age_units") = unitsCol,
+                                  Named("age") = ageCol);
+
+    dataFrame.attr("row.names") = IntegerVector::create(NA_INTEGER, -numRows);
+    dataFrame.attr("class") = "data.frame";
+
+    return dataFrame;
+}
+
+
+
+
+/*** String normalizer *******************************************************/
+
+/*
+ *  Class: StringNormalizer
+ *
+ *      Normalizes a character column of the open data: trims whitespace
+ *      from both ends of each string, maps strings left empty to NA, and
+ *      optionally folds ASCII letters to lower case.
+ *
+ *      Equal strings in a column are mostly the same R CHARSXP, from R's
+ *      global string cache, so each distinct CHARSXP is normalized once,
+ *      and a string left unchanged keeps its CHARSXP. The distinct strings
+ *      are found by address, and their texts normalized, without calling
+ *      the R API, so different columns may be processed on different
+ *      threads at once. The texts of the distinct strings are read, and the
+ *      output column is made, on the calling thread.
+ *      
+ */
+class StringNormalizer
+{
+public:
+    StringNormalizer () : mFoldCase(false), mNumRows(0), mNumChanged(0) {}
+    ~StringNormalizer () {}
+
+    // Find the distinct strings of a column, viewed as the elements of its
+    // character vector. Does not call the R API.
+
+    void FindDistincts (const SEXP* strings, int numRows);
+
+    // Read the texts of the distinct strings. Calls the R API.
+
+    void ReadDistinctTexts ();
+
+    // Normalize the texts of the distinct strings. Does not call the R API.
+
+    void Normalize (bool foldCase);
+
+    // Make the normalized column, or return the column itself when no
+    // string is changed.
+
+    SEXP MakeColumn (SEXP column) const;
+
+private:
+    int FindOrAdd (SEXP charSxp);
+    void Grow ();
+
+    // Outcome of normalizing a distinct string.
+
+    enum Result
+    {
+        Unchanged,              // Keeps its CHARSXP (NA stays NA)
+        ToNa,                   // Blank, made NA
+        Changed                 // Trimmed or folded text
+    };
+
+private:
+    bool mFoldCase;             // Whether to fold ASCII letters to lower case
+    int mNumRows;               // Number of elements of the column
+    vector<int> mRowDistincts;  // Distinct string of each row
+    vector<SEXP> mDistincts;    // Distinct CHARSXPs, in first-seen order
+    vector<const char*> mDistinctTexts; // Text of each distinct string (null when NA)
+    vector<int> mDistinctLengths;   // Length of the text of each distinct string
+    vector<Result> mResults;    // Outcome of each distinct string
+    vector<string> mTexts;      // Text of each changed distinct string
+    vector<int> mSlots;         // Hash table of distinct strings (-1 marks empty)
+    size_t mSlotMask;           // Number of slots minus one (power of two)
+    int mNumChanged;            // Number of distinct strings changed or made NA
+};
+
+
+
+
+/*
+ *  Method: FindDistincts
+ *
+ *      Finds the distinct strings of a column, comparing the CHARSXPs by
+ *      address only.
+ *      
+ */
+void StringNormalizer::FindDistincts (const SEXP* strings, int numRows)
+{
+    mNumRows = numRows;
+    mRowDistincts.resize(numRows);
+    mDistincts.clear();
+    mSlots.assign(64, -1);
+    mSlotMask = 63;
+
+    for (int row = 0; row < numRows; ++row)
+        mRowDistincts[row] = FindOrAdd(strings[row]);
+}
+
+
+
+
+/*
+ *  Method: ReadDistinctTexts
+ *
+ *      Reads the text and length of each distinct string, for normalizing
+ *      without calling the R API. Must be called on the main thread.
+ *      
+ */
+void StringNormalizer::ReadDistinctTexts ()
+{
+    int numDistincts = mDistincts.size();
+
+    mDistinctTexts.assign(numDistincts, nullptr);
+    mDistinctLengths.assign(numDistincts, 0);
+
+    for (int i = 0; i < numDistincts; ++i)
+    {
+        SEXP charSxp = mDistincts[i];
+
+        if (charSxp == NA_STRING)
+            continue;
+
+        mDistinctTexts[i] = CHAR(charSxp);
+        mDistinctLengths[i] = LENGTH(charSxp);
+    }
+}
+
+
+
+
+/*
+ *  Method: Normalize
+ *
+ *      Normalizes each distinct string of the column once, from the texts
+ *      read by ReadDistinctTexts.
+ *      
+ */
+void StringNormalizer::Normalize (bool foldCase)
+{
+    mFoldCase = foldCase;
+
+    // Trim the characters that trimws removes by default, then fold.
+
+    int numDistincts = mDistincts.size();
+
+    mResults.assign(numDistincts, Unchanged);
+    mTexts.assign(numDistincts, string());
+    mNumChanged = 0;
+
+    for (int i = 0; i < numDistincts; ++i)
+    {
+        const char* text = mDistinctTexts[i];
+
+        if (text == nullptr)
+            continue;
+
+        int length = mDistinctLengths[i];
+        int begin = 0;
+        int end = length;
+
+        while (begin < end && strchr(" \t\r\n", text[begin]) != nullptr)
+            ++begin;
+
+        while (end > begin && strchr(" \t\r\n", text[end - 1]) != nullptr)
+            --end;
+
+        bool folds = false;
+
+        for (int k = begin; k < end && mFoldCase && !folds; ++k)
+            folds = (text[k] >= 'A' && text[k] <= 'Z');
+
+        if (begin == end)
+            mResults[i] = ToNa;
+        else if (begin > 0 || end < length || folds)
+        {
+            string& normalized = mTexts[i];
+
+            normalized.assign(text + begin, end - begin);
+
+            for (size_t k = 0; k < normalized.size() && folds; ++k)
+                if (normalized[k] >= 'A' && normalized[k] <= 'Z')
+                    normalized[k] += 'a' - 'A';
+
+            mResults[i] = Changed;
+        }
+        else
+            continue;
+
+        ++mNumChanged;
+    }
+}
+
+
+
+
+/*
+ *  Method: MakeColumn
+ *
+ *      Makes the normalized character column, making a CHARSXP for each
+ *      changed distinct string, in the encoding of the string it replaces.
+ *      Calls the R API, so must be called on the main thread.
+ *      
+ */
+SEXP StringNormalizer::MakeColumn (SEXP column) const
+{
+    if (mNumChanged == 0)
+        return column;
+
+    int numDistincts = mDistincts.size();
+    vector<SEXP> outputs(numDistincts);
+
+    for (int i = 0; i < numDistincts; ++i)
+    {
+        if (mResults[i] == Unchanged)
+            outputs[i] = mDistincts[i];
+        else if (mResults[i] == ToNa)
+            outputs[i] = NA_STRING;
+    }
+
+    // Protect the new CHARSXPs in the output column, which they are stored
+    // into as soon as they are made.
+
+    CharacterVector normalized(mNumRows);
+
+    for (int row = 0; row < mNumRows; ++row)
+    {
+        int distinct = mRowDistincts[row];
+
+        if (mResults[distinct] == Changed && outputs[distinct] == nullptr)
+        {
+            const string& text = mTexts[distinct];
+
+            outputs[distinct] = Rf_mkCharLenCE(text.data(), text.size(), Rf_getCharCE(mDistincts[distinct]));
+        }
+
+        SET_STRING_ELT(normalized, row, outputs[distinct]);
+    }
+
+    return normalized;
+}
+
+
+
+
+/*
+ *  Method: FindOrAdd
+ *
+ *      Returns the index of a CHARSXP among the distinct strings, adding it
+ *      when not seen before.
+ *      
+ */
+int StringNormalizer::FindOrAdd (SEXP charSxp)
+{
+    // Multiplicative hash of the address, as in the symbol table.
+
+    size_t hash = (size_t) (((uintptr_t) charSxp >> 3) * 11400714819323198485ULL);
+    size_t slot = hash & mSlotMask;
+
+    while (mSlots[slot] != -1)
+    {
+        if (mDistincts[mSlots[slot]] == charSxp)
+            return mSlots[slot];
+
+        slot = (slot + 1) & mSlotMask;
+    }
+
+    int distinct = mDistincts.size();
+
+    mDistincts.push_back(charSxp);
+    mSlots[slot] = distinct;
+
+    if (2 * mDistincts.size() > mSlots.size())
+        Grow();
+
+    return distinct;
+}
+
+
+
+
+/*
+ *  Method: Grow
+ *
+ *      Doubles the number of hash table slots and re-inserts all distinct
+ *      strings.
+ *      
+ */
+void StringNormalizer::Grow ()
+{
+    mSlots.assign(2 * mSlots.size(), -1);
+    mSlotMask = mSlots.size() - 1;
+
+    for (size_t distinct = 0; distinct < mDistincts.size(); ++distinct)
+    {
+        size_t hash = (size_t) (((uintptr_t) mDistincts[distinct] >> 3) * 11400714819323198485ULL);
+        size_t slot = hash & mSlotMask;
+
+        while (mSlots[slot] != -1)
+            slot = (slot + 1) & mSlotMask;
+
+        mSlots[slot] = distinct;
+    }
+}
+
+
+
+
+/*
+ *  Function: NormalizeStringColumns
+ *
+ *      Normalizes a list of columns as character columns, in parallel over
+ *      the columns. Columns of other types are converted to character
+ *      first. Returns the list of normalized columns, with the same names.
+ *      
+ */
+static List NormalizeStringColumns (const List& columns, bool foldCase)
+{
+    int numColumns = columns.size();
+    List normalized(numColumns);
+    vector<const SEXP*> strings(numColumns);
+    vector<int> numRows(numColumns);
+
+    // Convert the columns and find their elements here, and read the texts
+    // of their distinct strings between the parallel passes, so that the
+    // worker threads never call the R API.
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        CharacterVector column = columns[c];
+
+        SET_VECTOR_ELT(normalized, c, column);
+        strings[c] = STRING_PTR_RO(column);
+        numRows[c] = column.size();
+    }
+
+    vector<StringNormalizer> normalizers(numColumns);
+
+    ParallelFor(numColumns, GetNumWorkerThreads(), [&] (int c)
+    {
+        normalizers[c].FindDistincts(strings[c], numRows[c]);
+    });
+
+    for (int c = 0; c < numColumns; ++c)
+        normalizers[c].ReadDistinctTexts();
+
+    ParallelFor(numColumns, GetNumWorkerThreads(), [&] (int c)
+    {
+        normalizers[c].Normalize(foldCase);
+    });
+
+    for (int c = 0; c < numColumns; ++c)
+        SET_VECTOR_ELT(normalized, c, normalizers[c].MakeColumn(VECTOR_ELT(normalized, c)));
+
+    Rf_setAttrib(normalized, R_NamesSymbol, Rf_getAttrib(columns, R_NamesSymbol));
+
+    return normalized;
+}
+
+
+
+
+/*** Event stores ************************************************************/
+
+// Row index that stands for a missing event, e.g., the missing outcome of a
+// solitary intake.
+
+static const int NaRow = -1;
+
+
+
+
+/*
+ *  Class: EventOrderLessThan
+ *
+ *      Compares two rows of an event store by animal index, then by event
+ *      timestamp, then by row index, and returns whether the first is less
+ *      than the second.
+ *
+ *      Missing timestamps order after all others. Ties on timestamp keep the
+ *      order in which the events were added.
+ *      
+ */
+class EventOrderLessThan
+{
+public:
+    EventOrderLessThan (const vector<int>& animals, const vector<double>& times)
+                      : mAnimals(animals), mTimes(times) {}
+
+    bool operator() (int rowA, int rowB) const
+    {
+        if (mAnimals[rowA] != mAnimals[rowB])
+            return (mAnimals[rowA] < mAnimals[rowB]);
+
+        double timeA = mTimes[rowA];
+        double timeB = mTimes[rowB];
+
+        if (ISNAN(timeA) || ISNAN(timeB))
+        {
+            if (ISNAN(timeA) != ISNAN(timeB))
+                return ISNAN(timeB);
+        }
+        else if (timeA != timeB)
+            return (timeA < timeB);
+
+        return (rowA < rowB);
+    }
+
+private:
+    const vector<int>& mAnimals;
+    const vector<double>& mTimes;
+};
+
+
+
+
+/*
+ *  Function: GroupRowsByAnimal
+ *
+ *      Computes the order of the rows of an event store that groups them by
+ *      animal, and orders the rows of each animal by timestamp.
+ *
+ *      The first numGroupedRows rows are already grouped, as described by
+ *      firstRows, and the rows after them are new. The grouped rows keep
+ *      their order, and only the rows of animals with new rows are sorted,
+ *      so regrouping after a few new rows takes linear time. All rows are
+ *      new on the first grouping.
+ *
+ *      On return, order holds the old row index of each new row, and the
+ *      new rows of animal a are [firstRows[a], firstRows[a + 1]).
+ *      
+ */
+static void GroupRowsByAnimal (const vector<int>& animals, const vector<double>& times,
+                               int numAnimals, int numGroupedRows,
+                               vector<int>& order, vector<int>& firstRows)
+{
+    int numRows = animals.size();
+
+    // Animals added since the last grouping have no grouped rows.
+
+    vector<int> groupedFirstRows;
+    groupedFirstRows.swap(firstRows);
+    groupedFirstRows.resize(numAnimals + 1, numGroupedRows);
+
+    // Count the rows of each animal, grouped and new, and make the ranges.
+
+    firstRows.assign(numAnimals + 1, 0);
+
+    for (int a = 0; a < numAnimals; ++a)
+        firstRows[a + 1] = groupedFirstRows[a + 1] - groupedFirstRows[a];
+
+    for (int i = numGroupedRows; i < numRows; ++i)
+        ++firstRows[animals[i] + 1];
+
+    for (int a = 0; a < numAnimals; ++a)
+        firstRows[a + 1] += firstRows[a];
+
+    // Place the grouped rows of each animal, then its new rows in the order
+    // in which they were added.
+
+    order.resize(numRows);
+
+    vector<int> nextRows(firstRows.begin(), firstRows.end() - 1);
+
+    for (int a = 0; a < numAnimals; ++a)
+        for (int row = groupedFirstRows[a]; row < groupedFirstRows[a + 1]; ++row)
+            order[nextRows[a]++] = row;
+
+    for (int i = numGroupedRows; i < numRows; ++i)
+        order[nextRows[animals[i]]++] = i;
+
+    // Order the rows of each animal with new rows by timestamp. Exports are
+    // mostly in date order, so most animals' rows already are.
+
+    EventOrderLessThan lessThan(animals, times);
+
+    for (int a = 0; a < numAnimals; ++a)
+    {
+        int numGrouped = groupedFirstRows[a + 1] - groupedFirstRows[a];
+        int numTotal = firstRows[a + 1] - firstRows[a];
+        vector<int>::iterator begin = order.begin() + firstRows[a];
+        vector<int>::iterator end = order.begin() + firstRows[a + 1];
+
+        if (numTotal > numGrouped && numTotal > 1 && !std::is_sorted(begin, end, lessThan))
+            sort(begin, end, lessThan);
+    }
+}
+
+
+
+
+/*
+ *  Function: PermuteColumn
+ *
+ *      Reorders a column of an event store so that new row i holds the value
+ *      of old row order[i].
+ *      
+ */
+template <class T>
+static void PermuteColumn (vector<T>& column, const vector<int>& order)
+{
+    vector<T> permuted(column.size());
+
+    for (size_t i = 0; i < order.size(); ++i)
+        permuted[i] = column[order[i]];
+
+    column.swap(permuted);
+}
+
+
+
+
+/*** IntakeStore *************************************************************/
+
+/*
+ *  Class: IntakeStore
+ *
+ *      Animal intake events, stored as one column per field and referred to
+ *      by row index.
+ *
+ *      Events are added in input order. Grouping then reorders the rows once
+ *      so that the intakes of each animal are contiguous and in time order,
+ *      and the merge can walk the rows of an animal as a range of packed
+ *      columns.
+ *      
+ */
+class IntakeStore
+{
+public:
+    IntakeStore () : mFirstRows(1, 0), mNumGroupedRows(0) {}
+    ~IntakeStore () {}
+
+    // Add an intake with all other fields NA, returning its row. The day is
+    // the local-day key of the date (NaDay when the date is missing).
+
+    int Add (int animal, double intakeDate, int intakeDay);
+
+    // Make room for a number of further intakes.
+
+    void Reserve (int numIntakes);
+
+    // All fields of an intake, for moving intakes through spill runs.
+
+    struct Row
+    {
+        double intakeDate;          // Intake event timestamp (seconds, NA when missing)
+        int intakeDay;              // Local-day key of the intake timestamp
+        Symbol intakeType;          // Type of intake
+        Symbol intakeSubType;       // Sub-type of intake type
+        Symbol intakeCondition;     // Condition at time of intake
+        Symbol intakeLocation;      // Place where animal was captured or surrendered
+        int intakeAgeCount;         // Integer age
+        Symbol intakeAgeUnits;      // Units of the integer age
+        int intakeAge;              // Age as a count of seconds
+        Symbol intakeSpayNeuter;    // Sterilization status
+        Symbol kennel;              // Kennel assignment
+    };
+
+    Row GetRow (int row) const;
+
+    // Append an intake of the specified animal with all fields of a row,
+    // returning its row.
+
+    int AddRow (int animal, const Row& row);
+
+    // Group rows by animal, and order each animal's rows by intake date.
+
+    void GroupByAnimal (int numAnimals);
+
+    // Remove all intakes.
+
+    void Clear ();
+
+    // Number of bytes allocated by this store.
+
+    size_t GetNumBytes () const;
+
+    // Rows of an animal's intakes, valid after grouping.
+
+    int GetFirstRow (int animal) const
+    { return mFirstRows[animal]; }
+
+    int GetEndRow (int animal) const
+    { return mFirstRows[animal + 1]; }
+
+    // Properties
+
+    int GetNumIntakes () const
+    { return mAnimalCol.size(); }
+
+    double GetIntakeDate (int row) const
+    { return mIntakeDateCol[row]; }
+
+    int GetIntakeDay (int row) const
+    { return mIntakeDayCol[row]; }
+
+    Symbol GetIntakeType (int row) const
+    { return mIntakeTypeCol[row]; }
+
+    void SetIntakeType (int row, Symbol intakeType)
+    { mIntakeTypeCol[row] = intakeType; }
+
+    Symbol GetIntakeSubType (int row) const
+    { return mIntakeSubTypeCol[row]; }
+
+    void SetIntakeSubType (int row, Symbol intakeSubType)
+    { mIntakeSubTypeCol[row] = intakeSubType; }
+
+    Symbol GetIntakeCondition (int row) const
+    { return mIntakeConditionCol[row]; }
+
+    void SetIntakeCondition (int row, Symbol intakeCondition)
+    { mIntakeConditionCol[row] = intakeCondition; }
+
+    Symbol GetIntakeLocation (int row) const
+    { return mIntakeLocationCol[row]; }
+
+    void SetIntakeLocation (int row, Symbol intakeLocation)
+    { mIntakeLocationCol[row] = intakeLocation; }
+
+    int GetIntakeAgeCount (int row) const
+    { return mIntakeAgeCountCol[row]; }
+
+    void SetIntakeAgeCount (int row, int intakeAgeCount)
+    { mIntakeAgeCountCol[row] = intakeAgeCount; }
+
+    Symbol GetIntakeAgeUnits (int row) const
+    { return mIntakeAgeUnitsCol[row]; }
+
+    void SetIntakeAgeUnits (int row, Symbol intakeAgeUnits)
+    { mIntakeAgeUnitsCol[row] = intakeAgeUnits; }
+
+    int GetIntakeAge (int row) const
+    { return mIntakeAgeCol[row]; }
+
+    void SetIntakeAge (int row, int intakeAge)
+    { mIntakeAgeCol[row] = intakeAge; }
+
+    Symbol GetIntakeSpayNeuter (int row) const
+    { return mIntakeSpayNeuterCol[row]; }
+
+    void SetIntakeSpayNeuter (int row, Symbol intakeSpayNeuter)
+    { mIntakeSpayNeuterCol[row] = intakeSpayNeuter; }
+
+    Symbol GetKennel (int row) const
+    { return mKennelCol[row]; }
+
+    void SetKennel (int row, Symbol kennel)
+    { mKennelCol[row] = kennel; }
+
+    // Convert a row to printable string.
+
+    string ToString (int row, const SymbolTable& symbols) const;
+
+private:
+    vector<int> mAnimalCol;             // Animal map index of the animal taken in
+    vector<double> mIntakeDateCol;      // Intake event timestamp (seconds, NA when missing)
+    vector<int> mIntakeDayCol;          // Local-day key of the intake timestamp
+    vector<Symbol> mIntakeTypeCol;      // Type of intake (e.g., Stray, Owner Surrender)
+    vector<Symbol> mIntakeSubTypeCol;   // Sub-type of intake type (e.g., Stray/Field, Owner Surrender/OTC)
+    vector<Symbol> mIntakeConditionCol; // Condition at time of intake (e.g., Normal, Injured)
+    vector<Symbol> mIntakeLocationCol;  // Place where animal was captured or surrendered
+    vector<int> mIntakeAgeCountCol;     // Integer age
+    vector<Symbol> mIntakeAgeUnitsCol;  // Units of the integer age (e.g., dy, mo, yr)
+    vector<int> mIntakeAgeCol;          // Age represented as a count of seconds (denormalized age count)
+    vector<Symbol> mIntakeSpayNeuterCol;// Sterilization status (e.g., Intact, Altered)
+    vector<Symbol> mKennelCol;          // Kennel assignment
+    vector<int> mFirstRows;             // First row of each animal, plus the end row
+    int mNumGroupedRows;                // Number of rows grouped by the last grouping
+};
+
+
+
+
+/*
+ *  Method: Add
+ *
+ *      Appends an intake of the specified animal at the specified time.
+ *      The other fields of the intake are NA until set.
+ *
+ *      Returns the row of the new intake.
+ *      
+ */
+int IntakeStore::Add (int animal, double intakeDate, int intakeDay)
+{
+    mAnimalCol.push_back(animal);
+    mIntakeDateCol.push_back(R_FINITE(intakeDate) ? intakeDate : NA_REAL);
+    mIntakeDayCol.push_back(R_FINITE(intakeDate) ? intakeDay : NaDay);
+    mIntakeTypeCol.push_back(NaSymbol);
+    mIntakeSubTypeCol.push_back(NaSymbol);
+    mIntakeConditionCol.push_back(NaSymbol);
+    mIntakeLocationCol.push_back(NaSymbol);
+    mIntakeAgeCountCol.push_back(NA_INTEGER);
+    mIntakeAgeUnitsCol.push_back(NaSymbol);
+    mIntakeAgeCol.push_back(NA_INTEGER);
+    mIntakeSpayNeuterCol.push_back(NaSymbol);
+    mKennelCol.push_back(NaSymbol);
+
+    return mAnimalCol.size() - 1;
+}
+
+
+
+
+/*
+ *  Method: Reserve
+ *
+ *      Makes room in every column for a number of further intakes.
+ *      
+ */
+void IntakeStore::Reserve (int numIntakes)
+{
+    size_t size = mAnimalCol.size() + numIntakes;
+
+    mAnimalCol.reserve(size);
+    mIntakeDateCol.reserve(size);
+    mIntakeDayCol.reserve(size);
+    mIntakeTypeCol.reserve(size);
+    mIntakeSubTypeCol.reserve(size);
+    mIntakeConditionCol.reserve(size);
+    mIntakeLocationCol.reserve(size);
+    mIntakeAgeCountCol.reserve(size);
+    mIntakeAgeUnitsCol.reserve(size);
+    mIntakeAgeCol.reserve(size);
+    mIntakeSpayNeuterCol.reserve(size);
+    mKennelCol.reserve(size);
+}
+
+
+
+
+/*
+ *  Method: GetRow
+ *
+ *      Returns all fields of the intake in the specified row.
+ *      
+ */
+IntakeStore::Row IntakeStore::GetRow (int row) const
+{
+    Row fields;
+
+    fields.intakeDate = mIntakeDateCol[row];
+    fields.intakeDay = mIntakeDayCol[row];
+    fields.intakeType = mIntakeTypeCol[row];
+    fields.intakeSubType = mIntakeSubTypeCol[row];
+    fields.intakeCondition = mIntakeConditionCol[row];
+    fields.intakeLocation = mIntakeLocationCol[row];
+    fields.intakeAgeCount = mIntakeAgeCountCol[row];
+    fields.intakeAgeUnits = mIntakeAgeUnitsCol[row];
+    fields.intakeAge = mIntakeAgeCol[row];
+    fields.intakeSpayNeuter = mIntakeSpayNeuterCol[row];
+    fields.kennel = mKennelCol[row];
+
+    return fields;
+}
+
+
+
+
+/*
+ *  Method: AddRow
+ *
+ *      Appends an intake of the specified animal with all fields given.
+ *
+ *      Returns the row of the new intake.
+ *      
+ */
+int IntakeStore::AddRow (int animal, const Row& fields)
+{
+    mAnimalCol.push_back(animal);
+    mIntakeDateCol.push_back(fields.intakeDate);
+    mIntakeDayCol.push_back(fields.intakeDay);
+    mIntakeTypeCol.push_back(fields.intakeType);
+    mIntakeSubTypeCol.push_back(fields.intakeSubType);
+    mIntakeConditionCol.push_back(fields.intakeCondition);
+    mIntakeLocationCol.push_back(fields.intakeLocation);
+    mIntakeAgeCountCol.push_back(fields.intakeAgeCount);
+    mIntakeAgeUnitsCol.push_back(fields.intakeAgeUnits);
+    mIntakeAgeCol.push_back(fields.intakeAge);
+    mIntakeSpayNeuterCol.push_back(fields.intakeSpayNeuter);
+    mKennelCol.push_back(fields.kennel);
+
+    return mAnimalCol.size() - 1;
+}
+
+
+
+
+/*
+ *  Method: GroupByAnimal
+ *
+ *      Reorders all rows so that the intakes of each animal are contiguous
+ *      and ordered by intake date. Rows added since the last grouping are
+ *      placed among the rows of their animals.
+ *      
+ */
+void IntakeStore::GroupByAnimal (int numAnimals)
+{
+    // Nothing to reorder when no rows were added since the last grouping.
+
+    if (mNumGroupedRows == (int) mAnimalCol.size())
+    {
+        mFirstRows.resize(numAnimals + 1, mNumGroupedRows);
+        return;
+    }
+
+    vector<int> order;
+
+    GroupRowsByAnimal(mAnimalCol, mIntakeDateCol, numAnimals, mNumGroupedRows, order, mFirstRows);
+
+    PermuteColumn(mAnimalCol, order);
+    PermuteColumn(mIntakeDateCol, order);
+    PermuteColumn(mIntakeDayCol, order);
+    PermuteColumn(mIntakeTypeCol, order);
+    PermuteColumn(mIntakeSubTypeCol, order);
+    PermuteColumn(mIntakeConditionCol, order);
+    PermuteColumn(mIntakeLocationCol, order);
+    PermuteColumn(mIntakeAgeCountCol, order);
+    PermuteColumn(mIntakeAgeUnitsCol, order);
+    PermuteColumn(mIntakeAgeCol, order);
+    PermuteColumn(mIntakeSpayNeuterCol, order);
+    PermuteColumn(mKennelCol, order);
+
+    mNumGroupedRows = mAnimalCol.size();
+}
+
+
+
+
+/*
+ *  Method: Clear
+ *
+ *      Removes all intakes from this store.
+ *      
+ */
+void IntakeStore::Clear ()
+{
+    mAnimalCol.clear();
+    mIntakeDateCol.clear();
+    mIntakeDayCol.clear();
+    mIntakeTypeCol.clear();
+    mIntakeSubTypeCol.clear();
+    mIntakeConditionCol.clear();
+    mIntakeLocationCol.clear();
+    mIntakeAgeCountCol.clear();
+    mIntakeAgeUnitsCol.clear();
+    mIntakeAgeCol.clear();
+    mIntakeSpayNeuterCol.clear();
+    mKennelCol.clear();
+    mFirstRows.assign(1, 0);
+    mNumGroupedRows = 0;
+}
+
+
+
+
+/*
+ *  Method: GetNumBytes
+ *
+ *      Returns the number of bytes allocated for the columns of this store.
+ *      
+ */
+size_t IntakeStore::GetNumBytes () const
+{
+    return GetVectorBytes(mAnimalCol) + GetVectorBytes(mIntakeDateCol) + GetVectorBytes(mIntakeDayCol) +
+           GetVectorBytes(mIntakeTypeCol) + GetVectorBytes(mIntakeSubTypeCol) +
+           GetVectorBytes(mIntakeConditionCol) + GetVectorBytes(mIntakeLocationCol) +
+           GetVectorBytes(mIntakeAgeCountCol) + GetVectorBytes(mIntakeAgeUnitsCol) +
+           GetVectorBytes(mIntakeAgeCol) + GetVectorBytes(mIntakeSpayNeuterCol) +
+           GetVectorBytes(mKennelCol) + GetVectorBytes(mFirstRows);
+}
+
+
+
+
+/*
+ *  Method: ToString
+ *
+ *      Returns the printable string representation of the intake in the
+ *      specified row.
+ *      
+ */
+string IntakeStore::ToString (int row, const SymbolTable& symbols) const
+{
+    ostringstream buffer;
+    
+    buffer << "Intake " << DateTimeToString(Datetime(mIntakeDateCol[row]))
+           << " type(" << symbols.GetString(mIntakeTypeCol[row])
+           << ") subtype(" << symbols.GetString(mIntakeSubTypeCol[row])
+           << ") condition(" << symbols.GetString(mIntakeConditionCol[row])
+           << ") spayNeuter(" << symbols.GetString(mIntakeSpayNeuterCol[row])
+           << ") ageCount(" << mIntakeAgeCountCol[row]
+           << ") ageUnits(" << symbols.GetString(mIntakeAgeUnitsCol[row])
+           << ") age(" << mIntakeAgeCol[row]
+           << ") location(" << symbols.GetString(mIntakeLocationCol[row])
+           << ") kennel(" << symbols.GetString(mKennelCol[row])
+           << ")";
+    
+    return buffer.str();
+}
+
+
+
+
+/*** OutcomeStore ************************************************************/
+
+/*
+ *  Class: OutcomeStore
+ *
+ *      Animal outcome events, stored as one column per field and referred to
+ *      by row index. Grouped by animal in the same way as intakes.
+ *      
+ */
+class OutcomeStore
+{
+public:
+    OutcomeStore () : mFirstRows(1, 0), mNumGroupedRows(0) {}
+    ~OutcomeStore () {}
+
+    // Add an outcome with all other fields NA, returning its row. The day is
+    // the local-day key of the date (NaDay when the date is missing).
+
+    int Add (int animal, double outcomeDate, int outcomeDay);
+
+    // Make room for a number of further outcomes.
+
+    void Reserve (int numOutcomes);
+
+    // All fields of an outcome, for moving outcomes through spill runs.
+
+    struct Row
+    {
+        double outcomeDate;         // Outcome event timestamp (seconds, NA when missing)
+        int outcomeDay;             // Local-day key of the outcome timestamp
+        Symbol outcomeType;         // Type of outcome
+        Symbol outcomeSubType;      // Sub-type of outcome type
+        Symbol outcomeCondition;    // Condition at time of discharge
+        Symbol outcomeSpayNeuter;   // Sterilization status when discharged
+    };
+
+    Row GetRow (int row) const;
+
+    // Append an outcome of the specified animal with all fields of a row,
+    // returning its row.
+
+    int AddRow (int animal, const Row& row);
+
+    // Group rows by animal, and order each animal's rows by outcome date.
+
+    void GroupByAnimal (int numAnimals);
+
+    // Remove all outcomes.
+
+    void Clear ();
+
+    // Number of bytes allocated by this store.
+
+    size_t GetNumBytes () const;
+
+    // Rows of an animal's outcomes, valid after grouping.
+
+    int GetFirstRow (int animal) const
+    { return mFirstRows[animal]; }
+
+    int GetEndRow (int animal) const
+    { return mFirstRows[animal + 1]; }
+
+    // Properties
+
+    int GetNumOutcomes () const
+    { return mAnimalCol.size(); }
+
+    double GetOutcomeDate (int row) const
+    { return mOutcomeDateCol[row]; }
+
+    int GetOutcomeDay (int row) const
+    { return mOutcomeDayCol[row]; }
+
+    Symbol GetOutcomeType (int row) const
+    { return mOutcomeTypeCol[row]; }
+
+    void SetOutcomeType (int row, Symbol outcomeType)
+    { mOutcomeTypeCol[row] = outcomeType; }
+
+    Symbol GetOutcomeSubType (int row) const
+    { return mOutcomeSubTypeCol[row]; }
+
+    void SetOutcomeSubType (int row, Symbol outcomeSubType)
+    { mOutcomeSubTypeCol[row] = outcomeSubType; }
+
+    Symbol GetOutcomeCondition (int row) const
+    { return mOutcomeConditionCol[row]; }
+
+    void SetOutcomeCondition (int row, Symbol outcomeCondition)
+    { mOutcomeConditionCol[row] = outcomeCondition; }
+
+    Symbol GetOutcomeSpayNeuter (int row) const
+    { return mOutcomeSpayNeuterCol[row]; }
+
+    void SetOutcomeSpayNeuter (int row, Symbol outcomeSpayNeuter)
+    { mOutcomeSpayNeuterCol[row] = outcomeSpayNeuter; }
+
+    // Convert a row to printable string.
+
+    string ToString (int row, const SymbolTable& symbols) const;
+
+private:
+    vector<int> mAnimalCol;                 // Animal map index of the animal discharged
+    vector<double> mOutcomeDateCol;         // Outcome event timestamp (seconds, NA when missing)
+    vector<int> mOutcomeDayCol;             // Local-day key of the outcome timestamp
+    vector<Symbol> mOutcomeTypeCol;         // Type of outcome (e.g., Adoption, Transfer, Return to Owner)
+    vector<Symbol> mOutcomeSubTypeCol;      // Sub-type of outcome type (e.g., Adoption/Foster, Transfer/Partner)
+    vector<Symbol> mOutcomeConditionCol;    // Condition at time of discharge (e.g., Normal, Sick)
+    vector<Symbol> mOutcomeSpayNeuterCol;   // Sterilization status when discharged (e.g., Intact, Altered)
+    vector<int> mFirstRows;                 // First row of each animal, plus the end row
+    int mNumGroupedRows;                    // Number of rows grouped by the last grouping
+};
+
+
+
+
+/*
+ *  Method: Add
+ *
+ *      Appends an outcome of the specified animal at the specified time.
+ *      The other fields of the outcome are NA until set.
+ *
+ *      Returns the row of the new outcome.
+ *      
+ */
+int OutcomeStore::Add (int animal, double outcomeDate, int outcomeDay)
+{
+    mAnimalCol.push_back(animal);
+    mOutcomeDateCol.push_back(R_FINITE(outcomeDate) ? outcomeDate : NA_REAL);
+    mOutcomeDayCol.push_back(R_FINITE(outcomeDate) ? outcomeDay : NaDay);
+    mOutcomeTypeCol.push_back(NaSymbol);
+    mOutcomeSubTypeCol.push_back(NaSymbol);
+    mOutcomeConditionCol.push_back(NaSymbol);
+    mOutcomeSpayNeuterCol.push_back(NaSymbol);
+
+    return mAnimalCol.size() - 1;
+}
+
+
+
+
+/*
+ *  Method: Reserve
+ *
+ *      Makes room in every column for a number of further outcomes.
+ *      
+ */
+void OutcomeStore::Reserve (int numOutcomes)
+{
+    size_t size = mAnimalCol.size() + numOutcomes;
+
+    mAnimalCol.reserve(size);
+    mOutcomeDateCol.reserve(size);
+    mOutcomeDayCol.reserve(size);
+    mOutcomeTypeCol.reserve(size);
+    mOutcomeSubTypeCol.reserve(size);
+    mOutcomeConditionCol.reserve(size);
+    mOutcomeSpayNeuterCol.reserve(size);
+}
+
+
+
+
+/*
+ *  Method: GetRow
+ *
+ *      Returns all fields of the outcome in the specified row.
+ *      
+ */
+OutcomeStore::Row OutcomeStore::GetRow (int row) const
+{
+    Row fields;
+
+    fields.outcomeDate = mOutcomeDateCol[row];
+    fields.outcomeDay = mOutcomeDayCol[row];
+    fields.outcomeType = mOutcomeTypeCol[row];
+    fields.outcomeSubType = mOutcomeSubTypeCol[row];
+    fields.outcomeCondition = mOutcomeConditionCol[row];
+    fields.outcomeSpayNeuter = mOutcomeSpayNeuterCol[row];
+
+    return fields;
+}
+
+
+
+
+/*
+ *  Method: AddRow
+ *
+ *      Appends an outcome of the specified animal with all fields given.
+ *
+ *      Returns the row of the new outcome.
+ *      
+ */
+int OutcomeStore::AddRow (int animal, const Row& fields)
+{
+    mAnimalCol.push_back(animal);
+    mOutcomeDateCol.push_back(fields.outcomeDate);
+    mOutcomeDayCol.push_back(fields.outcomeDay);
+    mOutcomeTypeCol.push_back(fields.outcomeType);
+    mOutcomeSubTypeCol.push_back(fields.outcomeSubType);
+    mOutcomeConditionCol.push_back(fields.outcomeCondition);
+    mOutcomeSpayNeuterCol.push_back(fields.outcomeSpayNeuter);
+
+    return mAnimalCol.size() - 1;
+}
+
+
+
+
+/*
+ *  Method: GroupByAnimal
+ *
+ *      Reorders all rows so that the outcomes of each animal are contiguous
+ *      and ordered by outcome date. Rows added since the last grouping are
+ *      placed among the rows of their animals.
+ *      
+ */
+void OutcomeStore::GroupByAnimal (int numAnimals)
+{
+    // Nothing to reorder when no rows were added since the last grouping.
+
+    if (mNumGroupedRows == (int) mAnimalCol.size())
+    {
+        mFirstRows.resize(numAnimals + 1, mNumGroupedRows);
+        return;
+    }
+
+    vector<int> order;
+
+    GroupRowsByAnimal(mAnimalCol, mOutcomeDateCol, numAnimals, mNumGroupedRows, order, mFirstRows);
+
+    PermuteColumn(mAnimalCol, order);
+    PermuteColumn(mOutcomeDateCol, order);
+    PermuteColumn(mOutcomeDayCol, order);
+    PermuteColumn(mOutcomeTypeCol, order);
+    PermuteColumn(mOutcomeSubTypeCol, order);
+    PermuteColumn(mOutcomeConditionCol, order);
+    PermuteColumn(mOutcomeSpayNeuterCol, order);
+
+    mNumGroupedRows = mAnimalCol.size();
+}
+
+
+
+
+/*
+ *  Method: Clear
+ *
+ *      Removes all outcomes from this store.
+ *      
+ */
+void OutcomeStore::Clear ()
+{
+    mAnimalCol.clear();
+    mOutcomeDateCol.clear();
+    mOutcomeDayCol.clear();
+    mOutcomeTypeCol.clear();
+    mOutcomeSubTypeCol.clear();
+    mOutcomeConditionCol.clear();
+    mOutcomeSpayNeuterCol.clear();
+    mFirstRows.assign(1, 0);
+    mNumGroupedRows = 0;
+}
+
+
+
+
+/*
+ *  Method: GetNumBytes
+ *
+ *      Returns the number of bytes allocated for the columns of this store.
+ *      
+ */
+size_t OutcomeStore::GetNumBytes () const
+{
+    return GetVectorBytes(mAnimalCol) + GetVectorBytes(mOutcomeDateCol) + GetVectorBytes(mOutcomeDayCol) +
+           GetVectorBytes(mOutcomeTypeCol) + GetVectorBytes(mOutcomeSubTypeCol) +
+           GetVectorBytes(mOutcomeConditionCol) + GetVectorBytes(mOutcomeSpayNeuterCol) +
+           GetVectorBytes(mFirstRows);
+}
+
+
+
+
+/*
+ *  Method: ToString
+ *
+ *      Returns the printable string representation of the outcome in the
+ *      specified row.
+ *      
+ */
+string OutcomeStore::ToString (int row, const SymbolTable& symbols) const
+{
+    ostringstream buffer;
+
+    buffer << "Outcome " << DateTimeToString(Datetime(mOutcomeDateCol[row]))
+           << " type(" << symbols.GetString(mOutcomeTypeCol[row])
+           << ") subtype(" << symbols.GetString(mOutcomeSubTypeCol[row])
+           << ") spayNeuter(" << symbols.GetString(mOutcomeSpayNeuterCol[row])
+           << ")";
+
+    return buffer.str();
+}
+
+
+
+
+
+/*** Animal ******************************************************************/
+
+/*
+ *  Struct: AnimalRecord
+ *
+ *      Animal information read from a single input record, used to create or
+ *      update an animal in place.
+ *      
+ */
+struct AnimalRecord
+{
+    AnimalRecord (double recordDateTime)
+                :
+                 dateTime(recordDateTime),
+                 kind(NaSymbol),
+                 gender(NaSymbol),
+                 name(NaSymbol),
+                 color1(NaSymbol),
+                 color2(NaSymbol),
+                 breed1(NaSymbol),
+                 breed2(NaSymbol)
+    {}
+
+    double dateTime;    // Timestamp of the record (seconds)
+    Symbol kind;        // Kind (e.g., Dog, Cat)
+    Symbol gender;      // Gender (e.g., Male, Female)
+    Symbol name;        // Name
+    Symbol color1;      // Primary color
+    Symbol color2;      // Secondary color
+    Symbol breed1;      // Primary breed designation
+    Symbol breed2;      // Secondary breed designation
+};
+
+
+
+
+/*
+ *  Class: Animal
+ *
+ *      Animal description.
+ *      
+ */
+class Animal
+{
+public:
+    
+    Animal ();
+    ~Animal () {}
+
+    // Set all fields from the first record of this animal. Later records
+    // are resolved in batches by AnimalUpdateStore.
+
+    void Assign (Symbol animalId, const AnimalRecord& record);
+
+    // Properties
+    
+    Symbol GetAnimalId () const
+    { return mAnimalId; }
+
+    void SetAnimalId (Symbol animalId)
+    { mAnimalId = animalId; }
+
+    Symbol GetSource () const
+    { return mSource; }
+
+    void SetSource (Symbol source)
+    { mSource = source; }
+
+    Symbol GetCity () const
+    { return mCity; }
+
+    void SetCity (Symbol city)
+    { mCity = city; }
+
+    Symbol GetKind () const
+    { return mKind; }
+
+    void SetKind (Symbol kind)
+    { mKind = kind; }
+    
+    Symbol GetName () const
+    { return mName; }
+    
+    void SetName (Symbol name)
+    { mName = name; }
+
+    Symbol GetGender () const
+    { return mGender; }
+    
+    void SetGender (Symbol gender)
+    { mGender = gender; }
+
+    Symbol GetColor1 () const
+    { return mColor1; }
+    
+    void SetColor1 (Symbol color1)
+    { mColor1 = color1; }
+
+    Symbol GetColor2 () const
+    { return mColor2; }
+    
+    void SetColor2 (Symbol color2)
+    { mColor2 = color2; }
+
+    Symbol GetBreed1 () const
+    { return mBreed1; }
+    
+    void SetBreed1 (Symbol breed1)
+    { mBreed1 = breed1; }
+
+    Symbol GetBreed2 () const
+    { return mBreed2; }
+    
+    void SetBreed2 (Symbol breed2)
+    { mBreed2 = breed2; }
+
+    double GetDateTime () const
+    { return mDateTime; }
+
+    void SetDateTime (double dateTime)
+    { mDateTime = dateTime; }
+
+    // Convert to printable string.
+
+    string ToString (const SymbolTable& symbols) const;
+
+private:
+
+    Symbol mAnimalId;   // Impound identifier for this animal
+    Symbol mSource;     // Data set of the animal's records, in combined builds
+    Symbol mCity;       // City of the shelter, in combined builds
+    Symbol mKind;       // Kind (e.g., Dog, Cat)
+    Symbol mGender;     // Gender (e.g., Male, Female)
+    Symbol mName;       // Name
+    Symbol mColor1;     // Primary color
+    Symbol mColor2;     // Secondary color
+    Symbol mBreed1;     // Primary breed designation
+    Symbol mBreed2;     // Secondary breed designation
+    double mDateTime;   // Timestamp of this animal's information (seconds)
+};
+
+
+
+
+/*
+ *  Method: Null constructor
+ *
+ *      Initializes this object to NA.
+ *      
+ */
+Animal::Animal ()
+       :
+        mAnimalId(NaSymbol),
+        mSource(NaSymbol),
+        mCity(NaSymbol),
+        mKind(NaSymbol),
+        mGender(NaSymbol),
+        mName(NaSymbol),
+        mColor1(NaSymbol),
+        mColor2(NaSymbol),
+        mBreed1(NaSymbol),
+        mBreed2(NaSymbol),
+        mDateTime(NA_REAL)
+{
+}
+
+
+
+
+/*
+ *  Method: Assign
+ *
+ *      Sets this animal's ID, and sets its information from the first
+ *      record in which the animal appears.
+ *      
+ */
+void Animal::Assign (Symbol animalId, const AnimalRecord& record)
+{
+    mAnimalId = animalId;
+    mKind = record.kind;
+    mGender = record.gender;
+    mName = record.name;
+    mColor1 = record.color1;
+    mColor2 = record.color2;
+    mBreed1 = record.breed1;
+    mBreed2 = record.breed2;
+    mDateTime = record.dateTime;
+}
+
+
+
+
+/*
+ *  Method: ToString
+ *
+ *      Returns the printable string representation of this object.
+ *      
+ */
+string Animal::ToString (const SymbolTable& symbols) const
+{
+    ostringstream buffer;
+
+    buffer << "Animal " << symbols.GetString(mAnimalId)
+           << " kind(" << symbols.GetString(mKind)
+           << ") gender(" << symbols.GetString(mGender)
+           << ") name(" << symbols.GetString(mName)
+           << ") color(" << symbols.GetString(mColor1) << "," << symbols.GetString(mColor2)
+           << ") breed(" << symbols.GetString(mBreed1) << "," << symbols.GetString(mBreed2)
+           << ")";
+
+    return buffer.str();
+}
+
+
+
+
+/*** AnimalUpdateStore *******************************************************/
+
+/*
+ *  Class: AnimalUpdateStore
+ *
+ *      Animal information read from records, stored as one column per field
+ *      until the animals are resolved in a batch before a merge. Grouped by
+ *      animal like the event stores, but keeping the order in which the
+ *      records were read.
+ *      
+ */
+class AnimalUpdateStore
+{
+public:
+    AnimalUpdateStore () : mFirstRows(1, 0), mNumGroupedRows(0) {}
+    ~AnimalUpdateStore () {}
+
+    // Add the information of a record of an animal.
+
+    void Add (int animal, const AnimalRecord& record);
+
+    // Group rows by animal, keeping the order of each animal's rows.
+
+    void GroupByAnimal (int numAnimals);
+
+    // Set an animal's information from its first row, as if it were the
+    // animal's first record, valid after grouping. Returns false when the
+    // animal has no rows.
+
+    bool Assign (int animalIndex, Animal& animal) const;
+
+    // Update an animal from its rows, or from all but the first, valid
+    // after grouping.
+
+    void Resolve (int animalIndex, Animal& animal, bool skipFirst) const;
+
+    // Remove all rows.
+
+    void Clear ();
+
+    // Number of bytes allocated by this store.
+
+    size_t GetNumBytes () const;
+
+    // Properties
+
+    int GetNumUpdates () const
+    { return mAnimalCol.size(); }
+
+private:
+    vector<int> mAnimalCol;             // Animal map index of the animal updated
+    vector<double> mDateTimeCol;        // Timestamp of the record (seconds)
+    vector<Symbol> mKindCol;            // Kind
+    vector<Symbol> mGenderCol;          // Gender
+    vector<Symbol> mNameCol;            // Name
+    vector<Symbol> mColor1Col;          // Primary color
+    vector<Symbol> mColor2Col;          // Secondary color
+    vector<Symbol> mBreed1Col;          // Primary breed designation
+    vector<Symbol> mBreed2Col;          // Secondary breed designation
+    vector<int> mFirstRows;             // First row of each animal, plus the end row
+    int mNumGroupedRows;                // Number of rows grouped by the last grouping
+};
+
+
+
+
+/*
+ *  Method: Add
+ *
+ *      Appends the information of a record of the specified animal.
+ *      
+ */
+void AnimalUpdateStore::Add (int animal, const AnimalRecord& record)
+{
+    mAnimalCol.push_back(animal);
+    mDateTimeCol.push_back(record.dateTime);
+    mKindCol.push_back(record.kind);
+    mGenderCol.push_back(record.gender);
+    mNameCol.push_back(record.name);
+    mColor1Col.push_back(record.color1);
+    mColor2Col.push_back(record.color2);
+    mBreed1Col.push_back(record.breed1);
+    mBreed2Col.push_back(record.breed2);
+}
+
+
+
+
+/*
+ *  Method: GroupByAnimal
+ *
+ *      Reorders all rows so that the rows of each animal are contiguous.
+ *      A counting sort keeps each animal's rows in the order they were
+ *      added, which decides which records are newer, and so places rows
+ *      added since the last grouping after the other rows of their animals.
+ *      
+ */
+void AnimalUpdateStore::GroupByAnimal (int numAnimals)
+{
+    int numRows = mAnimalCol.size();
+
+    // Nothing to reorder when no rows were added since the last grouping.
+
+    if (mNumGroupedRows == numRows)
+    {
+        mFirstRows.resize(numAnimals + 1, mNumGroupedRows);
+        return;
+    }
+
+    mFirstRows.assign(numAnimals + 1, 0);
+
+    for (int k = 0; k < numRows; ++k)
+        ++mFirstRows[mAnimalCol[k] + 1];
+
+    for (int a = 0; a < numAnimals; ++a)
+        mFirstRows[a + 1] += mFirstRows[a];
+
+    vector<int> nextRows(mFirstRows.begin(), mFirstRows.end() - 1);
+    vector<int> order(numRows);
+
+    for (int k = 0; k < numRows; ++k)
+        order[nextRows[mAnimalCol[k]]++] = k;
+
+    PermuteColumn(mAnimalCol, order);
+    PermuteColumn(mDateTimeCol, order);
+    PermuteColumn(mKindCol, order);
+    PermuteColumn(mGenderCol, order);
+    PermuteColumn(mNameCol, order);
+    PermuteColumn(mColor1Col, order);
+    PermuteColumn(mColor2Col, order);
+    PermuteColumn(mBreed1Col, order);
+    PermuteColumn(mBreed2Col, order);
+
+    mNumGroupedRows = numRows;
+}
+
+
+
+
+/*
+ *  Method: Assign
+ *
+ *      Sets an animal's information from its first row, keeping its ID,
+ *      as Animal::Assign does from the animal's first record.
+ *
+ *      Returns false, leaving the animal as it is, when it has no rows.
+ *      
+ */
+bool AnimalUpdateStore::Assign (int animalIndex, Animal& animal) const
+{
+    int first = mFirstRows[animalIndex];
+
+    if (first == mFirstRows[animalIndex + 1])
+        return false;
+
+    AnimalRecord record(mDateTimeCol[first]);
+
+    record.kind = mKindCol[first];
+    record.gender = mGenderCol[first];
+    record.name = mNameCol[first];
+    record.color1 = mColor1Col[first];
+    record.color2 = mColor2Col[first];
+    record.breed1 = mBreed1Col[first];
+    record.breed2 = mBreed2Col[first];
+
+    animal.Assign(animal.GetAnimalId(), record);
+
+    return true;
+}
+
+
+
+
+/*
+ *  Method: Resolve
+ *
+ *      Updates an animal's information from its rows in one pass, setting
+ *      each field of the animal once. A row updates the animal only when
+ *      its record is newer than every record applied before it, and never
+ *      deletes accumulated information (i.e., converts a field to empty
+ *      because the record's field is empty). The first row is skipped when
+ *      the animal was just assigned from it.
+ *      
+ */
+void AnimalUpdateStore::Resolve (int animalIndex, Animal& animal, bool skipFirst) const
+{
+    int first = mFirstRows[animalIndex] + (skipFirst ? 1 : 0);
+    int end = mFirstRows[animalIndex + 1];
+
+    if (first >= end)
+        return;
+
+    double dateTime = animal.GetDateTime();
+    Symbol gender = animal.GetGender();
+    Symbol name = animal.GetName();
+    Symbol color1 = animal.GetColor1();
+    Symbol color2 = animal.GetColor2();
+    Symbol breed1 = animal.GetBreed1();
+    Symbol breed2 = animal.GetBreed2();
+
+    for (int k = first; k < end; ++k)
+    {
+        // Skip records with older information. A missing timestamp
+        // compares as neither older nor newer, so never skips.
+
+        if (mDateTimeCol[k] <= dateTime)
+            continue;
+
+        // Keep the current field when the newer field has value NA, since it
+        // has possibly been deleted.
+
+        gender = (mGenderCol[k] != NaSymbol) ? mGenderCol[k] : gender;
+        name = (mNameCol[k] != NaSymbol) ? mNameCol[k] : name;
+        color1 = (mColor1Col[k] != NaSymbol) ? mColor1Col[k] : color1;
+        color2 = (mColor2Col[k] != NaSymbol) ? mColor2Col[k] : color2;
+        breed1 = (mBreed1Col[k] != NaSymbol) ? mBreed1Col[k] : breed1;
+        breed2 = (mBreed2Col[k] != NaSymbol) ? mBreed2Col[k] : breed2;
+
+        // Advance the timestamp to that of the record.
+
+        dateTime = mDateTimeCol[k];
+    }
+
+    animal.SetDateTime(dateTime);
+    animal.SetGender(gender);
+    animal.SetName(name);
+    animal.SetColor1(color1);
+    animal.SetColor2(color2);
+    animal.SetBreed1(breed1);
+    animal.SetBreed2(breed2);
+}
+
+
+
+
+/*
+ *  Method: Clear
+ *
+ *      Removes all rows from this store, keeping the allocated columns for
+ *      the next batch.
+ *      
+ */
+void AnimalUpdateStore::Clear ()
+{
+    mAnimalCol.clear();
+    mDateTimeCol.clear();
+    mKindCol.clear();
+    mGenderCol.clear();
+    mNameCol.clear();
+    mColor1Col.clear();
+    mColor2Col.clear();
+    mBreed1Col.clear();
+    mBreed2Col.clear();
+    mFirstRows.assign(1, 0);
+    mNumGroupedRows = 0;
+}
+
+
+
+
+/*
+ *  Method: GetNumBytes
+ *
+ *      Returns the number of bytes allocated for the columns of this store.
+ *      
+ */
+size_t AnimalUpdateStore::GetNumBytes () const
+{
+    return GetVectorBytes(mAnimalCol) + GetVectorBytes(mDateTimeCol) + GetVectorBytes(mKindCol) +
+           GetVectorBytes(mGenderCol) + GetVectorBytes(mNameCol) + GetVectorBytes(mColor1Col) +
+           GetVectorBytes(mColor2Col) + GetVectorBytes(mBreed1Col) + GetVectorBytes(mBreed2Col) +
+           GetVectorBytes(mFirstRows);
+}
+
+
+
+
+/*** AnimalMap ***************************************************************/
+
+/*
+ *  Class: AnimalMap
+ *
+ *      Dictionary of animal objects keyed on animal ID.
+ *
+ *      Implemented as an open-addressing hash table (linear probing) of
+ *      indexes into a contiguous arena of nodes. Each node holds an animal
+ *      ID, the hash of that ID, and the animal object itself. Iteration in sorted
+ *      animal ID order is available for building output tables whose row
+ *      order does not depend on hashing.
+ *      
+ */
+class AnimalMap
+{
+public:
+    AnimalMap ();
+    ~AnimalMap () {}
+
+    // Find an animal, or add an NA animal, returning its arena index.
+
+    int FindOrAdd (const char* animalId, size_t length, bool& added);
+
+    int FindOrAdd (const string& animalId, bool& added)
+    { return FindOrAdd(animalId.data(), animalId.size(), added); }
+
+    // Find an animal.
+
+    const Animal* Lookup (const string& animalId) const;
+
+    // Remove all animals.
+
+    void Clear ();
+
+    // Number of bytes allocated by this dictionary.
+
+    size_t GetNumBytes () const;
+
+    // Properties
+
+    int GetNumAnimals () const
+    { return mNodes.size(); }
+
+    Animal& GetAnimalAt (int index)
+    { return mNodes.at(index).animal; }
+
+    const Animal& GetAnimalAt (int index) const
+    { return mNodes.at(index).animal; }
+
+    // Arena indexes of the animals ordered by ascending animal ID.
+
+    const vector<int>& GetSortedOrder () const;
+
+private:
+    struct Node
+    {
+        string animalId;    // Key of this node
+        size_t hash;        // Hash of the key
+        Animal animal;      // Animal object
+    };
+
+    int FindSlot (const char* animalId, size_t length, size_t hash) const;
+    void Grow ();
+
+    void SortByAnimalId (vector<int>::iterator first, vector<int>::iterator last,
+                         size_t offset) const;
+    uint64_t GetIdChunk (int index, size_t offset) const;
+
+private:
+    static const int EmptySlot = -1;
+    static const int MinRadixSortLength = 256;  // Fewer animals are sorted by comparison
+
+    vector<Node> mNodes;                // Arena of nodes, in order of insertion
+    vector<int> mSlots;                 // Hash table of arena indexes
+    size_t mSlotMask;                   // Number of slots minus one (power of two)
+    mutable vector<int> mSortedOrder;   // Cached arena indexes sorted by animal ID
+    mutable bool mSortedOrderValid;     // Whether the cached sort order is current
+};
+
+// Out-of-class definition, since mSlots.assign binds a reference to it.
+
+const int AnimalMap::EmptySlot;
+
+
+
+
+/*
+ *  Method: Null constructor
+ *
+ *      Initializes this object to an empty dictionary.
+ *      
+ */
+AnimalMap::AnimalMap ()
+         :
+          mNodes(),
+          mSlots(16, EmptySlot),
+          mSlotMask(15),
+          mSortedOrder(),
+          mSortedOrderValid(true)
+{
+}
+
+
+
+
+/*
+ *  Method: FindSlot
+ *
+ *      Probes the hash table for an animal ID.
+ *
+ *      Returns the index of the slot that holds the animal, or the index of
+ *      the empty slot at which the animal would be inserted.
+ *      
+ */
+int AnimalMap::FindSlot (const char* animalId, size_t length, size_t hash) const
+{
+    size_t slot = hash & mSlotMask;
+
+    while (mSlots[slot] != EmptySlot)
+    {
+        const Node& node = mNodes[mSlots[slot]];
+
+        if (node.hash == hash && node.animalId.size() == length &&
+            memcmp(node.animalId.data(), animalId, length) == 0)
+            break;
+
+        slot = (slot + 1) & mSlotMask;
+    }
+
+    return slot;
+}
+
+
+
+
+/*
+ *  Method: Grow
+ *
+ *      Doubles the number of hash table slots and re-inserts the nodes.
+ *      The nodes themselves do not move.
+ *      
+ */
+void AnimalMap::Grow ()
+{
+    size_t numSlots = 2 * mSlots.size();
+
+    mSlots.assign(numSlots, EmptySlot);
+    mSlotMask = numSlots - 1;
+
+    for (size_t i = 0; i < mNodes.size(); ++i)
+    {
+        size_t slot = mNodes[i].hash & mSlotMask;
+
+        while (mSlots[slot] != EmptySlot)
+            slot = (slot + 1) & mSlotMask;
+
+        mSlots[slot] = i;
+    }
+}
+
+
+
+
+/*
+ *  Method: FindOrAdd
+ *
+ *      Looks up an animal by its animal ID, adding an entry for the animal
+ *      when it is not found.
+ *
+ *      Returns the arena index of the animal stored in the dictionary, which
+ *      does not change as animals are added. A newly added animal is NA,
+ *      which is flagged through the added argument.
+ *      
+ */
+int AnimalMap::FindOrAdd (const char* animalId, size_t length, bool& added)
+{
+    size_t hash = HashString(animalId, length);
+    int slot = FindSlot(animalId, length, hash);
+
+    added = (mSlots[slot] == EmptySlot);
+
+    if (added)
+    {
+        // Keep the load factor at or under one half, so that probe
+        // sequences stay short.
+
+        if (2 * (mNodes.size() + 1) > mSlots.size())
+        {
+            Grow();
+            slot = FindSlot(animalId, length, hash);
+        }
+
+        Node node;
+        node.animalId.assign(animalId, length);
+        node.hash = hash;
+
+        mSlots[slot] = mNodes.size();
+        mNodes.push_back(node);
+        mSortedOrderValid = false;
+    }
+
+    return mSlots[slot];
+}
+
+
+
+
+/*
+ *  Method: Lookup
+ *
+ *      Look up an animal object by its animal ID.
+ *      
+ *      Returns a pointer to the animal object, or nullptr when the
+ *      animal is not found. The pointer remains valid only until the next
+ *      animal is added.
+ *      
+ */
+const Animal* AnimalMap::Lookup (const string& animalId) const
+{
+    int slot = FindSlot(animalId.data(), animalId.size(), HashString(animalId.data(), animalId.size()));
+
+    if (mSlots[slot] == EmptySlot)
+        return nullptr;
+
+    return &mNodes[mSlots[slot]].animal;
+}
+
+
+
+
+/*
+ *  Method: Clear
+ *
+ *      Remove all animals from this dictionary.
+ *      
+ */
+void AnimalMap::Clear ()
+{
+    mNodes.clear();
+    mSlots.assign(16, EmptySlot);
+    mSlotMask = 15;
+    mSortedOrder.clear();
+    mSortedOrderValid = true;
+}
+
+
+
+
+/*
+ *  Method: GetNumBytes
+ *
+ *      Returns the number of bytes allocated by this dictionary.
+ *      
+ */
+size_t AnimalMap::GetNumBytes () const
+{
+    return GetVectorBytes(mNodes) + GetVectorBytes(mSlots) + GetVectorBytes(mSortedOrder);
+}
+
+
+
+
+/*
+ *  Method: GetSortedOrder
+ *
+ *      Returns the arena indexes of all animals, ordered by ascending
+ *      animal ID. This is the iteration order of the former tree-based
+ *      dictionary, so output tables keep the same row order.
+ *
+ *      The animals ordered by the last call keep their order, and only the
+ *      animals added since are sorted, then merged in.
+ *      
+ */
+const vector<int>& AnimalMap::GetSortedOrder () const
+{
+    if (!mSortedOrderValid)
+    {
+        int numSorted = mSortedOrder.size();
+        int numAnimals = mNodes.size();
+
+        for (int i = numSorted; i < numAnimals; ++i)
+            mSortedOrder.push_back(i);
+
+        const vector<Node>& nodes = mNodes;
+        auto lessThan = [&nodes] (int a, int b) { return nodes[a].animalId < nodes[b].animalId; };
+
+        // Animals are often added in animal ID order, and then need no sort.
+
+        vector<int>::iterator added = mSortedOrder.begin() + numSorted;
+
+        if (!std::is_sorted(added, mSortedOrder.end(), lessThan))
+            SortByAnimalId(added, mSortedOrder.end(), 0);
+
+        std::inplace_merge(mSortedOrder.begin(), added, mSortedOrder.end(), lessThan);
+
+        mSortedOrderValid = true;
+    }
+
+    return mSortedOrder;
+}
+
+
+
+
+/*
+ *  Method: SortByAnimalId
+ *
+ *      Sorts a range of arena indexes by ascending animal ID, where the IDs
+ *      of the range all start with the same offset bytes.
+ *
+ *      Long ranges are radix sorted on the next eight bytes of the IDs,
+ *      with one least-significant-digit pass per byte that varies, and the
+ *      runs of IDs that tie on those bytes are sorted on the bytes after
+ *      them. This replaces string comparisons, each of which reaches into
+ *      two nodes of the arena, with sequential passes over packed keys.
+ *      
+ */
+void AnimalMap::SortByAnimalId (vector<int>::iterator first, vector<int>::iterator last,
+                                size_t offset) const
+{
+    const vector<Node>& nodes = mNodes;
+    auto lessThan = [&nodes] (int a, int b) { return nodes[a].animalId < nodes[b].animalId; };
+    size_t numAnimals = last - first;
+
+    if (numAnimals < (size_t) MinRadixSortLength)
+    {
+        sort(first, last, lessThan);
+        return;
+    }
+
+    // Pack the eight bytes of each ID, and count the values of each byte.
+
+    struct Key
+    {
+        uint64_t chunk;     // Bytes [offset, offset + 8) of the ID, most significant first
+        int index;          // Arena index of the animal
+    };
+
+    vector<Key> keys(numAnimals);
+    vector<size_t> counts(8 * 256, 0);
+    bool anyLonger = false;
+
+    for (size_t i = 0; i < numAnimals; ++i)
+    {
+        keys[i].chunk = GetIdChunk(first[i], offset);
+        keys[i].index = first[i];
+        anyLonger = anyLonger || nodes[first[i]].animalId.size() > offset + 8;
+
+        for (int b = 0; b < 8; ++b)
+            ++counts[256 * b + ((keys[i].chunk >> (8 * b)) & 0xFF)];
+    }
+
+    // Sort on each byte, least significant first. A byte that all IDs share
+    // does not reorder them, and its pass is skipped.
+
+    vector<Key> sorted(numAnimals);
+
+    for (int b = 0; b < 8; ++b)
+    {
+        size_t* byteCounts = &counts[256 * b];
+
+        if (byteCounts[(keys[0].chunk >> (8 * b)) & 0xFF] == numAnimals)
+            continue;
+
+        size_t position = 0;
+
+        for (int value = 0; value < 256; ++value)
+        {
+            size_t count = byteCounts[value];
+            byteCounts[value] = position;
+            position += count;
+        }
+
+        for (size_t i = 0; i < numAnimals; ++i)
+            sorted[byteCounts[(keys[i].chunk >> (8 * b)) & 0xFF]++] = keys[i];
+
+        keys.swap(sorted);
+    }
+
+    for (size_t i = 0; i < numAnimals; ++i)
+        first[i] = keys[i].index;
+
+    // Order the IDs that tie on these bytes by the bytes after them. Where
+    // no ID has bytes after them, ties differ only in trailing NULs.
+
+    for (size_t i = 0; i < numAnimals; )
+    {
+        size_t end = i + 1;
+
+        while (end < numAnimals && keys[end].chunk == keys[i].chunk)
+            ++end;
+
+        if (end - i > 1)
+        {
+            if (anyLonger)
+                SortByAnimalId(first + i, first + end, offset + 8);
+            else
+                sort(first + i, first + end, lessThan);
+        }
+
+        i = end;
+    }
+}
+
+
+
+
+/*
+ *  Method: GetIdChunk
+ *
+ *      Returns bytes [offset, offset + 8) of the ID of an animal, packed
+ *      most significant first and padded with zeros past its end, so that
+ *      chunks order as the IDs do.
+ *      
+ */
+uint64_t AnimalMap::GetIdChunk (int index, size_t offset) const
+{
+    const string& animalId = mNodes[index].animalId;
+    uint64_t chunk = 0;
+
+    for (size_t i = offset; i < offset + 8; ++i)
+        chunk = (chunk << 8) | (i < animalId.size() ? (unsigned char) animalId[i] : 0);
+
+    return chunk;
+}
+
+
+
+
+/*** Ingest schemas **********************************************************/
+
+// An ingest schema describes one layout of input data frame: which columns
+// set which fields of the animal record and of the intake and outcome
+// events. Each field is a type naming its column and the field it sets, so
+// the ingest loop of a schema expands at compile time into straight-line
+// reads of its columns, with no lookups by name or branches per field.
+
+/*
+ *  Struct: AnimalSymbolField
+ *
+ *      Schema field setting a symbol of the animal record from a character
+ *      or factor column.
+ *      
+ */
+template <const string* Name, Symbol AnimalRecord::* Member>
+struct AnimalSymbolField
+{
+    class Reader
+    {
+    public:
+        Reader (const DataFrame& table, SymbolTable& symbols) : mColumn(table, *Name, symbols) {}
+
+        void Read (int row, AnimalRecord& record) const
+        { record.*Member = mColumn.GetSymbolAt(row); }
+
+    private:
+        StringColumn mColumn;
+    };
+};
+
+
+
+
+/*
+ *  Struct: EventSymbolField
+ *
+ *      Schema field setting a symbol of an event, in an intake or outcome
+ *      store, from a character or factor column.
+ *      
+ */
+template <const string* Name, class Store, void (Store::* Set)(int, Symbol)>
+struct EventSymbolField
+{
+    class Reader
+    {
+    public:
+        Reader (const DataFrame& table, SymbolTable& symbols) : mColumn(table, *Name, symbols) {}
+
+        void Read (int row, Store& store, int event) const
+        { (store.*Set)(event, mColumn.GetSymbolAt(row)); }
+
+    private:
+        StringColumn mColumn;
+    };
+};
+
+
+
+
+/*
+ *  Struct: EventIntegerField
+ *
+ *      Schema field setting an integer of an event, in an intake or outcome
+ *      store, from an integer column.
+ *      
+ */
+template <const string* Name, class Store, void (Store::* Set)(int, int)>
+struct EventIntegerField
+{
+    class Reader
+    {
+    public:
+        Reader (const DataFrame& table, SymbolTable&) : mColumn(table[*Name]) {}
+
+        void Read (int row, Store& store, int event) const
+        { (store.*Set)(event, mColumn[row]); }
+
+    private:
+        IntegerVector mColumn;
+    };
+};
+
+template <const string* Name, void (IntakeStore::* Set)(int, Symbol)>
+using IntakeSymbolField = EventSymbolField<Name, IntakeStore, Set>;
+
+template <const string* Name, void (IntakeStore::* Set)(int, int)>
+using IntakeIntegerField = EventIntegerField<Name, IntakeStore, Set>;
+
+template <const string* Name, void (OutcomeStore::* Set)(int, Symbol)>
+using OutcomeSymbolField = EventSymbolField<Name, OutcomeStore, Set>;
+
+
+
+
+/*
+ *  Struct: FieldList
+ *
+ *      List of schema fields. Its reader views the columns of all the fields
+ *      of an input data frame, and reads a row into all of them at once.
+ *      
+ */
+template <class... Fields>
+struct FieldList;
+
+template <>
+struct FieldList<>
+{
+    class Reader
+    {
+    public:
+        Reader (const DataFrame&, SymbolTable&) {}
+
+        template <class... Targets>
+        void Read (int, Targets&...) const {}
+    };
+};
+
+template <class Field, class... Fields>
+struct FieldList<Field, Fields...>
+{
+    class Reader
+    {
+    public:
+        Reader (const DataFrame& table, SymbolTable& symbols) : mField(table, symbols), mFields(table, symbols) {}
+
+        template <class... Targets>
+        void Read (int row, Targets&... targets) const
+        { mField.Read(row, targets...); mFields.Read(row, targets...); }
+
+    private:
+        typename Field::Reader mField;
+        typename FieldList<Fields...>::Reader mFields;
+    };
+};
+
+
+
+
+/*
+ *  Struct: AtxIntakeSchema
+ *
+ *      Austin open-data intake records.
+ *      
+ */
+struct AtxIntakeSchema
+{
+    static const bool HasIntakes = true;
+    static const bool HasOutcomes = false;
+
+    typedef FieldList<AnimalSymbolField<&Col::Kind, &AnimalRecord::kind>,
+                      AnimalSymbolField<&Col::Gender, &AnimalRecord::gender>,
+                      AnimalSymbolField<&Col::Name, &AnimalRecord::name>,
+                      AnimalSymbolField<&Col::Color1, &AnimalRecord::color1>,
+                      AnimalSymbolField<&Col::Color2, &AnimalRecord::color2>,
+                      AnimalSymbolField<&Col::Breed1, &AnimalRecord::breed1>,
+                      AnimalSymbolField<&Col::Breed2, &AnimalRecord::breed2>> AnimalFields;
+
+    typedef FieldList<IntakeSymbolField<&Col::IntakeType, &IntakeStore::SetIntakeType>,
+                      IntakeSymbolField<&Col::IntakeCondition, &IntakeStore::SetIntakeCondition>,
+                      IntakeSymbolField<&Col::IntakeLocation, &IntakeStore::SetIntakeLocation>,
+                      IntakeIntegerField<&Col::IntakeAgeCount, &IntakeStore::SetIntakeAgeCount>,
+                      IntakeSymbolField<&Col::IntakeAgeUnits, &IntakeStore::SetIntakeAgeUnits>,
+                      IntakeIntegerField<&Col::IntakeAge, &IntakeStore::SetIntakeAge>,
+                      IntakeSymbolField<&Col::IntakeSpayNeuter, &IntakeStore::SetIntakeSpayNeuter>> IntakeFields;
+
+    typedef FieldList<> OutcomeFields;
+};
+
+
+
+
+/*
+ *  Struct: AtxOutcomeSchema
+ *
+ *      Austin open-data outcome records.
+ *      
+ */
+struct AtxOutcomeSchema
+{
+    static const bool HasIntakes = false;
+    static const bool HasOutcomes = true;
+
+    typedef FieldList<AnimalSymbolField<&Col::Kind, &AnimalRecord::kind>,
+                      AnimalSymbolField<&Col::Gender, &AnimalRecord::gender>,
+                      AnimalSymbolField<&Col::Name, &AnimalRecord::name>,
+                      AnimalSymbolField<&Col::Color1, &AnimalRecord::color1>,
+                      AnimalSymbolField<&Col::Color2, &AnimalRecord::color2>,
+                      AnimalSymbolField<&Col::Breed1, &AnimalRecord::breed1>,
+                      AnimalSymbolField<&Col::Breed2, &AnimalRecord::breed2>> AnimalFields;
+
+    typedef FieldList<> IntakeFields;
+
+    typedef FieldList<OutcomeSymbolField<&Col::OutcomeType, &OutcomeStore::SetOutcomeType>,
+                      OutcomeSymbolField<&Col::OutcomeSubType, &OutcomeStore::SetOutcomeSubType>,
+                      OutcomeSymbolField<&Col::OutcomeSpayNeuter, &OutcomeStore::SetOutcomeSpayNeuter>> OutcomeFields;
+};
+
+
+
+
+/*
+ *  Struct: SacOpenSchema
+ *
+ *      Sacramento open-data impound records, each combining an intake and an
+ *      outcome.
+ *      
+ */
+struct SacOpenSchema
+{
+    static const bool HasIntakes = true;
+    static const bool HasOutcomes = true;
+
+    typedef FieldList<AnimalSymbolField<&Col::Kind, &AnimalRecord::kind>,
+                      AnimalSymbolField<&Col::Name, &AnimalRecord::name>> AnimalFields;
+
+    typedef FieldList<IntakeSymbolField<&Col::IntakeType, &IntakeStore::SetIntakeType>,
+                      IntakeSymbolField<&Col::IntakeLocation, &IntakeStore::SetIntakeLocation>> IntakeFields;
+
+    typedef FieldList<OutcomeSymbolField<&Col::OutcomeType, &OutcomeStore::SetOutcomeType>> OutcomeFields;
+};
+
+
+
+
+/*
+ *  Struct: SacCpraSchema
+ *
+ *      Sacramento CPRA (California Public Records Act) impound records, each
+ *      combining an intake and an outcome. The spay/neuter status is that at
+ *      intake.
+ *      
+ */
+struct SacCpraSchema
+{
+    static const bool HasIntakes = true;
+    static const bool HasOutcomes = true;
+
+    typedef FieldList<AnimalSymbolField<&Col::Kind, &AnimalRecord::kind>,
+                      AnimalSymbolField<&Col::Name, &AnimalRecord::name>,
+                      AnimalSymbolField<&Col::Gender, &AnimalRecord::gender>,
+                      AnimalSymbolField<&Col::Color1, &AnimalRecord::color1>,
+                      AnimalSymbolField<&Col::Color2, &AnimalRecord::color2>,
+                      AnimalSymbolField<&Col::Breed1, &AnimalRecord::breed1>,
+                      AnimalSymbolField<&Col::Breed2, &AnimalRecord::breed2>> AnimalFields;
+
+    typedef FieldList<IntakeSymbolField<&Col::Kennel, &IntakeStore::SetKennel>,
+                      IntakeSymbolField<&Col::SpayNeuter, &IntakeStore::SetIntakeSpayNeuter>,
+                      IntakeSymbolField<&Col::IntakeType, &IntakeStore::SetIntakeType>,
+                      IntakeSymbolField<&Col::IntakeSubType, &IntakeStore::SetIntakeSubType>,
+                      IntakeSymbolField<&Col::IntakeCondition, &IntakeStore::SetIntakeCondition>,
+                      IntakeSymbolField<&Col::IntakeLocation, &IntakeStore::SetIntakeLocation>> IntakeFields;
+
+    typedef FieldList<OutcomeSymbolField<&Col::OutcomeType, &OutcomeStore::SetOutcomeType>,
+                      OutcomeSymbolField<&Col::OutcomeSubType, &OutcomeStore::SetOutcomeSubType>,
+                      OutcomeSymbolField<&Col::OutcomeCondition, &OutcomeStore::SetOutcomeCondition>> OutcomeFields;
+};
+
+
+
+
+/*** Output tables ***********************************************************/
+
+/*
+ *  Function: MakeDataFrame
+ *
+ *      Makes an R data frame of the specified named columns, each of which
+ *      has the specified number of rows.
+ *      
+ */
+static DataFrame MakeDataFrame (const vector<string>& names, const vector<SEXP>& columns, int numRows)
+{
+    int numColumns = columns.size();
+    List dataFrame(numColumns);
+    CharacterVector columnNames(numColumns);
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        SET_VECTOR_ELT(dataFrame, c, columns[c]);
+        columnNames[c] = names[c];
+    }
+
+    dataFrame.attr("names") = columnNames;
+    dataFrame.attr("row.names") = IntegerVector::create(NA_INTEGER, -numRows);
+    dataFrame.attr("class") = "data.frame";
+
+    return DataFrame(dataFrame);
+}
+
+
+
+
+/*
+ *  Function: GetColumnBytes
+ *
+ *      Returns the number of bytes allocated for the elements of the
+ *      specified columns of an output table.
+ *      
+ */
+static size_t GetColumnBytes (const vector<SEXP>& columns)
+{
+    size_t numBytes = 0;
+
+    for (size_t c = 0; c < columns.size(); ++c)
+        numBytes += XLENGTH(columns[c]) * ((TYPEOF(columns[c]) == REALSXP) ? sizeof(double) : sizeof(int));
+
+    return numBytes;
+}
+
+
+
+
+/*
+ *  Function: SetElement
+ *
+ *      Sets an element of a column of an output table, unless the column
+ *      is skipped (i.e., allocated empty).
+ *      
+ */
+template <typename Vector, typename Value>
+static inline void SetElement (Vector& column, int row, Value value)
+{
+    if (column.size() != 0)
+        column.begin()[row] = value;
+}
+
+
+
+
+/*** AnimalTable *************************************************************/
+
+/*
+ *  Class: AnimalTable
+ *
+ *      Accumulator to build animal data frame.
+ *
+ *      The columns are R vectors allocated once at the final number of
+ *      rows. Categorical columns hold symbols until they are encoded as
+ *      factors.
+ *
+ *      Tables built from several data sets have source and city columns,
+ *      which are otherwise allocated empty and left out.
+ *      
+ */
+class AnimalTable
+{
+public:
+    AnimalTable () : mSourceColumns(false) {}
+    ~AnimalTable () {}
+
+    // Whether tables allocated from now on have source and city columns.
+
+    void SetSourceColumns (bool sourceColumns)
+    { mSourceColumns = sourceColumns; }
+
+    void Allocate (int numRows);
+    void SetRow (int row, const Animal& animal);
+    void EncodeFactors (SymbolTable& symbols, FactorDictionaries& dictionaries);
+    void Clear ();
+
+    int GetNumRows () const
+    { return mAnimalIdCol.size(); }
+
+    // Named columns of this table, in data frame order.
+
+    void GetColumns (vector<string>& names, vector<SEXP>& columns) const;
+
+    // Number of bytes allocated for the columns of this table.
+
+    size_t GetNumBytes () const;
+
+    DataFrame GetDataFrame () const;
+        
+private:
+    // Vectors hold the columns of this animal table.
+
+    bool mSourceColumns;
+    IntegerVector mAnimalIdCol;
+    IntegerVector mSourceCol;
+    IntegerVector mCityCol;
+    IntegerVector mNameCol;
+    IntegerVector mKindCol;
+    IntegerVector mGenderCol;
+    IntegerVector mColor1Col;
+    IntegerVector mColor2Col;
+    IntegerVector mBreed1Col;
+    IntegerVector mBreed2Col;
+};
+
+
+
+
+/*
+ *  Method: Allocate
+ *
+ *      Allocates every column of this table at the specified number of rows.
+ *      
+ */
+void AnimalTable::Allocate (int numRows)
+{
+    int numSourceRows = mSourceColumns ? numRows : 0;
+
+    mAnimalIdCol = IntegerVector(numRows);
+    mSourceCol = IntegerVector(numSourceRows);
+    mCityCol = IntegerVector(numSourceRows);
+    mNameCol = IntegerVector(numRows);
+    mKindCol = IntegerVector(numRows);
+    mGenderCol = IntegerVector(numRows);
+    mColor1Col = IntegerVector(numRows);
+    mColor2Col = IntegerVector(numRows);
+    mBreed1Col = IntegerVector(numRows);
+    mBreed2Col = IntegerVector(numRows);
+}
+
+
+
+
+/*
+ *  Method: SetRow
+ *
+ *      Sets a row of this table to the specified animal.
+ *      
+ */
+void AnimalTable::SetRow (int row, const Animal& animal)
+{
+    // Table is stored as columns; so setting a row sets an element of
+    // each column.
+
+    mAnimalIdCol.begin()[row] = animal.GetAnimalId();
+    SetElement(mSourceCol, row, animal.GetSource());
+    SetElement(mCityCol, row, animal.GetCity());
+    mNameCol.begin()[row] = animal.GetName();
+    mKindCol.begin()[row] = animal.GetKind();
+    mGenderCol.begin()[row] = animal.GetGender();
+    mColor1Col.begin()[row] = animal.GetColor1();
+    mColor2Col.begin()[row] = animal.GetColor2();
+    mBreed1Col.begin()[row] = animal.GetBreed1();
+    mBreed2Col.begin()[row] = animal.GetBreed2();
+}
+
+
+
+
+/*
+ *  Method: EncodeFactors
+ *
+ *      Converts the columns of symbols to factors, once all rows are set,
+ *      against the dictionaries of the columns when they are enabled.
+ *      
+ */
+void AnimalTable::EncodeFactors (SymbolTable& symbols, FactorDictionaries& dictionaries)
+{
+    using namespace Col;
+
+    const string columnNames[] = { AnimalId, Source, City, Name, Kind, Gender,
+                                   Color1, Color2, Breed1, Breed2 };
+    IntegerVector* const columnVectors[] = { &mAnimalIdCol, &mSourceCol, &mCityCol, &mNameCol, &mKindCol,
+                                             &mGenderCol, &mColor1Col, &mColor2Col, &mBreed1Col, &mBreed2Col };
+
+    vector<string> names(columnNames, columnNames + 10);
+    vector<IntegerVector*> columns(columnVectors, columnVectors + 10);
+
+    EncodeFactorColumns(columns, names, symbols, dictionaries);
+}
+
+
+
+
+/*
+ *  Method: Clear
+ *
+ *      Remove all rows from this animal table.
+ *      
+ */
+void AnimalTable::Clear ()
+{
+    Allocate(0);
+}
+
+
+
+
+/*
+ *  Method: GetColumns
+ *
+ *      Appends the names and R vectors of the columns of this table, in
+ *      data frame order, to the specified vectors.
+ *      
+ */
+void AnimalTable::GetColumns (vector<string>& names, vector<SEXP>& columns) const
+{
+    using namespace Col;
+
+    // Each column is already an R vector object, in this case a factor
+    // (integer) vector whose levels come from the symbol table.
+
+    const string columnNames[] = { AnimalId, Source, City, Kind, Name, Gender,
+                                   Color1, Color2, Breed1, Breed2 };
+    const IntegerVector* columnVectors[] = { &mAnimalIdCol, &mSourceCol, &mCityCol, &mKindCol, &mNameCol,
+                                             &mGenderCol, &mColor1Col, &mColor2Col, &mBreed1Col, &mBreed2Col };
+
+    for (int c = 0; c < 10; ++c)
+    {
+        if (!mSourceColumns && (columnNames[c] == Source || columnNames[c] == City))
+            continue;
+
+        names.push_back(columnNames[c]);
+        columns.push_back(*columnVectors[c]);
+    }
+}
+
+
+
+
+/*
+ *  Method: GetNumBytes
+ *
+ *      Returns the number of bytes allocated for the columns of this table.
+ *      
+ */
+size_t AnimalTable::GetNumBytes () const
+{
+    vector<string> names;
+    vector<SEXP> columns;
+
+    GetColumns(names, columns);
+
+    return GetColumnBytes(columns);
+}
+
+
+
+
+/*
+ *  Method: GetDataFrame
+ *
+ *      Creates an R data frame object corresponding to the rows of
+ *      animals in this table.
+ *      
+ */
+DataFrame AnimalTable::GetDataFrame () const
+{
+    vector<string> names;
+    vector<SEXP> columns;
+
+    GetColumns(names, columns);
+
+    return MakeDataFrame(names, columns, GetNumRows());
+}
+
+
+
+
+/*** ImpoundTable ************************************************************/
+
+/*
+ *  Class: ImpoundTable
+ *
+ *      Accumulator to build impound data frame.
+ *
+ *      The columns are R vectors allocated once at the final number of
+ *      rows, which is known after the merge. Rows are then set in place;
+ *      categorical columns hold symbols until they are encoded as factors.
+ *
+ *      Columns may be skipped, in which case they are allocated empty and
+ *      never set, and are left out of the data frame. The animal ID column
+ *      is always kept. The source and city columns of tables built from
+ *      several data sets are skipped in other tables.
+ *      
+ */
+class ImpoundTable
+{
+public:
+    ImpoundTable () : mSourceColumns(false) {}
+    ~ImpoundTable () {}
+
+    // Columns to leave out of the tables allocated from now on.
+
+    void SetSkippedColumns (const vector<string>& skipColumns)
+    { mSkippedColumns = skipColumns; }
+
+    // Whether tables allocated from now on have source and city columns.
+
+    void SetSourceColumns (bool sourceColumns)
+    { mSourceColumns = sourceColumns; }
+    
+    void Allocate (int numRows);
+    void SetRow (int row, const Animal& animal, const IntakeStore& intakes, int intakeRow,
+                 const OutcomeStore& outcomes, int outcomeRow);
+    void EncodeFactors (SymbolTable& symbols, FactorDictionaries& dictionaries);
+    void Clear ();
+
+    int GetNumRows () const
+    { return mAnimalIdCol.size(); }
+
+    // Named columns of this table that are not skipped, in data frame order.
+
+    void GetColumns (vector<string>& names, vector<SEXP>& columns) const;
+
+    // Number of bytes allocated for the columns of this table.
+
+    size_t GetNumBytes () const;
+        
+    DataFrame GetDataFrame () const;
+    
+private:
+    bool IsSkipped (const string& name) const
+    {
+        return (!mSourceColumns && (name == Col::Source || name == Col::City)) ||
+               std::find(mSkippedColumns.begin(), mSkippedColumns.end(), name) != mSkippedColumns.end();
+    }
+
+    int GetColumnSize (const string& name, int numRows) const
+    { return IsSkipped(name) ? 0 : numRows; }
+
+private:
+    vector<string> mSkippedColumns;
+    bool mSourceColumns;
+    IntegerVector mAnimalIdCol;
+    IntegerVector mSourceCol;
+    IntegerVector mCityCol;
+    NumericVector mIntakeDateCol;
+    IntegerVector mIntakeTypeCol;
+    IntegerVector mIntakeSubTypeCol;
+    IntegerVector mIntakeConditionCol;
+    IntegerVector mIntakeLocationCol;
+    IntegerVector mIntakeAgeCountCol;
+    IntegerVector mIntakeAgeUnitsCol;
+    IntegerVector mIntakeAgeCol;
+    IntegerVector mIntakeSpayNeuterCol;
+    NumericVector mOutcomeDateCol;
+    IntegerVector mOutcomeTypeCol;
+    IntegerVector mOutcomeSubTypeCol;
+    IntegerVector mOutcomeConditionCol;
+    IntegerVector mOutcomeSpayNeuterCol;
+    IntegerVector mKennelCol;
+};
+
+
+
+
+/*
+ *  Method: Allocate
+ *
+ *      Allocates every column of this table at the specified number of rows.
+ *      
+ */
+void ImpoundTable::Allocate (int numRows)
+{
+    using namespace Col;
+
+    mAnimalIdCol = IntegerVector(numRows);
+    mSourceCol = IntegerVector(GetColumnSize(Source, numRows));
+    mCityCol = IntegerVector(GetColumnSize(City, numRows));
+    mIntakeDateCol = NumericVector(GetColumnSize(IntakeDate, numRows));
+    mIntakeTypeCol = IntegerVector(GetColumnSize(IntakeType, numRows));
+    mIntakeSubTypeCol = IntegerVector(GetColumnSize(IntakeSubType, numRows));
+    mIntakeConditionCol = IntegerVector(GetColumnSize(IntakeCondition, numRows));
+    mIntakeLocationCol = IntegerVector(GetColumnSize(IntakeLocation, numRows));
+    mIntakeAgeCountCol = IntegerVector(GetColumnSize(IntakeAgeCount, numRows));
+    mIntakeAgeUnitsCol = IntegerVector(GetColumnSize(IntakeAgeUnits, numRows));
+    mIntakeAgeCol = IntegerVector(GetColumnSize(IntakeAge, numRows));
+    mIntakeSpayNeuterCol = IntegerVector(GetColumnSize(IntakeSpayNeuter, numRows));
+    mOutcomeDateCol = NumericVector(GetColumnSize(OutcomeDate, numRows));
+    mOutcomeTypeCol = IntegerVector(GetColumnSize(OutcomeType, numRows));
+    mOutcomeSubTypeCol = IntegerVector(GetColumnSize(OutcomeSubType, numRows));
+    mOutcomeConditionCol = IntegerVector(GetColumnSize(OutcomeCondition, numRows));
+    mOutcomeSpayNeuterCol = IntegerVector(GetColumnSize(OutcomeSpayNeuter, numRows));
+    mKennelCol = IntegerVector(GetColumnSize(Kennel, numRows));
+
+    // Timestamp columns are date-time (POSIXct) vectors.
+
+    mIntakeDateCol.attr("class") = CharacterVector::create("POSIXct", "POSIXt");
+    mOutcomeDateCol.attr("class") = CharacterVector::create("POSIXct", "POSIXt");
+}
+
+
+
+
+/*
+ *  Method: SetRow
+ *
+ *      Sets a row of this table to an impound.
+ *
+ *      The intake and outcome are rows of the event stores; either may be
+ *      NaRow, in which case its fields are set to NA. Skipped columns are
+ *      not set.
+ *
+ *      Elements are written through the column data pointers, without
+ *      calling the R API, so different rows may be set on different threads
+ *      at once.
+ *      
+ */
+void ImpoundTable::SetRow (int row, const Animal& animal, const IntakeStore& intakes, int intakeRow,
+                           const OutcomeStore& outcomes, int outcomeRow)
+{
+    mAnimalIdCol.begin()[row] = animal.GetAnimalId();
+    SetElement(mSourceCol, row, animal.GetSource());
+    SetElement(mCityCol, row, animal.GetCity());
+
+    if (intakeRow != NaRow)
+    {
+        SetElement(mIntakeDateCol, row, intakes.GetIntakeDate(intakeRow));
+        SetElement(mIntakeTypeCol, row, intakes.GetIntakeType(intakeRow));
+        SetElement(mIntakeSubTypeCol, row, intakes.GetIntakeSubType(intakeRow));
+        SetElement(mIntakeConditionCol, row, intakes.GetIntakeCondition(intakeRow));
+        SetElement(mIntakeLocationCol, row, intakes.GetIntakeLocation(intakeRow));
+        SetElement(mIntakeAgeCountCol, row, intakes.GetIntakeAgeCount(intakeRow));
+        SetElement(mIntakeAgeUnitsCol, row, intakes.GetIntakeAgeUnits(intakeRow));
+        SetElement(mIntakeAgeCol, row, intakes.GetIntakeAge(intakeRow));
+        SetElement(mIntakeSpayNeuterCol, row, intakes.GetIntakeSpayNeuter(intakeRow));
+        SetElement(mKennelCol, row, intakes.GetKennel(intakeRow));
+    }
+    else
+    {
+        SetElement(mIntakeDateCol, row, NA_REAL);
+        SetElement(mIntakeTypeCol, row, NaSymbol);
+        SetElement(mIntakeSubTypeCol, row, NaSymbol);
+        SetElement(mIntakeConditionCol, row, NaSymbol);
+        SetElement(mIntakeLocationCol, row, NaSymbol);
+        SetElement(mIntakeAgeCountCol, row, NA_INTEGER);
+        SetElement(mIntakeAgeUnitsCol, row, NaSymbol);
+        SetElement(mIntakeAgeCol, row, NA_INTEGER);
+        SetElement(mIntakeSpayNeuterCol, row, NaSymbol);
+        SetElement(mKennelCol, row, NaSymbol);
+    }
+
+    if (outcomeRow != NaRow)
+    {
+        SetElement(mOutcomeDateCol, row, outcomes.GetOutcomeDate(outcomeRow));
+        SetElement(mOutcomeTypeCol, row, outcomes.GetOutcomeType(outcomeRow));
+        SetElement(mOutcomeSubTypeCol, row, outcomes.GetOutcomeSubType(outcomeRow));
+        SetElement(mOutcomeConditionCol, row, outcomes.GetOutcomeCondition(outcomeRow));
+        SetElement(mOutcomeSpayNeuterCol, row, outcomes.GetOutcomeSpayNeuter(outcomeRow));
+    }
+    else
+    {
+        SetElement(mOutcomeDateCol, row, NA_REAL);
+        SetElement(mOutcomeTypeCol, row, NaSymbol);
+        SetElement(mOutcomeSubTypeCol, row, NaSymbol);
+        SetElement(mOutcomeConditionCol, row, NaSymbol);
+        SetElement(mOutcomeSpayNeuterCol, row, NaSymbol);
+    }
+}
+
+
+
+
+/*
+ *  Method: EncodeFactors
+ *
+ *      Converts the columns of symbols to factors, once all rows are set,
+ *      against the dictionaries of the columns when they are enabled.
+ *      
+ */
+void ImpoundTable::EncodeFactors (SymbolTable& symbols, FactorDictionaries& dictionaries)
+{
+    using namespace Col;
+
+    const string columnNames[] = { AnimalId, Source, City, IntakeType, IntakeSubType,
+                                   IntakeCondition, IntakeLocation, IntakeAgeUnits,
+                                   IntakeSpayNeuter, Kennel, OutcomeType, OutcomeSubType,
+                                   OutcomeCondition, OutcomeSpayNeuter };
+    IntegerVector* const columnVectors[] = { &mAnimalIdCol, &mSourceCol, &mCityCol, &mIntakeTypeCol,
+                                             &mIntakeSubTypeCol, &mIntakeConditionCol, &mIntakeLocationCol,
+                                             &mIntakeAgeUnitsCol, &mIntakeSpayNeuterCol, &mKennelCol,
+                                             &mOutcomeTypeCol, &mOutcomeSubTypeCol, &mOutcomeConditionCol,
+                                             &mOutcomeSpayNeuterCol };
+
+    vector<string> names(columnNames, columnNames + 14);
+    vector<IntegerVector*> columns(columnVectors, columnVectors + 14);
+
+    EncodeFactorColumns(columns, names, symbols, dictionaries);
+}
+
+
+
+
+/*
+ *  Method: Clear
+ *
+ *      Remove all rows from this impound table.
+ *      
+ */
+void ImpoundTable::Clear ()
+{
+    Allocate(0);
+}
+
+
+
+
+/*
+ *  Method: GetColumns
+ *
+ *      Appends the names and R vectors of the columns of this table that
+ *      are not skipped, in data frame order, to the specified vectors.
+ *      
+ */
+void ImpoundTable::GetColumns (vector<string>& names, vector<SEXP>& columns) const
+{
+    using namespace Col;
+
+    // Each column is already an R vector object, either a factor (integer)
+    // vector, an integer vector, or a date-time (POSIXct) vector.
+
+    const string columnNames[] = { AnimalId, Source, City, IntakeDate, IntakeType,
+                                   IntakeSubType, IntakeCondition, IntakeLocation,
+                                   IntakeAgeCount, IntakeAgeUnits, IntakeAge,
+                                   IntakeSpayNeuter, Kennel, OutcomeDate, OutcomeType,
+                                   OutcomeSubType, OutcomeCondition, OutcomeSpayNeuter };
+    const SEXP columnVectors[] = { mAnimalIdCol, mSourceCol, mCityCol, mIntakeDateCol, mIntakeTypeCol,
+                                   mIntakeSubTypeCol, mIntakeConditionCol, mIntakeLocationCol,
+                                   mIntakeAgeCountCol, mIntakeAgeUnitsCol, mIntakeAgeCol,
+                                   mIntakeSpayNeuterCol, mKennelCol, mOutcomeDateCol, mOutcomeTypeCol,
+                                   mOutcomeSubTypeCol, mOutcomeConditionCol, mOutcomeSpayNeuterCol };
+
+    for (int c = 0; c < 18; ++c)
+    {
+        if (c != 0 && IsSkipped(columnNames[c]))
+            continue;
+
+        names.push_back(columnNames[c]);
+        columns.push_back(columnVectors[c]);
+    }
+}
+
+
+
+
+/*
+ *  Method: GetNumBytes
+ *
+ *      Returns the number of bytes allocated for the columns of this table.
+ *      
+ */
+size_t ImpoundTable::GetNumBytes () const
+{
+    vector<string> names;
+    vector<SEXP> columns;
+
+    GetColumns(names, columns);
+
+    return GetColumnBytes(columns);
+}
+
+
+
+
+/*
+ *  Method: GetDataFrame
+ *
+ *      Creates an R data frame object corresponding to the rows of
+ *      impounds in this table.
+ *      
+ */
+DataFrame ImpoundTable::GetDataFrame () const
+{
+    vector<string> names;
+    vector<SEXP> columns;
+
+    GetColumns(names, columns);
+
+    return MakeDataFrame(names, columns, GetNumRows());
+}
+
+
+
+
+/*** DiscrepancyTable ********************************************************/
+
+/*
+ *  Class: DiscrepancyTable
+ *
+ *      Output data table of the events discarded as discrepancies while
+ *      pairing up intakes with outcomes: the animal, the discrepancy, the
+ *      action taken, and the dates of the events involved. Tables built
+ *      from several data sets also have the source and city of the animal.
+ *      
+ */
+class DiscrepancyTable
+{
+public:
+    // Discrepancies, in the order of their factor levels.
+
+    enum Discrepancy
+    {
+        ExtraOutcome,           // Outcome after the last intake was paired
+        OutOfOrderOutcome,      // Outcome dated before the next intake
+        UnmatchedIntake         // Intake followed by another intake, without an outcome
+    };
+
+    DiscrepancyTable () : mSourceColumns(false) {}
+    ~DiscrepancyTable () {}
+
+    // Whether tables allocated from now on have source and city columns.
+
+    void SetSourceColumns (bool sourceColumns)
+    { mSourceColumns = sourceColumns; }
+
+    void Allocate (int numRows);
+    void SetRow (int row, const Animal& animal, Discrepancy discrepancy,
+                 double intakeDate, double outcomeDate);
+    void EncodeFactors (SymbolTable& symbols, FactorDictionaries& dictionaries);
+    void Clear ();
+
+    int GetNumRows () const
+    { return mAnimalIdCol.size(); }
+
+    // Named columns of this table, in data frame order.
+
+    void GetColumns (vector<string>& names, vector<SEXP>& columns) const;
+
+    // Number of bytes allocated for the columns of this table.
+
+    size_t GetNumBytes () const;
+
+    DataFrame GetDataFrame () const;
+
+private:
+    bool mSourceColumns;
+    IntegerVector mAnimalIdCol;
+    IntegerVector mSourceCol;
+    IntegerVector mCityCol;
+    IntegerVector mKindCol;
+    IntegerVector mDiscrepancyCol;
+    IntegerVector mActionCol;
+    NumericVector mIntakeDateCol;
+    NumericVector mOutcomeDateCol;
+};
+
+
+
+
+/*
+ *  Method: Allocate
+ *
+ *      Allocates the columns of this table for the specified number of rows.
+ *      
+ */
+void DiscrepancyTable::Allocate (int numRows)
+{
+    int numSourceRows = mSourceColumns ? numRows : 0;
+
+    mAnimalIdCol = IntegerVector(numRows);
+    mSourceCol = IntegerVector(numSourceRows);
+    mCityCol = IntegerVector(numSourceRows);
+    mKindCol = IntegerVector(numRows);
+    mDiscrepancyCol = IntegerVector(numRows);
+    mActionCol = IntegerVector(numRows);
+    mIntakeDateCol = NumericVector(numRows);
+    mOutcomeDateCol = NumericVector(numRows);
+
+    // Timestamp columns are date-time (POSIXct) vectors.
+
+    mIntakeDateCol.attr("class") = CharacterVector::create("POSIXct", "POSIXt");
+    mOutcomeDateCol.attr("class") = CharacterVector::create("POSIXct", "POSIXt");
+}
+
+
+
+
+/*
+ *  Method: SetRow
+ *
+ *      Sets a row of this table from a discrepancy of an animal. The intake
+ *      date is that of the discarded intake, or of the intake the discarded
+ *      outcome could not be paired with; either date may be NA.
+ *      
+ */
+void DiscrepancyTable::SetRow (int row, const Animal& animal, Discrepancy discrepancy,
+                               double intakeDate, double outcomeDate)
+{
+    // Discrepancy and action columns are factors with fixed levels, which
+    // are set once the table is encoded.
+
+    mAnimalIdCol[row] = animal.GetAnimalId();
+    SetElement(mSourceCol, row, animal.GetSource());
+    SetElement(mCityCol, row, animal.GetCity());
+    mKindCol[row] = animal.GetKind();
+    mDiscrepancyCol[row] = discrepancy + 1;
+    mActionCol[row] = (discrepancy == UnmatchedIntake) ? 1 : 2;
+    mIntakeDateCol[row] = intakeDate;
+    mOutcomeDateCol[row] = outcomeDate;
+}
+
+
+
+
+/*
+ *  Method: EncodeFactors
+ *
+ *      Converts the symbol columns of this table to R factors, against the
+ *      dictionaries of the columns when they are enabled.
+ *      
+ */
+void DiscrepancyTable::EncodeFactors (SymbolTable& symbols, FactorDictionaries& dictionaries)
+{
+    const string columnNames[] = { Col::AnimalId, Col::Source, Col::City, Col::Kind };
+    IntegerVector* const columnVectors[] = { &mAnimalIdCol, &mSourceCol, &mCityCol, &mKindCol };
+
+    vector<string> names(columnNames, columnNames + 4);
+    vector<IntegerVector*> columns(columnVectors, columnVectors + 4);
+
+    EncodeFactorColumns(columns, names, symbols, dictionaries);
+
+    mDiscrepancyCol.attr("levels") = CharacterVector::create("extra_outcome", "out_of_order_outcome",
+                                                             "unmatched_intake");
+    mDiscrepancyCol.attr("class") = "factor";
+    mActionCol.attr("levels") = CharacterVector::create("intake_discarded", "outcome_discarded");
+    mActionCol.attr("class") = "factor";
+}
+
+
+
+
+/*
+ *  Method: Clear
+ *
+ *      Remove all rows from this discrepancy table.
+ *      
+ */
+void DiscrepancyTable::Clear ()
+{
+    Allocate(0);
+}
+
+
+
+
+/*
+ *  Method: GetColumns
+ *
+ *      Appends the names and R vectors of the columns of this table, in
+ *      data frame order, to the specified vectors.
+ *      
+ */
+void DiscrepancyTable::GetColumns (vector<string>& names, vector<SEXP>& columns) const
+{
+    // Column names are qualified, as the discrepancy column name is hidden
+    // by the enumeration of discrepancies.
+
+    const string columnNames[] = { Col::AnimalId, Col::Source, Col::City, Col::Kind, Col::Discrepancy,
+                                   Col::Action, Col::IntakeDate, Col::OutcomeDate };
+    const SEXP columnVectors[] = { mAnimalIdCol, mSourceCol, mCityCol, mKindCol, mDiscrepancyCol,
+                                   mActionCol, mIntakeDateCol, mOutcomeDateCol };
+
+    for (int c = 0; c < 8; ++c)
+    {
+        if (!mSourceColumns && (columnNames[c] == Col::Source || columnNames[c] == Col::City))
+            continue;
+
+        names.push_back(columnNames[c]);
+        columns.push_back(columnVectors[c]);
+    }
+}
+
+
+
+
+/*
+ *  Method: GetNumBytes
+ *
+ *      Returns the number of bytes allocated for the columns of this table.
+ *      
+ */
+size_t DiscrepancyTable::GetNumBytes () const
+{
+    vector<string> names;
+    vector<SEXP> columns;
+
+    GetColumns(names, columns);
+
+    return GetColumnBytes(columns);
+}
+
+
+
+
+/*
+ *  Method: GetDataFrame
+ *
+ *      Creates an R data frame object corresponding to the rows of
+ *      discrepancies in this table.
+ *      
+ */
+DataFrame DiscrepancyTable::GetDataFrame () const
+{
+    vector<string> names;
+    vector<SEXP> columns;
+
+    GetColumns(names, columns);
+
+    return MakeDataFrame(names, columns, GetNumRows());
+}
+
+
+
+
+/*** Spill runs **************************************************************/
+
+// Within a memory budget, a builder writes the records it has ingested to
+// runs on disk, one run per partition of the animals by hash of animal ID.
+// At the finish each partition is read back and merged on its own, and its
+// merged animals are written to a further run in animal ID order; these
+// runs are then merged into the tables. Runs are only read back by the
+// process that wrote them, so their records are written as their bytes.
+
+static const int SpillPartitionBits = 4;
+static const int NumSpillPartitions = 1 << SpillPartitionBits;
+
+// Intake and outcome of an ingested record, or of a merged impound.
+
+struct SpilledEvents
+{
+    bool hasIntake;                 // Whether there is an intake
+    bool hasOutcome;                // Whether there is an outcome
+    IntakeStore::Row intake;        // Fields of the intake, if any
+    OutcomeStore::Row outcome;      // Fields of the outcome, if any
+};
+
+// Ingested record, as written to the run of its partition.
+
+struct SpilledRecord
+{
+    SpilledRecord (const AnimalRecord& animalRecord) : animalId(NaSymbol), record(animalRecord), events() {}
+
+    Symbol animalId;                // Animal ID of the record
+    AnimalRecord record;            // Animal information of the record
+    SpilledEvents events;           // Events of the record
+};
+
+// Merged animal, as written to the results of its partition. It is
+// followed by its impounds (as SpilledEvents) and its discrepancies.
+
+struct SpilledAnimal
+{
+    Animal animal;                  // Fields of the animal
+    int numImpounds;                // Number of impounds that follow
+    int numDiscrepancies;           // Number of discrepancies that follow them
+};
+
+struct SpilledDiscrepancy
+{
+    DiscrepancyTable::Discrepancy discrepancy;  // Sort of discrepancy
+    double intakeDate;              // Date of the intake involved, or NA
+    double outcomeDate;             // Date of the outcome involved, or NA
+};
+
+
+
+
+/*
+ *  Class: SpillRun
+ *
+ *      Temporary file of fixed-size records, written in one pass and then
+ *      read back in the same order. The file is removed with the run.
+ *      
+ */
+class SpillRun
+{
+public:
+    SpillRun (const string& directory);
+    ~SpillRun ();
+
+    // Append a record.
+
+    template <class T>
+    void Write (const T& record)
+    {
+        mFile.write(reinterpret_cast<const char*>(&record), sizeof record);
+        mNumBytes += sizeof record;
+    }
+
+    // Start reading from the first record, once all are written.
+
+    void Rewind ();
+
+    // Read the next record, returning false after the last one.
+
+    template <class T>
+    bool Read (T& record)
+    {
+        if (mNumBytesRead == mNumBytes)
+            return false;
+
+        mFile.read(reinterpret_cast<char*>(&record), sizeof record);
+        mNumBytesRead += sizeof record;
+
+        if (!mFile)
+            throw "Cannot read spill file " + mFilePath;
+
+        return true;
+    }
+
+    // Properties
+
+    uint64_t GetNumBytes () const
+    { return mNumBytes; }
+
+private:
+    SpillRun (const SpillRun&);
+    SpillRun& operator= (const SpillRun&);
+
+private:
+    string mFilePath;           // Name of the file
+    std::fstream mFile;         // Stream of the file
+    uint64_t mNumBytes;         // Number of bytes written
+    uint64_t mNumBytesRead;     // Number of bytes read since the rewind
+};
+
+
+
+
+/*
+ *  Method: Constructor
+ *
+ *      Creates an empty run in a new file of the specified directory.
+ *      
+ */
+SpillRun::SpillRun (const string& directory)
+        :
+         mFilePath(),
+         mFile(),
+         mNumBytes(0),
+         mNumBytesRead(0)
+{
+    // Name the file by the process ID, the time and a count of the runs
+    // made by the process, so that builders of one or more sessions never
+    // share a file, even those of a child process forked with the count.
+
+    static std::atomic<unsigned> numRuns(0);
+
+    mFilePath = directory + "/hmspill-" + std::to_string(GetProcessId()) + "-" +
+                std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + "-" +
+                std::to_string(numRuns++) + ".run";
+
+    mFile.open(mFilePath.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!mFile)
+        throw "Cannot create spill file " + mFilePath;
+}
+
+
+
+
+/*
+ *  Method: Destructor
+ *
+ *      Removes the file.
+ *      
+ */
+SpillRun::~SpillRun ()
+{
+    mFile.close();
+    std::remove(mFilePath.c_str());
+}
+
+
+
+
+/*
+ *  Method: Rewind
+ *
+ *      Flushes the records written, throwing an exception if they could not
+ *      all be written (e.g., the disk is full), and starts reading from the
+ *      first record.
+ *      
+ */
+void SpillRun::Rewind ()
+{
+    mFile.flush();
+
+    if (!mFile)
+        throw "Cannot write spill file " + mFilePath;
+
+    mFile.seekg(0);
+    mNumBytesRead = 0;
+}
+
+
+
+
+/*** DataFrameBuilder ********************************************************/
+
+/*
+ *  Struct: MergeCounts
+ *
+ *      Counts of how the events of merged animals were paired up into
+ *      impounds, or discarded as discrepancies.
+ *      
+ */
+struct MergeCounts
+{
+    MergeCounts () : paired(0), solitaryIntakes(0), solitaryOutcomes(0),
+                     outOfOrderOutcomes(0), extraOutcomes(0), unmatchedIntakes(0) {}
+
+    void Add (const MergeCounts& counts)
+    {
+        paired += counts.paired;
+        solitaryIntakes += counts.solitaryIntakes;
+        solitaryOutcomes += counts.solitaryOutcomes;
+        outOfOrderOutcomes += counts.outOfOrderOutcomes;
+        extraOutcomes += counts.extraOutcomes;
+        unmatchedIntakes += counts.unmatchedIntakes;
+    }
+
+    int64_t paired;             // Impounds of an intake paired with an outcome
+    int64_t solitaryIntakes;    // Impounds of an intake alone (animal still in custody)
+    int64_t solitaryOutcomes;   // Impounds of an outcome alone (intake before the data set)
+    int64_t outOfOrderOutcomes; // Outcomes discarded for preceding their intakes
+    int64_t extraOutcomes;      // Outcomes discarded for following the last intake
+    int64_t unmatchedIntakes;   // Intakes discarded for not having outcomes
+};
+
+
+
+
+
+/*
+ *  Struct: MergeChunk
+ *
+ *      Output of merging a run of consecutive animals: the impound rows and
+ *      the discrepancies, each in the order in which the animals were
+ *      merged. An impound or discrepancy refers to its animal and events by
+ *      index, so that the chunk stays small until the rows are copied into
+ *      the output tables.
+ *
+ *      Chunks are merged on worker threads, so discrepancies are only
+ *      recorded here, never printed.
+ *
+ *      The builder keeps the impounds and discrepancies of all animals
+ *      between updates, with the event rows of each relative to the first
+ *      rows of its animal, which stay valid when the stores are regrouped.
+ *      
+ */
+struct MergeChunk
+{
+    struct Impound
+    {
+        int animalIndex;        // Animal map index of the animal
+        int intakeRow;          // Row of the intake, or NaRow
+        int outcomeRow;         // Row of the outcome, or NaRow
+    };
+
+    struct Discrepancy
+    {
+        int animalIndex;        // Animal map index of the animal
+        int intakeRow;          // Row of the intake discarded or not paired, or NaRow
+        int outcomeRow;         // Row of the outcome discarded, or NaRow
+        DiscrepancyTable::Discrepancy discrepancy;
+    };
+
+    void Emit (int animalIndex, int intakeRow, int outcomeRow)
+    {
+        Impound impound = { animalIndex, intakeRow, outcomeRow };
+        impounds.push_back(impound);
+
+        if (intakeRow == NaRow)
+            ++counts.solitaryOutcomes;
+        else if (outcomeRow == NaRow)
+            ++counts.solitaryIntakes;
+        else
+            ++counts.paired;
+    }
+
+    void Discard (int animalIndex, DiscrepancyTable::Discrepancy discrepancy, int intakeRow, int outcomeRow)
+    {
+        Discrepancy discarded = { animalIndex, intakeRow, outcomeRow, discrepancy };
+        discrepancies.push_back(discarded);
+    }
+
+    vector<Impound> impounds;           // Impound rows of the merged animals
+    vector<Discrepancy> discrepancies;  // Events discarded while merging, if collected
+    MergeCounts counts;                 // Counts of the pairings and discrepancies
+};
+
+
+
+
+
+/*
+ *  Class: DataFrameBuilder
+ *
+ *      Builds separate animal and impound data frames from either combined or
+ *      disjoint intake and outcome input data frames in various expected
+ *      formats.
+ *
+ *      Intake and outcome events are held in column stores owned by the
+ *      builder and are referred to by row. Animals are held in the animal
+ *      map, and events refer to animals by animal map index.
+ *
+ *      A builder may be updated with further input records of the kind it
+ *      was built from. Only the animals with new records are merged again;
+ *      the merged impounds of the other animals are kept.
+ *
+ *      The impound table may also be emitted already joined with the animal
+ *      table, as one denormalized data frame.
+ *
+ *      Input records may also be streamed into a builder in chunks, which
+ *      are only ingested (and may then be freed) until the tables are
+ *      finished, so that the input is never all held in memory at once.
+ *
+ *      Within a memory budget, the records ingested are buffered, and are
+ *      spilled to runs on disk whenever the buffer outgrows the budget.
+ *      Each partition of the spilled animals is then merged on its own,
+ *      and the merged partitions are merged into the tables in animal ID
+ *      order, so that the tables are the same as those built in memory.
+ *      Tables built by spilling records cannot be updated.
+ *      
+ */
+class DataFrameBuilder
+{
+public:
+    DataFrameBuilder ();
+    ~DataFrameBuilder () {}
+
+    // Build animal table and impound table from different sorts
+    // of input records.
+
+    void BuildFromAtxIntakesAndOutcomes (const DataFrame& intake, const DataFrame& outcome);
+    void BuildFromSacOpenImpounds (const DataFrame& impound);
+    void BuildFromSacCpraImpounds (const DataFrame& impound);
+
+    // Add further input records, of the sort the tables were built from,
+    // and rebuild the tables.
+
+    void UpdateFromAtxIntakesAndOutcomes (const DataFrame& intake, const DataFrame& outcome);
+    void UpdateFromSacOpenImpounds (const DataFrame& impound);
+    void UpdateFromSacCpraImpounds (const DataFrame& impound);
+
+    // Stream input records in chunks: start empty tables for a sort of
+    // input records, append any number of chunks of records, then finish
+    // the tables once.
+
+    void StartAtxIntakesAndOutcomes ();
+    void StartSacOpenImpounds ();
+    void StartSacCpraImpounds ();
+    void AppendAtxIntakes (const DataFrame& intake);
+    void AppendAtxOutcomes (const DataFrame& outcome);
+    void AppendSacImpounds (const DataFrame& impound);
+    void FinishTables ();
+
+    // Build tables from any mix of data sets at once: start combined
+    // tables, append each data set, then finish the tables once. Rows are
+    // tagged with the source and city of their data set, and animals of
+    // different sources are kept apart even when their IDs are equal.
+
+    void StartCombined ();
+    void AppendAtxSource (const DataFrame& intake, const DataFrame& outcome);
+    void AppendSacSource (const DataFrame& impound);
+
+    // Columns to leave out of the tables built from now on.
+
+    void SetSkippedColumns (const vector<string>& skipColumns);
+
+    // Whether to collect the events discarded while merging into the
+    // discrepancy table (the default). When not collected, the table is
+    // left empty.
+
+    void SetCollectDiscrepancies (bool collectDiscrepancies)
+    { mCollectDiscrepancies = collectDiscrepancies; }
+
+    // Factor levels to encode the tables against from now on, as an R list
+    // of character vectors named by column. The dictionaries are kept
+    // across builds and updates, and levels are only ever appended to them,
+    // so the factor codes of the tables stay the same.
+
+    void SetFactorDictionaries (const List& dictionaries)
+    { mDictionaries.Assign(dictionaries); }
+
+    // Memory budget of the builds started from now on, in bytes, and the
+    // directory of the temporary files that records are spilled to once
+    // they outgrow it. A budget of zero (the default) keeps all records in
+    // memory. The budget bounds the records held while ingesting and
+    // merging, not the interned strings or the tables themselves.
+
+    void SetMemoryBudget (double numBytes, const string& spillDirectory);
+
+    // Seconds spent in each phase of the last finish of the tables, and
+    // in ingesting the records appended before it.
+
+    struct PhaseTimes
+    {
+        double ingest;          // Ingesting input records into the stores
+        double sort;            // Grouping events by animal, ordering animals by ID
+        double merge;           // Pairing up intakes with outcomes
+        double fill;            // Copying animals and impounds into the tables
+        double encode;          // Wrapping the string columns of the tables as factors
+        double impoundTable;    // Building the impound table (sort, merge, fill, encode)
+        double animalTable;     // Building the animal table (fill, encode)
+        double frames;          // Making the R data frames of the tables
+    };
+
+    // Statistics of the last finish of the tables: phase times, counts of
+    // records and of merge outcomes, and bytes allocated, as an R list.
+
+    List GetStats () const;
+        
+    // Properties
+
+    const PhaseTimes& GetPhaseTimes () const
+    { return mPhaseTimes; }
+
+    bool GetCollectDiscrepancies () const
+    { return mCollectDiscrepancies; }
+
+    bool GetUseFactorDictionaries () const
+    { return mDictionaries.IsEnabled(); }
+
+    // Factor dictionaries after the last build, as an R list of character
+    // vectors named by column.
+
+    List GetFactorDictionaries () const
+    { return mDictionaries.GetList(); }
+    
+    DataFrame GetAnimalDataFrame () const;
+    DataFrame GetImpoundDataFrame () const;
+    DataFrame GetDiscrepancyDataFrame () const;
+
+    // Impound table joined with the animal table on animal ID.
+
+    DataFrame GetJoinedDataFrame () const;
+
+    // IDs of the animals merged by the last build or update.
+
+    CharacterVector GetChangedAnimalIds () const;
+
+private:
+    enum InputKind
+    {
+        NoInput,
+        AtxInput,
+        SacOpenInput,
+        SacCpraInput,
+        CombinedInput
+    };
+
+    void Clear ();
+    void Start (InputKind inputKind);
+    void CheckInputKind (InputKind inputKind) const;
+    void SetSource (const string& source, const string& city, const string& timeZone);
+
+    template <class Schema>
+    void Ingest (const DataFrame& table);
+    
+    int AddAnimal (SEXP animalId, const AnimalRecord& record, bool intakeRecord);
+    void UpdateAnimal (int animalIndex, bool added, Symbol animalId, const AnimalRecord& record,
+                       bool intakeRecord);
+    void ResolveAnimals ();
+
+    // Spilling records within a memory budget.
+
+    struct SpillTotals
+    {
+        SpillTotals () : numAnimals(0), numIntakes(0), numOutcomes(0), numImpounds(0), numDiscrepancies(0) {}
+
+        int64_t numAnimals;         // Animals merged
+        int64_t numIntakes;         // Intakes of the animals
+        int64_t numOutcomes;        // Outcomes of the animals
+        int64_t numImpounds;        // Impounds merged
+        int64_t numDiscrepancies;   // Discrepancies collected
+        MergeCounts counts;         // Pairings and discrepancies
+    };
+
+    void BufferRecord (SEXP animalId, const AnimalRecord& record, int intakeRow, int outcomeRow);
+    void SpillBuffer ();
+    void ReplayRecord (const SpilledRecord& spilled);
+    int GetSpillPartition (Symbol animalId, int level) const;
+    void MergeSpillRun (unique_ptr<SpillRun>& run, int level,
+                        vector<unique_ptr<SpillRun>>& results, SpillTotals& totals);
+    unique_ptr<SpillRun> WriteMergedAnimals () const;
+    void FinishSpilledTables ();
+    void ResetWorkingState ();
+
+    void MergeAnimal (int animalIndex, MergeChunk& chunk) const;
+    void EmitSolitaryIntake (int animalIndex, int intakeRow, MergeChunk& chunk) const;
+    void EmitIntakeOutcome (int animalIndex, int intakeRow, int outcomeRow, MergeChunk& chunk) const;
+    void EmitSolitaryOutcome (int animalIndex, int outcomeRow, MergeChunk& chunk) const;
+    void MergeAnimals ();
+    void BuildAnimalTable ();
+    void BuildImpoundTable ();
+    void BuildDiscrepancyTable ();
+
+    template <class Row>
+    void UpdateMergedRows (const vector<MergeChunk>& chunks, vector<Row> MergeChunk::* merged,
+                           vector<int>& firstRows, vector<Row>& rows) const;
+
+    void DeepPrint (ostream& output, int animalIndex) const;
+    
+private:
+    // Animals to merge or copy are split into a few chunks per thread to
+    // balance the load, but each chunk has enough animals to be worth a task.
+
+    static const int ChunksPerThread = 4;
+    static const int MinAnimalsPerChunk = 1024;
+
+    // Spilled runs too large for the budget are split again by the next
+    // bits of the hash, at most this many times.
+
+    static const int MaxSpillLevels = 4;
+
+    SymbolTable mSymbols;           // Interned strings of categorical fields
+    FactorDictionaries mDictionaries;   // Persistent factor levels, kept across builds
+    IntakeStore mIntakes;           // Columns of intake events
+    OutcomeStore mOutcomes;         // Columns of outcome events
+    AnimalMap mAnimalMap;           // Dictionary of individual animals
+    AnimalUpdateStore mAnimalUpdates;   // Records of animals seen before, not yet resolved
+    AnimalUpdateStore mIntakeRecords;   // Records of all intakes, in Austin builds
+    AnimalUpdateStore mOutcomeRecords;  // Records of all outcomes, in Austin builds
+    AnimalTable mAnimalTable;       // Output data table of animals
+    ImpoundTable mImpoundTable;     // Output data table of animal impounds
+    DiscrepancyTable mDiscrepancyTable; // Output data table of merge discrepancies
+    const TimeZoneRules* mTimeZone; // Time zone of the shelter, for local-day keys
+    InputKind mInputKind;           // Sort of input records the tables are built from
+    string mSourceKey;              // Animal key prefix of the source being appended, in combined builds
+    string mAnimalKey;              // Scratch animal key (source prefix and animal ID)
+    Symbol mSource;                 // Source of the animals being appended, in combined builds
+    Symbol mCity;                   // City of the animals being appended, in combined builds
+    vector<bool> mAnimalsToMerge;   // Whether each animal has records not yet merged
+    vector<int> mMergedAnimals;     // Animals merged by the last build or update, in ID order
+    vector<int> mFirstImpounds;     // First merged impound of each animal, plus the end
+    vector<MergeChunk::Impound> mImpounds;  // Merged impounds, grouped by animal (relative rows)
+    vector<int> mFirstImpoundRows;  // First impound table row of each animal table row, plus the end
+    vector<int> mFirstDiscrepancies;    // First merged discrepancy of each animal, plus the end
+    vector<MergeChunk::Discrepancy> mDiscrepancies; // Merged discrepancies, grouped by animal (relative rows)
+    vector<string> mSkippedColumns; // Columns left out of the tables
+    bool mCollectDiscrepancies;     // Whether to collect merge discrepancies
+    mutable PhaseTimes mPhaseTimes; // Seconds per phase of the last finish (data frames are made later)
+    double mIngestSeconds;          // Seconds ingesting records since the last finish
+    MergeCounts mMergeCounts;       // Pairings and discrepancies of the last finish
+    double mMemoryBudget;           // Bytes of records to hold before spilling, or zero
+    string mSpillDirectory;         // Directory of the spill runs
+    IntakeStore mSpillIntakes;      // Scratch intake of the record being buffered
+    OutcomeStore mSpillOutcomes;    // Scratch outcome of the record being buffered
+    vector<SpilledRecord> mSpillBuffer; // Records ingested and not yet spilled
+    vector<unique_ptr<SpillRun>> mSpillRuns;    // Runs of spilled records, by partition
+    bool mBuiltWithinBudget;        // Whether the tables were built by spilling records
+    int64_t mNumSpilledRecords;     // Records spilled by the last build
+    SpillTotals mSpillTotals;       // Totals of the animals merged by spilling
+    vector<Symbol> mSpilledAnimalIds;   // IDs of the animals merged by spilling, in ID order
+};
+
+
+
+
+/*
+ *  Method: Constructor
+ *
+ *      Initializes this builder with empty tables.
+ *      
+ */
+DataFrameBuilder::DataFrameBuilder ()
+                :
+                 mTimeZone(&FindTimeZoneRules("UTC")),
+                 mInputKind(NoInput),
+                 mSource(NaSymbol),
+                 mCity(NaSymbol),
+                 mFirstImpounds(1, 0),
+                 mFirstImpoundRows(1, 0),
+                 mFirstDiscrepancies(1, 0),
+                 mCollectDiscrepancies(true),
+                 mPhaseTimes(),
+                 mIngestSeconds(0),
+                 mMemoryBudget(0),
+                 mBuiltWithinBudget(false),
+                 mNumSpilledRecords(0)
+{
+}
+
+
+
+
+/*
+ *  Class: Clear
+ *
+ *      Erases all internal data structures.
+ *      Leaves this builder ready to build new tables.
+ *      
+ */
+void DataFrameBuilder::Clear ()
+{
+    mAnimalTable.Clear();
+    mImpoundTable.Clear();
+    mDiscrepancyTable.Clear();
+    mAnimalMap.Clear();
+    mAnimalUpdates.Clear();
+    mIntakeRecords.Clear();
+    mOutcomeRecords.Clear();
+    mIntakes.Clear();
+    mOutcomes.Clear();
+    mSymbols.Clear();
+    mInputKind = NoInput;
+    mSourceKey.clear();
+    mSource = NaSymbol;
+    mCity = NaSymbol;
+    mAnimalsToMerge.clear();
+    mMergedAnimals.clear();
+    mFirstImpounds.assign(1, 0);
+    mImpounds.clear();
+    mFirstImpoundRows.assign(1, 0);
+    mFirstDiscrepancies.assign(1, 0);
+    mDiscrepancies.clear();
+    mPhaseTimes = PhaseTimes();
+    mIngestSeconds = 0;
+    mMergeCounts = MergeCounts();
+    vector<SpilledRecord>().swap(mSpillBuffer);
+    mSpillRuns.clear();
+    mBuiltWithinBudget = false;
+    mNumSpilledRecords = 0;
+    mSpillTotals = SpillTotals();
+    vector<Symbol>().swap(mSpilledAnimalIds);
+}
+
+
+
+
+/*
+ *  Method: CheckInputKind
+ *
+ *      Throws an exception unless the tables were built from the specified
+ *      sort of input records.
+ *      
+ */
+void DataFrameBuilder::CheckInputKind (InputKind inputKind) const
+{
+    if (mInputKind != inputKind)
+        throw string("Cannot update tables built from a different sort of input records");
+}
+
+
+
+
+/*
+ *  Class: BuildFromAtxIntakesAndOutcomes
+ *
+ *      Builds tables from input intake and outcome events.
+ *      
+ */
+void DataFrameBuilder::BuildFromAtxIntakesAndOutcomes (const DataFrame& intake, const DataFrame& outcome)
+{
+    // Build the tables as an update of empty tables.
+
+    StartAtxIntakesAndOutcomes();
+    UpdateFromAtxIntakesAndOutcomes(intake, outcome);
+}
+
+
+
+
+/*
+ *  Method: UpdateFromAtxIntakesAndOutcomes
+ *
+ *      Adds further input records to the tables built from the same sort of
+ *      records, and rebuilds the tables.
+ *      
+ */
+void DataFrameBuilder::UpdateFromAtxIntakesAndOutcomes (const DataFrame& intake, const DataFrame& outcome)
+{
+    // Add the new events, then merge again the animals with new events.
+
+    AppendAtxIntakes(intake);
+    AppendAtxOutcomes(outcome);
+    FinishTables();
+}
+
+
+
+
+/*
+ *  Class: BuildFromSacOpenImpounds
+ *
+ *      Builds tables from input open-data impound events, which combine intake
+ *      and outcome events.
+ *      
+ */
+void DataFrameBuilder::BuildFromSacOpenImpounds (const DataFrame& impound)
+{
+    // Build the tables as an update of empty tables.
+
+    StartSacOpenImpounds();
+    UpdateFromSacOpenImpounds(impound);
+}
+
+
+
+
+/*
+ *  Method: UpdateFromSacOpenImpounds
+ *
+ *      Adds further input records to the tables built from the same sort of
+ *      records, and rebuilds the tables.
+ *      
+ */
+void DataFrameBuilder::UpdateFromSacOpenImpounds (const DataFrame& impound)
+{
+    CheckInputKind(SacOpenInput);
+
+    // Add the new events, then merge again the animals with new events.
+
+    AppendSacImpounds(impound);
+    FinishTables();
+}
+
+
+
+
+/*
+ *  Class: BuildFromSacCpraImpounds
+ *
+ *      Builds tables from input CPRA impound events, which combine intake
+ *      and outcome events.
+ *      
+ */
+void DataFrameBuilder::BuildFromSacCpraImpounds (const DataFrame& impound)
+{
+    // Build the tables as an update of empty tables.
+
+    StartSacCpraImpounds();
+    UpdateFromSacCpraImpounds(impound);
+}
+
+
+
+
+/*
+ *  Method: UpdateFromSacCpraImpounds
+ *
+ *      Adds further input records to the tables built from the same sort of
+ *      records, and rebuilds the tables.
+ *      
+ */
+void DataFrameBuilder::UpdateFromSacCpraImpounds (const DataFrame& impound)
+{
+    CheckInputKind(SacCpraInput);
+
+    // Add the new events, then merge again the animals with new events.
+
+    AppendSacImpounds(impound);
+    FinishTables();
+}
+
+
+
+
+/*
+ *  Method: Start
+ *
+ *      Erases the tables and starts empty tables for the specified sort of
+ *      input records. Events are compared by day in the time zone of the
+ *      shelter of the records; combined tables switch time zones with each
+ *      source.
+ *      
+ */
+void DataFrameBuilder::Start (InputKind inputKind)
+{
+    // Animals of combined tables are keyed by source, which spilled
+    // records do not keep.
+
+    if (inputKind == CombinedInput && mMemoryBudget > 0)
+        throw string("Cannot build combined tables within a memory budget");
+
+    Clear();
+
+    mInputKind = inputKind;
+    mTimeZone = &FindTimeZoneRules((inputKind == AtxInput) ? "America/Chicago" : "America/Los_Angeles");
+
+    bool sourceColumns = (inputKind == CombinedInput);
+
+    mAnimalTable.SetSourceColumns(sourceColumns);
+    mImpoundTable.SetSourceColumns(sourceColumns);
+    mDiscrepancyTable.SetSourceColumns(sourceColumns);
+}
+
+
+
+
+/*
+ *  Method: SetMemoryBudget
+ *
+ *      Sets the memory budget of the builds started from now on, and the
+ *      directory to spill records to. The spill directory is required with
+ *      a budget.
+ *      
+ */
+void DataFrameBuilder::SetMemoryBudget (double numBytes, const string& spillDirectory)
+{
+    if (numBytes > 0 && spillDirectory.empty())
+        throw string("A spill directory is required with a memory budget");
+
+    mMemoryBudget = std::max(numBytes, 0.0);
+    mSpillDirectory = spillDirectory;
+}
+
+
+
+
+/*
+ *  Method: StartAtxIntakesAndOutcomes
+ *
+ *      Starts empty tables to which Austin intakes and outcomes are
+ *      appended.
+ *      
+ */
+void DataFrameBuilder::StartAtxIntakesAndOutcomes ()
+{
+    Start(AtxInput);
+}
+
+
+
+
+/*
+ *  Method: StartSacOpenImpounds
+ *
+ *      Starts empty tables to which Sacramento open-data impounds are
+ *      appended.
+ *      
+ */
+void DataFrameBuilder::StartSacOpenImpounds ()
+{
+    Start(SacOpenInput);
+}
+
+
+
+
+/*
+ *  Method: StartSacCpraImpounds
+ *
+ *      Starts empty tables to which Sacramento CPRA impounds are appended.
+ *      
+ */
+void DataFrameBuilder::StartSacCpraImpounds ()
+{
+    Start(SacCpraInput);
+}
+
+
+
+
+/*
+ *  Method: AppendAtxIntakes
+ *
+ *      Ingests a chunk of Austin intake records, without rebuilding the
+ *      tables. The chunk is not referred to once this returns.
+ *      
+ */
+void DataFrameBuilder::AppendAtxIntakes (const DataFrame& intake)
+{
+    CheckInputKind(AtxInput);
+
+    Stopwatch stopwatch;
+
+    Ingest<AtxIntakeSchema>(intake);
+    mSymbols.ForgetCharSxps();
+
+    mIngestSeconds += stopwatch.GetSeconds();
+}
+
+
+
+
+/*
+ *  Method: AppendAtxOutcomes
+ *
+ *      Ingests a chunk of Austin outcome records, without rebuilding the
+ *      tables. The chunk is not referred to once this returns.
+ *      
+ */
+void DataFrameBuilder::AppendAtxOutcomes (const DataFrame& outcome)
+{
+    CheckInputKind(AtxInput);
+
+    Stopwatch stopwatch;
+
+    Ingest<AtxOutcomeSchema>(outcome);
+    mSymbols.ForgetCharSxps();
+
+    mIngestSeconds += stopwatch.GetSeconds();
+}
+
+
+
+
+/*
+ *  Method: AppendSacImpounds
+ *
+ *      Ingests a chunk of Sacramento impound records, of the sort the
+ *      tables were started for, without rebuilding the tables. The chunk is
+ *      not referred to once this returns.
+ *      
+ */
+void DataFrameBuilder::AppendSacImpounds (const DataFrame& impound)
+{
+    Stopwatch stopwatch;
+
+    if (mInputKind == SacCpraInput)
+        Ingest<SacCpraSchema>(impound);
+    else
+    {
+        CheckInputKind(SacOpenInput);
+        Ingest<SacOpenSchema>(impound);
+    }
+
+    mSymbols.ForgetCharSxps();
+
+    mIngestSeconds += stopwatch.GetSeconds();
+}
+
+
+
+
+/*
+ *  Method: StartCombined
+ *
+ *      Starts empty tables to which data sets of any source are appended.
+ *      
+ */
+void DataFrameBuilder::StartCombined ()
+{
+    Start(CombinedInput);
+}
+
+
+
+
+/*
+ *  Method: SetSource
+ *
+ *      Sets the source and city with which the animals appended from now on
+ *      are tagged, and the time zone of their shelter. Animals are keyed by
+ *      source and animal ID, so that the same ID in two sources makes two
+ *      animals.
+ *      
+ */
+void DataFrameBuilder::SetSource (const string& source, const string& city, const string& timeZone)
+{
+    mSourceKey = source + ':';
+    mSource = mSymbols.Intern(source);
+    mCity = mSymbols.Intern(city);
+    mTimeZone = &FindTimeZoneRules(timeZone);
+}
+
+
+
+
+/*
+ *  Method: AppendAtxSource
+ *
+ *      Ingests an Austin data set of intake and outcome records into
+ *      combined tables, without rebuilding the tables.
+ *      
+ */
+void DataFrameBuilder::AppendAtxSource (const DataFrame& intake, const DataFrame& outcome)
+{
+    CheckInputKind(CombinedInput);
+
+    Stopwatch stopwatch;
+
+    SetSource("atx", "Austin", "America/Chicago");
+    Ingest<AtxIntakeSchema>(intake);
+    Ingest<AtxOutcomeSchema>(outcome);
+    mSymbols.ForgetCharSxps();
+
+    mIngestSeconds += stopwatch.GetSeconds();
+}
+
+
+
+
+/*
+ *  Method: AppendSacSource
+ *
+ *      Ingests a Sacramento data set of impound records into combined
+ *      tables, without rebuilding the tables. CPRA records are told from
+ *      open-data records by their record-source column.
+ *      
+ */
+void DataFrameBuilder::AppendSacSource (const DataFrame& impound)
+{
+    CheckInputKind(CombinedInput);
+
+    Stopwatch stopwatch;
+
+    if (impound.containsElementNamed(Col::RecSource.c_str()))
+    {
+        SetSource("sac_cpra", "Sacramento", "America/Los_Angeles");
+        Ingest<SacCpraSchema>(impound);
+    }
+    else
+    {
+        SetSource("sac_open", "Sacramento", "America/Los_Angeles");
+        Ingest<SacOpenSchema>(impound);
+    }
+
+    mSymbols.ForgetCharSxps();
+
+    mIngestSeconds += stopwatch.GetSeconds();
+}
+
+
+
+
+/*
+ *  Method: FinishTables
+ *
+ *      Merges the animals with events appended since the tables were last
+ *      built, and rebuilds the tables. Tables built by spilling records are
+ *      already finished.
+ *      
+ */
+void DataFrameBuilder::FinishTables ()
+{
+    // Tables built by spilling records keep none of the records once they
+    // are filled, so they are left as they were built.
+
+    if (mBuiltWithinBudget)
+        return;
+
+    mPhaseTimes = PhaseTimes();
+    mPhaseTimes.ingest = mIngestSeconds;
+    mIngestSeconds = 0;
+
+    Stopwatch stopwatch;
+
+    if (!mSpillRuns.empty())
+    {
+        FinishSpilledTables();
+        return;
+    }
+
+    // Records buffered within a memory budget that were never spilled fit
+    // in memory after all, so add them to the animals and stores.
+
+    for (size_t i = 0; i < mSpillBuffer.size(); ++i)
+        ReplayRecord(mSpillBuffer[i]);
+
+    vector<SpilledRecord>().swap(mSpillBuffer);
+
+    mPhaseTimes.ingest += stopwatch.Lap();
+
+    BuildImpoundTable();
+
+    mPhaseTimes.impoundTable = stopwatch.Lap();
+
+    // Build the table of animals.
+
+    BuildAnimalTable();
+
+    mPhaseTimes.animalTable = stopwatch.Lap();
+}
+
+
+
+
+/*
+ *  Class: BuildAnimalTable
+ *
+ *      Builds the animal table from the animal map created from
+ *      the input data.
+ *      
+ */
+void DataFrameBuilder::BuildAnimalTable ()
+{
+    // Build the animal table from the animals in the animal map,
+    // in animal ID order.
+
+    Stopwatch stopwatch;
+
+    const vector<int>& order = mAnimalMap.GetSortedOrder();
+    int numAnimals = order.size();
+
+    mAnimalTable.Allocate(numAnimals);
+
+    for (int i = 0; i < numAnimals; ++i)
+        mAnimalTable.SetRow(i, mAnimalMap.GetAnimalAt(order[i]));
+
+    mPhaseTimes.fill += stopwatch.Lap();
+
+    mAnimalTable.EncodeFactors(mSymbols, mDictionaries);
+
+    mPhaseTimes.encode += stopwatch.Lap();
+}
+
+
+
+
+/*
+ *  Class: AddAnimal
+ *
+ *      Add a new animal or update an existing animal.
+ *      
+ *      Returns the animal map index of the animal object that was updated
+ *      in place in the animal map.
+ *      
+ */
+int DataFrameBuilder::AddAnimal (SEXP animalId, const AnimalRecord& record, bool intakeRecord)
+{
+    // Look up the animal to see if it is already in the dictionary,
+    // adding an entry for it when it is not.
+
+    // In combined tables, animals are keyed by source and animal ID.
+
+    const char* key = CHAR(animalId);
+    size_t keyLength = LENGTH(animalId);
+
+    if (!mSourceKey.empty())
+    {
+        mAnimalKey.assign(mSourceKey).append(key, keyLength);
+        key = mAnimalKey.data();
+        keyLength = mAnimalKey.size();
+    }
+
+    bool added = false;
+    int animalIndex = mAnimalMap.FindOrAdd(key, keyLength, added);
+
+    UpdateAnimal(animalIndex, added, added ? mSymbols.Intern(animalId) : NaSymbol, record, intakeRecord);
+
+    return animalIndex;
+}
+
+
+
+
+/*
+ *  Method: UpdateAnimal
+ *
+ *      Adds a record of an animal of the animal map to be resolved before
+ *      the next merge, or fills in the entry of an animal just added with
+ *      the symbol of its animal ID, and marks the animal to be merged again.
+ *
+ *      Austin records are all kept, as intake or outcome records, so that
+ *      the animals are resolved as a full build of all the records would.
+ *      
+ */
+void DataFrameBuilder::UpdateAnimal (int animalIndex, bool added, Symbol animalId, const AnimalRecord& record,
+                                     bool intakeRecord)
+{
+    // A full Austin build reads all intakes, then all outcomes, while
+    // updates and chunks interleave them.
+
+    if (mInputKind == AtxInput)
+        (intakeRecord ? mIntakeRecords : mOutcomeRecords).Add(animalIndex, record);
+
+    // Update an animal that has been seen before. Otherwise fill in
+    // the new animal's entry.
+
+    if (!added)
+    {
+        // Keep the record, to update the animal when the incoming information
+        // is more recent than the existing animal's information.
+
+        if (mInputKind != AtxInput)
+            mAnimalUpdates.Add(animalIndex, record);
+    } 
+    else
+    {
+        // Identify the new animal by the symbol for its animal ID, and tag
+        // it with the source being appended (NA unless combined).
+
+        Animal& animal = mAnimalMap.GetAnimalAt(animalIndex);
+
+        animal.Assign(animalId, record);
+        animal.SetSource(mSource);
+        animal.SetCity(mCity);
+    }
+
+    // The animal has to be merged again.
+
+    if (animalIndex >= (int) mAnimalsToMerge.size())
+        mAnimalsToMerge.resize(animalIndex + 1, false);
+
+    mAnimalsToMerge[animalIndex] = true;
+}
+
+
+
+
+/*
+ *  Method: ResolveAnimals
+ *
+ *      Updates the animals from the records kept since the last merge, in
+ *      a batch over the animals grouped by animal. Each animal's fields are
+ *      set once from all of its records, as if the records were applied
+ *      one at a time in the order they were read.
+ *
+ *      In Austin builds, the animals to merge are instead resolved again
+ *      from all of their intake records, then all of their outcome records,
+ *      so that the order in which intakes and outcomes were appended does
+ *      not change the animals.
+ *      
+ */
+void DataFrameBuilder::ResolveAnimals ()
+{
+    bool austin = (mInputKind == AtxInput);
+
+    if (!austin && mAnimalUpdates.GetNumUpdates() == 0)
+        return;
+
+    int numAnimals = mAnimalMap.GetNumAnimals();
+
+    if (austin)
+    {
+        mIntakeRecords.GroupByAnimal(numAnimals);
+        mOutcomeRecords.GroupByAnimal(numAnimals);
+        mAnimalsToMerge.resize(numAnimals, false);
+    }
+    else
+        mAnimalUpdates.GroupByAnimal(numAnimals);
+
+    // Animals are independent of each other, so resolve chunks of
+    // consecutive animals in parallel.
+
+    int numThreads = GetNumWorkerThreads();
+    int numChunks = std::min(numThreads * ChunksPerThread,
+                             (numAnimals + MinAnimalsPerChunk - 1) / MinAnimalsPerChunk);
+
+    ParallelFor(numChunks, numThreads, [&] (int chunk)
+    {
+        int begin = (int64_t) numAnimals * chunk / numChunks;
+        int end = (int64_t) numAnimals * (chunk + 1) / numChunks;
+
+        for (int a = begin; a < end; ++a)
+        {
+            Animal& animal = mAnimalMap.GetAnimalAt(a);
+
+            if (!austin)
+                mAnimalUpdates.Resolve(a, animal, false);
+            else if (mAnimalsToMerge[a])
+            {
+                // The animal's first record is its first intake, if any.
+
+                bool fromIntake = mIntakeRecords.Assign(a, animal);
+
+                if (!fromIntake)
+                    mOutcomeRecords.Assign(a, animal);
+
+                mIntakeRecords.Resolve(a, animal, fromIntake);
+                mOutcomeRecords.Resolve(a, animal, !fromIntake);
+            }
+        }
+    });
+
+    mAnimalUpdates.Clear();
+}
+
+
+
+
+/*
+ *  Method: DeepPrint
+ *
+ *      Prints a complete representation of an animal, including all of its
+ *      intake and outcome events, to the specified output stream.
+ *      
+ */
+void DataFrameBuilder::DeepPrint (ostream& output, int animalIndex) const
+{
+    // Output the animal's description.
+
+    output << mAnimalMap.GetAnimalAt(animalIndex).ToString(mSymbols) << endl;
+
+    // Output intake and outcome events interleaved as they appear
+    // in their respective stores.
+
+    int nextIntake = mIntakes.GetFirstRow(animalIndex);
+    int endIntake = mIntakes.GetEndRow(animalIndex);
+    int nextOutcome = mOutcomes.GetFirstRow(animalIndex);
+    int endOutcome = mOutcomes.GetEndRow(animalIndex);
+
+    while (nextIntake < endIntake || nextOutcome < endOutcome)
+    {
+        if (nextIntake < endIntake)
+            output << mIntakes.ToString(nextIntake++, mSymbols) << endl;
+
+        if (nextOutcome < endOutcome)
+            output << mOutcomes.ToString(nextOutcome++, mSymbols) << endl;
+    }
+}
+
+
+
+
+/*
+ *  Method: Ingest
+ *
+ *      Adds the given input records, in the layout described by the ingest
+ *      schema, to the internal representation of animals and events.
+ *
+ *      Each record updates its animal, and adds an intake event and an
+ *      outcome event when the schema has them. The animal record is dated
+ *      by the intake when there is one, else by the outcome.
+ *
+ *      Within a memory budget, each record is instead read into scratch
+ *      stores and buffered, to be spilled or added at the finish.
+ *      
+ */
+template <class Schema>
+void DataFrameBuilder::Ingest (const DataFrame& table)
+{
+    ATXSAC_PROFILE_SCOPE("Ingest");
+
+    if (mBuiltWithinBudget)
+        throw string("Cannot update tables built by spilling records to disk");
+
+    int numRecords = table.nrows();
+    if (numRecords == 0)
+        return;
+    
+    using namespace Col;
+
+    // Get the R data frame columns wrapped as C++ objects. String columns
+    // are viewed in place as R CHARSXPs.
+
+    StringColumn animalIdCol(table, AnimalId, mSymbols);
+    typename Schema::AnimalFields::Reader animalFields(table, mSymbols);
+    typename Schema::IntakeFields::Reader intakeFields(table, mSymbols);
+    typename Schema::OutcomeFields::Reader outcomeFields(table, mSymbols);
+
+    NumericVector intakeDateCol;
+    NumericVector outcomeDateCol;
+
+    bool buffered = (mMemoryBudget > 0);
+    IntakeStore& intakes = buffered ? mSpillIntakes : mIntakes;
+    OutcomeStore& outcomes = buffered ? mSpillOutcomes : mOutcomes;
+
+    if (Schema::HasIntakes)
+    {
+        SEXP intakeDates = table[IntakeDate];
+        intakeDateCol = intakeDates;
+
+        if (!buffered)
+            mIntakes.Reserve(numRecords);
+    }
+
+    if (Schema::HasOutcomes)
+    {
+        SEXP outcomeDates = table[OutcomeDate];
+        outcomeDateCol = outcomeDates;
+
+        if (!buffered)
+            mOutcomes.Reserve(numRecords);
+    }
+
+    // Add rows of animals and events to the internal accumulator tables.
+
+    for (int i = 0; i < numRecords; ++i)
+    {
+        SEXP animalId = animalIdCol.GetCharSxpAt(i);
+        double intakeDate = Schema::HasIntakes ? intakeDateCol[i] : NA_REAL;
+        double outcomeDate = Schema::HasOutcomes ? outcomeDateCol[i] : NA_REAL;
+
+        // Read the animal information in the record.
+
+        AnimalRecord record(Schema::HasIntakes ? intakeDate : outcomeDate);
+        animalFields.Read(i, record);
+
+        // Add or update the animal in place in the internal map.
+        // The returned index is that of the animal object stored in
+        // the internal map.
+
+        int animal = buffered ? 0 : AddAnimal(animalId, record, Schema::HasIntakes);
+
+        // Add event rows for the animal from the event information in the
+        // record.
+
+        int intake = NaRow;
+        int outcome = NaRow;
+
+        if (Schema::HasIntakes)
+        {
+            intake = intakes.Add(animal, intakeDate, mTimeZone->GetLocalDay(intakeDate));
+            intakeFields.Read(i, intakes, intake);
+        }
+
+        if (Schema::HasOutcomes)
+        {
+            outcome = outcomes.Add(animal, outcomeDate, mTimeZone->GetLocalDay(outcomeDate));
+            outcomeFields.Read(i, outcomes, outcome);
+        }
+
+        if (buffered)
+            BufferRecord(animalId, record, intake, outcome);
+    }
+}
+
+
+
+
+/*
+ *  Method: MergeAnimals
+ *
+ *      Pairs up the intake and outcome events of the animals with new
+ *      events, replacing their kept impounds and discrepancies, and counts
+ *      the outcomes of the merge.
+ *      
+ */
+void DataFrameBuilder::MergeAnimals ()
+{
+    // Order the intakes and outcomes of all animals at once, so that the
+    // events of each animal are a contiguous range ordered by date.
+
+    // Bring the animals up to date with their records first, counted as
+    // part of reading the records.
+
+    Stopwatch stopwatch;
+
+    ResolveAnimals();
+
+    mPhaseTimes.ingest += stopwatch.Lap();
+
+    int numAnimals = mAnimalMap.GetNumAnimals();
+
+    mIntakes.GroupByAnimal(numAnimals);
+    mOutcomes.GroupByAnimal(numAnimals);
+
+    const vector<int>& order = mAnimalMap.GetSortedOrder();
+
+    mPhaseTimes.sort += stopwatch.Lap();
+
+    // Merge the animals with new events, in animal ID order.
+
+    mAnimalsToMerge.resize(numAnimals, false);
+    mMergedAnimals.clear();
+
+    for (int i = 0; i < numAnimals; ++i)
+        if (mAnimalsToMerge[order[i]])
+            mMergedAnimals.push_back(order[i]);
+
+    int numMerged = mMergedAnimals.size();
+
+    // Animals are independent of each other, so split the animals to merge
+    // into chunks of consecutive animals and merge the chunks in parallel.
+
+    int numThreads = GetNumWorkerThreads();
+    int numChunks = std::min(numThreads * ChunksPerThread,
+                             (numMerged + MinAnimalsPerChunk - 1) / MinAnimalsPerChunk);
+
+    vector<MergeChunk> chunks(numChunks);
+
+    ParallelFor(numChunks, numThreads, [&] (int chunk)
+    {
+        int begin = (int64_t) numMerged * chunk / numChunks;
+        int end = (int64_t) numMerged * (chunk + 1) / numChunks;
+
+        // For each animal in the chunk, process both ranges of events to
+        // pair-up intake events with subsequent outcome events in order to
+        // create impound events (which are the rows of the impound table).
+
+        for (int i = begin; i < end; ++i)
+            MergeAnimal(mMergedAnimals[i], chunks[chunk]);
+    });
+
+    UpdateMergedRows(chunks, &MergeChunk::impounds, mFirstImpounds, mImpounds);
+    UpdateMergedRows(chunks, &MergeChunk::discrepancies, mFirstDiscrepancies, mDiscrepancies);
+
+    mPhaseTimes.merge += stopwatch.Lap();
+
+    mMergeCounts = MergeCounts();
+
+    for (int chunk = 0; chunk < numChunks; ++chunk)
+        mMergeCounts.Add(chunks[chunk].counts);
+}
+
+
+
+
+/*
+ *  Method: BuildImpoundTable
+ *
+ *      Builds the internal impound table by pairing-up the intake and
+ *      outcome events of the animals with new events, and keeping the
+ *      impound events of the other animals from the last build.
+ *      
+ */
+void DataFrameBuilder::BuildImpoundTable ()
+{
+    MergeAnimals();
+
+    Stopwatch stopwatch;
+    int numAnimals = mAnimalMap.GetNumAnimals();
+    int numThreads = GetNumWorkerThreads();
+    const vector<int>& order = mAnimalMap.GetSortedOrder();
+
+    // The rows of each animal follow those of the previous animal in animal
+    // ID order, which is also the order of the animal table. Allocate the
+    // table once at its final size.
+
+    vector<int>& firstRows = mFirstImpoundRows;
+
+    firstRows.assign(numAnimals + 1, 0);
+
+    for (int i = 0; i < numAnimals; ++i)
+        firstRows[i + 1] = firstRows[i] + mFirstImpounds[order[i] + 1] - mFirstImpounds[order[i]];
+
+    mImpoundTable.Allocate(firstRows[numAnimals]);
+
+    // Copy the fields of the impounds into the table in parallel, over
+    // chunks of consecutive animals.
+
+    int numCopyChunks = std::min(numThreads * ChunksPerThread,
+                                 (numAnimals + MinAnimalsPerChunk - 1) / MinAnimalsPerChunk);
+
+    ParallelFor(numCopyChunks, numThreads, [&] (int chunk)
+    {
+        int begin = (int64_t) numAnimals * chunk / numCopyChunks;
+        int end = (int64_t) numAnimals * (chunk + 1) / numCopyChunks;
+
+        for (int i = begin; i < end; ++i)
+        {
+            int animalIndex = order[i];
+            const Animal& animal = mAnimalMap.GetAnimalAt(animalIndex);
+            int firstIntake = mIntakes.GetFirstRow(animalIndex);
+            int firstOutcome = mOutcomes.GetFirstRow(animalIndex);
+            int row = firstRows[i];
+
+            for (int k = mFirstImpounds[animalIndex]; k < mFirstImpounds[animalIndex + 1]; ++k, ++row)
+            {
+                const MergeChunk::Impound& impound = mImpounds[k];
+                int intakeRow = (impound.intakeRow == NaRow) ? NaRow : firstIntake + impound.intakeRow;
+                int outcomeRow = (impound.outcomeRow == NaRow) ? NaRow : firstOutcome + impound.outcomeRow;
+
+                mImpoundTable.SetRow(row, animal, mIntakes, intakeRow, mOutcomes, outcomeRow);
+            }
+        }
+    });
+
+    BuildDiscrepancyTable();
+
+    mPhaseTimes.fill += stopwatch.Lap();
+
+    mImpoundTable.EncodeFactors(mSymbols, mDictionaries);
+    mDiscrepancyTable.EncodeFactors(mSymbols, mDictionaries);
+
+    mPhaseTimes.encode += stopwatch.Lap();
+
+    // All events are merged now.
+
+    mAnimalsToMerge.assign(numAnimals, false);
+}
+
+
+
+
+/*
+ *  Method: UpdateMergedRows
+ *
+ *      Replaces the kept rows (impounds or discrepancies) of the animals
+ *      just merged with those of the merge chunks. The event rows of the
+ *      kept rows are made relative to the first event rows of their animals.
+ *      
+ */
+template <class Row>
+void DataFrameBuilder::UpdateMergedRows (const vector<MergeChunk>& chunks, vector<Row> MergeChunk::* merged,
+                                         vector<int>& firstRows, vector<Row>& rows) const
+{
+    int numAnimals = mAnimalMap.GetNumAnimals();
+
+    // Animals added since the last build have no kept rows.
+
+    firstRows.resize(numAnimals + 1, firstRows.back());
+
+    // Count the rows of each animal, kept or just merged.
+
+    vector<int> newFirstRows(numAnimals + 1, 0);
+
+    for (int a = 0; a < numAnimals; ++a)
+        if (!mAnimalsToMerge[a])
+            newFirstRows[a + 1] = firstRows[a + 1] - firstRows[a];
+
+    for (size_t chunk = 0; chunk < chunks.size(); ++chunk)
+        for (size_t i = 0; i < (chunks[chunk].*merged).size(); ++i)
+            ++newFirstRows[(chunks[chunk].*merged)[i].animalIndex + 1];
+
+    for (int a = 0; a < numAnimals; ++a)
+        newFirstRows[a + 1] += newFirstRows[a];
+
+    // Copy the kept rows, then add the merged ones.
+
+    vector<Row> newRows(newFirstRows[numAnimals]);
+
+    for (int a = 0; a < numAnimals; ++a)
+        if (!mAnimalsToMerge[a])
+            std::copy(rows.begin() + firstRows[a], rows.begin() + firstRows[a + 1],
+                      newRows.begin() + newFirstRows[a]);
+
+    vector<int> nextRows(newFirstRows.begin(), newFirstRows.end() - 1);
+
+    for (size_t chunk = 0; chunk < chunks.size(); ++chunk)
+    {
+        const vector<Row>& mergedRows = chunks[chunk].*merged;
+
+        for (size_t i = 0; i < mergedRows.size(); ++i)
+        {
+            Row row = mergedRows[i];
+            int animalIndex = row.animalIndex;
+
+            if (row.intakeRow != NaRow)
+                row.intakeRow -= mIntakes.GetFirstRow(animalIndex);
+
+            if (row.outcomeRow != NaRow)
+                row.outcomeRow -= mOutcomes.GetFirstRow(animalIndex);
+
+            newRows[nextRows[animalIndex]++] = row;
+        }
+    }
+
+    firstRows.swap(newFirstRows);
+    rows.swap(newRows);
+}
+
+
+
+
+/*
+ *  Method: BuildDiscrepancyTable
+ *
+ *      Builds the internal discrepancy table from the kept discrepancies of
+ *      all animals, in animal ID order, or empties it when discrepancies are
+ *      not collected.
+ *      
+ */
+void DataFrameBuilder::BuildDiscrepancyTable ()
+{
+    int numAnimals = mAnimalMap.GetNumAnimals();
+
+    // The discrepancies of animals merged without collecting them would be
+    // missing, so drop all of them rather than keep only some.
+
+    if (!mCollectDiscrepancies)
+    {
+        mFirstDiscrepancies.assign(numAnimals + 1, 0);
+        mDiscrepancies.clear();
+    }
+
+    const vector<int>& order = mAnimalMap.GetSortedOrder();
+
+    mDiscrepancyTable.Allocate(mDiscrepancies.size());
+
+    int row = 0;
+
+    for (int i = 0; i < numAnimals; ++i)
+    {
+        int animalIndex = order[i];
+        const Animal& animal = mAnimalMap.GetAnimalAt(animalIndex);
+        int firstIntake = mIntakes.GetFirstRow(animalIndex);
+        int firstOutcome = mOutcomes.GetFirstRow(animalIndex);
+
+        for (int k = mFirstDiscrepancies[animalIndex]; k < mFirstDiscrepancies[animalIndex + 1]; ++k, ++row)
+        {
+            const MergeChunk::Discrepancy& discrepancy = mDiscrepancies[k];
+            double intakeDate = (discrepancy.intakeRow == NaRow)
+                                ? NA_REAL : mIntakes.GetIntakeDate(firstIntake + discrepancy.intakeRow);
+            double outcomeDate = (discrepancy.outcomeRow == NaRow)
+                                 ? NA_REAL : mOutcomes.GetOutcomeDate(firstOutcome + discrepancy.outcomeRow);
+
+            mDiscrepancyTable.SetRow(row, animal, discrepancy.discrepancy, intakeDate, outcomeDate);
+        }
+    }
+}
+
+
+
+
+/*
+ *  Method: BufferRecord
+ *
+ *      Buffers an ingested record, with its events from the scratch stores,
+ *      and spills the buffer once it outgrows the memory budget.
+ *      
+ */
+void DataFrameBuilder::BufferRecord (SEXP animalId, const AnimalRecord& record, int intakeRow, int outcomeRow)
+{
+    SpilledRecord spilled(record);
+
+    spilled.animalId = mSymbols.Intern(animalId);
+    spilled.events.hasIntake = (intakeRow != NaRow);
+    spilled.events.hasOutcome = (outcomeRow != NaRow);
+
+    if (spilled.events.hasIntake)
+        spilled.events.intake = mSpillIntakes.GetRow(intakeRow);
+
+    if (spilled.events.hasOutcome)
+        spilled.events.outcome = mSpillOutcomes.GetRow(outcomeRow);
+
+    mSpillIntakes.Clear();
+    mSpillOutcomes.Clear();
+
+    mSpillBuffer.push_back(spilled);
+
+    if ((double) mSpillBuffer.size() * sizeof(SpilledRecord) >= mMemoryBudget)
+        SpillBuffer();
+}
+
+
+
+
+/*
+ *  Method: SpillBuffer
+ *
+ *      Appends the buffered records to the runs of their partitions, and
+ *      empties the buffer. The runs are created by the first spill.
+ *      
+ */
+void DataFrameBuilder::SpillBuffer ()
+{
+    if (mSpillRuns.empty())
+    {
+        // The records of an update are merged with the animals in memory,
+        // so cannot be spilled.
+
+        if (mAnimalMap.GetNumAnimals() > 0)
+            throw string("Cannot update tables with more records than the memory budget holds");
+
+        for (int p = 0; p < NumSpillPartitions; ++p)
+            mSpillRuns.push_back(unique_ptr<SpillRun>(new SpillRun(mSpillDirectory)));
+    }
+
+    for (size_t i = 0; i < mSpillBuffer.size(); ++i)
+        mSpillRuns[GetSpillPartition(mSpillBuffer[i].animalId, 0)]->Write(mSpillBuffer[i]);
+
+    mNumSpilledRecords += mSpillBuffer.size();
+    mSpillBuffer.clear();
+}
+
+
+
+
+/*
+ *  Method: GetSpillPartition
+ *
+ *      Returns the partition of an animal ID at a level of splitting: the
+ *      next bits of the hash of the ID, from the most significant. The
+ *      animal map probes by the least significant bits, which stay spread
+ *      out within a partition.
+ *      
+ */
+int DataFrameBuilder::GetSpillPartition (Symbol animalId, int level) const
+{
+    const string& id = mSymbols.GetString(animalId);
+    size_t hash = HashString(id.data(), id.size());
+    int shift = sizeof hash * CHAR_BIT - SpillPartitionBits * (level + 1);
+
+    return (hash >> shift) & (NumSpillPartitions - 1);
+}
+
+
+
+
+/*
+ *  Method: ReplayRecord
+ *
+ *      Adds a buffered or spilled record to the animals and stores, as if
+ *      it were ingested now.
+ *      
+ */
+void DataFrameBuilder::ReplayRecord (const SpilledRecord& spilled)
+{
+    bool added = false;
+    int animalIndex = mAnimalMap.FindOrAdd(mSymbols.GetString(spilled.animalId), added);
+
+    UpdateAnimal(animalIndex, added, spilled.animalId, spilled.record, spilled.events.hasIntake);
+
+    if (spilled.events.hasIntake)
+        mIntakes.AddRow(animalIndex, spilled.events.intake);
+
+    if (spilled.events.hasOutcome)
+        mOutcomes.AddRow(animalIndex, spilled.events.outcome);
+}
+
+
+
+
+/*
+ *  Method: MergeSpillRun
+ *
+ *      Merges the animals of a run of spilled records, and appends a run of
+ *      the merged animals to the results. A run too large for the memory
+ *      budget is first split by the next level of partitions. The run is
+ *      removed once read.
+ *      
+ */
+void DataFrameBuilder::MergeSpillRun (unique_ptr<SpillRun>& run, int level,
+                                      vector<unique_ptr<SpillRun>>& results, SpillTotals& totals)
+{
+    if (run->GetNumBytes() == 0)
+    {
+        run.reset();
+        return;
+    }
+
+    Stopwatch stopwatch;
+
+    run->Rewind();
+
+    SpilledRecord spilled((AnimalRecord(NA_REAL)));
+
+    if (run->GetNumBytes() > mMemoryBudget && level + 1 < MaxSpillLevels)
+    {
+        vector<unique_ptr<SpillRun>> parts;
+
+        for (int p = 0; p < NumSpillPartitions; ++p)
+            parts.push_back(unique_ptr<SpillRun>(new SpillRun(mSpillDirectory)));
+
+        while (run->Read(spilled))
+            parts[GetSpillPartition(spilled.animalId, level + 1)]->Write(spilled);
+
+        run.reset();
+
+        mPhaseTimes.ingest += stopwatch.Lap();
+
+        for (int p = 0; p < NumSpillPartitions; ++p)
+            MergeSpillRun(parts[p], level + 1, results, totals);
+
+        return;
+    }
+
+    // Records are replayed in the order they were ingested, so that each
+    // animal is updated as it would be in memory.
+
+    while (run->Read(spilled))
+        ReplayRecord(spilled);
+
+    run.reset();
+
+    mPhaseTimes.ingest += stopwatch.Lap();
+
+    MergeAnimals();
+
+    stopwatch.Lap();
+
+    totals.numAnimals += mAnimalMap.GetNumAnimals();
+    totals.numIntakes += mIntakes.GetNumIntakes();
+    totals.numOutcomes += mOutcomes.GetNumOutcomes();
+    totals.numImpounds += mImpounds.size();
+    totals.numDiscrepancies += mCollectDiscrepancies ? mDiscrepancies.size() : 0;
+    totals.counts.Add(mMergeCounts);
+
+    results.push_back(WriteMergedAnimals());
+
+    ResetWorkingState();
+
+    mPhaseTimes.fill += stopwatch.Lap();
+}
+
+
+
+
+/*
+ *  Method: WriteMergedAnimals
+ *
+ *      Writes the merged animals to a new run in animal ID order, each
+ *      followed by the events of its impounds and by its discrepancies,
+ *      and returns the run rewound for reading.
+ *      
+ */
+unique_ptr<SpillRun> DataFrameBuilder::WriteMergedAnimals () const
+{
+    unique_ptr<SpillRun> run(new SpillRun(mSpillDirectory));
+    const vector<int>& order = mAnimalMap.GetSortedOrder();
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        int animalIndex = order[i];
+        int firstIntake = mIntakes.GetFirstRow(animalIndex);
+        int firstOutcome = mOutcomes.GetFirstRow(animalIndex);
+
+        SpilledAnimal spilled;
+
+        spilled.animal = mAnimalMap.GetAnimalAt(animalIndex);
+        spilled.numImpounds = mFirstImpounds[animalIndex + 1] - mFirstImpounds[animalIndex];
+        spilled.numDiscrepancies = mCollectDiscrepancies
+                                   ? mFirstDiscrepancies[animalIndex + 1] - mFirstDiscrepancies[animalIndex] : 0;
+
+        run->Write(spilled);
+
+        for (int k = mFirstImpounds[animalIndex]; k < mFirstImpounds[animalIndex + 1]; ++k)
+        {
+            const MergeChunk::Impound& impound = mImpounds[k];
+            SpilledEvents events = SpilledEvents();
+
+            events.hasIntake = (impound.intakeRow != NaRow);
+            events.hasOutcome = (impound.outcomeRow != NaRow);
+
+            if (events.hasIntake)
+                events.intake = mIntakes.GetRow(firstIntake + impound.intakeRow);
+
+            if (events.hasOutcome)
+                events.outcome = mOutcomes.GetRow(firstOutcome + impound.outcomeRow);
+
+            run->Write(events);
+        }
+
+        for (int k = 0; k < spilled.numDiscrepancies; ++k)
+        {
+            const MergeChunk::Discrepancy& discrepancy = mDiscrepancies[mFirstDiscrepancies[animalIndex] + k];
+            SpilledDiscrepancy discarded = SpilledDiscrepancy();
+
+            discarded.discrepancy = discrepancy.discrepancy;
+            discarded.intakeDate = (discrepancy.intakeRow == NaRow)
+                                   ? NA_REAL : mIntakes.GetIntakeDate(firstIntake + discrepancy.intakeRow);
+            discarded.outcomeDate = (discrepancy.outcomeRow == NaRow)
+                                    ? NA_REAL : mOutcomes.GetOutcomeDate(firstOutcome + discrepancy.outcomeRow);
+
+            run->Write(discarded);
+        }
+    }
+
+    run->Rewind();
+
+    return run;
+}
+
+
+
+
+/*
+ *  Method: FinishSpilledTables
+ *
+ *      Builds the tables from spilled records: spills the records still
+ *      buffered, merges each partition on its own, and fills the tables
+ *      from the merged partitions in animal ID order.
+ *      
+ */
+void DataFrameBuilder::FinishSpilledTables ()
+{
+    Stopwatch stopwatch;
+
+    SpillBuffer();
+
+    vector<SpilledRecord>().swap(mSpillBuffer);
+    mSpillIntakes = IntakeStore();
+    mSpillOutcomes = OutcomeStore();
+
+    mPhaseTimes.ingest += stopwatch.Lap();
+
+    // Merge the partitions one at a time, within the budget.
+
+    vector<unique_ptr<SpillRun>> runs;
+    vector<unique_ptr<SpillRun>> results;
+    SpillTotals totals;
+
+    runs.swap(mSpillRuns);
+
+    for (size_t p = 0; p < runs.size(); ++p)
+        MergeSpillRun(runs[p], 0, results, totals);
+
+    stopwatch.Lap();    // Counted by phase for each partition
+
+    // Fill the tables from the merged animals of all partitions, taking
+    // the animal with the least ID next. The events of an impound are
+    // copied into scratch stores, from which the table copies its fields.
+
+    mAnimalTable.Allocate(totals.numAnimals);
+    mImpoundTable.Allocate(totals.numImpounds);
+    mDiscrepancyTable.Allocate(totals.numDiscrepancies);
+    mFirstImpoundRows.assign(1, 0);
+    mFirstImpoundRows.reserve(totals.numAnimals + 1);
+    mSpilledAnimalIds.clear();
+    mSpilledAnimalIds.reserve(totals.numAnimals);
+
+    vector<SpilledAnimal> heads(results.size());
+    auto isLater = [this, &heads] (int a, int b)
+    {
+        return mSymbols.GetString(heads[a].animal.GetAnimalId()) > mSymbols.GetString(heads[b].animal.GetAnimalId());
+    };
+    std::priority_queue<int, vector<int>, decltype(isLater)> nextRuns(isLater);
+
+    for (size_t r = 0; r < results.size(); ++r)
+        if (results[r]->Read(heads[r]))
+            nextRuns.push(r);
+
+    IntakeStore intakes;
+    OutcomeStore outcomes;
+    int animalRow = 0;
+    int impoundRow = 0;
+    int discrepancyRow = 0;
+
+    while (!nextRuns.empty())
+    {
+        int r = nextRuns.top();
+        SpillRun& run = *results[r];
+        const Animal& animal = heads[r].animal;
+
+        nextRuns.pop();
+
+        mAnimalTable.SetRow(animalRow++, animal);
+        mSpilledAnimalIds.push_back(animal.GetAnimalId());
+
+        intakes.Clear();
+        outcomes.Clear();
+
+        for (int k = 0; k < heads[r].numImpounds; ++k)
+        {
+            SpilledEvents events;
+            run.Read(events);
+
+            int intakeRow = events.hasIntake ? intakes.AddRow(0, events.intake) : NaRow;
+            int outcomeRow = events.hasOutcome ? outcomes.AddRow(0, events.outcome) : NaRow;
+
+            mImpoundTable.SetRow(impoundRow++, animal, intakes, intakeRow, outcomes, outcomeRow);
+        }
+
+        for (int k = 0; k < heads[r].numDiscrepancies; ++k)
+        {
+            SpilledDiscrepancy discarded;
+            run.Read(discarded);
+
+            mDiscrepancyTable.SetRow(discrepancyRow++, animal, discarded.discrepancy,
+                                     discarded.intakeDate, discarded.outcomeDate);
+        }
+
+        mFirstImpoundRows.push_back(impoundRow);
+
+        if (run.Read(heads[r]))
+            nextRuns.push(r);
+        else
+            results[r].reset();
+    }
+
+    mPhaseTimes.fill += stopwatch.Lap();
+
+    mImpoundTable.EncodeFactors(mSymbols, mDictionaries);
+    mDiscrepancyTable.EncodeFactors(mSymbols, mDictionaries);
+
+    mPhaseTimes.encode += stopwatch.Lap();
+    mPhaseTimes.impoundTable = mPhaseTimes.sort + mPhaseTimes.merge + mPhaseTimes.fill + mPhaseTimes.encode;
+
+    mAnimalTable.EncodeFactors(mSymbols, mDictionaries);
+
+    mPhaseTimes.animalTable = stopwatch.Lap();
+    mPhaseTimes.encode += mPhaseTimes.animalTable;
+
+    mMergeCounts = totals.counts;
+    mSpillTotals = totals;
+    mBuiltWithinBudget = true;
+}
+
+
+
+
+/*
+ *  Method: ResetWorkingState
+ *
+ *      Releases the animals, stores, and merged rows of a partition, so
+ *      that the next partition is merged within the memory budget.
+ *      
+ */
+void DataFrameBuilder::ResetWorkingState ()
+{
+    mAnimalMap = AnimalMap();
+    mAnimalUpdates = AnimalUpdateStore();
+    mIntakeRecords = AnimalUpdateStore();
+    mOutcomeRecords = AnimalUpdateStore();
+    mIntakes = IntakeStore();
+    mOutcomes = OutcomeStore();
+    vector<bool>().swap(mAnimalsToMerge);
+    vector<int>().swap(mMergedAnimals);
+    vector<int>(1, 0).swap(mFirstImpounds);
+    vector<MergeChunk::Impound>().swap(mImpounds);
+    vector<int>(1, 0).swap(mFirstDiscrepancies);
+    vector<MergeChunk::Discrepancy>().swap(mDiscrepancies);
+}
+
+
+
+
+/*
+ *  Method: GetChangedAnimalIds
+ *
+ *      Returns the IDs of the animals merged by the last build or update,
+ *      in animal ID order. Only the rows of these animals may differ from
+ *      the tables before the update.
+ *      
+ */
+CharacterVector DataFrameBuilder::GetChangedAnimalIds () const
+{
+    // Tables built by spilling records have all their animals merged.
+
+    if (mBuiltWithinBudget)
+    {
+        int numMerged = mSpilledAnimalIds.size();
+        CharacterVector animalIds(numMerged);
+
+        for (int i = 0; i < numMerged; ++i)
+            animalIds[i] = mSymbols.GetString(mSpilledAnimalIds[i]);
+
+        return animalIds;
+    }
+
+    int numMerged = mMergedAnimals.size();
+    CharacterVector animalIds(numMerged);
+
+    for (int i = 0; i < numMerged; ++i)
+        animalIds[i] = mSymbols.GetString(mAnimalMap.GetAnimalAt(mMergedAnimals[i]).GetAnimalId());
+
+    return animalIds;
+}
+
+
+
+
+/*
+ *  Method: GetAnimalDataFrame
+ *
+ *      Creates an R data frame of the animal table.
+ *      
+ */
+DataFrame DataFrameBuilder::GetAnimalDataFrame () const
+{
+    Stopwatch stopwatch;
+    DataFrame animals = mAnimalTable.GetDataFrame();
+
+    mPhaseTimes.frames += stopwatch.GetSeconds();
+
+    return animals;
+}
+
+
+
+
+/*
+ *  Method: GetImpoundDataFrame
+ *
+ *      Creates an R data frame of the impound table.
+ *      
+ */
+DataFrame DataFrameBuilder::GetImpoundDataFrame () const
+{
+    Stopwatch stopwatch;
+    DataFrame impounds = mImpoundTable.GetDataFrame();
+
+    mPhaseTimes.frames += stopwatch.GetSeconds();
+
+    return impounds;
+}
+
+
+
+
+/*
+ *  Method: GetDiscrepancyDataFrame
+ *
+ *      Creates an R data frame of the discrepancy table.
+ *      
+ */
+DataFrame DataFrameBuilder::GetDiscrepancyDataFrame () const
+{
+    Stopwatch stopwatch;
+    DataFrame discrepancies = mDiscrepancyTable.GetDataFrame();
+
+    mPhaseTimes.frames += stopwatch.GetSeconds();
+
+    return discrepancies;
+}
+
+
+
+
+/*
+ *  Method: GetStats
+ *
+ *      Returns the statistics of the last finish of the tables, as an R
+ *      list of named numeric vectors:
+ *
+ *          times  - Seconds per phase. The impound table phase is the sort,
+ *                   merge, and the impound parts of fill and encode; the
+ *                   data frame phase counts the data frames made so far.
+ *          counts - Numbers of animals, events, impounds, discrepancies,
+ *                   animals merged again, records spilled to disk within
+ *                   a memory budget, and interned strings.
+ *          merge  - Outcomes of pairing up the events of the merged animals.
+ *          bytes  - Bytes allocated by each internal structure and by the
+ *                   columns of the tables.
+ *      
+ */
+List DataFrameBuilder::GetStats () const
+{
+    const PhaseTimes& times = mPhaseTimes;
+
+    NumericVector timeStats = NumericVector::create(Named("ingest") = times.ingest,
+                                                    Named("sort") = times.sort,
+                                                    Named("merge") = times.merge,
+                                                    Named("fill") = times.fill,
+                                                    Named("encode") = times.encode,
+                                                    Named("impound_table") = times.impoundTable,
+                                                    Named("animal_table") = times.animalTable,
+                                                    Named("frames") = times.frames);
+
+    // Tables built by spilling records keep no animals or events once
+    // they are filled, so count those merged.
+
+    bool spilled = mBuiltWithinBudget;
+
+    NumericVector countStats = NumericVector::create(Named("animals") = spilled ? (double) mSpillTotals.numAnimals
+                                                                                : mAnimalMap.GetNumAnimals(),
+                                                     Named("intakes") = spilled ? (double) mSpillTotals.numIntakes
+                                                                                : mIntakes.GetNumIntakes(),
+                                                     Named("outcomes") = spilled ? (double) mSpillTotals.numOutcomes
+                                                                                 : mOutcomes.GetNumOutcomes(),
+                                                     Named("impounds") = mImpoundTable.GetNumRows(),
+                                                     Named("discrepancies") = mDiscrepancyTable.GetNumRows(),
+                                                     Named("merged_animals") = spilled ? (double) mSpilledAnimalIds.size()
+                                                                                       : (double) mMergedAnimals.size(),
+                                                     Named("spilled_records") = (double) mNumSpilledRecords,
+                                                     Named("symbols") = mSymbols.GetNumSymbols());
+
+    const MergeCounts& counts = mMergeCounts;
+
+    NumericVector mergeStats = NumericVector::create(Named("paired") = (double) counts.paired,
+                                                     Named("solitary_intakes") = (double) counts.solitaryIntakes,
+                                                     Named("solitary_outcomes") = (double) counts.solitaryOutcomes,
+                                                     Named("out_of_order_outcomes") = (double) counts.outOfOrderOutcomes,
+                                                     Named("extra_outcomes") = (double) counts.extraOutcomes,
+                                                     Named("unmatched_intakes") = (double) counts.unmatchedIntakes);
+
+    // The merge state is the kept impounds and discrepancies and their indexes.
+
+    double symbolBytes = mSymbols.GetNumBytes();
+    double dictionaryBytes = mDictionaries.GetNumBytes();
+    double intakeBytes = mIntakes.GetNumBytes();
+    double outcomeBytes = mOutcomes.GetNumBytes();
+    double animalBytes = mAnimalMap.GetNumBytes() + mAnimalUpdates.GetNumBytes() +
+                         mIntakeRecords.GetNumBytes() + mOutcomeRecords.GetNumBytes();
+    double mergeBytes = GetVectorBytes(mImpounds) + GetVectorBytes(mFirstImpounds) +
+                        GetVectorBytes(mDiscrepancies) + GetVectorBytes(mFirstDiscrepancies) +
+                        GetVectorBytes(mMergedAnimals) + GetVectorBytes(mFirstImpoundRows) +
+                        mAnimalsToMerge.capacity() / CHAR_BIT + GetVectorBytes(mSpillBuffer) +
+                        GetVectorBytes(mSpilledAnimalIds);
+    double tableBytes = mAnimalTable.GetNumBytes() + mImpoundTable.GetNumBytes() +
+                        mDiscrepancyTable.GetNumBytes();
+
+    NumericVector byteStats = NumericVector::create(Named("symbols") = symbolBytes,
+                                                    Named("dictionaries") = dictionaryBytes,
+                                                    Named("intakes") = intakeBytes,
+                                                    Named("outcomes") = outcomeBytes,
+                                                    Named("animals") = animalBytes,
+                                                    Named("merge") = mergeBytes,
+                                                    Named("tables") = tableBytes,
+                                                    Named("total") = symbolBytes + dictionaryBytes + intakeBytes +
+                                                                     outcomeBytes + animalBytes + mergeBytes +
+                                                                     tableBytes);
+
+    return List::create(Named("times") = timeStats,
+                        Named("counts") = countStats,
+                        Named("merge") = mergeStats,
+                        Named("bytes") = byteStats);
+}
+
+
+
+
+/*
+ *  Method: SetSkippedColumns
+ *
+ *      Sets the impound columns to leave out of the tables built from now
+ *      on. Skipped columns are not filled in by the merge, and are left out
+ *      of the impound and joined data frames.
+ *      
+ */
+void DataFrameBuilder::SetSkippedColumns (const vector<string>& skipColumns)
+{
+    mSkippedColumns = skipColumns;
+    mImpoundTable.SetSkippedColumns(skipColumns);
+}
+
+
+
+
+/*
+ *  Method: GetJoinedDataFrame
+ *
+ *      Creates an R data frame of the impound table joined with the animal
+ *      table on animal ID: the impound columns followed by the other animal
+ *      columns, in impound table order.
+ *
+ *      The impound rows of each animal are contiguous and in animal table
+ *      order, so the animal columns are made by repeating the factor code
+ *      of each animal over its impound rows; no join is needed.
+ *      
+ */
+DataFrame DataFrameBuilder::GetJoinedDataFrame () const
+{
+    Stopwatch stopwatch;
+    vector<string> names;
+    vector<SEXP> columns;
+
+    mImpoundTable.GetColumns(names, columns);
+
+    vector<string> animalNames;
+    vector<SEXP> animalColumns;
+
+    mAnimalTable.GetColumns(animalNames, animalColumns);
+
+    // Allocate the repeated animal columns here, so that the worker threads
+    // only fill them in through their data pointers.
+
+    int numRows = mImpoundTable.GetNumRows();
+    int numAnimals = mAnimalTable.GetNumRows();
+    vector<SEXP> fromColumns;
+    vector<IntegerVector> toColumns;
+
+    for (size_t c = 0; c < animalNames.size(); ++c)
+    {
+        if (std::find(names.begin(), names.end(), animalNames[c]) != names.end() ||
+            std::find(mSkippedColumns.begin(), mSkippedColumns.end(), animalNames[c]) != mSkippedColumns.end())
+            continue;
+
+        IntegerVector column(numRows);
+
+        Rf_setAttrib(column, R_LevelsSymbol, Rf_getAttrib(animalColumns[c], R_LevelsSymbol));
+        Rf_setAttrib(column, R_ClassSymbol, Rf_getAttrib(animalColumns[c], R_ClassSymbol));
+
+        names.push_back(animalNames[c]);
+        columns.push_back(column);
+        fromColumns.push_back(animalColumns[c]);
+        toColumns.push_back(column);
+    }
+
+    vector<const int*> fromValues;
+    vector<int*> toValues;
+
+    for (size_t c = 0; c < toColumns.size(); ++c)
+    {
+        fromValues.push_back(INTEGER(fromColumns[c]));
+        toValues.push_back(toColumns[c].begin());
+    }
+
+    const vector<int>& firstRows = mFirstImpoundRows;
+
+    ParallelFor(toValues.size(), GetNumWorkerThreads(), [&] (int c)
+    {
+        for (int i = 0; i < numAnimals; ++i)
+            std::fill(toValues[c] + firstRows[i], toValues[c] + firstRows[i + 1], fromValues[c][i]);
+    });
+
+    DataFrame joined = MakeDataFrame(names, columns, numRows);
+
+    mPhaseTimes.frames += stopwatch.GetSeconds();
+
+    return joined;
+}
+
+
+
+
+/*
+ *  Method: EmitSolitaryIntake
+ *
+ *      Add an intake event that is not paired with an outcome event to the
+ *      internal impound table.
+ *      
+ *      Presumably this intake event corresponds to an animal that is still
+ *      in the custody of the animal shelter.
+ *      
+ */
+void DataFrameBuilder::EmitSolitaryIntake (int animalIndex, int intakeRow, MergeChunk& chunk) const
+{
+    //Rcout << animalIndex << " intake only" << endl;
+    chunk.Emit(animalIndex, intakeRow, NaRow);
+}
+
+
+
+
+/*
+ *  Method: EmitIntakeOutcome
+ *
+ *      Add a pair of intake and outcome events to the internal impound table.
+ *      
+ */
+void DataFrameBuilder::EmitIntakeOutcome (int animalIndex, int intakeRow, int outcomeRow, MergeChunk& chunk) const
+{
+    //Rcout << animalIndex << " outcome only" << endl;
+    chunk.Emit(animalIndex, intakeRow, outcomeRow);
+}
+
+
+
+
+/*
+ *  Method: EmitSolitaryOutcome
+ *
+ *      Add an outcome event that is not paired with an intake event to the
+ *      internal impound table.
+ *      
+ *      This outcome event ought to correspond to an animal for which the
+ *      intake event is missing from the data set being processed.
+ *      
+ */
+void DataFrameBuilder::EmitSolitaryOutcome (int animalIndex, int outcomeRow, MergeChunk& chunk) const
+{
+    //Rcout << animalIndex << " merged" << endl;
+    chunk.Emit(animalIndex, NaRow, outcomeRow);
+}
+
+
+
+
+/*
+ *  Method: MergeAnimal
+ *
+ *    Add impound records for the paired-up intake and outcome events of
+ *    the specified animal to a merge chunk.
+ *
+ *    Reads only the animal map and the event stores, and so may be called
+ *    for different animals and chunks on different threads at once.
+ *      
+ */
+void DataFrameBuilder::MergeAnimal (int animalIndex, MergeChunk& chunk) const
+{
+    ATXSAC_PROFILE_SCOPE("MergeAnimal");
+
+    // The animal's events are the packed rows [first, end) of each store,
+    // already in date order.
+
+    int firstIntake = mIntakes.GetFirstRow(animalIndex);
+    int endIntake = mIntakes.GetEndRow(animalIndex);
+    int firstOutcome = mOutcomes.GetFirstRow(animalIndex);
+    int endOutcome = mOutcomes.GetEndRow(animalIndex);
+
+    int numIntakes = endIntake - firstIntake;
+    int numIntakesRemaining = numIntakes;
+    int numOutcomesRemaining = endOutcome - firstOutcome;
+    int nextIntake = firstIntake;
+    int nextOutcome = firstOutcome;
+
+    while (numIntakesRemaining > 0)
+    {
+        // Pair each intake with an outcome.
+        // At the end there may be a solitary intake, meaning that the data
+        // set ends with the animal in the custody of the shelter.
+        
+        int intake = nextIntake;
+        
+        if (numOutcomesRemaining == 0)
+        {
+            // Intake(s) remaining but no more outcomes.
+
+            if (numIntakesRemaining > 1)
+            {
+                // Discrepancy: multiple intakes are left over, not just one.
+                // One or more late-date intakes is missing a matching outcome in the data set.
+                
+                chunk.counts.unmatchedIntakes += numIntakesRemaining - 1;
+
+                for (int discarded = nextIntake; discarded < endIntake - 1 && mCollectDiscrepancies; ++discarded)
+                    chunk.Discard(animalIndex, DiscrepancyTable::UnmatchedIntake, discarded, NaRow);
+
+                // Take the most recent intake and discard the other(s).
+                
+                intake = endIntake - 1;
+
+                // The solitary intake is the final event for the animal.
+
+                EmitSolitaryIntake(animalIndex, intake, chunk);
+                numIntakesRemaining = 0;
+                nextIntake = endIntake;
+            }
+            else
+            {
+                // A single intake is left over and not paired with an outcome.
+                // Add an impound record for the intake event.
+                // The solitary intake is the final event for the animal.
+                
+                EmitSolitaryIntake(animalIndex, intake, chunk);
+                --numIntakesRemaining;
+                ++nextIntake;
+            }
+        }
+        else
+        {
+            // Try to pair the next intake event with the next outcome event.
+
+            int outcome = nextOutcome;
+            --numOutcomesRemaining;
+            ++nextOutcome;
+            
+            if (mOutcomes.GetOutcomeDay(outcome) < mIntakes.GetIntakeDay(intake))
+            {
+                if (numIntakesRemaining == numIntakes)
+                {
                     // When the next outcome is on an earlier day than the first intake,
                     // the outcome has to be solitary (i.e., the intake occurred before the
                     // first date in the data set). Emit the outcome by itself as its own
                     // impound event.
                 
-                    EmitSolitaryOutcome(animal, outcome);
+                    EmitSolitaryOutcome(animalIndex, outcome, chunk);
+                }
+                else
+                {
+                    // Discrepancy: Unexpected outcome that is out of time order and
+                    // does not pair with the next intake.
+                    
+                    ++chunk.counts.outOfOrderOutcomes;
+
+                    if (mCollectDiscrepancies)
+                        chunk.Discard(animalIndex, DiscrepancyTable::OutOfOrderOutcome, intake, outcome);
+                }
+            }
+            else
+            {
+                // The next outcome is on the same or a later day than the next
+                // intake. Pair the next intake event with the next outcome event and
+                // emit the corresponding impound event.
+
+                EmitIntakeOutcome(animalIndex, intake, outcome, chunk);
+                --numIntakesRemaining;
+                ++nextIntake;
+            }
+        }
+    }
+    
+    // Discrepancy: Process the outcome event(s) (if any) that are not paired
+    // with an intake.
+    
+    if (numOutcomesRemaining > 0)
+    {
+        if (numIntakes == 0)
+        {
+            // Okay to have left-over outcome event when there are no intake
+            // events in the time period. This means the animal was taken up
+            // prior to the first date in the data set.
+
+            EmitSolitaryOutcome(animalIndex, nextOutcome, chunk);
+        }
+        else
+        {
+            // Discrepancy: Extra outcome events are left over and not paired
+            // with any intake event. Discard all of these extaneous events.
+
+            chunk.counts.extraOutcomes += numOutcomesRemaining;
+
+            for (int discarded = nextOutcome; discarded < endOutcome && mCollectDiscrepancies; ++discarded)
+                chunk.Discard(animalIndex, DiscrepancyTable::ExtraOutcome, endIntake - 1, discarded);
+            //DeepPrint(Rcout, animalIndex);
+        }
+    }
+}
+
+
+
+
+/*** Snapshot ****************************************************************/
+
+// A snapshot file holds a list of data frames. It starts with a fixed
+// header, followed by the data of the columns, each block aligned to eight
+// bytes so that the columns of a mapped file can be read in place, and ends
+// with a directory of the tables and their columns. The directory starts
+// with the key of the snapshot, which identifies the data it was made from.
+
+static const char SnapshotMagic[8] = { 'H', 'M', 'S', 'N', 'A', 'P', 0, 0 };
+static const uint32_t SnapshotFormatVersion = 1;
+static const uint32_t SnapshotByteOrderMark = 0x01020304;
+static const uint32_t SnapshotNaLength = 0xFFFFFFFF;
+
+struct SnapshotHeader
+{
+    char magic[8];              // SnapshotMagic
+    uint32_t formatVersion;     // SnapshotFormatVersion
+    uint32_t byteOrderMark;     // SnapshotByteOrderMark, in the byte order of the writer
+    uint64_t directoryOffset;   // Offset of the directory from the start of the file
+    uint64_t directorySize;     // Number of bytes in the directory
+};
+
+// Attributes of a column kept in a snapshot.
+
+static const char* const SnapshotAttributes[] = { "levels", "class", "tzone" };
+static const int NumSnapshotAttributes = 3;
+
+
+
+
+/*
+ *  Class: SnapshotWriter
+ *
+ *      Writes data frames into a snapshot file.
+ *
+ *      The file is written under a temporary name and renamed when it is
+ *      complete, so a snapshot file is never seen half-written.
+ *      
+ */
+class SnapshotWriter
+{
+public:
+    SnapshotWriter (const string& filePath);
+    ~SnapshotWriter ();
+
+    // Add a data frame of logical, integer, double, and character columns.
+
+    void AddTable (const string& name, const List& table);
+
+    // Write the directory and make the file visible under its name.
+
+    void Commit (const string& key);
+
+private:
+    void WriteColumn (const string& tableName, SEXP column, string& directory);
+    void WriteBytes (const void* bytes, size_t numBytes);
+    void Align ();
+
+    static void PutU32 (string& buffer, uint32_t value);
+    static void PutU64 (string& buffer, uint64_t value);
+    static void PutString (string& buffer, const char* text, size_t length);
+    static void PutCharSxp (string& buffer, SEXP charSxp);
+
+private:
+    string mFilePath;           // Name of the snapshot file
+    string mTempPath;           // Name of the file while it is written
+    std::ofstream mFile;        // Stream of the temporary file
+    uint64_t mOffset;           // Number of bytes written
+    uint32_t mNumTables;        // Number of tables added
+    string mTables;             // Directory entries of the tables added
+    bool mCommitted;            // Whether the file was renamed
+};
+
+
+
+
+/*
+ *  Method: Constructor
+ *
+ *      Creates the temporary file and writes a placeholder for the header.
+ *      
+ */
+SnapshotWriter::SnapshotWriter (const string& filePath)
+              :
+               mFilePath(filePath),
+               mTempPath(MakeTempFilePath(filePath)),
+               mFile(mTempPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc),
+               mOffset(0),
+               mNumTables(0),
+               mTables(),
+               mCommitted(false)
+{
+    if (!mFile)
+        throw "Cannot create file " + mTempPath;
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof header);
+    WriteBytes(&header, sizeof header);
+}
+
+
+
+
+/*
+ *  Method: Destructor
+ *
+ *      Removes the temporary file of a snapshot that was not committed.
+ *      
+ */
+SnapshotWriter::~SnapshotWriter ()
+{
+    if (!mCommitted)
+    {
+        mFile.close();
+        std::remove(mTempPath.c_str());
+    }
+}
+
+
+
+
+/*
+ *  Method: AddTable
+ *
+ *      Writes the columns of a data frame and adds its directory entry.
+ *      
+ */
+void SnapshotWriter::AddTable (const string& name, const List& table)
+{
+    int numColumns = table.size();
+    SEXP names = Rf_getAttrib(table, R_NamesSymbol);
+    string directory;
+
+    if (TYPEOF(names) != STRSXP)
+        throw "Columns of table " + name + " have no names";
+
+    PutString(directory, name.data(), name.size());
+    PutU64(directory, numColumns > 0 ? Rf_xlength(VECTOR_ELT(table, 0)) : 0);
+    PutU32(directory, numColumns);
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        PutCharSxp(directory, STRING_ELT(names, c));
+        WriteColumn(name, VECTOR_ELT(table, c), directory);
+    }
+
+    mTables += directory;
+    ++mNumTables;
+}
+
+
+
+
+/*
+ *  Method: WriteColumn
+ *
+ *      Writes the data block of a column and adds the column's type, block,
+ *      and attributes to a directory entry.
+ *      
+ */
+void SnapshotWriter::WriteColumn (const string& tableName, SEXP column, string& directory)
+{
+    int type = TYPEOF(column);
+    R_xlen_t length = Rf_xlength(column);
+
+    Align();
+
+    uint64_t offset = mOffset;
+
+    switch (type)
+    {
+        case LGLSXP:
+        case INTSXP:
+            WriteBytes(INTEGER(column), length * sizeof(int));
+            break;
+
+        case REALSXP:
+            WriteBytes(REAL(column), length * sizeof(double));
+            break;
+
+        case STRSXP:
+        {
+            string block;
+
+            for (R_xlen_t i = 0; i < length; ++i)
+                PutCharSxp(block, STRING_ELT(column, i));
+
+            WriteBytes(block.data(), block.size());
+            break;
+        }
+
+        default:
+            throw "Unsupported column type in table " + tableName;
+    }
+
+    PutU32(directory, type);
+    PutU64(directory, offset);
+    PutU64(directory, mOffset - offset);
+
+    // Attributes, each as a name and a character vector.
+
+    string attributes;
+    uint32_t numAttributes = 0;
+
+    for (int a = 0; a < NumSnapshotAttributes; ++a)
+    {
+        SEXP values = Rf_getAttrib(column, Rf_install(SnapshotAttributes[a]));
+
+        if (TYPEOF(values) != STRSXP)
+            continue;
+
+        PutU32(attributes, a);
+        PutU32(attributes, Rf_xlength(values));
+
+        for (R_xlen_t i = 0; i < Rf_xlength(values); ++i)
+            PutCharSxp(attributes, STRING_ELT(values, i));
+
+        ++numAttributes;
+    }
+
+    PutU32(directory, numAttributes);
+    directory += attributes;
+}
+
+
+
+
+/*
+ *  Method: Commit
+ *
+ *      Writes the directory, fills in the header, and renames the file.
+ *      
+ */
+void SnapshotWriter::Commit (const string& key)
+{
+    string directory;
+
+    PutString(directory, key.data(), key.size());
+    PutU32(directory, mNumTables);
+    directory += mTables;
+
+    Align();
+
+    SnapshotHeader header;
+    memcpy(header.magic, SnapshotMagic, sizeof header.magic);
+    header.formatVersion = SnapshotFormatVersion;
+    header.byteOrderMark = SnapshotByteOrderMark;
+    header.directoryOffset = mOffset;
+    header.directorySize = directory.size();
+
+    WriteBytes(directory.data(), directory.size());
+
+    mFile.seekp(0);
+    mFile.write(reinterpret_cast<const char*>(&header), sizeof header);
+    mFile.close();
+
+    if (!mFile)
+        throw "Cannot write file " + mTempPath;
+
+    if (std::rename(mTempPath.c_str(), mFilePath.c_str()) != 0)
+        throw "Cannot rename file " + mTempPath;
+
+    mCommitted = true;
+}
+
+
+
+
+/*
+ *  Method: WriteBytes
+ *
+ *      Appends bytes to the file.
+ *      
+ */
+void SnapshotWriter::WriteBytes (const void* bytes, size_t numBytes)
+{
+    mFile.write(static_cast<const char*>(bytes), numBytes);
+
+    if (!mFile)
+        throw "Cannot write file " + mTempPath;
+
+    mOffset += numBytes;
+}
+
+
+
+
+/*
+ *  Method: Align
+ *
+ *      Pads the file to a multiple of eight bytes.
+ *      
+ */
+void SnapshotWriter::Align ()
+{
+    static const char padding[8] = { 0 };
+
+    if (mOffset % 8 != 0)
+        WriteBytes(padding, 8 - mOffset % 8);
+}
+
+
+
+
+/*
+ *  Method: PutU32, PutU64, PutString, PutCharSxp
+ *
+ *      Append values to a directory (or character data) buffer. A string is
+ *      its length followed by its bytes; NA has the length SnapshotNaLength.
+ *      
+ */
+void SnapshotWriter::PutU32 (string& buffer, uint32_t value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+void SnapshotWriter::PutU64 (string& buffer, uint64_t value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+void SnapshotWriter::PutString (string& buffer, const char* text, size_t length)
+{
+    PutU32(buffer, length);
+    buffer.append(text, length);
+}
+
+void SnapshotWriter::PutCharSxp (string& buffer, SEXP charSxp)
+{
+    if (charSxp == NA_STRING)
+        PutU32(buffer, SnapshotNaLength);
+    else
+        PutString(buffer, CHAR(charSxp), LENGTH(charSxp));
+}
+
+
+
+
+/*
+ *  Class: SnapshotReader
+ *
+ *      Reads the values of a directory (or character data) of a mapped
+ *      snapshot file, checking that each value lies within the file.
+ *      
+ */
+class SnapshotReader
+{
+public:
+    SnapshotReader (const char* data, size_t size)
+                  : mNext(data), mEnd(data + size) {}
+
+    uint32_t GetU32 ()
+    { uint32_t value; memcpy(&value, GetBytes(sizeof value), sizeof value); return value; }
+
+    uint64_t GetU64 ()
+    { uint64_t value; memcpy(&value, GetBytes(sizeof value), sizeof value); return value; }
+
+    string GetString ();
+
+    SEXP GetCharSxp ();
+
+    const char* GetBytes (size_t numBytes);
+
+private:
+    const char* mNext;      // Next byte to read
+    const char* mEnd;       // End of the bytes
+};
+
+
+
+
+/*
+ *  Method: GetBytes
+ *
+ *      Returns the address of the next bytes and skips them, throwing an
+ *      exception if there are not enough bytes left.
+ *      
+ */
+const char* SnapshotReader::GetBytes (size_t numBytes)
+{
+    if ((size_t) (mEnd - mNext) < numBytes)
+        throw string("Corrupt snapshot file");
+
+    const char* bytes = mNext;
+    mNext += numBytes;
+
+    return bytes;
+}
+
+
+
+
+/*
+ *  Method: GetString
+ *
+ *      Reads a string, which must not be NA.
+ *      
+ */
+string SnapshotReader::GetString ()
+{
+    uint32_t length = GetU32();
+
+    if (length == SnapshotNaLength)
+        throw string("Corrupt snapshot file");
+
+    const char* text = GetBytes(length);
+
+    return string(text, length);
+}
+
+
+
+
+/*
+ *  Method: GetCharSxp
+ *
+ *      Reads a string as an R CHARSXP (NA_STRING for NA).
+ *      
+ */
+SEXP SnapshotReader::GetCharSxp ()
+{
+    uint32_t length = GetU32();
+
+    if (length == SnapshotNaLength)
+        return NA_STRING;
+
+    return Rf_mkCharLen(GetBytes(length), length);
+}
+
+
+
+
+#if defined(ATXSAC_HAVE_ALTREP)
+
+/*
+ *  Class: SnapshotColumn
+ *
+ *      Logical, integer, or double column of R served in place from its
+ *      block in a mapped snapshot file.
+ *
+ *      R reads the elements from the mapping (or its pages are never read
+ *      at all, for columns that are not used). The first time R asks for a
+ *      writable pointer, the column is copied into an ordinary vector, and
+ *      from then on it is that copy. A duplicate is an ordinary vector.
+ *
+ *      Each column holds the file, so the mapping lives until the last
+ *      column served from it is materialized or collected.
+ *      
+ */
+class SnapshotColumn
+{
+public:
+    SnapshotColumn (const std::shared_ptr<MappedFile>& file, const char* data, R_xlen_t length);
+
+    // Make an R vector of the specified type (LGLSXP, INTSXP, or REALSXP)
+    // served from the length elements at data.
+
+    static SEXP Make (int type, const std::shared_ptr<MappedFile>& file,
+                      const char* data, R_xlen_t length);
+
+private:
+    static R_altrep_class_t GetClass (int type);
+    static R_altrep_class_t MakeClass (int type);
+    static SnapshotColumn& Get (SEXP x);
+    static size_t GetElementSize (SEXP x);
+    static void* GetVectorData (SEXP vector);
+    static SEXP MakeCopy (SEXP x);
+
+    // ALTREP methods
+
+    static R_xlen_t Length (SEXP x);
+    static Rboolean Inspect (SEXP x, int pre, int deep, int pvec,
+                             void (*inspectSubtree) (SEXP, int, int, int));
+    static SEXP Duplicate (SEXP x, Rboolean deep);
+    static void* Dataptr (SEXP x, Rboolean writeable);
+    static const void* DataptrOrNull (SEXP x);
+
+    template<typename T>
+    static T Elt (SEXP x, R_xlen_t i);
+
+    template<typename T>
+    static R_xlen_t GetRegion (SEXP x, R_xlen_t start, R_xlen_t count, T* buffer);
+
+private:
+    std::shared_ptr<MappedFile> mFile;  // File of the block (none once materialized)
+    const char* mData;                  // First element of the block
+    R_xlen_t mLength;                   // Number of elements
+};
+
+
+
+
+/*
+ *  Method: Constructor
+ *
+ *      Initializes this object to serve the specified block.
+ *      
+ */
+SnapshotColumn::SnapshotColumn (const std::shared_ptr<MappedFile>& file, const char* data,
+                                R_xlen_t length)
+              :
+               mFile(file),
+               mData(data),
+               mLength(length)
+{
+}
+
+
+
+
+/*
+ *  Method: Make
+ *
+ *      Returns a new R vector of the specified type served from the
+ *      specified block, which must be aligned for its elements.
+ *      
+ */
+SEXP SnapshotColumn::Make (int type, const std::shared_ptr<MappedFile>& file,
+                           const char* data, R_xlen_t length)
+{
+    R_altrep_class_t columnClass = GetClass(type);
+    XPtr<SnapshotColumn> column(new SnapshotColumn(file, data, length), true);
+
+    return R_new_altrep(columnClass, column, R_NilValue);
+}
+
+
+
+
+/*
+ *  Method: GetClass
+ *
+ *      Returns the ALTREP class of the columns of the specified type,
+ *      registering the classes the first time.
+ *      
+ */
+R_altrep_class_t SnapshotColumn::GetClass (int type)
+{
+    static R_altrep_class_t logicalClass = MakeClass(LGLSXP);
+    static R_altrep_class_t integerClass = MakeClass(INTSXP);
+    static R_altrep_class_t realClass = MakeClass(REALSXP);
+
+    switch (type)
+    {
+        case LGLSXP:
+            return logicalClass;
+
+        case INTSXP:
+            return integerClass;
+
+        case REALSXP:
+            return realClass;
+
+        default:
+            throw string("Corrupt snapshot file");
+    }
+}
+
+
+
+
+/*
+ *  Method: MakeClass
+ *
+ *      Registers the ALTREP class of the columns of the specified type.
+ *      
+ */
+R_altrep_class_t SnapshotColumn::MakeClass (int type)
+{
+    R_altrep_class_t columnClass;
+
+    switch (type)
+    {
+        case LGLSXP:
+            columnClass = R_make_altlogical_class("hm_snapshot_logical", "AtxSacToolkit", nullptr);
+            R_set_altlogical_Elt_method(columnClass, Elt<int>);
+            R_set_altlogical_Get_region_method(columnClass, GetRegion<int>);
+            break;
+
+        case INTSXP:
+            columnClass = R_make_altinteger_class("hm_snapshot_integer", "AtxSacToolkit", nullptr);
+            R_set_altinteger_Elt_method(columnClass, Elt<int>);
+            R_set_altinteger_Get_region_method(columnClass, GetRegion<int>);
+            break;
+
+        default:
+            columnClass = R_make_altreal_class("hm_snapshot_real", "AtxSacToolkit", nullptr);
+            R_set_altreal_Elt_method(columnClass, Elt<double>);
+            R_set_altreal_Get_region_method(columnClass, GetRegion<double>);
+            break;
+    }
+
+    // Without a serialized state, R serializes a column as an ordinary
+    // vector, which any session can read back.
+
+    R_set_altrep_Length_method(columnClass, Length);
+    R_set_altrep_Inspect_method(columnClass, Inspect);
+    R_set_altrep_Duplicate_method(columnClass, Duplicate);
+    R_set_altvec_Dataptr_method(columnClass, Dataptr);
+    R_set_altvec_Dataptr_or_null_method(columnClass, DataptrOrNull);
+
+    return columnClass;
+}
+
+
+
+
+/*
+ *  Method: Get
+ *
+ *      Returns the block of a column.
+ *      
+ */
+SnapshotColumn& SnapshotColumn::Get (SEXP x)
+{
+    return *static_cast<SnapshotColumn*>(R_ExternalPtrAddr(R_altrep_data1(x)));
+}
+
+
+
+
+/*
+ *  Method: GetElementSize
+ *
+ *      Returns the number of bytes of an element of a column.
+ *      
+ */
+size_t SnapshotColumn::GetElementSize (SEXP x)
+{
+    return (TYPEOF(x) == REALSXP) ? sizeof(double) : sizeof(int);
+}
+
+
+
+
+/*
+ *  Method: GetVectorData
+ *
+ *      Returns the elements of an ordinary logical, integer, or double
+ *      vector.
+ *      
+ */
+void* SnapshotColumn::GetVectorData (SEXP vector)
+{
+    switch (TYPEOF(vector))
+    {
+        case LGLSXP:
+            return LOGICAL(vector);
+
+        case INTSXP:
+            return INTEGER(vector);
+
+        default:
+            return REAL(vector);
+    }
+}
+
+
+
+
+/*
+ *  Method: MakeCopy
+ *
+ *      Returns a new ordinary vector of the elements of a column.
+ *      
+ */
+SEXP SnapshotColumn::MakeCopy (SEXP x)
+{
+    R_xlen_t length = Length(x);
+    SEXP copy = Rf_allocVector(TYPEOF(x), length);
+
+    if (length > 0)
+        memcpy(GetVectorData(copy), DataptrOrNull(x), length * GetElementSize(x));
+
+    return copy;
+}
+
+
+
+
+/*
+ *  Method: Length
+ *
+ *      Returns the number of elements of a column.
+ *      
+ */
+R_xlen_t SnapshotColumn::Length (SEXP x)
+{
+    return Get(x).mLength;
+}
+
+
+
+
+/*
+ *  Method: Inspect
+ *
+ *      Prints whether a column is still served from its snapshot file, for
+ *      .Internal(inspect()).
+ *      
+ */
+Rboolean SnapshotColumn::Inspect (SEXP x, int, int, int, void (*) (SEXP, int, int, int))
+{
+    bool mapped = R_altrep_data2(x) == R_NilValue;
+
+    Rprintf(" hm snapshot column (%s, %lld elements)\n", mapped ? "mapped" : "materialized",
+            (long long) Length(x));
+
+    return TRUE;
+}
+
+
+
+
+/*
+ *  Method: Duplicate
+ *
+ *      Returns an ordinary copy of a column, copied directly from its block
+ *      rather than by materializing the column first.
+ *      
+ */
+SEXP SnapshotColumn::Duplicate (SEXP x, Rboolean)
+{
+    return MakeCopy(x);
+}
+
+
+
+
+/*
+ *  Method: Dataptr
+ *
+ *      Returns the elements of a column. A writable pointer materializes
+ *      the column, and lets go of the file.
+ *      
+ */
+void* SnapshotColumn::Dataptr (SEXP x, Rboolean writeable)
+{
+    SEXP copy = R_altrep_data2(x);
+
+    if (copy == R_NilValue)
+    {
+        if (!writeable)
+            return const_cast<char*>(Get(x).mData);
+
+        copy = MakeCopy(x);
+        R_set_altrep_data2(x, copy);
+
+        SnapshotColumn& column = Get(x);
+        column.mFile.reset();
+        column.mData = nullptr;
+    }
+
+    return GetVectorData(copy);
+}
+
+
+
+
+/*
+ *  Method: DataptrOrNull
+ *
+ *      Returns the elements of a column for reading, without materializing
+ *      it.
+ *      
+ */
+const void* SnapshotColumn::DataptrOrNull (SEXP x)
+{
+    SEXP copy = R_altrep_data2(x);
+
+    return (copy == R_NilValue) ? Get(x).mData : GetVectorData(copy);
+}
+
+
+
+
+/*
+ *  Method: Elt
+ *
+ *      Returns an element of a column.
+ *      
+ */
+template<typename T>
+T SnapshotColumn::Elt (SEXP x, R_xlen_t i)
+{
+    return static_cast<const T*>(DataptrOrNull(x))[i];
+}
+
+
+
+
+/*
+ *  Method: GetRegion
+ *
+ *      Copies up to count elements of a column, from start, into buffer,
+ *      and returns the number of elements copied.
+ *      
+ */
+template<typename T>
+R_xlen_t SnapshotColumn::GetRegion (SEXP x, R_xlen_t start, R_xlen_t count, T* buffer)
+{
+    R_xlen_t length = Length(x);
+    R_xlen_t numCopied = (start < length) ? std::min(count, length - start) : 0;
+
+    if (numCopied > 0)
+        memcpy(buffer, static_cast<const T*>(DataptrOrNull(x)) + start, numCopied * sizeof(T));
+
+    return numCopied;
+}
+
+#endif
+
+
+
+
+/*
+ *  Function: WriteSnapshotFile
+ *
+ *      Writes a named list of data frames into a snapshot file with the
+ *      specified key.
+ *      
+ */
+static void WriteSnapshotFile (const string& filePath, const string& key, const List& tables)
+{
+    SnapshotWriter writer(filePath);
+    SEXP names = Rf_getAttrib(tables, R_NamesSymbol);
+
+    if (TYPEOF(names) != STRSXP)
+        throw string("Snapshot tables must be named");
+
+    for (int t = 0; t < tables.size(); ++t)
+    {
+        SEXP table = VECTOR_ELT(tables, t);
+
+        if (TYPEOF(table) != VECSXP)
+            throw string("Snapshot tables must be data frames");
+
+        writer.AddTable(string(CHAR(STRING_ELT(names, t))), List(table));
+    }
+
+    writer.Commit(key);
+}
+
+
+
+
+/*
+ *  Function: ReadSnapshotFile
+ *
+ *      Reads the named list of data frames of a snapshot file, leaving out
+ *      the columns named in skipColumns; their data is never read.
+ *
+ *      Where R supports ALTREP, the logical, integer, and double columns
+ *      are served in place from the mapped file (see SnapshotColumn), so
+ *      the pages of a column are read only if it is used.
+ *
+ *      Returns R NULL if the file is not a snapshot of this format version
+ *      and byte order, or if its key is not the specified key.
+ *      
+ */
+static SEXP ReadSnapshotFile (const string& filePath, const string& key,
+                              const vector<string>& skipColumns)
+{
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(filePath);
+    const char* data = file->GetData();
+    size_t size = file->GetSize();
+
+    // A file of another format, version, or byte order is a stale snapshot.
+
+    SnapshotHeader header;
+
+    if (size < sizeof header)
+        return R_NilValue;
+
+    memcpy(&header, data, sizeof header);
+
+    if (memcmp(header.magic, SnapshotMagic, sizeof header.magic) != 0 ||
+        header.formatVersion != SnapshotFormatVersion ||
+        header.byteOrderMark != SnapshotByteOrderMark)
+        return R_NilValue;
+
+    if (header.directoryOffset > size || header.directorySize > size - header.directoryOffset)
+        throw string("Corrupt snapshot file");
+
+    SnapshotReader directory(data + header.directoryOffset, header.directorySize);
+
+    if (directory.GetString() != key)
+        return R_NilValue;
+
+    // Read the tables.
+
+    uint32_t numTables = directory.GetU32();
+    List tables(numTables);
+    CharacterVector tableNames(numTables);
+
+    for (uint32_t t = 0; t < numTables; ++t)
+    {
+        tableNames[t] = directory.GetString();
+
+        uint64_t numRows = directory.GetU64();
+        uint32_t numColumns = directory.GetU32();
+        List columns(numColumns);
+        vector<string> names;
+
+        for (uint32_t c = 0; c < numColumns; ++c)
+        {
+            string name = directory.GetString();
+            int type = directory.GetU32();
+            uint64_t offset = directory.GetU64();
+            uint64_t numBytes = directory.GetU64();
+            bool skip = std::find(skipColumns.begin(), skipColumns.end(), name) != skipColumns.end();
+
+            if (offset > size || numBytes > size - offset)
+                throw string("Corrupt snapshot file");
+
+            // Make the column from its data block, unless it is skipped.
+
+            SEXP column = R_NilValue;
+
+            if (!skip)
+            {
+                size_t elementSize = (type == REALSXP) ? sizeof(double) : sizeof(int);
+
+                if (type != STRSXP && numBytes != numRows * elementSize)
+                    throw string("Corrupt snapshot file");
+
+                // Where R supports it, the other columns are served in place
+                // from the file.
+
+#if defined(ATXSAC_HAVE_ALTREP)
+                bool mapped = (type == LGLSXP || type == INTSXP || type == REALSXP) && numBytes > 0 &&
+                              reinterpret_cast<uintptr_t>(data + offset) % elementSize == 0;
+
+                column = mapped ? SnapshotColumn::Make(type, file, data + offset, numRows) :
+                                  Rf_allocVector(type, numRows);
+#else
+                bool mapped = false;
+
+                column = Rf_allocVector(type, numRows);
+#endif
+                SET_VECTOR_ELT(columns, names.size(), column);
+                names.push_back(name);
+
+                if (type == STRSXP)
+                {
+                    SnapshotReader block(data + offset, numBytes);
+
+                    for (uint64_t i = 0; i < numRows; ++i)
+                        SET_STRING_ELT(column, i, block.GetCharSxp());
                 }
-                else
+                else if (!mapped && numBytes > 0)
                 {
-                    // Discrepancy: Unexpected outcome that is out of time order and
-                    // does not pair with the next intake.
-                    
-                    Warning(animal, "Outcome out of order. Discarded.");
+                    memcpy(type == REALSXP ? (void*) REAL(column) : (void*) INTEGER(column),
+                           data + offset, numBytes);
                 }
             }
+
+            // Attributes follow the block in the directory.
+
+            uint32_t numAttributes = directory.GetU32();
+
+            for (uint32_t a = 0; a < numAttributes; ++a)
+            {
+                uint32_t attribute = directory.GetU32();
+                uint32_t numValues = directory.GetU32();
+
+                if (attribute >= (uint32_t) NumSnapshotAttributes)
+                    throw string("Corrupt snapshot file");
+
+                CharacterVector values(skip ? 0 : numValues);
+
+                for (uint32_t i = 0; i < numValues; ++i)
+                {
+                    SEXP value = directory.GetCharSxp();
+
+                    if (!skip)
+                        SET_STRING_ELT(values, i, value);
+                }
+
+                if (!skip)
+                    Rf_setAttrib(column, Rf_install(SnapshotAttributes[attribute]), values);
+            }
+        }
+
+        // Drop the places of the skipped columns.
+
+        if (names.size() < numColumns)
+        {
+            List keptColumns(names.size());
+
+            for (size_t c = 0; c < names.size(); ++c)
+                SET_VECTOR_ELT(keptColumns, c, VECTOR_ELT(columns, c));
+
+            columns = keptColumns;
+        }
+
+        columns.attr("names") = wrap(names);
+        columns.attr("row.names") = IntegerVector::create(NA_INTEGER, -(int) numRows);
+        columns.attr("class") = "data.frame";
+        SET_VECTOR_ELT(tables, t, columns);
+    }
+
+    tables.attr("names") = tableNames;
+
+    return tables;
+}
+
+
+
+
+/*** ImpoundIntervals ********************************************************/
+
+/*
+ *  Class: ImpoundIntervals
+ *
+ *      Index of the custody intervals of an impound table, for counting
+ *      the animals in custody over time without rescanning the table.
+ *
+ *      Each impound is in custody from its intake date up to, but not
+ *      including, its outcome date; an impound without an outcome is still
+ *      in custody. Impounds without an intake date, or with an outcome
+ *      before the intake, cannot be placed and are left out.
+ *
+ *      Intervals are grouped by the codes of a factor column, with NA as a
+ *      last group when it occurs. Within each group, the intake dates and
+ *      the outcome dates are sorted separately: the number of impounds in
+ *      custody at a time is the number of intakes up to it less the number
+ *      of outcomes up to it, so counts at ascending times are made by one
+ *      sweep of both arrays. Stay lengths are kept by group, unsorted.
+ *      
+ */
+class ImpoundIntervals
+{
+public:
+    // Index the impounds of a data frame with intake and outcome date
+    // columns, grouped by a factor column unless no column is named.
+
+    ImpoundIntervals (const DataFrame& impounds, const string& groupColumn);
+    ~ImpoundIntervals () {}
+
+    // Counts of the impounds in custody during each period between
+    // ascending bounds, by group (group-major).
+
+    vector<int> CountDuring (const vector<double>& bounds) const;
+
+    // Counts of the impounds in custody at each of the times, by group
+    // (group-major).
+
+    vector<int> CountAt (const vector<double>& times) const;
+
+    // Counts of the stays of impounds with an outcome whose length (in
+    // seconds) falls in each bin between ascending breaks, by group
+    // (group-major).
+
+    vector<int> CountStays (const vector<double>& breaks) const;
+
+    // Output group column of a result with the specified number of rows
+    // per group.
+
+    IntegerVector MakeGroupColumn (int numRowsPerGroup) const;
+
+    // Properties
+
+    bool IsGrouped () const
+    { return !mGroupColumn.empty(); }
+
+    int GetNumGroups () const
+    { return mFirstIntervals.size() - 1; }
+
+    const string& GetGroupColumn () const
+    { return mGroupColumn; }
+
+private:
+    string mGroupColumn;            // Name of the grouping factor column, or empty
+    SEXP mGroupLevels;              // Levels of the grouping factor (protected by the input)
+    bool mHasNaGroup;               // Whether the last group is that of NA
+    vector<int> mFirstIntervals;    // First interval of each group, plus the end
+    vector<double> mIntakes;        // Intake dates, by group, ascending within a group
+    vector<double> mOutcomes;       // Outcome dates (infinite when none), by group, ascending
+    vector<double> mStays;          // Stay lengths (seconds, NaN when no outcome), by group
+};
+
+
+
+
+/*
+ *  Method: Constructor
+ *
+ *      Indexes the intervals of the impounds of a data frame, grouped by the
+ *      named factor column unless the name is empty.
+ *      
+ */
+ImpoundIntervals::ImpoundIntervals (const DataFrame& impounds, const string& groupColumn)
+                :
+                 mGroupColumn(groupColumn),
+                 mGroupLevels(R_NilValue),
+                 mHasNaGroup(false)
+{
+    using namespace Col;
+
+    if (!impounds.containsElementNamed(IntakeDate.c_str()) ||
+        !impounds.containsElementNamed(OutcomeDate.c_str()))
+        throw string("Impounds must have intake and outcome date columns");
+
+    SEXP intakeDates = impounds[IntakeDate];
+    SEXP outcomeDates = impounds[OutcomeDate];
+
+    if (TYPEOF(intakeDates) != REALSXP || TYPEOF(outcomeDates) != REALSXP)
+        throw string("Impound intake and outcome dates must be date-times");
+
+    int numRows = LENGTH(intakeDates);
+    const double* intakes = REAL(intakeDates);
+    const double* outcomes = REAL(outcomeDates);
+
+    // Find the group of each row: its factor code less one, or the last
+    // group for NA.
+
+    vector<int> groups(numRows, 0);
+    int numGroups = 1;
+
+    if (!groupColumn.empty())
+    {
+        if (!impounds.containsElementNamed(groupColumn.c_str()))
+            throw "Impounds have no column " + groupColumn;
+
+        SEXP column = impounds[groupColumn];
+
+        if (!Rf_isFactor(column))
+            throw "Impound column " + groupColumn + " is not a factor";
+
+        mGroupLevels = Rf_getAttrib(column, R_LevelsSymbol);
+        numGroups = LENGTH(mGroupLevels);
+
+        const int* codes = INTEGER(column);
+
+        for (int i = 0; i < numRows; ++i)
+        {
+            if (codes[i] == NA_INTEGER)
+                mHasNaGroup = true;
+
+            groups[i] = (codes[i] == NA_INTEGER) ? -1 : codes[i] - 1;
+        }
+
+        if (mHasNaGroup)
+        {
+            for (int i = 0; i < numRows; ++i)
+                if (groups[i] < 0)
+                    groups[i] = numGroups;
+
+            ++numGroups;
+        }
+    }
+
+    // Bucket the placeable intervals by group (a counting sort), then sort
+    // the dates of each group.
+
+    mFirstIntervals.assign(numGroups + 1, 0);
+
+    for (int i = 0; i < numRows; ++i)
+        if (!ISNAN(intakes[i]) && !(outcomes[i] < intakes[i]))
+            ++mFirstIntervals[groups[i] + 1];
+
+    for (int g = 0; g < numGroups; ++g)
+        mFirstIntervals[g + 1] += mFirstIntervals[g];
+
+    mIntakes.resize(mFirstIntervals[numGroups]);
+    mOutcomes.resize(mFirstIntervals[numGroups]);
+    mStays.resize(mFirstIntervals[numGroups]);
+
+    vector<int> next(mFirstIntervals.begin(), mFirstIntervals.end() - 1);
+
+    for (int i = 0; i < numRows; ++i)
+    {
+        if (ISNAN(intakes[i]) || outcomes[i] < intakes[i])
+            continue;
+
+        int k = next[groups[i]]++;
+
+        mIntakes[k] = intakes[i];
+        mOutcomes[k] = ISNAN(outcomes[i]) ? INFINITY : outcomes[i];
+        mStays[k] = outcomes[i] - intakes[i];
+    }
+
+    ParallelFor(numGroups, GetNumWorkerThreads(), [&] (int g)
+    {
+        std::sort(mIntakes.begin() + mFirstIntervals[g], mIntakes.begin() + mFirstIntervals[g + 1]);
+        std::sort(mOutcomes.begin() + mFirstIntervals[g], mOutcomes.begin() + mFirstIntervals[g + 1]);
+    });
+}
+
+
+
+
+/*
+ *  Method: CountDuring
+ *
+ *      Counts the impounds of each group in custody at any time during each
+ *      period [bounds[k], bounds[k + 1]). An impound is in custody during a
+ *      period when its intake is before the end of the period and its
+ *      outcome is after the start; it is counted in every period it spans.
+ *
+ *      Returns the counts of the groups in turn, each for all periods.
+ *      
+ */
+vector<int> ImpoundIntervals::CountDuring (const vector<double>& bounds) const
+{
+    int numPeriods = bounds.size() - 1;
+    if (numPeriods < 1)
+        return vector<int>();
+
+    vector<int> counts(GetNumGroups() * numPeriods);
+
+    ParallelFor(GetNumGroups(), GetNumWorkerThreads(), [&] (int g)
+    {
+        const double* intakeBegin = mIntakes.data() + mFirstIntervals[g];
+        const double* intakeEnd = mIntakes.data() + mFirstIntervals[g + 1];
+        const double* outcomeBegin = mOutcomes.data() + mFirstIntervals[g];
+        const double* outcomeEnd = mOutcomes.data() + mFirstIntervals[g + 1];
+        const double* intake = intakeBegin;
+        const double* outcome = outcomeBegin;
+
+        // Intakes before the end of the period, less outcomes at or before
+        // its start (which are all of impounds taken in before the end).
+
+        for (int k = 0; k < numPeriods; ++k)
+        {
+            while (intake < intakeEnd && *intake < bounds[k + 1])
+                ++intake;
+
+            while (outcome < outcomeEnd && *outcome <= bounds[k])
+                ++outcome;
+
+            counts[g * numPeriods + k] = (intake - intakeBegin) - (outcome - outcomeBegin);
+        }
+    });
+
+    return counts;
+}
+
+
+
+
+/*
+ *  Method: CountAt
+ *
+ *      Counts the impounds of each group in custody at each time: taken in
+ *      at or before the time, with an outcome after it. The times are swept
+ *      in ascending order, whatever their order; NA times have NA counts.
+ *
+ *      Returns the counts of the groups in turn, each for all times.
+ *      
+ */
+vector<int> ImpoundIntervals::CountAt (const vector<double>& times) const
+{
+    int numTimes = times.size();
+    vector<int> counts(GetNumGroups() * numTimes);
+    vector<int> order(numTimes);
+
+    for (int k = 0; k < numTimes; ++k)
+        order[k] = k;
+
+    // NA times sort last, and have NA counts.
+
+    std::sort(order.begin(), order.end(),
+              [&times] (int a, int b) { return times[a] < times[b] || (!ISNAN(times[a]) && ISNAN(times[b])); });
+
+    ParallelFor(GetNumGroups(), GetNumWorkerThreads(), [&] (int g)
+    {
+        const double* intakeBegin = mIntakes.data() + mFirstIntervals[g];
+        const double* intakeEnd = mIntakes.data() + mFirstIntervals[g + 1];
+        const double* outcomeBegin = mOutcomes.data() + mFirstIntervals[g];
+        const double* outcomeEnd = mOutcomes.data() + mFirstIntervals[g + 1];
+        const double* intake = intakeBegin;
+        const double* outcome = outcomeBegin;
+
+        for (int i = 0; i < numTimes; ++i)
+        {
+            int k = order[i];
+
+            if (ISNAN(times[k]))
+            {
+                counts[g * numTimes + k] = NA_INTEGER;
+                continue;
+            }
+
+            while (intake < intakeEnd && *intake <= times[k])
+                ++intake;
+
+            while (outcome < outcomeEnd && *outcome <= times[k])
+                ++outcome;
+
+            counts[g * numTimes + k] = (intake - intakeBegin) - (outcome - outcomeBegin);
+        }
+    });
+
+    return counts;
+}
+
+
+
+
+/*
+ *  Method: CountStays
+ *
+ *      Counts the stays of the impounds of each group with an outcome whose
+ *      length falls in each bin [breaks[k], breaks[k + 1]). Stays outside
+ *      all bins are not counted.
+ *      
+ */
+vector<int> ImpoundIntervals::CountStays (const vector<double>& breaks) const
+{
+    int numBins = breaks.size() - 1;
+    if (numBins < 1)
+        return vector<int>();
+
+    vector<int> counts(GetNumGroups() * numBins, 0);
+
+    ParallelFor(GetNumGroups(), GetNumWorkerThreads(), [&] (int g)
+    {
+        for (int i = mFirstIntervals[g]; i < mFirstIntervals[g + 1]; ++i)
+        {
+            double stay = mStays[i];
+
+            if (ISNAN(stay))
+                continue;
+
+            int bin = std::upper_bound(breaks.begin(), breaks.end(), stay) - breaks.begin() - 1;
+
+            if (bin >= 0 && bin < numBins)
+                ++counts[g * numBins + bin];
+        }
+    });
+
+    return counts;
+}
+
+
+
+
+/*
+ *  Method: MakeGroupColumn
+ *
+ *      Returns the group column of a result holding the specified number
+ *      of rows for each group in turn: a factor with the levels of the
+ *      grouping column, NA for the NA group.
+ *      
+ */
+IntegerVector ImpoundIntervals::MakeGroupColumn (int numRowsPerGroup) const
+{
+    int numGroups = GetNumGroups();
+    IntegerVector column(numGroups * numRowsPerGroup);
+
+    for (int g = 0; g < numGroups; ++g)
+    {
+        int code = (mHasNaGroup && g == numGroups - 1) ? NA_INTEGER : g + 1;
+
+        std::fill(column.begin() + g * numRowsPerGroup, column.begin() + (g + 1) * numRowsPerGroup, code);
+    }
+
+    Rf_setAttrib(column, R_LevelsSymbol, mGroupLevels);
+    Rf_setAttrib(column, R_ClassSymbol, Rf_mkString("factor"));
+
+    return column;
+}
+
+
+
+
+/*
+ *  Function: MakeCountsDataFrame
+ *
+ *      Returns a data frame of counts by group of an interval query: the
+ *      group column (unless not grouped), the specified columns of each
+ *      query row repeated for every group, and the counts.
+ *      
+ */
+static DataFrame MakeCountsDataFrame (const ImpoundIntervals& intervals, const vector<string>& queryNames,
+                                      const vector<NumericVector>& queryColumns, const vector<int>& counts)
+{
+    int numGroups = intervals.GetNumGroups();
+    int numQueryRows = queryColumns.empty() ? 0 : queryColumns[0].size();
+    int numRows = numGroups * numQueryRows;
+
+    vector<string> names;
+    vector<SEXP> columns;
+
+    IntegerVector groupColumn;
+
+    if (intervals.IsGrouped())
+    {
+        groupColumn = intervals.MakeGroupColumn(numQueryRows);
+        names.push_back(intervals.GetGroupColumn());
+        columns.push_back(groupColumn);
+    }
+
+    // Repeat each query column for every group, keeping its attributes
+    // (e.g., the date-time class).
+
+    vector<NumericVector> repeated;
+
+    for (size_t c = 0; c < queryColumns.size(); ++c)
+    {
+        NumericVector column(numRows);
+
+        for (int g = 0; g < numGroups; ++g)
+            std::copy(queryColumns[c].begin(), queryColumns[c].end(), column.begin() + g * numQueryRows);
+
+        Rf_setAttrib(column, R_ClassSymbol, Rf_getAttrib(queryColumns[c], R_ClassSymbol));
+        Rf_setAttrib(column, Rf_install("tzone"), Rf_getAttrib(queryColumns[c], Rf_install("tzone")));
+
+        repeated.push_back(column);
+        names.push_back(queryNames[c]);
+        columns.push_back(column);
+    }
+
+    IntegerVector countColumn(counts.begin(), counts.end());
+
+    names.push_back("count");
+    columns.push_back(countColumn);
+
+    return MakeDataFrame(names, columns, numRows);
+}
+
+
+
+
+/*** Builder handles *********************************************************/
+
+typedef XPtr<DataFrameBuilder> BuilderHandle;
+
+
+
+
+/*
+ *  Function: GetBuilder
+ *
+ *      Returns the builder of an R handle, throwing an exception if the
+ *      handle no longer refers to a builder (e.g., after a save and load).
+ *      
+ */
+static DataFrameBuilder& GetBuilder (SEXP handle)
+{
+    if (TYPEOF(handle) != EXTPTRSXP || R_ExternalPtrAddr(handle) == nullptr)
+        throw string("Invalid builder handle");
+
+    return *BuilderHandle(handle);
+}
+
+
+
+
+/*
+ *  Function: SetFactorDictionaries
+ *
+ *      Sets the factor dictionaries of a builder from an R list of
+ *      character vectors named by column, unless the list is NULL.
+ *      
+ */
+static void SetFactorDictionaries (DataFrameBuilder& builder, SEXP levels)
+{
+    if (levels == R_NilValue)
+        return;
+
+    if (TYPEOF(levels) != VECSXP)
+        throw string("Factor dictionaries must be a list of character vectors");
+
+    builder.SetFactorDictionaries(List(levels));
+}
+
+
+
+
+/*
+ *  Function: SetMemoryBudget
+ *
+ *      Sets the memory budget of a builder, given in megabytes, and the
+ *      directory to spill records to, unless the budget is zero.
+ *      
+ */
+static void SetMemoryBudget (DataFrameBuilder& builder, double memoryBudget, const string& spillDirectory)
+{
+    if (memoryBudget == 0)
+        return;
+
+    if (!(memoryBudget > 0))
+        throw string("Memory budget must be a positive number of megabytes");
+
+    builder.SetMemoryBudget(memoryBudget * 1024 * 1024, spillDirectory);
+}
+
+
+
+
+/*
+ *  Function: MakeTableList
+ *
+ *      Returns an R list of the named tables of a builder: the animal,
+ *      impound and discrepancy data frames, the factor dictionaries
+ *      (levels), the IDs of the changed animals, and the statistics of the
+ *      build. Each element is stored in the list as it is made, so that
+ *      the elements made earlier stay protected.
+ *      
+ */
+static List MakeTableList (const DataFrameBuilder& builder, const vector<string>& names)
+{
+    int numElements = names.size();
+    List tables(numElements);
+    CharacterVector elementNames(numElements);
+
+    for (int i = 0; i < numElements; ++i)
+    {
+        const string& name = names[i];
+
+        if (name == "animal_data")
+            SET_VECTOR_ELT(tables, i, builder.GetAnimalDataFrame());
+        else if (name == "impound_data")
+            SET_VECTOR_ELT(tables, i, builder.GetImpoundDataFrame());
+        else if (name == "discrepancy_data")
+            SET_VECTOR_ELT(tables, i, builder.GetDiscrepancyDataFrame());
+        else if (name == "levels")
+            SET_VECTOR_ELT(tables, i, builder.GetFactorDictionaries());
+        else if (name == "changed_animal_ids")
+            SET_VECTOR_ELT(tables, i, builder.GetChangedAnimalIds());
+        else
+            SET_VECTOR_ELT(tables, i, builder.GetStats());
+
+        elementNames[i] = name;
+    }
+
+    tables.attr("names") = elementNames;
+
+    return tables;
+}
+
+
+
+
+/*
+ *  Function: GetBuiltTables
+ *
+ *      Returns an R list of the tables of a builder, including the
+ *      discrepancy table when discrepancies are collected, the factor
+ *      dictionaries when the tables are encoded against them, and the
+ *      statistics of the build when requested. The statistics are made
+ *      last, so that they include the making of the data frames.
+ *      
+ */
+static List GetBuiltTables (const DataFrameBuilder& builder, bool stats)
+{
+    vector<string> names;
+
+    names.push_back("animal_data");
+    names.push_back("impound_data");
+
+    if (builder.GetCollectDiscrepancies())
+        names.push_back("discrepancy_data");
+
+    if (builder.GetUseFactorDictionaries())
+        names.push_back("levels");
+
+    if (stats)
+        names.push_back("stats");
+
+    return MakeTableList(builder, names);
+}
+
+
+
+
+/*
+ *  Function: GetBuilderTables
+ *
+ *      Returns an R list of the tables of a builder, including the
+ *      discrepancy table and the factor dictionaries when the tables are
+ *      encoded against them, and of the IDs of the animals changed by its
+ *      last build or update.
+ *      
+ */
+static List GetBuilderTables (const DataFrameBuilder& builder)
+{
+    vector<string> names;
+
+    names.push_back("animal_data");
+    names.push_back("impound_data");
+    names.push_back("discrepancy_data");
+
+    if (builder.GetUseFactorDictionaries())
+        names.push_back("levels");
+
+    names.push_back("changed_animal_ids");
+
+    return MakeTableList(builder, names);
+}
+
+
+
+
+/*** Synthetic data **********************************************************/
+
+/*
+ *  Function: MixBits
+ *
+ *      Scrambles the bits of a 64-bit integer (the SplitMix64 finalizer),
+ *      so that consecutive integers hash to unrelated values.
+ *      
+ */
+static inline uint64_t MixBits (uint64_t bits)
+{
+    bits += 0x9E3779B97F4A7C15ULL;
+    bits = (bits ^ (bits >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    bits = (bits ^ (bits >> 27)) * 0x94D049BB133111EBULL;
+
+    return bits ^ (bits >> 31);
+}
+
+
+
+
+/*
+ *  Function: ToUniform
+ *
+ *      Converts random bits to a number uniformly distributed in [0, 1).
+ *      
+ */
+static inline double ToUniform (uint64_t bits)
+{
+    return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+
+
+/*
+ *  Function: MakeSyntheticLevels
+ *
+ *      Makes the levels prefix1, prefix2, ... of a synthetic factor, with
+ *      the numbers zero-padded so that the levels sort in number order.
+ *      
+ */
+static CharacterVector MakeSyntheticLevels (const char* prefix, int numLevels)
+{
+    int width = 1;
+
+    for (int n = numLevels; n >= 10; n /= 10)
+        ++width;
+
+    CharacterVector levels(numLevels);
+    string level(prefix);
+    size_t prefixLength = level.size();
+
+    for (int i = 0; i < numLevels; ++i)
+    {
+        string digits = std::to_string(i + 1);
+
+        level.resize(prefixLength);
+        level.append(width - digits.size(), '0');
+        level += digits;
+        levels[i] = level;
+    }
+
+    return levels;
+}
+
+
+
+
+/*
+ *  Function: GetSyntheticLevels
+ *
+ *      Returns the levels of a synthetic factor column, with as many
+ *      distinct values as the column has in the Austin or Sacramento data.
+ *      
+ */
+static CharacterVector GetSyntheticLevels (const string& column)
+{
+    using namespace Col;
+
+    if (column == Kind)
+        return CharacterVector::create("Bird", "Cat", "Dog", "Livestock", "Other");
+    if (column == Gender)
+        return CharacterVector::create("Female", "Male", "Unknown");
+    if (column == Name)
+        return MakeSyntheticLevels("Name", 20000);
+    if (column == Color1 || column == Color2)
+        return MakeSyntheticLevels("Color", 60);
+    if (column == Breed1 || column == Breed2)
+        return MakeSyntheticLevels("Breed", 400);
+    if (column == Kennel)
+        return MakeSyntheticLevels("Kennel", 300);
+    if (column == SpayNeuter || column == IntakeSpayNeuter || column == OutcomeSpayNeuter)
+        return CharacterVector::create("Intact", "Neutered", "Spayed");
+    if (column == IntakeType)
+        return CharacterVector::create("Euthanasia Request", "Owner Surrender", "Public Assist",
+                                       "Stray", "Wildlife");
+    if (column == IntakeSubType || column == OutcomeSubType)
+        return MakeSyntheticLevels("Subtype", 20);
+    if (column == IntakeCondition || column == OutcomeCondition)
+        return CharacterVector::create("Aged", "Feral", "Injured", "Normal", "Nursing",
+                                       "Pregnant", "Sick");
+    if (column == IntakeLocation)
+        return MakeSyntheticLevels("Location", 100000);
+    if (column == IntakeAgeUnits)
+        return CharacterVector::create("days", "months", "weeks", "years");
+    if (column == OutcomeType)
+        return CharacterVector::create("Adoption", "Died", "Euthanasia", "Return to Owner",
+                                       "Transfer");
+    if (column == RecSource)
+        return CharacterVector::create("CPRA");
+
+    throw "No synthetic values for column " + column;
+}
+
+
+
+
+/*
+ *  Class: SyntheticData
+ *
+ *      Generates synthetic input data frames shaped like the wrangled
+ *      Austin intake and outcome data sets and the Sacramento open-data and
+ *      CPRA impound data sets, to benchmark the builder at any size.
+ *
+ *      Each animal is impounded once, and then again with the re-impound
+ *      rate, in stays that do not overlap. Some outcomes are dated before
+ *      their intakes, stays still open at the end of the period have no
+ *      outcome, and factor cells are missing at random. Rows are in random
+ *      order, as are those of the open-data portals.
+ *
+ *      Every cell is a hash of the seed, its column and its animal or
+ *      impound, so the same arguments make the same frames on every
+ *      platform.
+ *      
+ */
+class SyntheticData
+{
+public:
+    SyntheticData (int numImpounds, double reimpoundRate, double outOfOrderRate,
+                   double naRate, uint64_t seed);
+    ~SyntheticData () {}
+
+    // Input data frames.
+
+    List GetAtxFrames () const;
+    DataFrame GetSacOpenFrame () const;
+    DataFrame GetSacCpraFrame () const;
+
+private:
+    struct Impound
+    {
+        int animal;             // Index of the animal
+        double intakeDate;      // Intake date-time (seconds)
+        double outcomeDate;     // Outcome date-time (seconds), or NA while in custody
+    };
+
+    void MakeImpounds (int numImpounds, double reimpoundRate, double outOfOrderRate);
+    void MakeRowOrders ();
+    double GetNextUniform ();
+    double GetUniform (const string& column, int64_t key) const;
+    int GetCode (const string& column, int64_t key, int numLevels) const;
+
+    DataFrame MakeFrame (const string& frame, const vector<string>& columns,
+                         const vector<int>& rows, const string& timeZone) const;
+    SEXP MakeColumn (const string& frame, const string& column,
+                     const vector<int>& rows, const string& timeZone) const;
+
+private:
+    uint64_t mSeed;                 // Seed of all random draws
+    uint64_t mNumDraws;             // Number of sequential draws so far
+    double mNaRate;                 // Probability that a factor cell is missing
+    int mNumAnimals;                // Number of distinct animals
+    vector<Impound> mImpounds;      // Impounds, grouped by animal
+    vector<int> mIntakeOrder;       // Impounds in the row order of intake records
+    vector<int> mOutcomeOrder;      // Impounds with outcomes, in the row order of outcome records
+};
+
+
+
+
+/*
+ *  Method: Constructor
+ *
+ *      Generates the impounds of a synthetic data set.
+ *      
+ */
+SyntheticData::SyntheticData (int numImpounds, double reimpoundRate, double outOfOrderRate,
+                              double naRate, uint64_t seed)
+             :
+              mSeed(MixBits(seed)),
+              mNumDraws(0),
+              mNaRate(naRate),
+              mNumAnimals(0),
+              mImpounds(),
+              mIntakeOrder(),
+              mOutcomeOrder()
+{
+    if (numImpounds < 0)
+        throw string("The number of impounds must not be negative");
+
+    if (!(reimpoundRate >= 0 && reimpoundRate < 1) || !(outOfOrderRate >= 0 && outOfOrderRate <= 1) ||
+        !(naRate >= 0 && naRate <= 1))
+        throw string("Rates must be between 0 and 1 (and the re-impound rate less than 1)");
+
+    MakeImpounds(numImpounds, reimpoundRate, outOfOrderRate);
+    MakeRowOrders();
+}
+
+
+
+
+/*
+ *  Method: MakeImpounds
+ *
+ *      Generates impounds, animal by animal, over the three fiscal years
+ *      from October 2013, until there are the specified number.
+ *      
+ */
+void SyntheticData::MakeImpounds (int numImpounds, double reimpoundRate, double outOfOrderRate)
+{
+    static const double Day = 86400;
+    static const double PeriodStart = 1380585600;           // 2013-10-01 00:00 UTC
+    static const double PeriodEnd = PeriodStart + 1096 * Day;
+
+    mImpounds.reserve(numImpounds);
+
+    while ((int) mImpounds.size() < numImpounds)
+    {
+        int animal = mNumAnimals++;
+        double intakeDate = PeriodStart + GetNextUniform() * (PeriodEnd - PeriodStart);
+
+        // Stays of up to two months, with one month to a year between them.
+
+        do
+        {
+            Impound impound;
+            impound.animal = animal;
+            impound.intakeDate = std::floor(intakeDate / 60) * 60;
+
+            double outcomeDate = impound.intakeDate + std::floor(GetNextUniform() * 60 * Day / 60) * 60;
+            double nextIntakeDate = outcomeDate + (30 + GetNextUniform() * 335) * Day;
+
+            if (GetNextUniform() < outOfOrderRate)
+                outcomeDate = impound.intakeDate - (1 + std::floor(GetNextUniform() * 10)) * Day;
+
+            impound.outcomeDate = (outcomeDate < PeriodEnd) ? outcomeDate : NA_REAL;
+            mImpounds.push_back(impound);
+
+            intakeDate = nextIntakeDate;
+        }
+        while ((int) mImpounds.size() < numImpounds && intakeDate < PeriodEnd &&
+               GetNextUniform() < reimpoundRate);
+    }
+}
+
+
+
+
+/*
+ *  Method: MakeRowOrders
+ *
+ *      Shuffles the impounds into the row orders of the intake and outcome
+ *      records.
+ *      
+ */
+void SyntheticData::MakeRowOrders ()
+{
+    int numImpounds = mImpounds.size();
+
+    mIntakeOrder.resize(numImpounds);
+
+    for (int i = 0; i < numImpounds; ++i)
+        mIntakeOrder[i] = i;
+
+    for (int i = numImpounds - 1; i > 0; --i)
+        std::swap(mIntakeOrder[i], mIntakeOrder[(int) (GetNextUniform() * (i + 1))]);
+
+    // Outcome records are in an order of their own.
+
+    for (int i = 0; i < numImpounds; ++i)
+        if (!std::isnan(mImpounds[i].outcomeDate))
+            mOutcomeOrder.push_back(i);
+
+    for (int i = (int) mOutcomeOrder.size() - 1; i > 0; --i)
+        std::swap(mOutcomeOrder[i], mOutcomeOrder[(int) (GetNextUniform() * (i + 1))]);
+}
+
+
+
+
+/*
+ *  Method: GetNextUniform
+ *
+ *      Returns the next of the sequential random draws, uniform in [0, 1).
+ *      
+ */
+double SyntheticData::GetNextUniform ()
+{
+    return ToUniform(MixBits(mSeed + ++mNumDraws));
+}
+
+
+
+
+/*
+ *  Method: GetUniform
+ *
+ *      Returns the random draw, uniform in [0, 1), for a key (an animal or
+ *      impound) in a column.
+ *      
+ */
+double SyntheticData::GetUniform (const string& column, int64_t key) const
+{
+    return ToUniform(MixBits(mSeed ^ HashString(column.data(), column.size()) ^ MixBits(key)));
+}
+
+
+
+
+/*
+ *  Method: GetCode
+ *
+ *      Returns the factor code for a key in a column. Lower codes are drawn
+ *      more often, as the common values of the real data sets are.
+ *      
+ */
+int SyntheticData::GetCode (const string& column, int64_t key, int numLevels) const
+{
+    double draw = GetUniform(column, key);
+
+    return 1 + (int) (draw * draw * numLevels);
+}
+
+
+
+
+/*
+ *  Method: GetAtxFrames
+ *
+ *      Returns an R list of the Austin intake and outcome data frames.
+ *      
+ */
+List SyntheticData::GetAtxFrames () const
+{
+    using namespace Col;
+
+    const string intakeColumns[] = { AnimalId, Kind, Gender, Name, Color1, Color2, Breed1, Breed2,
+                                     IntakeDate, IntakeType, IntakeCondition, IntakeLocation,
+                                     IntakeAgeCount, IntakeAgeUnits, IntakeAge, IntakeSpayNeuter };
+    const string outcomeColumns[] = { AnimalId, Kind, Gender, Name, Color1, Color2, Breed1, Breed2,
+                                      OutcomeDate, OutcomeType, OutcomeSubType, OutcomeSpayNeuter };
+
+    DataFrame intake = MakeFrame("intake", vector<string>(std::begin(intakeColumns), std::end(intakeColumns)),
+                                 mIntakeOrder, "America/Chicago");
+    DataFrame outcome = MakeFrame("outcome", vector<string>(std::begin(outcomeColumns), std::end(outcomeColumns)),
+                                  mOutcomeOrder, "America/Chicago");
+
+    return List::create(Named("intake") = intake,
+                        Named("outcome") = outcome);
+}
+
+
+
+
+/*
+ *  Method: GetSacOpenFrame
+ *
+ *      Returns the Sacramento open-data impound data frame.
+ *      
+ */
+DataFrame SyntheticData::GetSacOpenFrame () const
+{
+    using namespace Col;
+
+    const string columns[] = { AnimalId, Kind, Name, IntakeDate, IntakeType, IntakeLocation,
+                               OutcomeDate, OutcomeType };
+
+    return MakeFrame("impound", vector<string>(std::begin(columns), std::end(columns)),
+                     mIntakeOrder, "America/Los_Angeles");
+}
+
+
+
+
+/*
+ *  Method: GetSacCpraFrame
+ *
+ *      Returns the Sacramento CPRA impound data frame.
+ *      
+ */
+DataFrame SyntheticData::GetSacCpraFrame () const
+{
+    using namespace Col;
+
+    const string columns[] = { AnimalId, Kind, Name, Gender, SpayNeuter, Breed1, Breed2, Color1, Color2,
+                               RecSource, IntakeDate, IntakeType, IntakeSubType, IntakeCondition,
+                               IntakeLocation, OutcomeDate, OutcomeType, OutcomeSubType,
+                               OutcomeCondition, Kennel };
+
+    return MakeFrame("impound", vector<string>(std::begin(columns), std::end(columns)),
+                     mIntakeOrder, "America/Los_Angeles");
+}
+
+
+
+
+/*
+ *  Method: MakeFrame
+ *
+ *      Makes a data frame of the specified columns, with a row for each of
+ *      the specified impounds.
+ *      
+ */
+DataFrame SyntheticData::MakeFrame (const string& frame, const vector<string>& columns,
+                                    const vector<int>& rows, const string& timeZone) const
+{
+    int numColumns = columns.size();
+
+    // The list keeps the columns protected while the others are made.
+
+    List columnList(numColumns);
+    vector<SEXP> columnSxps(numColumns);
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        SET_VECTOR_ELT(columnList, c, MakeColumn(frame, columns[c], rows, timeZone));
+        columnSxps[c] = VECTOR_ELT(columnList, c);
+    }
+
+    return MakeDataFrame(columns, columnSxps, rows.size());
+}
+
+
+
+
+/*
+ *  Method: MakeColumn
+ *
+ *      Makes a column of a data frame, with a cell for each of the
+ *      specified impounds. Animal attributes are drawn per animal, so that
+ *      the records of an animal agree, and other cells per impound.
+ *      
+ */
+SEXP SyntheticData::MakeColumn (const string& frame, const string& column,
+                                const vector<int>& rows, const string& timeZone) const
+{
+    using namespace Col;
+
+    int numRows = rows.size();
+
+    if (column == IntakeDate || column == OutcomeDate)
+    {
+        NumericVector dates = MakeDateTimeVector(numRows, FindTimeZoneRules(timeZone));
+
+        for (int i = 0; i < numRows; ++i)
+        {
+            const Impound& impound = mImpounds[rows[i]];
+            dates[i] = (column == IntakeDate) ? impound.intakeDate : impound.outcomeDate;
+        }
+
+        return dates;
+    }
+
+    // Ages agree with their counts and units.
+
+    if (column == IntakeAgeCount || column == IntakeAge)
+    {
+        static const double SecondsPerUnit[] = { 86400, 2629746, 604800, 31556952 };
+
+        IntegerVector counts(numRows);
+        NumericVector ages(numRows);
+
+        for (int i = 0; i < numRows; ++i)
+        {
+            counts[i] = 1 + (int) (GetUniform(IntakeAgeCount, rows[i]) * 15);
+            ages[i] = counts[i] * SecondsPerUnit[GetCode(IntakeAgeUnits, rows[i], 4) - 1];
+        }
+
+        return (column == IntakeAgeCount) ? SEXP(counts) : SEXP(ages);
+    }
+
+    // Every other column is a factor.
+
+    bool isAnimalId = (column == AnimalId);
+    bool isPerAnimal = (column == Kind || column == Gender || column == Name ||
+                        column == Color1 || column == Color2 || column == Breed1 || column == Breed2);
+
+    CharacterVector levels = isAnimalId ? MakeSyntheticLevels("A", mNumAnimals) : GetSyntheticLevels(column);
+    int numLevels = levels.size();
+    string naColumn = frame + "." + column;
+    IntegerVector codes(numRows);
+
+    for (int i = 0; i < numRows; ++i)
+    {
+        int impound = rows[i];
+        int animal = mImpounds[impound].animal;
+
+        if (isAnimalId)
+            codes[i] = animal + 1;
+        else if (GetUniform(naColumn, impound) < mNaRate)
+            codes[i] = NA_INTEGER;
+        else
+            codes[i] = GetCode(column, isPerAnimal ? animal : impound, numLevels);
+    }
+
+    codes.attr("levels") = levels;
+    codes.attr("class") = "factor";
+
+    return codes;
+}
+
+
+
+
+/*** Benchmarks **************************************************************/
+
+/*
+ *  Function: GetPeakMemoryBytes
+ *
+ *      Returns the peak resident memory of the process so far, in bytes,
+ *      or NA where the platform does not report it.
+ *      
+ */
+static double GetPeakMemoryBytes ()
+{
+#if defined(ATXSAC_HAVE_GETRUSAGE)
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return NA_REAL;
+
+#if defined(__APPLE__)
+    return (double) usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024.0;
+#endif
+#else
+    return NA_REAL;
+#endif
+}
+
+
+
+
+/*
+ *  Function: BenchmarkTables
+ *
+ *      Builds the tables of a synthetic data set of the specified kind
+ *      ("atx", "sac_open" or "sac_cpra"), timing each phase of the build.
+ *      Discrepancies are collected, as by the exported builds.
+ *
+ *      Returns the sizes, the seconds per phase, the input records per
+ *      second, and the peak memory of the process, in megabytes.
+ *      
+ */
+static NumericVector BenchmarkTables (const string& kind, const SyntheticData& data)
+{
+    DataFrameBuilder builder;
+    double numRecords;
+
+    if (kind == "atx")
+    {
+        List frames = data.GetAtxFrames();
+        DataFrame intake = frames["intake"];
+        DataFrame outcome = frames["outcome"];
+        numRecords = intake.nrows() + outcome.nrows();
+
+        builder.StartAtxIntakesAndOutcomes();
+        builder.AppendAtxIntakes(intake);
+        builder.AppendAtxOutcomes(outcome);
+    }
+    else if (kind == "sac_open" || kind == "sac_cpra")
+    {
+        DataFrame impound = (kind == "sac_open") ? data.GetSacOpenFrame() : data.GetSacCpraFrame();
+        numRecords = impound.nrows();
+
+        if (kind == "sac_open")
+            builder.StartSacOpenImpounds();
+        else
+            builder.StartSacCpraImpounds();
+
+        builder.AppendSacImpounds(impound);
+    }
+    else
+        throw "Unknown benchmark data set kind " + kind;
+
+    builder.FinishTables();
+
+    DataFrame animals = builder.GetAnimalDataFrame();
+    DataFrame impounds = builder.GetImpoundDataFrame();
+
+    const DataFrameBuilder::PhaseTimes& times = builder.GetPhaseTimes();
+    double totalSeconds = times.ingest + times.impoundTable + times.animalTable + times.frames;
+
+    return NumericVector::create(Named("records") = numRecords,
+                                 Named("animals") = animals.nrows(),
+                                 Named("impounds") = impounds.nrows(),
+                                 Named("ingest") = times.ingest,
+                                 Named("sort") = times.sort,
+                                 Named("merge") = times.merge,
+                                 Named("fill") = times.fill,
+                                 Named("encode") = times.encode,
+                                 Named("frames") = times.frames,
+                                 Named("total") = totalSeconds,
+                                 Named("records_per_sec") = numRecords / totalSeconds,
+                                 Named("peak_memory_mb") = GetPeakMemoryBytes() / (1024 * 1024));
+}
+
+
+
+
+/*** EXPORTS *****************************************************************/
+
+/*
+ *  Method: sacMakeTables
+ *
+ *    Builds normalized Animal and Impound tables from the specified Sacramento
+ *    open-data set.
+ *      
+ *    When factor dictionaries (levels) are given, as a list of character
+ *    vectors named by column such as the levels returned by an earlier
+ *    build, the factors are encoded against them.
+ *
+ *    When a memory budget (in megabytes) is given, records beyond it are
+ *    spilled to temporary files in the spill directory, which is required
+ *    with a budget. The tables are the same, but cannot be updated.
+ *
+ *    Returns an R list containing the two data frames, the table of merge
+ *    discrepancies unless not collected, the factor dictionaries after the
+ *    build when given, and the statistics of the build (see hmBuilderStats)
+ *    when requested.
+ *    
+ */
+// [[Rcpp::export]]
+List sacMakeTables (const DataFrame& impound, bool stats = false, bool discrepancies = true,
+                    SEXP levels = R_NilValue, double memoryBudget = 0,
+                    const std::string& spillDirectory = std::string())
+{
+    try
+    {
+        using namespace Col;
+        DataFrameBuilder builder;
+
+        builder.SetCollectDiscrepancies(discrepancies);
+        SetFactorDictionaries(builder, levels);
+        SetMemoryBudget(builder, memoryBudget, spillDirectory);
+
+        // See if the input data frame has a record-source column.
+        // If so, then the data frame contains CPRA records; otherwise,
+        // the data frame contains open-data records. Open data records
+        // have less information, and hence fewer columns, than CPRA
+        // data records.
+
+        bool cpraRecSource = impound.containsElementNamed(RecSource.c_str());
+    
+        if (cpraRecSource)
+            builder.BuildFromSacCpraImpounds(impound);
+        else
+            builder.BuildFromSacOpenImpounds(impound);
+
+        return GetBuiltTables(builder, stats);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: sacMakeJoinedTable
+ *
+ *    Builds the table of impounds joined with their animals from the
+ *    specified Sacramento data set, leaving out the named impound or animal
+ *    columns. The same as joining the normalized tables on animal_id, but
+ *    without making the normalized tables in R.
+ *
+ *    Returns the joined data frame.
+ *      
+ */
+// [[Rcpp::export]]
+List sacMakeJoinedTable (const DataFrame& impound,
+                         const std::vector<std::string>& skipColumns = std::vector<std::string>())
+{
+    try
+    {
+        using namespace Col;
+        DataFrameBuilder builder;
+
+        builder.SetSkippedColumns(skipColumns);
+        builder.SetCollectDiscrepancies(false);
+
+        if (impound.containsElementNamed(RecSource.c_str()))
+            builder.BuildFromSacCpraImpounds(impound);
+        else
+            builder.BuildFromSacOpenImpounds(impound);
+
+        return builder.GetJoinedDataFrame();
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: atxMakeTables
+ *
+ *    Builds normalized Animal and Impound tables from the specified Austin
+ *    open-data intake and outcome data sets.
+ *    
+ *    When factor dictionaries (levels) are given, as a list of character
+ *    vectors named by column such as the levels returned by an earlier
+ *    build, the factors are encoded against them.
+ *
+ *    When a memory budget (in megabytes) is given, records beyond it are
+ *    spilled to temporary files in the spill directory, which is required
+ *    with a budget. The tables are the same, but cannot be updated.
+ *
+ *    Returns an R list containing the two data frames, the table of merge
+ *    discrepancies unless not collected, the factor dictionaries after the
+ *    build when given, and the statistics of the build (see hmBuilderStats)
+ *    when requested.
+ *      
+ */
+// [[Rcpp::export]]
+List atxMakeTables (const DataFrame& intake, const DataFrame& outcome, bool stats = false,
+                    bool discrepancies = true, SEXP levels = R_NilValue, double memoryBudget = 0,
+                    const std::string& spillDirectory = std::string())
+{
+    try
+    {
+        using namespace Col;
+        DataFrameBuilder builder;
+        
+        builder.SetCollectDiscrepancies(discrepancies);
+        SetFactorDictionaries(builder, levels);
+        SetMemoryBudget(builder, memoryBudget, spillDirectory);
+        builder.BuildFromAtxIntakesAndOutcomes(intake, outcome);
+
+        return GetBuiltTables(builder, stats);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: atxMakeJoinedTable
+ *
+ *    Builds the table of impounds joined with their animals from the
+ *    specified Austin open-data intake and outcome data sets, leaving out
+ *    the named impound or animal columns. The same as joining the
+ *    normalized tables on animal_id, but without making the normalized
+ *    tables in R.
+ *
+ *    Returns the joined data frame.
+ *      
+ */
+// [[Rcpp::export]]
+List atxMakeJoinedTable (const DataFrame& intake, const DataFrame& outcome,
+                         const std::vector<std::string>& skipColumns = std::vector<std::string>())
+{
+    try
+    {
+        DataFrameBuilder builder;
+
+        builder.SetSkippedColumns(skipColumns);
+        builder.SetCollectDiscrepancies(false);
+        builder.BuildFromAtxIntakesAndOutcomes(intake, outcome);
+
+        return builder.GetJoinedDataFrame();
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmMakeCombinedTables
+ *
+ *    Builds normalized Animal and Impound tables from any mix of Austin and
+ *    Sacramento data sets at once. Each element of the list of sources is
+ *    either an Austin data set, as a list of intake and outcome data
+ *    frames, or a Sacramento open-data or CPRA impound data frame. Rows are
+ *    tagged with the source (atx, sac_open or sac_cpra) and city of their
+ *    data set, and the factors of all sources share one set of levels.
+ *
+ *    When factor dictionaries (levels) are given, as a list of character
+ *    vectors named by column such as the levels returned by an earlier
+ *    build, the factors are encoded against them.
+ *
+ *    Returns an R list containing the two data frames, the table of merge
+ *    discrepancies unless not collected, the factor dictionaries after the
+ *    build when given, and the statistics of the build (see hmBuilderStats)
+ *    when requested.
+ *      
+ */
+// [[Rcpp::export]]
+List hmMakeCombinedTables (const List& sources, bool stats = false, bool discrepancies = true,
+                           SEXP levels = R_NilValue)
+{
+    try
+    {
+        DataFrameBuilder builder;
+
+        builder.SetCollectDiscrepancies(discrepancies);
+        SetFactorDictionaries(builder, levels);
+        builder.StartCombined();
+
+        for (int i = 0; i < sources.size(); ++i)
+        {
+            List source = sources[i];
+
+            if (source.containsElementNamed("intake"))
+            {
+                if (!source.containsElementNamed("outcome"))
+                    throw string("Austin source has intakes but no outcomes");
+
+                DataFrame intake = source["intake"];
+                DataFrame outcome = source["outcome"];
+
+                builder.AppendAtxSource(intake, outcome);
+            }
             else
-            {
-                // The next outcome is on the same or a later day than the next
-                // intake. Pair the next intake event with the next outcome event and
-                // emit the corresponding impound event.
+                builder.AppendSacSource(DataFrame(source));
+        }
+
+        builder.FinishTables();
+
+        return GetBuiltTables(builder, stats);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: atxMakeBuilder
+ *
+ *    Builds normalized Animal and Impound tables from the specified Austin
+ *    open-data intake and outcome data sets, keeping the builder so that
+ *    the tables can be updated with further intakes and outcomes.
+ *
+ *    When factor dictionaries (levels) are given, the factors of every
+ *    build and update of the tables are encoded against them.
+ *
+ *    Returns a handle to the builder.
+ *      
+ */
+// [[Rcpp::export]]
+SEXP atxMakeBuilder (const DataFrame& intake, const DataFrame& outcome, SEXP levels = R_NilValue)
+{
+    try
+    {
+        BuilderHandle handle(new DataFrameBuilder(), true);
+
+        SetFactorDictionaries(*handle, levels);
+        handle->BuildFromAtxIntakesAndOutcomes(intake, outcome);
+
+        return handle;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return R_NilValue;
+    }
+}
+
+
+
+
+/*
+ *  Method: atxUpdateTables
+ *
+ *    Adds Austin open-data intakes and outcomes, not seen before, to the
+ *    tables of a builder made by atxMakeBuilder. Only the animals with new
+ *    events are merged again. The tables are those of a full build of all
+ *    the intakes so far, then all the outcomes, each in the order they were
+ *    added (see atxStartTables).
+ *
+ *    Returns an R list containing the updated animal, impound and
+ *    discrepancy data frames, the factor dictionaries when the builder has
+ *    them, and the IDs of the animals whose rows may have changed.
+ *      
+ */
+// [[Rcpp::export]]
+List atxUpdateTables (SEXP builder, const DataFrame& intake, const DataFrame& outcome)
+{
+    try
+    {
+        DataFrameBuilder& tables = GetBuilder(builder);
+
+        tables.UpdateFromAtxIntakesAndOutcomes(intake, outcome);
+
+        return GetBuilderTables(tables);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: sacMakeBuilder
+ *
+ *    Builds normalized Animal and Impound tables from the specified
+ *    Sacramento data set, keeping the builder so that the tables can be
+ *    updated with further impounds.
+ *
+ *    When factor dictionaries (levels) are given, the factors of every
+ *    build and update of the tables are encoded against them.
+ *
+ *    Returns a handle to the builder.
+ *      
+ */
+// [[Rcpp::export]]
+SEXP sacMakeBuilder (const DataFrame& impound, SEXP levels = R_NilValue)
+{
+    try
+    {
+        using namespace Col;
+        BuilderHandle handle(new DataFrameBuilder(), true);
+
+        SetFactorDictionaries(*handle, levels);
+
+        if (impound.containsElementNamed(RecSource.c_str()))
+            handle->BuildFromSacCpraImpounds(impound);
+        else
+            handle->BuildFromSacOpenImpounds(impound);
+
+        return handle;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return R_NilValue;
+    }
+}
+
+
+
+
+/*
+ *  Method: sacUpdateTables
+ *
+ *    Adds Sacramento impounds, not seen before, to the tables of a builder
+ *    made by sacMakeBuilder from the same sort of data set. Only the
+ *    animals with new events are merged again.
+ *
+ *    Returns an R list containing the updated animal, impound and
+ *    discrepancy data frames, the factor dictionaries when the builder has
+ *    them, and the IDs of the animals whose rows may have changed.
+ *      
+ */
+// [[Rcpp::export]]
+List sacUpdateTables (SEXP builder, const DataFrame& impound)
+{
+    try
+    {
+        using namespace Col;
+        DataFrameBuilder& tables = GetBuilder(builder);
+
+        if (impound.containsElementNamed(RecSource.c_str()))
+            tables.UpdateFromSacCpraImpounds(impound);
+        else
+            tables.UpdateFromSacOpenImpounds(impound);
+
+        return GetBuilderTables(tables);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmBuilderTables
+ *
+ *    Returns an R list containing the animal, impound and discrepancy data
+ *    frames of a builder, its factor dictionaries when it has them, and the
+ *    IDs of the animals changed by its last build or update.
+ *      
+ */
+// [[Rcpp::export]]
+List hmBuilderTables (SEXP builder)
+{
+    try
+    {
+        return GetBuilderTables(GetBuilder(builder));
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmBuilderStats
+ *
+ *    Returns the statistics of the last build, update or finish of a
+ *    builder's tables, as an R list of named numeric vectors: times
+ *    (seconds per phase: ingest, sort, merge, fill, encode, impound_table,
+ *    animal_table, and frames for the data frames made since), counts
+ *    (animals, intakes, outcomes, impounds, merged_animals, spilled_records,
+ *    symbols), merge
+ *    (paired, solitary_intakes, solitary_outcomes, out_of_order_outcomes,
+ *    extra_outcomes, unmatched_intakes), and bytes (allocated by symbols,
+ *    factor dictionaries, intakes, outcomes, animals, merge state, tables,
+ *    and total).
+ *      
+ */
+// [[Rcpp::export]]
+List hmBuilderStats (SEXP builder)
+{
+    try
+    {
+        return GetBuilder(builder).GetStats();
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: atxStartTables
+ *
+ *    Starts empty normalized tables, to which chunks of Austin open-data
+ *    intakes and outcomes are appended by atxAppendIntakes and
+ *    atxAppendOutcomes, and which are then built once by hmFinishTables.
+ *
+ *    Chunks of intakes and of outcomes may be interleaved. The tables are
+ *    those of a full build of all the intakes, in the order their chunks
+ *    were appended, followed by all the outcomes, in the order theirs were:
+ *    an animal's kind comes from its first intake (else outcome), and its
+ *    other fields from its later records in that order. So the chunks of
+ *    each must be appended in the order of the full data set.
+ *
+ *    When factor dictionaries (levels) are given, the factors of every
+ *    build and update of the tables are encoded against them.
+ *
+ *    When a memory budget (in megabytes) is given, the records appended
+ *    beyond it are spilled to temporary files in the spill directory, and
+ *    the finished tables cannot be updated.
+ *
+ *    Returns a handle to the builder.
+ *      
+ */
+// [[Rcpp::export]]
+SEXP atxStartTables (SEXP levels = R_NilValue, double memoryBudget = 0,
+                     const std::string& spillDirectory = std::string())
+{
+    try
+    {
+        BuilderHandle handle(new DataFrameBuilder(), true);
+
+        SetFactorDictionaries(*handle, levels);
+        SetMemoryBudget(*handle, memoryBudget, spillDirectory);
+
+        handle->StartAtxIntakesAndOutcomes();
+
+        return handle;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return R_NilValue;
+    }
+}
+
+
+
+
+/*
+ *  Method: atxAppendIntakes
+ *
+ *    Ingests a chunk of Austin open-data intakes into a builder started by
+ *    atxStartTables, without building the tables. The intakes are ordered
+ *    after those of the chunks appended before, and before all outcomes,
+ *    whenever the outcomes were appended (see atxStartTables).
+ *
+ *    Returns TRUE when the chunk was ingested.
+ *      
+ */
+// [[Rcpp::export]]
+bool atxAppendIntakes (SEXP builder, const DataFrame& intake)
+{
+    try
+    {
+        GetBuilder(builder).AppendAtxIntakes(intake);
+
+        return true;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return false;
+    }
+}
+
+
+
+
+/*
+ *  Method: atxAppendOutcomes
+ *
+ *    Ingests a chunk of Austin open-data outcomes into a builder started by
+ *    atxStartTables, without building the tables. The outcomes are ordered
+ *    after those of the chunks appended before, and after all intakes
+ *    (see atxStartTables).
+ *
+ *    Returns TRUE when the chunk was ingested.
+ *      
+ */
+// [[Rcpp::export]]
+bool atxAppendOutcomes (SEXP builder, const DataFrame& outcome)
+{
+    try
+    {
+        GetBuilder(builder).AppendAtxOutcomes(outcome);
+
+        return true;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return false;
+    }
+}
+
+
+
+
+/*
+ *  Method: sacStartTables
+ *
+ *    Starts empty normalized tables, to which chunks of Sacramento impounds
+ *    (CPRA records, or else open-data records) are appended by
+ *    sacAppendImpounds, and which are then built once by hmFinishTables.
+ *
+ *    When factor dictionaries (levels) are given, the factors of every
+ *    build and update of the tables are encoded against them.
+ *
+ *    When a memory budget (in megabytes) is given, the records appended
+ *    beyond it are spilled to temporary files in the spill directory, and
+ *    the finished tables cannot be updated.
+ *
+ *    Returns a handle to the builder.
+ *      
+ */
+// [[Rcpp::export]]
+SEXP sacStartTables (bool cpra = false, SEXP levels = R_NilValue, double memoryBudget = 0,
+                     const std::string& spillDirectory = std::string())
+{
+    try
+    {
+        BuilderHandle handle(new DataFrameBuilder(), true);
+
+        SetFactorDictionaries(*handle, levels);
+        SetMemoryBudget(*handle, memoryBudget, spillDirectory);
+
+        if (cpra)
+            handle->StartSacCpraImpounds();
+        else
+            handle->StartSacOpenImpounds();
+
+        return handle;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return R_NilValue;
+    }
+}
+
+
+
+
+/*
+ *  Method: sacAppendImpounds
+ *
+ *    Ingests a chunk of Sacramento impounds into a builder started by
+ *    sacStartTables, without building the tables.
+ *
+ *    Returns TRUE when the chunk was ingested.
+ *      
+ */
+// [[Rcpp::export]]
+bool sacAppendImpounds (SEXP builder, const DataFrame& impound)
+{
+    try
+    {
+        GetBuilder(builder).AppendSacImpounds(impound);
+
+        return true;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return false;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmFinishTables
+ *
+ *    Builds the tables of a builder from the chunks appended to it. The
+ *    builder may then be updated as one made by atxMakeBuilder or
+ *    sacMakeBuilder, unless it spilled records within a memory budget.
+ *
+ *    Returns an R list containing the animal, impound and discrepancy data
+ *    frames, the factor dictionaries when the builder has them, and the IDs
+ *    of the animals merged.
+ *      
+ */
+// [[Rcpp::export]]
+List hmFinishTables (SEXP builder)
+{
+    try
+    {
+        DataFrameBuilder& tables = GetBuilder(builder);
+
+        tables.FinishTables();
+
+        return GetBuilderTables(tables);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmOccupancy
+ *
+ *    Counts the impounds in custody during each day or hour from one date
+ *    to another, optionally by a factor column of the impounds (e.g., kind,
+ *    for a joined table). Days are those of the specified time zone. An
+ *    impound is counted in every period it spans, and impounds without an
+ *    outcome are still in custody.
+ *
+ *    Returns a data frame of the group (when grouped), the start of each
+ *    period, and the count, grouped then in time order.
+ *      
+ */
+// [[Rcpp::export]]
+List hmOccupancy (const DataFrame& impounds, double from, double to, const std::string& unit = "day",
+                  const std::string& groupColumn = "", const std::string& timeZone = "UTC")
+{
+    try
+    {
+        const TimeZoneRules& zone = FindTimeZoneRules(timeZone);
+
+        if (ISNAN(from) || ISNAN(to) || to < from)
+            throw string("Occupancy needs dates from and to, in order");
+
+        // The periods lie between ascending bounds: local midnights for
+        // days, and whole UTC hours for hours.
+
+        vector<double> bounds;
+
+        if (unit == "day")
+        {
+            int firstDay = zone.GetLocalDay(from);
+            int lastDay = zone.GetLocalDay(to);
+
+            for (int day = firstDay; day <= lastDay + 1; ++day)
+                bounds.push_back(zone.LocalToUtc(day * 86400.0));
+        }
+        else if (unit == "hour")
+        {
+            double firstHour = floor(from / 3600) * 3600;
+
+            for (double hour = firstHour; hour <= to + 3600; hour += 3600)
+                bounds.push_back(hour);
+        }
+        else
+            throw "Unknown occupancy unit " + unit;
+
+        ImpoundIntervals intervals(impounds, groupColumn);
+
+        NumericVector periodStarts = MakeDateTimeVector(bounds.size() - 1, zone);
+        std::copy(bounds.begin(), bounds.end() - 1, periodStarts.begin());
+
+        return MakeCountsDataFrame(intervals, vector<string>(1, "period_start"),
+                                   vector<NumericVector>(1, periodStarts), intervals.CountDuring(bounds));
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmInCustody
+ *
+ *    Counts the impounds in custody at each of the specified times (taken
+ *    in at or before the time, with no outcome until after it), optionally
+ *    by a factor column of the impounds.
+ *
+ *    Returns a data frame of the group (when grouped), the time, and the
+ *    count, grouped then in the order of the times.
+ *      
+ */
+// [[Rcpp::export]]
+List hmInCustody (const DataFrame& impounds, const NumericVector& times, const std::string& groupColumn = "")
+{
+    try
+    {
+        ImpoundIntervals intervals(impounds, groupColumn);
+        vector<double> queryTimes(times.begin(), times.end());
+
+        return MakeCountsDataFrame(intervals, vector<string>(1, "time"),
+                                   vector<NumericVector>(1, times), intervals.CountAt(queryTimes));
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmLengthOfStay
+ *
+ *    Makes the histogram of the lengths of stay, in days, of the impounds
+ *    with an outcome, over bins between ascending breaks, optionally by a
+ *    factor column of the impounds. Stays outside all bins are not counted
+ *    (give an infinite last break to count all long stays).
+ *
+ *    Returns a data frame of the group (when grouped), the bounds of each
+ *    bin in days (stay_from, stay_to), and the count.
+ *      
+ */
+// [[Rcpp::export]]
+List hmLengthOfStay (const DataFrame& impounds, const NumericVector& breaks, const std::string& groupColumn = "")
+{
+    try
+    {
+        int numBins = breaks.size() - 1;
+
+        if (numBins < 1)
+            throw string("Length of stay needs at least two breaks");
+
+        for (int k = 0; k < numBins; ++k)
+            if (!(breaks[k] < breaks[k + 1]))
+                throw string("Length of stay breaks must be ascending");
+
+        ImpoundIntervals intervals(impounds, groupColumn);
+
+        vector<double> breakSeconds(breaks.size());
+        NumericVector stayFrom(numBins);
+        NumericVector stayTo(numBins);
+
+        for (int k = 0; k <= numBins; ++k)
+            breakSeconds[k] = breaks[k] * 86400;
+
+        for (int k = 0; k < numBins; ++k)
+        {
+            stayFrom[k] = breaks[k];
+            stayTo[k] = breaks[k + 1];
+        }
+
+        vector<string> names;
+        vector<NumericVector> columns;
+
+        names.push_back("stay_from");
+        names.push_back("stay_to");
+        columns.push_back(stayFrom);
+        columns.push_back(stayTo);
+
+        return MakeCountsDataFrame(intervals, names, columns, intervals.CountStays(breakSeconds));
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmReadCsv
+ *
+ *    Reads the specified CSV file, such as a cached open-data download,
+ *    into a data frame of character columns. The named date columns are
+ *    parsed, as by hmParseDateTimes, into date-time columns of the
+ *    specified time zone.
+ *
+ *    Returns the data frame, with the column names as in the header line.
+ *      
+ */
+// [[Rcpp::export]]
+List hmReadCsv (const std::string& filePath,
+                const std::vector<std::string>& dateColumns = std::vector<std::string>(),
+                const std::string& timeZone = "UTC")
+{
+    try
+    {
+        return ReadCsvFile(filePath, dateColumns, FindTimeZoneRules(timeZone));
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
 
-                EmitIntakeOutcome(animal, intake, outcome);
-                --numIntakesRemaining;
-                ++nextIntake;
-            }
-        }
+
+
+
+/*
+ *  Method: hmReadCsvChunk
+ *
+ *    Reads a chunk of at most the specified number of records of a CSV
+ *    file, as hmReadCsv does, starting at the specified byte offset. Offset
+ *    zero is the first record after the header line; the offset of the next
+ *    chunk is returned with each chunk.
+ *
+ *    Returns a list of the data frame of the chunk (data) and of the offset
+ *    of the next chunk (next_offset), which is NA after the last chunk.
+ *      
+ */
+// [[Rcpp::export]]
+List hmReadCsvChunk (const std::string& filePath, double offset, int maxRows,
+                     const std::vector<std::string>& dateColumns = std::vector<std::string>(),
+                     const std::string& timeZone = "UTC")
+{
+    try
+    {
+        if (!(offset >= 0) || maxRows < 1)
+            throw string("Invalid CSV chunk offset or size");
+
+        size_t endOffset = 0;
+        List data = ReadCsvFile(filePath, dateColumns, FindTimeZoneRules(timeZone),
+                                (size_t) offset, maxRows, &endOffset);
+
+        // Fewer records than asked for means the end of the file.
+
+        double nextOffset = (DataFrame(data).nrows() < maxRows) ? NA_REAL : (double) endOffset;
+
+        return List::create(Named("data") = data,
+                            Named("next_offset") = nextOffset);
     }
-    
-    // Discrepancy: Process the outcome event(s) (if any) that are not paired
-    // with an intake.
-    
-    if (numOutcomesRemaining > 0)
+    catch (string& message)
     {
-        if (animal->GetNumIntakes() == 0)
-        {
-            // Okay to have left-over outcome event when there are no intake
-            // events in the time period. This means the animal was taken up
-            // prior to the first date in the data set.
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
 
-            OutcomeRef outcome = animal->GetOutcomeAt(nextOutcome);
-            
-            EmitSolitaryOutcome(animal, outcome);
-        }
-        else
+
+
+
+/*
+ *  Method: hmJoinCsvFiles
+ *
+ *    Joins CSV files with the same header line, such as the pages of a
+ *    downloaded data set, into the specified CSV file.
+ *
+ *    Returns TRUE when the joined file was written.
+ *      
+ */
+// [[Rcpp::export]]
+bool hmJoinCsvFiles (const std::vector<std::string>& filePaths, const std::string& toFilePath)
+{
+    try
+    {
+        JoinCsvFiles(filePaths, toFilePath);
+
+        return true;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return false;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmParseDateTimes
+ *
+ *    Converts date-time strings, in the formats emitted by the Austin and
+ *    Sacramento data portals, to date-times of the specified time zone.
+ *    Strings that are not date-times become NA. Each run of repeated strings
+ *    is parsed once.
+ *
+ *    Returns a POSIXct vector.
+ *      
+ */
+// [[Rcpp::export]]
+NumericVector hmParseDateTimes (const CharacterVector& strings, const std::string& timeZone)
+{
+    try
+    {
+        const TimeZoneRules& zone = FindTimeZoneRules(timeZone);
+        int numStrings = strings.size();
+        NumericVector dateTimes = MakeDateTimeVector(numStrings, zone);
+        double* values = dateTimes.begin();
+        SEXP lastCharSxp = NA_STRING;
+        double lastValue = NA_REAL;
+
+        for (int i = 0; i < numStrings; ++i)
         {
-            // Discrepancy: Extra outcome events are left over and not paired
-            // with any intake event. Discard all of these extaneous events.
+            SEXP charSxp = STRING_ELT(strings, i);
+
+            if (charSxp != lastCharSxp)
+            {
+                lastCharSxp = charSxp;
+                lastValue = ParseDateTime(CHAR(charSxp), LENGTH(charSxp), zone);
+            }
 
-            Warning(animal, "Extra outcomes remaining at end.");
-            //animal->DeepPrint(Rcout);
+            values[i] = lastValue;
         }
+
+        return dateTimes;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
     }
 }
 
 
 
 
-/*** EXPORTS *****************************************************************/
+/*
+ *  Method: hmWriteSnapshot
+ *
+ *    Writes a named list of data frames, such as the normalized tables,
+ *    into a snapshot file with the specified key.
+ *
+ *    Returns TRUE when the snapshot was written.
+ *      
+ */
+// [[Rcpp::export]]
+bool hmWriteSnapshot (const std::string& filePath, const std::string& key, const List& tables)
+{
+    try
+    {
+        WriteSnapshotFile(filePath, key, tables);
+
+        return true;
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return false;
+    }
+}
+
+
+
 
 /*
- *  Method: sacMakeTables
+ *  Method: hmReadSnapshot
  *
- *    Builds normalized Animal and Impound tables from the specified Sacramento
- *    open-data set.
+ *    Reads the named list of data frames of a snapshot file, leaving out
+ *    the named columns.
+ *
+ *    Returns NULL when the snapshot is stale (its key is not the specified
+ *    key, or it is of another format version) or cannot be read.
  *      
- *    Returns an R list containing the two data frames.
- *    
  */
 // [[Rcpp::export]]
-List sacMakeTables (const DataFrame& impound)
+SEXP hmReadSnapshot (const std::string& filePath, const std::string& key,
+                     const std::vector<std::string>& skipColumns = std::vector<std::string>())
 {
     try
     {
-        using namespace Col;
-        DataFrameBuilder builder;
+        return ReadSnapshotFile(filePath, key, skipColumns);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return R_NilValue;
+    }
+}
+
 
-        // See if the input data frame has a record-source column.
-        // If so, then the data frame contains CPRA records; otherwise,
-        // the data frame contains open-data records. Open data records
-        // have less information, and hence fewer columns, than CPRA
-        // data records.
 
-        bool cpraRecSource = impound.containsElementNamed(RecSource.c_str());
-    
-        if (cpraRecSource)
-            builder.BuildFromSacCpraImpounds(impound);
-        else
-            builder.BuildFromSacOpenImpounds(impound);
 
-        return List::create(Named("animal_data") = builder.GetAnimalDataFrame(),
-                            Named("impound_data") = builder.GetImpoundDataFrame());
+/*
+ *  Method: hmWrangleColors
+ *
+ *    Splits color/coat strings, such as "Black/White", into primary and
+ *    secondary colors. Each distinct string is split once.
+ *
+ *    Returns a data frame of color_1 and color_2 factor columns.
+ *      
+ */
+// [[Rcpp::export]]
+List hmWrangleColors (const CharacterVector& colors)
+{
+    try
+    {
+        ColorWrangler wrangler;
+
+        return wrangler.Wrangle(colors, Col::Color1, Col::Color2);
     }
     catch (string& message)
     {
@@ -1950,26 +12135,120 @@ List sacMakeTables (const DataFrame& impound)
 
 
 /*
- *  Method: atxMakeTables
+ *  Method: hmWrangleBreeds
  *
- *    Builds normalized Animal and Impound tables from the specified Austin
- *    open-data intake and outcome data sets.
- *    
- *    Returns an R list containing the two data frames.
+ *    Splits breed strings, such as "Beagle Mix", into primary and secondary
+ *    breeds. Each distinct string is split once.
+ *
+ *    Returns a data frame of breed_1 and breed_2 factor columns.
  *      
  */
 // [[Rcpp::export]]
-List atxMakeTables (const DataFrame& intake, const DataFrame& outcome)
+List hmWrangleBreeds (const CharacterVector& breeds)
 {
     try
     {
-        using namespace Col;
-        DataFrameBuilder builder;
-        
-        builder.BuildFromAtxIntakesAndOutcomes(intake, outcome);
+        BreedWrangler wrangler;
+
+        return wrangler.Wrangle(breeds, Col::Breed1, Col::Breed2);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmWrangleAges
+ *
+ *    Parses age strings, such as "2 weeks", into counts, units and
+ *    durations. The seconds in a day, week, month and year are given, in
+ *    that order. Each distinct string is parsed once.
+ *
+ *    Returns a data frame of age_count, age_units (factor) and age
+ *    (seconds) columns.
+ *      
+ */
+// [[Rcpp::export]]
+List hmWrangleAges (const CharacterVector& ages, const NumericVector& secondsPerUnit)
+{
+    try
+    {
+        AgeWrangler wrangler(secondsPerUnit);
+
+        return wrangler.Wrangle(ages);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmNormalizeStrings
+ *
+ *    Normalizes a list of character columns in one pass: trims whitespace
+ *    from both ends of each string, maps blank strings to NA, and folds
+ *    ASCII letters to lower case when requested. Each distinct string of a
+ *    column is normalized once, and the columns are normalized in parallel.
+ *
+ *    Returns the list of normalized character columns.
+ *      
+ */
+// [[Rcpp::export]]
+List hmNormalizeStrings (const List& columns, bool foldCase = false)
+{
+    try
+    {
+        return NormalizeStringColumns(columns, foldCase);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmMakeSyntheticData
+ *
+ *    Generates synthetic input data of the specified kind ("atx",
+ *    "sac_open" or "sac_cpra"), shaped like the wrangled data sets, with
+ *    the specified number of impounds, rate at which animals are impounded
+ *    again, fraction of outcomes dated before their intakes, and fraction
+ *    of missing factor cells.
+ *
+ *    Returns an R list of the intake and outcome data frames (Austin) or of
+ *    the impound data frame (Sacramento).
+ *      
+ */
+// [[Rcpp::export]]
+List hmMakeSyntheticData (const std::string& kind, int numImpounds, double reimpoundRate = 0.25,
+                          double outOfOrderRate = 0.01, double naRate = 0.05, double seed = 1)
+{
+    try
+    {
+        SyntheticData data(numImpounds, reimpoundRate, outOfOrderRate, naRate, (uint64_t) seed);
+
+        if (kind == "atx")
+            return data.GetAtxFrames();
+        if (kind == "sac_open")
+            return List::create(Named("impound") = data.GetSacOpenFrame());
+        if (kind == "sac_cpra")
+            return List::create(Named("impound") = data.GetSacCpraFrame());
 
-        return List::create(Named("animal_data") = builder.GetAnimalDataFrame(),
-                            Named("impound_data") = builder.GetImpoundDataFrame());
+        throw "Unknown synthetic data set kind " + kind;
     }
     catch (string& message)
     {
@@ -1977,3 +12256,104 @@ List atxMakeTables (const DataFrame& intake, const DataFrame& outcome)
         return NULL;
     }
 }
+
+
+
+
+/*
+ *  Method: hmBenchmarkTables
+ *
+ *    Builds the tables of a synthetic data set (see hmMakeSyntheticData)
+ *    and times each phase of the build: ingest of the input records, sort
+ *    of the events and animals, merge of the intakes with the outcomes,
+ *    fill of the tables, and encode of the string columns as factors, then
+ *    making of the R data frames.
+ *
+ *    Returns a named numeric vector of the numbers of input records,
+ *    animals and impounds, the seconds per phase and in total, the input
+ *    records per second, and the peak memory of the R process so far (MB).
+ *      
+ */
+// [[Rcpp::export]]
+SEXP hmBenchmarkTables (const std::string& kind, int numImpounds, double reimpoundRate = 0.25,
+                        double outOfOrderRate = 0.01, double naRate = 0.05, double seed = 1)
+{
+    try
+    {
+        SyntheticData data(numImpounds, reimpoundRate, outOfOrderRate, naRate, (uint64_t) seed);
+
+        return BenchmarkTables(kind, data);
+    }
+    catch (string& message)
+    {
+        Rcout << "** Exception - " << message << endl;
+        return R_NilValue;
+    }
+}
+
+
+
+
+/*
+ *  Method: hmProfileCounters
+ *
+ *    Returns a data frame of the counts of the timed scopes of the engine:
+ *    the name of each probe, the number of times its scope ran, and the
+ *    seconds spent in it, summed over the threads, since the engine was
+ *    loaded or the counts last reset. If reset is TRUE, sets the counts to
+ *    zero after returning them.
+ *
+ *    The data frame is empty unless the engine was compiled with
+ *    ATXSAC_PROFILE defined.
+ *      
+ */
+// [[Rcpp::export]]
+DataFrame hmProfileCounters (bool reset = false)
+{
+    vector<string> probeNames;
+    vector<double> probeCalls;
+    vector<double> probeSeconds;
+
+#if defined(ATXSAC_PROFILE)
+    for (ProfileProbe* probe = ProfileProbe::GetFirst().load(); probe != nullptr; probe = probe->next)
+    {
+        int row = std::find(probeNames.begin(), probeNames.end(), probe->name) - probeNames.begin();
+
+        if (row == (int) probeNames.size())
+        {
+            probeNames.push_back(probe->name);
+            probeCalls.push_back(0);
+            probeSeconds.push_back(0);
+        }
+
+        probeCalls[row] += reset ? probe->calls.exchange(0) : probe->calls.load();
+        probeSeconds[row] += (reset ? probe->nanoseconds.exchange(0) : probe->nanoseconds.load()) / 1e9;
+    }
+#else
+    (void) reset;
+#endif
+
+    int numRows = probeNames.size();
+    CharacterVector names(numRows);
+    NumericVector calls(numRows);
+    NumericVector seconds(numRows);
+
+    for (int r = 0; r < numRows; ++r)
+    {
+        names[r] = probeNames[r];
+        calls[r] = probeCalls[r];
+        seconds[r] = probeSeconds[r];
+    }
+
+    vector<string> columnNames;
+    columnNames.push_back("probe");
+    columnNames.push_back("calls");
+    columnNames.push_back("seconds");
+
+    vector<SEXP> columns;
+    columns.push_back(names);
+    columns.push_back(calls);
+    columns.push_back(seconds);
+
+    return MakeDataFrame(columnNames, columns, numRows);
+}
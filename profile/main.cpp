@@ -0,0 +1,129 @@
+/*
+ *  File: main.cpp
+ *
+ *      Builds the tables of a synthetic data set repeatedly, outside of R,
+ *      so that the engine can be run under a sampling profiler (perf, VTune,
+ *      Instruments) and drawn as a flame graph. Prints the seconds per phase
+ *      of each build and, when the engine is compiled with ATXSAC_PROFILE,
+ *      the counts of its timed scopes.
+ *
+ *      Usage: atxsac_profile [kind [impounds [builds]]]
+ *
+ *          kind     - "atx", "sac_open" or "sac_cpra" (default "atx").
+ *          impounds - Number of impounds generated (default 200000).
+ *          builds   - Number of times the tables are built (default 5).
+ *
+ */
+
+#include <Rcpp.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+using namespace Rcpp;
+using std::string;
+
+
+
+
+// Exports of AtxSacMakeTables.cpp used by the driver. Under R, these are
+// declared by the generated Rcpp glue.
+
+List hmMakeSyntheticData (const string& kind, int numImpounds, double reimpoundRate,
+                          double outOfOrderRate, double naRate, double seed);
+List sacMakeTables (const DataFrame& impound, bool stats, bool discrepancies,
+                    SEXP levels, double memoryBudget, const string& spillDirectory);
+List atxMakeTables (const DataFrame& intake, const DataFrame& outcome, bool stats,
+                    bool discrepancies, SEXP levels, double memoryBudget,
+                    const string& spillDirectory);
+DataFrame hmProfileCounters (bool reset);
+
+
+
+
+/*
+ *  Function: PrintNamedVector
+ *
+ *      Prints the names and values of a named numeric vector on one line.
+ *
+ */
+static void PrintNamedVector (const char* label, SEXP vector)
+{
+    SEXP names = Rf_getAttrib(vector, R_NamesSymbol);
+
+    printf("%-8s", label);
+
+    for (int i = 0; i < Rf_length(vector); ++i)
+        printf(" %s=%.6g", CHAR(STRING_ELT(names, i)), REAL(vector)[i]);
+
+    printf("\n");
+}
+
+
+
+
+/*
+ *  Function: PrintProfileCounters
+ *
+ *      Prints the counts of the timed scopes of the engine since they were
+ *      last printed.
+ *
+ */
+static void PrintProfileCounters ()
+{
+    DataFrame counters = hmProfileCounters(true);
+    SEXP names = VECTOR_ELT(counters, 0);
+    SEXP calls = VECTOR_ELT(counters, 1);
+    SEXP seconds = VECTOR_ELT(counters, 2);
+
+    for (int r = 0; r < Rf_length(names); ++r)
+        printf("%-8s %s calls=%.0f seconds=%.4f\n", "probe", CHAR(STRING_ELT(names, r)),
+               REAL(calls)[r], REAL(seconds)[r]);
+}
+
+
+
+
+/*
+ *  Function: main
+ *
+ *      Generates the data set once, then builds its tables the specified
+ *      number of times.
+ *
+ */
+int main (int argc, char** argv)
+{
+    string kind = argc > 1 ? argv[1] : "atx";
+    int numImpounds = argc > 2 ? atoi(argv[2]) : 200000;
+    int numBuilds = argc > 3 ? atoi(argv[3]) : 5;
+
+    if (kind != "atx" && kind != "sac_open" && kind != "sac_cpra")
+    {
+        fprintf(stderr, "Unknown kind \"%s\" (expected atx, sac_open or sac_cpra)\n", kind.c_str());
+        return 1;
+    }
+
+    List data = hmMakeSyntheticData(kind, numImpounds, 0.25, 0.01, 0.05, 1);
+
+    if (Rf_isNull(data))
+        return 1;
+
+    for (int b = 0; b < numBuilds; ++b)
+    {
+        List tables = kind == "atx" ? atxMakeTables(VECTOR_ELT(data, 0), VECTOR_ELT(data, 1), true,
+                                                    true, R_NilValue, 0, string())
+                                    : sacMakeTables(VECTOR_ELT(data, 0), true, true, R_NilValue, 0,
+                                                    string());
+
+        if (Rf_isNull(tables))
+            return 1;
+
+        List stats = tables["stats"];
+
+        printf("build %d\n", b + 1);
+        PrintNamedVector("times", stats["times"]);
+        PrintNamedVector("counts", stats["counts"]);
+        PrintProfileCounters();
+    }
+
+    return 0;
+}
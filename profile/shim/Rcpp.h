@@ -0,0 +1,330 @@
+/*
+ *  File: Rcpp.h
+ *
+ *      Minimal stand-in for the parts of the R C API and of Rcpp used by
+ *      AtxSacMakeTables.cpp, so that the engine can be built and profiled
+ *      outside of R (see main.cpp). R objects are plain heap objects that
+ *      are never freed, and ALTREP is not provided, so snapshot columns
+ *      are read eagerly.
+ *      
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <climits>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdarg>
+
+struct SEXPREC {
+    int type = 0;
+    std::vector<int> ints;
+    std::vector<double> reals;
+    std::vector<SEXPREC*> elts;
+    std::string chars;
+    std::vector<std::pair<SEXPREC*, SEXPREC*>> attrs;
+    void* ptr = nullptr;
+    void (*fin)(SEXPREC*) = nullptr;
+    SEXPREC* protTag = nullptr; SEXPREC* protVal = nullptr;
+};
+typedef SEXPREC* SEXP;
+typedef ptrdiff_t R_xlen_t;
+typedef int Rboolean;
+#define NILSXP 0
+#define SYMSXP 1
+#define CHARSXP 9
+#define LGLSXP 10
+#define INTSXP 13
+#define REALSXP 14
+#define STRSXP 16
+#define VECSXP 19
+#define EXTPTRSXP 22
+#define RAWSXP 24
+#define CE_UTF8 1
+#define CE_NATIVE 0
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+inline double RFake_makeNA() { union { double d; uint64_t u; } x; x.u = 0x7FF00000000007A2ULL; return x.d; }
+inline double& RFake_NaReal() { static double v = RFake_makeNA(); return v; }
+#define R_NaReal RFake_NaReal()
+#define R_NaInt INT_MIN
+#define NA_REAL RFake_NaReal()
+#define NA_INTEGER INT_MIN
+#define NA_LOGICAL INT_MIN
+inline SEXP RFake_nil() { static SEXPREC n; return &n; }
+#define R_NilValue RFake_nil()
+inline std::unordered_map<std::string, SEXP>& RFake_charCache() { static std::unordered_map<std::string, SEXP> c; return c; }
+inline SEXP RFake_NaString() { static SEXP s = [](){ SEXP x = new SEXPREC; x->type = CHARSXP; x->chars = "NA"; return x; }(); return s; }
+#define NA_STRING RFake_NaString()
+inline SEXP Rf_mkCharLen(const char* s, int n) { std::string k(s, n); auto& c = RFake_charCache(); auto it = c.find(k); if (it != c.end()) return it->second; SEXP x = new SEXPREC; x->type = CHARSXP; x->chars = k; c[k] = x; return x; }
+inline SEXP Rf_mkChar(const char* s) { return Rf_mkCharLen(s, strlen(s)); }
+inline SEXP Rf_mkCharLenCE(const char* s, int n, int) { return Rf_mkCharLen(s, n); }
+inline SEXP Rf_mkCharCE(const char* s, int) { return Rf_mkChar(s); }
+inline std::unordered_map<std::string, SEXP>& RFake_symTable() { static std::unordered_map<std::string, SEXP> t; return t; }
+inline SEXP Rf_install(const char* s) { auto& t = RFake_symTable(); auto it = t.find(s); if (it != t.end()) return it->second; SEXP x = new SEXPREC; x->type = SYMSXP; x->chars = s; t[s] = x; return x; }
+#define R_NamesSymbol Rf_install("names")
+#define R_ClassSymbol Rf_install("class")
+#define R_LevelsSymbol Rf_install("levels")
+#define R_RowNamesSymbol Rf_install("row.names")
+#define R_DimSymbol Rf_install("dim")
+inline int TYPEOF(SEXP x) { return x->type; }
+inline R_xlen_t XLENGTH(SEXP x) { switch (x->type) { case INTSXP: case LGLSXP: return x->ints.size(); case REALSXP: return x->reals.size(); case STRSXP: case VECSXP: return x->elts.size(); case RAWSXP: return x->chars.size(); case CHARSXP: return x->chars.size(); default: return 0; } }
+inline int LENGTH(SEXP x) { return (int) XLENGTH(x); }
+inline R_xlen_t Rf_xlength(SEXP x) { return XLENGTH(x); }
+inline int Rf_length(SEXP x) { return LENGTH(x); }
+inline SEXP Rf_allocVector(int type, R_xlen_t n) { SEXP x = new SEXPREC; x->type = type; switch (type) { case INTSXP: case LGLSXP: x->ints.assign(n, 0); break; case REALSXP: x->reals.assign(n, 0.0); break; case STRSXP: x->elts.assign(n, Rf_mkChar("")); break; case VECSXP: x->elts.assign(n, R_NilValue); break; case RAWSXP: x->chars.assign(n, '\0'); break; } return x; }
+inline int* INTEGER(SEXP x) { return x->ints.data(); }
+inline int* LOGICAL(SEXP x) { return x->ints.data(); }
+inline double* REAL(SEXP x) { return x->reals.data(); }
+inline unsigned char* RAW(SEXP x) { return (unsigned char*) &x->chars[0]; }
+inline SEXP STRING_ELT(SEXP x, R_xlen_t i) { return x->elts.at(i); }
+inline const SEXP* STRING_PTR_RO(SEXP x) { return x->elts.data(); }
+typedef int cetype_t;
+inline cetype_t Rf_getCharCE(SEXP) { return 0; }
+inline void SET_STRING_ELT(SEXP x, R_xlen_t i, SEXP v) { x->elts.at(i) = v; }
+inline SEXP VECTOR_ELT(SEXP x, R_xlen_t i) { return x->elts.at(i); }
+inline SEXP SET_VECTOR_ELT(SEXP x, R_xlen_t i, SEXP v) { x->elts.at(i) = v; return v; }
+inline const char* CHAR(SEXP x) { return x->chars.c_str(); }
+inline SEXP Rf_protect(SEXP x) { return x; }
+inline void Rf_unprotect(int) {}
+#define PROTECT(x) Rf_protect(x)
+#define UNPROTECT(n) Rf_unprotect(n)
+inline SEXP Rf_getAttrib(SEXP x, SEXP sym) { for (auto& a : x->attrs) if (a.first == sym) return a.second; return R_NilValue; }
+inline SEXP Rf_setAttrib(SEXP x, SEXP sym, SEXP v) { for (auto& a : x->attrs) if (a.first == sym) { a.second = v; return v; } x->attrs.push_back({sym, v}); return v; }
+inline SEXP Rf_mkString(const char* s) { SEXP x = Rf_allocVector(STRSXP, 1); x->elts[0] = Rf_mkChar(s); return x; }
+inline SEXP Rf_ScalarInteger(int v) { SEXP x = Rf_allocVector(INTSXP, 1); x->ints[0] = v; return x; }
+inline SEXP Rf_ScalarLogical(int v) { SEXP x = Rf_allocVector(LGLSXP, 1); x->ints[0] = v; return x; }
+inline SEXP Rf_ScalarReal(double v) { SEXP x = Rf_allocVector(REALSXP, 1); x->reals[0] = v; return x; }
+inline SEXP Rf_ScalarString(SEXP c) { SEXP x = Rf_allocVector(STRSXP, 1); x->elts[0] = c; return x; }
+inline int Rf_inherits(SEXP x, const char* cls) { SEXP c = Rf_getAttrib(x, R_ClassSymbol); if (c == R_NilValue) return 0; for (SEXP e : c->elts) if (e->chars == cls) return 1; return 0; }
+inline int Rf_isFactor(SEXP x) { return x->type == INTSXP && Rf_inherits(x, "factor"); }
+inline int Rf_isString(SEXP x) { return x->type == STRSXP; }
+inline int Rf_isNull(SEXP x) { return x == R_NilValue || x->type == NILSXP; }
+inline int R_IsNA(double x) { if (!std::isnan(x)) return 0; union { double d; uint32_t u[2]; } y; y.d = x; return y.u[0] == 1954; }
+inline int R_finite(double x) { return std::isfinite(x); }
+#define ISNA(x) R_IsNA(x)
+#define ISNAN(x) std::isnan(x)
+#define R_FINITE(x) R_finite(x)
+inline void Rf_error(const char* fmt, ...) { char buf[1024]; va_list ap; va_start(ap, fmt); vsnprintf(buf, sizeof buf, fmt, ap); va_end(ap); throw std::runtime_error(buf); }
+inline void Rf_warning(const char* fmt, ...) { char buf[1024]; va_list ap; va_start(ap, fmt); vsnprintf(buf, sizeof buf, fmt, ap); va_end(ap); std::cerr << "Warning: " << buf << "\n"; }
+inline void R_CheckUserInterrupt() {}
+inline SEXP Rf_duplicate(SEXP x) { SEXP y = new SEXPREC(*x); return y; }
+inline SEXP Rf_lengthgets(SEXP x, R_xlen_t n) { SEXP y = Rf_duplicate(x); switch (y->type) { case INTSXP: case LGLSXP: y->ints.resize(n, NA_INTEGER); break; case REALSXP: y->reals.resize(n, NA_REAL); break; case STRSXP: y->elts.resize(n, NA_STRING); break; case VECSXP: y->elts.resize(n, R_NilValue); break; } return y; }
+inline SEXP R_MakeExternalPtr(void* p, SEXP tag, SEXP prot) { SEXP x = new SEXPREC; x->type = EXTPTRSXP; x->ptr = p; x->protTag = tag; x->protVal = prot; return x; }
+inline void* R_ExternalPtrAddr(SEXP x) { return x->ptr; }
+inline void R_ClearExternalPtr(SEXP x) { x->ptr = nullptr; }
+inline void R_RegisterCFinalizerEx(SEXP x, void (*f)(SEXP), Rboolean) { x->fin = f; }
+inline SEXP Rf_coerceToString(SEXP x) {
+    SEXP r = Rf_allocVector(STRSXP, XLENGTH(x));
+    if (Rf_isFactor(x)) { SEXP lv = Rf_getAttrib(x, R_LevelsSymbol); for (size_t i = 0; i < x->ints.size(); ++i) r->elts[i] = x->ints[i] == NA_INTEGER ? NA_STRING : lv->elts[x->ints[i] - 1]; return r; }
+    if (x->type == INTSXP || x->type == LGLSXP) { for (size_t i = 0; i < x->ints.size(); ++i) r->elts[i] = x->ints[i] == NA_INTEGER ? NA_STRING : Rf_mkChar(std::to_string(x->ints[i]).c_str()); return r; }
+    if (x->type == REALSXP) { for (size_t i = 0; i < x->reals.size(); ++i) { if (std::isnan(x->reals[i])) r->elts[i] = NA_STRING; else { std::ostringstream o; o << std::setprecision(15) << x->reals[i]; r->elts[i] = Rf_mkChar(o.str().c_str()); } } return r; }
+    return x;
+}
+inline SEXP Rf_coerceVector(SEXP x, int type) {
+    if (x->type == type) return x;
+    if (type == STRSXP) return Rf_coerceToString(x);
+    SEXP r = Rf_allocVector(type, XLENGTH(x));
+    if (type == INTSXP || type == LGLSXP) { if (x->type == REALSXP) for (size_t i = 0; i < x->reals.size(); ++i) r->ints[i] = std::isnan(x->reals[i]) ? NA_INTEGER : (int) x->reals[i]; else if (x->type == INTSXP || x->type == LGLSXP) r->ints = x->ints; else if (x->type == STRSXP) for (size_t i = 0; i < x->elts.size(); ++i) r->ints[i] = x->elts[i] == NA_STRING ? NA_INTEGER : atoi(x->elts[i]->chars.c_str()); return r; }
+    if (type == REALSXP) { if (x->type == INTSXP || x->type == LGLSXP) for (size_t i = 0; i < x->ints.size(); ++i) r->reals[i] = x->ints[i] == NA_INTEGER ? NA_REAL : x->ints[i]; else if (x->type == STRSXP) for (size_t i = 0; i < x->elts.size(); ++i) r->reals[i] = x->elts[i] == NA_STRING ? NA_REAL : atof(x->elts[i]->chars.c_str()); return r; }
+    return r;
+}
+
+namespace Rcpp {
+
+inline std::ostream& RcoutRef() { return std::cout; }
+static std::ostream& Rcout = std::cout;
+
+struct Datetime {
+    double m_dt; struct tm m_tm; int m_us;
+    Datetime() : m_dt(0) { update(); }
+    Datetime(double d) : m_dt(d) { update(); }
+    void update() { if (std::isfinite(m_dt)) { time_t t = (time_t) std::floor(m_dt); gmtime_r(&t, &m_tm); } else { m_dt = NA_REAL; m_tm.tm_sec = m_tm.tm_min = m_tm.tm_hour = m_tm.tm_mday = m_tm.tm_mon = m_tm.tm_year = m_tm.tm_yday = m_tm.tm_wday = NA_INTEGER; } }
+    int getYear() const { return m_tm.tm_year == NA_INTEGER ? NA_INTEGER : m_tm.tm_year + 1900; }
+    int getMonth() const { return m_tm.tm_mon == NA_INTEGER ? NA_INTEGER : m_tm.tm_mon + 1; }
+    int getDay() const { return m_tm.tm_mday; }
+    int getHours() const { return m_tm.tm_hour; }
+    int getMinutes() const { return m_tm.tm_min; }
+    int getSeconds() const { return m_tm.tm_sec; }
+    int getWeekday() const { return m_tm.tm_wday + 1; }
+    int getYearday() const { return m_tm.tm_yday + 1; }
+    double getFractionalTimestamp() const { return m_dt; }
+    operator double() const { return m_dt; }
+};
+inline bool operator<(const Datetime& a, const Datetime& b) { return a.m_dt < b.m_dt; }
+inline bool operator>(const Datetime& a, const Datetime& b) { return a.m_dt > b.m_dt; }
+inline bool operator<=(const Datetime& a, const Datetime& b) { return a.m_dt <= b.m_dt; }
+inline bool operator>=(const Datetime& a, const Datetime& b) { return a.m_dt >= b.m_dt; }
+inline bool operator==(const Datetime& a, const Datetime& b) { return a.m_dt == b.m_dt; }
+
+inline SEXP wrapSexp(SEXP x) { return x; }
+inline SEXP wrapStr(const std::string& s) { return Rf_mkString(s.c_str()); }
+
+struct GenericProxy {
+    SEXP x;
+    operator SEXP() const { return x; }
+    template<class T> operator T() const { return T(x); }
+};
+
+struct AttrProxy {
+    SEXP obj; SEXP sym;
+    AttrProxy& operator=(SEXP v) { Rf_setAttrib(obj, sym, v); return *this; }
+    AttrProxy& operator=(const char* s) { return *this = Rf_mkString(s); }
+    AttrProxy& operator=(const std::string& s) { return *this = Rf_mkString(s.c_str()); }
+    template<class T> AttrProxy& operator=(const T& v) { return *this = (SEXP) v; }
+    operator SEXP() const { return Rf_getAttrib(obj, sym); }
+};
+
+struct StringProxy {
+    SEXP vec; R_xlen_t i;
+    StringProxy& operator=(const std::string& s) { vec->elts[i] = Rf_mkCharLen(s.data(), s.size()); return *this; }
+    StringProxy& operator=(const char* s) { vec->elts[i] = Rf_mkChar(s); return *this; }
+    StringProxy& operator=(SEXP c) { vec->elts[i] = c; return *this; }
+    StringProxy& operator=(const StringProxy& o) { vec->elts[i] = o.vec->elts[o.i]; return *this; }
+    operator SEXP() const { return vec->elts[i]; }
+    explicit operator char*() const { return (char*) vec->elts[i]->chars.c_str(); }
+    operator std::string() const { return vec->elts[i]->chars; }
+};
+
+template<int RTYPE> struct traits;
+template<> struct traits<INTSXP> { typedef int& ref; typedef int elem; static int& at(SEXP x, R_xlen_t i) { return x->ints[i]; } };
+template<> struct traits<LGLSXP> { typedef int& ref; typedef int elem; static int& at(SEXP x, R_xlen_t i) { return x->ints[i]; } };
+template<> struct traits<REALSXP> { typedef double& ref; typedef double elem; static double& at(SEXP x, R_xlen_t i) { return x->reals[i]; } };
+template<> struct traits<STRSXP> { typedef StringProxy ref; typedef SEXP elem; static StringProxy at(SEXP x, R_xlen_t i) { return StringProxy{x, i}; } };
+template<> struct traits<VECSXP> { typedef GenericProxy ref; typedef SEXP elem; static GenericProxy at(SEXP x, R_xlen_t i) { return GenericProxy{x->elts[i]}; } };
+
+struct NamedArg { std::string name; SEXP value; };
+struct NamedT { std::string name; template<class T> NamedArg operator=(const T& v) const; };
+inline NamedT Named(const std::string& n) { return NamedT{n}; }
+
+template<int RTYPE>
+struct Vector {
+    SEXP x;
+    Vector() : x(Rf_allocVector(RTYPE, 0)) {}
+    Vector(SEXP s) : x(Rf_coerceVector(s, RTYPE)) {}
+    Vector(const GenericProxy& p) : x(Rf_coerceVector(p.x, RTYPE)) {}
+    template<class N, class = typename std::enable_if<std::is_arithmetic<N>::value>::type> Vector(N n) : x(Rf_allocVector(RTYPE, (R_xlen_t) n)) {}
+    template<class N, class V, class = typename std::enable_if<std::is_arithmetic<N>::value>::type> Vector(N n, V v) : x(Rf_allocVector(RTYPE, (R_xlen_t) n)) { for (R_xlen_t i = 0; i < (R_xlen_t) n; ++i) traits<RTYPE>::at(x, i) = v; }
+    Vector& operator=(SEXP s) { x = Rf_coerceVector(s, RTYPE); return *this; }
+    operator SEXP() const { return x; }
+    typename traits<RTYPE>::ref operator[](R_xlen_t i) const { return traits<RTYPE>::at(x, i); }
+    typename traits<RTYPE>::ref operator()(R_xlen_t i) const { return traits<RTYPE>::at(x, i); }
+    int size() const { return LENGTH(x); }
+    R_xlen_t length() const { return XLENGTH(x); }
+    AttrProxy attr(const std::string& n) const { return AttrProxy{x, Rf_install(n.c_str())}; }
+    AttrProxy names() const { return attr("names"); }
+    bool hasAttribute(const std::string& n) const { return Rf_getAttrib(x, Rf_install(n.c_str())) != R_NilValue; }
+    void erase(int i) { switch (RTYPE) { case INTSXP: case LGLSXP: x->ints.erase(x->ints.begin() + i); break; case REALSXP: x->reals.erase(x->reals.begin() + i); break; default: x->elts.erase(x->elts.begin() + i); } }
+    bool containsElementNamed(const char* n) const { SEXP nm = Rf_getAttrib(x, R_NamesSymbol); if (nm == R_NilValue) return false; for (SEXP e : nm->elts) if (e->chars == n) return true; return false; }
+    int findName(const std::string& n) const { SEXP nm = Rf_getAttrib(x, R_NamesSymbol); if (nm == R_NilValue) return -1; for (size_t i = 0; i < nm->elts.size(); ++i) if (nm->elts[i]->chars == n) return i; return -1; }
+    GenericProxy operator[](const std::string& n) const { int i = findName(n); if (i < 0) throw std::runtime_error("index out of bounds: " + n); return GenericProxy{x->elts[i]}; }
+    GenericProxy operator[](const char* n) const { return (*this)[std::string(n)]; }
+    template<class It> Vector(It b, It e);
+    template<class... A> static Vector create(const A&... a);
+    int* intBegin() const { return x->ints.data(); }
+    typename std::conditional<RTYPE==REALSXP, double*, int*>::type begin() const { return data_(); }
+    typename std::conditional<RTYPE==REALSXP, double*, int*>::type end() const { return data_() + length(); }
+    template<class D = void> typename std::conditional<RTYPE==REALSXP, double*, int*>::type data_() const { return dataImpl(std::integral_constant<int, RTYPE>()); }
+    static double* dataImpl2(SEXP x, std::integral_constant<int, REALSXP>) { return x->reals.data(); }
+    template<int R> static int* dataImpl2(SEXP x, std::integral_constant<int, R>) { return x->ints.data(); }
+    typename std::conditional<RTYPE==REALSXP, double*, int*>::type dataImpl(std::integral_constant<int, RTYPE> c) const { return dataImpl2(x, c); }
+    void push_back(typename traits<RTYPE>::elem v);
+};
+typedef Vector<INTSXP> IntegerVector;
+typedef Vector<REALSXP> NumericVector;
+typedef Vector<LGLSXP> LogicalVector;
+typedef Vector<STRSXP> CharacterVector;
+typedef Vector<STRSXP> StringVector;
+typedef Vector<RAWSXP> RawVector;
+
+inline SEXP wrapElem(int v, SEXP) { return Rf_ScalarInteger(v); }
+
+struct DatetimeVector {
+    SEXP x;
+    DatetimeVector(SEXP s) : x(Rf_coerceVector(s, REALSXP)) {}
+    DatetimeVector(const GenericProxy& p) : x(Rf_coerceVector(p.x, REALSXP)) {}
+    Datetime operator[](int i) const { return Datetime(x->reals[i]); }
+    int size() const { return LENGTH(x); }
+    operator SEXP() const { return x; }
+};
+
+inline SEXP wrap(SEXP x) { return x; }
+template<int R> inline SEXP wrap(const Vector<R>& v) { return v.x; }
+inline SEXP wrap(const std::vector<std::string>& v) { SEXP x = Rf_allocVector(STRSXP, v.size()); for (size_t i = 0; i < v.size(); ++i) x->elts[i] = Rf_mkCharLen(v[i].data(), v[i].size()); return x; }
+inline SEXP wrap(const std::vector<int>& v) { SEXP x = Rf_allocVector(INTSXP, v.size()); x->ints = v; return x; }
+inline SEXP wrap(const std::vector<double>& v) { SEXP x = Rf_allocVector(REALSXP, v.size()); x->reals = v; return x; }
+inline SEXP wrap(const std::vector<Datetime>& v) { SEXP x = Rf_allocVector(REALSXP, v.size()); for (size_t i = 0; i < v.size(); ++i) x->reals[i] = v[i].m_dt; SEXP c = Rf_allocVector(STRSXP, 2); c->elts[0] = Rf_mkChar("POSIXct"); c->elts[1] = Rf_mkChar("POSIXt"); Rf_setAttrib(x, R_ClassSymbol, c); return x; }
+inline SEXP wrap(const std::string& s) { return Rf_mkString(s.c_str()); }
+inline SEXP wrap(const char* s) { return Rf_mkString(s); }
+inline SEXP wrap(int v) { return Rf_ScalarInteger(v); }
+inline SEXP wrap(double v) { return Rf_ScalarReal(v); }
+inline SEXP wrap(bool v) { return Rf_ScalarLogical(v); }
+inline SEXP wrap(const GenericProxy& p) { return p.x; }
+inline SEXP wrap(const Datetime& d) { return wrap(std::vector<Datetime>(1, d)); }
+inline SEXP wrap(const std::vector<bool>& v) { SEXP x = Rf_allocVector(LGLSXP, v.size()); for (size_t i = 0; i < v.size(); ++i) x->ints[i] = v[i]; return x; }
+template<class T> inline SEXP wrapAny(const T& v) { return wrap(v); }
+template<class T> NamedArg NamedT::operator=(const T& v) const { return NamedArg{name, wrapAny(v)}; }
+
+template<int R> template<class It> Vector<R>::Vector(It b, It e) : x(wrap(std::vector<typename std::iterator_traits<It>::value_type>(b, e))) {}
+template<> inline void Vector<INTSXP>::push_back(int v) { x->ints.push_back(v); }
+template<> inline void Vector<REALSXP>::push_back(double v) { x->reals.push_back(v); }
+
+inline void fillList(std::vector<SEXP>&, std::vector<std::string>&) {}
+template<class T, class... A> void fillList(std::vector<SEXP>& v, std::vector<std::string>& n, const T& a, const A&... rest);
+template<class... A> void fillList(std::vector<SEXP>& v, std::vector<std::string>& n, const NamedArg& a, const A&... rest) { v.push_back(a.value); n.push_back(a.name); fillList(v, n, rest...); }
+template<class T, class... A> void fillList(std::vector<SEXP>& v, std::vector<std::string>& n, const T& a, const A&... rest) { v.push_back(wrap(a)); n.push_back(""); fillList(v, n, rest...); }
+inline SEXP makeList(const std::vector<SEXP>& v, const std::vector<std::string>& n) { SEXP x = Rf_allocVector(VECSXP, v.size()); x->elts = v; bool anyName = false; for (auto& s : n) if (!s.empty()) anyName = true; if (anyName) Rf_setAttrib(x, R_NamesSymbol, wrap(n)); return x; }
+template<int R> template<class... A> Vector<R> Vector<R>::create(const A&... a) { std::vector<SEXP> v; std::vector<std::string> n; fillList(v, n, a...); if (R == VECSXP) return Vector<R>(makeList(v, n)); Vector<R> r((int) v.size()); for (size_t i = 0; i < v.size(); ++i) { SEXP e = v[i]; switch (R) { case INTSXP: case LGLSXP: r.x->ints[i] = Rf_coerceVector(e, INTSXP)->ints[0]; break; case REALSXP: r.x->reals[i] = Rf_coerceVector(e, REALSXP)->reals[0]; break; case STRSXP: r.x->elts[i] = e->elts[0]; break; } } bool anyName = false; for (auto& s : n) if (!s.empty()) anyName = true; if (anyName) Rf_setAttrib(r.x, R_NamesSymbol, wrap(n)); return r; }
+
+struct List : Vector<VECSXP> {
+    List() : Vector<VECSXP>() {}
+    List(SEXP s) : Vector<VECSXP>(s) {}
+    List(const GenericProxy& p) : Vector<VECSXP>(p.x) {}
+    template<class N, class = typename std::enable_if<std::is_arithmetic<N>::value>::type> List(N n) : Vector<VECSXP>(n) {}
+    template<class... A> static List create(const A&... a) { std::vector<SEXP> v; std::vector<std::string> n; fillList(v, n, a...); return List(makeList(v, n)); }
+    GenericProxy operator[](int i) const { return GenericProxy{x->elts.at(i)}; }
+    GenericProxy operator[](const std::string& n) const { return Vector<VECSXP>::operator[](n); }
+    GenericProxy operator[](const char* n) const { return Vector<VECSXP>::operator[](std::string(n)); }
+    void setAt(int i, SEXP v) { x->elts.at(i) = v; }
+};
+struct ListSetter { SEXP x; int i; };
+struct DataFrame : List {
+    DataFrame() : List() {}
+    DataFrame(SEXP s) : List(s) {}
+    DataFrame(const GenericProxy& p) : List(p.x) {}
+    int nrows() const { SEXP rn = Rf_getAttrib(x, R_RowNamesSymbol); if (rn != R_NilValue && rn->type == INTSXP && rn->ints.size() == 2 && rn->ints[0] == NA_INTEGER) return std::abs(rn->ints[1]); if (x->elts.empty()) return 0; return LENGTH(x->elts[0]); }
+    template<class... A> static DataFrame create(const A&... a) { std::vector<SEXP> v; std::vector<std::string> n; fillList(v, n, a...); SEXP l = makeList(v, n); int nr = v.empty() ? 0 : LENGTH(v[0]); SEXP rn = Rf_allocVector(INTSXP, 2); rn->ints[0] = NA_INTEGER; rn->ints[1] = -nr; Rf_setAttrib(l, R_RowNamesSymbol, rn); Rf_setAttrib(l, R_ClassSymbol, Rf_mkString("data.frame")); return DataFrame(l); }
+};
+
+template<class T> struct AsImpl;
+template<> struct AsImpl<std::string> { static std::string get(SEXP x) { if (x->type == CHARSXP) return x->chars; if (x->type == STRSXP) return x->elts.at(0)->chars; return Rf_coerceToString(x)->elts.at(0)->chars; } };
+template<> struct AsImpl<int> { static int get(SEXP x) { return Rf_coerceVector(x, INTSXP)->ints.at(0); } };
+template<> struct AsImpl<double> { static double get(SEXP x) { return Rf_coerceVector(x, REALSXP)->reals.at(0); } };
+template<> struct AsImpl<bool> { static bool get(SEXP x) { return Rf_coerceVector(x, LGLSXP)->ints.at(0) != 0; } };
+template<class T> T as(SEXP x) { return AsImpl<T>::get(x); }
+template<class T> T as(const StringProxy& p) { return AsImpl<T>::get((SEXP) p); }
+template<class T> T as(const GenericProxy& p) { return AsImpl<T>::get(p.x); }
+
+inline CharacterVector sort_unique(const CharacterVector& v) { std::vector<SEXP> e = v.x->elts; std::sort(e.begin(), e.end(), [](SEXP a, SEXP b) { return strcmp(a->chars.c_str(), b->chars.c_str()) < 0; }); e.erase(std::unique(e.begin(), e.end()), e.end()); CharacterVector r((int) e.size()); r.x->elts = e; return r; }
+inline IntegerVector match(const CharacterVector& x, const CharacterVector& t) { std::unordered_map<SEXP, int> pos; for (size_t i = 0; i < t.x->elts.size(); ++i) if (!pos.count(t.x->elts[i])) pos[t.x->elts[i]] = i + 1; IntegerVector r((int) x.x->elts.size()); for (size_t i = 0; i < x.x->elts.size(); ++i) { auto it = pos.find(x.x->elts[i]); r.x->ints[i] = it == pos.end() ? NA_INTEGER : it->second; } return r; }
+
+template<class T> struct XPtr { SEXP x; XPtr(T* p, bool = true, SEXP tag = R_NilValue, SEXP prot = R_NilValue) : x(R_MakeExternalPtr(p, tag, prot)) {} XPtr(SEXP s) : x(s) {} T* get() const { return (T*) x->ptr; } T* operator->() const { return get(); } T& operator*() const { return *get(); } operator SEXP() const { return x; } void release() { delete get(); x->ptr = nullptr; } };
+template<class... A> [[noreturn]] void stop(const std::string& m, const A&...) { throw std::runtime_error(m); }
+template<class... A> void warning(const std::string& m, const A&...) { std::cerr << "Warning: " << m << "\n"; }
+inline void checkUserInterrupt() {}
+template<class T> struct Shield { SEXP x; Shield(SEXP s) : x(s) {} operator SEXP() const { return x; } };
+struct String { SEXP x; String(SEXP s) : x(s->type == STRSXP ? s->elts[0] : s) {} String(const std::string& s) : x(Rf_mkChar(s.c_str())) {} String(const char* s) : x(Rf_mkChar(s)) {} const char* get_cstring() const { return CHAR(x); } operator SEXP() const { return x; } };
+}
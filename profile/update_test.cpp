@@ -0,0 +1,355 @@
+/*
+ *  File: update_test.cpp
+ *
+ *      Checks that tables built in parts, by updates of a builder or by
+ *      chunks appended to it in memory or within a memory budget, are the
+ *      same as the tables of one full build of all the records, and stay
+ *      the same when the builder is finished again. The input records are
+ *      split into parts by row, the intakes and outcomes of Austin records
+ *      together.
+ *
+ *      Usage: atxsac_update_test [impounds [parts]]
+ *
+ *          impounds - Number of impounds generated (default 20000).
+ *          parts    - Number of parts the records are split into (default 4).
+ *
+ */
+
+#include <Rcpp.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+using namespace Rcpp;
+using std::string;
+using std::vector;
+
+
+
+
+// Exports of AtxSacMakeTables.cpp used by the test. Under R, these are
+// declared by the generated Rcpp glue.
+
+List hmMakeSyntheticData (const string& kind, int numImpounds, double reimpoundRate,
+                          double outOfOrderRate, double naRate, double seed);
+List sacMakeTables (const DataFrame& impound, bool stats, bool discrepancies,
+                    SEXP levels, double memoryBudget, const string& spillDirectory);
+List atxMakeTables (const DataFrame& intake, const DataFrame& outcome, bool stats,
+                    bool discrepancies, SEXP levels, double memoryBudget,
+                    const string& spillDirectory);
+SEXP atxMakeBuilder (const DataFrame& intake, const DataFrame& outcome, SEXP levels);
+List atxUpdateTables (SEXP builder, const DataFrame& intake, const DataFrame& outcome);
+SEXP sacMakeBuilder (const DataFrame& impound, SEXP levels);
+List sacUpdateTables (SEXP builder, const DataFrame& impound);
+SEXP atxStartTables (SEXP levels, double memoryBudget, const string& spillDirectory);
+bool atxAppendIntakes (SEXP builder, const DataFrame& intake);
+bool atxAppendOutcomes (SEXP builder, const DataFrame& outcome);
+SEXP sacStartTables (bool cpra, SEXP levels, double memoryBudget, const string& spillDirectory);
+bool sacAppendImpounds (SEXP builder, const DataFrame& impound);
+List hmFinishTables (SEXP builder);
+
+
+
+
+// Budget (MB) small enough that every build within it spills records.
+
+static const double SpillBudget = 0.05;
+
+
+
+
+/*
+ *  Function: SliceFrame
+ *
+ *      Returns a data frame of the rows [begin, end) of a data frame, with
+ *      the attributes (e.g., factor levels) of its columns.
+ *
+ */
+static DataFrame SliceFrame (SEXP frame, int begin, int end)
+{
+    int numColumns = Rf_length(frame);
+    int numRows = end - begin;
+    SEXP slice = Rf_allocVector(VECSXP, numColumns);
+
+    for (int c = 0; c < numColumns; ++c)
+    {
+        SEXP column = VECTOR_ELT(frame, c);
+        SEXP sliced = Rf_allocVector(TYPEOF(column), numRows);
+
+        for (int r = 0; r < numRows; ++r)
+        {
+            if (TYPEOF(column) == REALSXP)
+                REAL(sliced)[r] = REAL(column)[begin + r];
+            else if (TYPEOF(column) == STRSXP)
+                SET_STRING_ELT(sliced, r, STRING_ELT(column, begin + r));
+            else
+                INTEGER(sliced)[r] = INTEGER(column)[begin + r];
+        }
+
+        Rf_setAttrib(sliced, R_LevelsSymbol, Rf_getAttrib(column, R_LevelsSymbol));
+        Rf_setAttrib(sliced, R_ClassSymbol, Rf_getAttrib(column, R_ClassSymbol));
+        Rf_setAttrib(sliced, Rf_install("tzone"), Rf_getAttrib(column, Rf_install("tzone")));
+        SET_VECTOR_ELT(slice, c, sliced);
+    }
+
+    SEXP rowNames = Rf_allocVector(INTSXP, 2);
+    INTEGER(rowNames)[0] = NA_INTEGER;
+    INTEGER(rowNames)[1] = -numRows;
+
+    Rf_setAttrib(slice, R_NamesSymbol, Rf_getAttrib(frame, R_NamesSymbol));
+    Rf_setAttrib(slice, R_RowNamesSymbol, rowNames);
+    Rf_setAttrib(slice, R_ClassSymbol, Rf_mkString("data.frame"));
+
+    return DataFrame(slice);
+}
+
+
+
+
+/*
+ *  Function: SplitFrame
+ *
+ *      Returns the parts of a data frame split by row into nearly equal
+ *      numbers of rows.
+ *
+ */
+static vector<DataFrame> SplitFrame (SEXP frame, int numParts)
+{
+    int numRows = Rf_length(VECTOR_ELT(frame, 0));
+    vector<DataFrame> parts;
+
+    for (int p = 0; p < numParts; ++p)
+        parts.push_back(SliceFrame(frame, (int64_t) numRows * p / numParts,
+                                   (int64_t) numRows * (p + 1) / numParts));
+
+    return parts;
+}
+
+
+
+
+/*
+ *  Function: GetCell
+ *
+ *      Returns the printable value of a cell of a column, factors as their
+ *      levels.
+ *
+ */
+static string GetCell (SEXP column, int row)
+{
+    char buffer[64];
+
+    if (TYPEOF(column) == REALSXP)
+    {
+        double value = REAL(column)[row];
+
+        if (ISNAN(value))
+            return "NA";
+
+        snprintf(buffer, sizeof buffer, "%.17g", value);
+        return buffer;
+    }
+
+    if (TYPEOF(column) == STRSXP)
+        return STRING_ELT(column, row) == NA_STRING ? "NA" : CHAR(STRING_ELT(column, row));
+
+    int value = INTEGER(column)[row];
+
+    if (value == NA_INTEGER)
+        return "NA";
+
+    if (Rf_isFactor(column))
+        return CHAR(STRING_ELT(Rf_getAttrib(column, R_LevelsSymbol), value - 1));
+
+    snprintf(buffer, sizeof buffer, "%d", value);
+    return buffer;
+}
+
+
+
+
+/*
+ *  Function: CountDifferences
+ *
+ *      Returns the number of cells of a table that differ from those of the
+ *      expected table, printing the first few.
+ *
+ */
+static int CountDifferences (const char* label, SEXP expected, SEXP actual)
+{
+    SEXP names = Rf_getAttrib(expected, R_NamesSymbol);
+    int numDifferences = 0;
+
+    if (Rf_length(expected) != Rf_length(actual))
+    {
+        printf("%s: %d columns, expected %d\n", label, Rf_length(actual), Rf_length(expected));
+        return 1;
+    }
+
+    for (int c = 0; c < Rf_length(expected); ++c)
+    {
+        SEXP expectedColumn = VECTOR_ELT(expected, c);
+        SEXP actualColumn = VECTOR_ELT(actual, c);
+
+        if (Rf_length(expectedColumn) != Rf_length(actualColumn))
+        {
+            printf("%s: %d rows, expected %d\n", label, Rf_length(actualColumn), Rf_length(expectedColumn));
+            return 1;
+        }
+
+        for (int r = 0; r < Rf_length(expectedColumn); ++r)
+        {
+            string expectedCell = GetCell(expectedColumn, r);
+            string actualCell = GetCell(actualColumn, r);
+
+            if (expectedCell != actualCell && numDifferences++ < 5)
+                printf("%s: row %d %s is \"%s\", expected \"%s\"\n", label, r + 1,
+                       CHAR(STRING_ELT(names, c)), actualCell.c_str(), expectedCell.c_str());
+        }
+    }
+
+    return numDifferences;
+}
+
+
+
+
+/*
+ *  Function: CheckTables
+ *
+ *      Returns whether the tables built in parts are the same as those of
+ *      the full build, printing the outcome of the check.
+ *
+ */
+static bool CheckTables (const string& check, const List& expected, const List& actual)
+{
+    if (Rf_isNull(actual))
+    {
+        printf("FAIL %s: no tables\n", check.c_str());
+        return false;
+    }
+
+    const char* tableNames[] = { "animal_data", "impound_data", "discrepancy_data" };
+    int numDifferences = 0;
+
+    for (int t = 0; t < 3; ++t)
+    {
+        string label = check + " " + tableNames[t];
+
+        numDifferences += CountDifferences(label.c_str(), expected[tableNames[t]], actual[tableNames[t]]);
+    }
+
+    printf("%s %s: %d cells differ\n", numDifferences == 0 ? "ok  " : "FAIL", check.c_str(), numDifferences);
+
+    return numDifferences == 0;
+}
+
+
+
+
+/*
+ *  Function: CheckAtx
+ *
+ *      Checks the Austin tables built in parts against a full build.
+ *
+ */
+static bool CheckAtx (const List& data, int numParts)
+{
+    List expected = atxMakeTables(data["intake"], data["outcome"], false, true, R_NilValue, 0, string());
+    vector<DataFrame> intakes = SplitFrame(data["intake"], numParts);
+    vector<DataFrame> outcomes = SplitFrame(data["outcome"], numParts);
+    bool passed = true;
+
+    // Updates of a builder made from the first part.
+
+    SEXP builder = atxMakeBuilder(intakes[0], outcomes[0], R_NilValue);
+    List updated;
+
+    for (int p = 1; p < numParts; ++p)
+        updated = atxUpdateTables(builder, intakes[p], outcomes[p]);
+
+    passed &= CheckTables("atx update", expected, updated);
+
+    // Interleaved chunks, in memory and within a memory budget.
+
+    for (int spill = 0; spill < 2; ++spill)
+    {
+        builder = atxStartTables(R_NilValue, spill ? SpillBudget : 0, spill ? "." : "");
+
+        for (int p = 0; p < numParts; ++p)
+        {
+            atxAppendIntakes(builder, intakes[p]);
+            atxAppendOutcomes(builder, outcomes[p]);
+        }
+
+        string check = spill ? "atx append spilled" : "atx append";
+
+        passed &= CheckTables(check, expected, hmFinishTables(builder));
+        passed &= CheckTables(check + " finished again", expected, hmFinishTables(builder));
+    }
+
+    return passed;
+}
+
+
+
+
+/*
+ *  Function: CheckSac
+ *
+ *      Checks the Sacramento tables of a kind ("sac_open" or "sac_cpra")
+ *      built in parts against a full build.
+ *
+ */
+static bool CheckSac (const string& kind, const List& data, int numParts)
+{
+    List expected = sacMakeTables(data["impound"], false, true, R_NilValue, 0, string());
+    vector<DataFrame> impounds = SplitFrame(data["impound"], numParts);
+    bool passed = true;
+
+    SEXP builder = sacMakeBuilder(impounds[0], R_NilValue);
+    List updated;
+
+    for (int p = 1; p < numParts; ++p)
+        updated = sacUpdateTables(builder, impounds[p]);
+
+    passed &= CheckTables(kind + " update", expected, updated);
+
+    for (int spill = 0; spill < 2; ++spill)
+    {
+        builder = sacStartTables(kind == "sac_cpra", R_NilValue, spill ? SpillBudget : 0, spill ? "." : "");
+
+        for (int p = 0; p < numParts; ++p)
+            sacAppendImpounds(builder, impounds[p]);
+
+        string check = kind + (spill ? " append spilled" : " append");
+
+        passed &= CheckTables(check, expected, hmFinishTables(builder));
+        passed &= CheckTables(check + " finished again", expected, hmFinishTables(builder));
+    }
+
+    return passed;
+}
+
+
+
+
+/*
+ *  Function: main
+ *
+ *      Runs the checks of every kind of data set, and returns nonzero when
+ *      any fails.
+ *
+ */
+int main (int argc, char** argv)
+{
+    int numImpounds = argc > 1 ? atoi(argv[1]) : 20000;
+    int numParts = argc > 2 ? atoi(argv[2]) : 4;
+    bool passed = true;
+
+    passed &= CheckAtx(hmMakeSyntheticData("atx", numImpounds, 0.25, 0.05, 0.1, 1), numParts);
+    passed &= CheckSac("sac_open", hmMakeSyntheticData("sac_open", numImpounds, 0.25, 0.05, 0.1, 1), numParts);
+    passed &= CheckSac("sac_cpra", hmMakeSyntheticData("sac_cpra", numImpounds, 0.25, 0.05, 0.1, 1), numParts);
+
+    return passed ? 0 : 1;
+}